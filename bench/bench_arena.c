@@ -0,0 +1,66 @@
+/**
+ * @file bench_arena.c
+ * @brief 内存区和对象池基准测试
+ * @details 按TCP连接发送缓冲的用法比较malloc/free与对象池：单线程中始终保留64个对象，
+ *          每次释放最早的一个再分配一个新的；malloc方式按应答长度（64到1232字节随机）申请，
+ *          对象池方式取与连接发送缓冲相同大小的定长对象
+ */
+
+#include "dns_arena.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PAIRS 20000000
+#define OBJECT_SIZE 2048            // 与dns_tcp.c中池化的发送缓冲大小相同
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static size_t replyLength(uint32_t* seed) {
+    return 64 + nextRandom(seed) % (1232 - 64);
+}
+
+int main(void) {
+    uint32_t seed = 88172645u;
+    static void* ring[64];
+    uint64_t start;
+
+    // 单线程：每次分配后保留64个对象，再释放最早的一个
+    start = dnsNowNs();
+    for (int i = 0; i < PAIRS; i++) {
+        void** slot = &ring[i & 63];
+        free(*slot);
+        *slot = malloc(replyLength(&seed));
+    }
+    double mallocNs = (double)(dnsNowNs() - start) / PAIRS;
+    for (int i = 0; i < 64; i++) {
+        free(ring[i]);
+        ring[i] = NULL;
+    }
+
+    Arena arena;
+    SlabPool pool;
+    arenaInit(&arena, 0);
+    slabInit(&pool, &arena, OBJECT_SIZE, 0);
+    start = dnsNowNs();
+    for (int i = 0; i < PAIRS; i++) {
+        void** slot = &ring[i & 63];
+        slabFree(&pool, *slot);
+        *slot = slabAlloc(&pool);
+        (void)replyLength(&seed);
+    }
+    double slabNs = (double)(dnsNowNs() - start) / PAIRS;
+    for (int i = 0; i < 64; i++) slabFree(&pool, ring[i]);
+    slabCheckLeaks(&pool, "单线程");
+    arenaDestroy(&arena);
+
+    printf("单线程: malloc/free %.1f ns，对象池 %.1f ns\n", mallocNs, slabNs);
+    printf("RESULT malloc_ns=%.1f slab_ns=%.1f\n", mallocNs, slabNs);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file bench_cache.c
+ * @brief 响应缓存的键区分测试和命中路径基准测试
+ * @details 先对同一个名字分别写入不带EDNS、带EDNS和带EDNS且DO=1的上游响应，
+ *          检查每种查询命中的都是与自己匹配的那份应答：不带EDNS的客户端拿不到OPT记录，
+ *          DO位也不会混用；再写入一份超过512字节的应答，检查按512字节上限查找时命中的是
+ *          置了TC的截断应答而不是未命中；有任何不一致即退出并返回1。
+ *          之后测量缓存命中时cacheLookup的平均耗时
+ */
+
+#include "dns_cache.h"
+#include "dns_message.h"
+#include <stdio.h>
+#include <string.h>
+
+#define ITERATIONS 5000000
+#define NAME_COUNT 1024
+
+// 构造A查询；edns为真时附加一条OPT伪记录，do为真时在其中置DO位
+static size_t makeQuery(char* packet, const char* name, uint16_t id, int edns, int dnssecOk) {
+    memset(packet, 0, 12);
+    packet[0] = (char)(id >> 8);
+    packet[1] = (char)id;
+    packet[2] = 0x01;                                       // RD
+    packet[5] = 1;                                          // QDCOUNT
+    packet[11] = edns ? 1 : 0;                              // ARCOUNT
+    size_t pos = 12;
+    const char* label = name;
+    while (*label) {
+        const char* dot = strchr(label, '.');
+        size_t labelLength = dot ? (size_t)(dot - label) : strlen(label);
+        packet[pos++] = (char)labelLength;
+        memcpy(packet + pos, label, labelLength);
+        pos += labelLength;
+        label += labelLength + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+    const char tail[4] = { 0, DNS_TYPE_A, 0, DNS_CLASS_IN };
+    memcpy(packet + pos, tail, sizeof(tail));
+    pos += sizeof(tail);
+    if (edns) {
+        const char opt[11] = { 0, 0, DNS_TYPE_OPT, 0x04, (char)0xD0, 0, 0,
+                               (char)(dnssecOk ? 0x80 : 0), 0, 0, 0 };
+        memcpy(packet + pos, opt, sizeof(opt));
+        pos += sizeof(opt);
+    }
+    return pos;
+}
+
+// 构造上游响应：一条A记录，查询带OPT时原样带回OPT
+static size_t makeResponse(char* response, const char* query, size_t queryLength, int edns) {
+    size_t questionEnd = queryLength - (edns ? 11 : 0);
+    memcpy(response, query, questionEnd);
+    response[2] = (char)0x81;
+    response[3] = (char)0x80;
+    response[7] = 1;                                        // ANCOUNT
+    const char answer[16] = { (char)0xC0, 12, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, 0, 0, 0x0E, 0x10, 0, 4,
+                              10, 0, 0, (char)(edns ? 2 : 1) };
+    memcpy(response + questionEnd, answer, sizeof(answer));
+    size_t length = questionEnd + sizeof(answer);
+    if (edns) {
+        memcpy(response + length, query + questionEnd, 11);
+        length += 11;
+    }
+    return length;
+}
+
+// 同一名字的三种查询各自命中自己的应答，返回0表示有不一致
+static int keyTest(ResponseCache* cache) {
+    static const struct { int edns; int dnssecOk; } variants[] = { { 0, 0 }, { 1, 0 }, { 1, 1 } };
+    char query[512];
+    char response[512];
+    char reply[512];
+    int refresh = 0;
+
+    for (int stored = 0; stored < 3; stored++) {
+        // 只写入前stored+1种，未写入的种类必须未命中，而不是拿到别人的应答
+        size_t queryLength = makeQuery(query, "edns.example.com", 1, variants[stored].edns,
+                                       variants[stored].dnssecOk);
+        size_t responseLength = makeResponse(response, query, queryLength, variants[stored].edns);
+        cacheStore(cache, query, queryLength, response, responseLength);
+
+        for (int v = 0; v < 3; v++) {
+            queryLength = makeQuery(query, "edns.example.com", (uint16_t)(100 + v), variants[v].edns,
+                                    variants[v].dnssecOk);
+            size_t replyLength = cacheLookup(cache, query, queryLength, reply, sizeof(reply), sizeof(reply),
+                                             &refresh);
+            if (v > stored) {
+                if (replyLength != 0) {
+                    fprintf(stderr, "第%d种查询命中了其他种类的应答\n", v);
+                    return 0;
+                }
+                continue;
+            }
+            int hasOpt = replyLength >= 12 && reply[11] == 1;
+            int dnssecOk = hasOpt && (reply[replyLength - 4] & 0x80) != 0;
+            if (replyLength == 0 || (uint8_t)reply[1] != 100 + v ||
+                hasOpt != variants[v].edns || dnssecOk != variants[v].dnssecOk) {
+                fprintf(stderr, "第%d种查询的缓存应答不匹配: 长度%zu OPT=%d DO=%d\n",
+                        v, replyLength, hasOpt, dnssecOk);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// 超出客户端上限的条目按上限截断后返回，放得下时返回完整应答，返回0表示有不一致
+static int oversizeTest(ResponseCache* cache) {
+    char query[512];
+    char response[2048];
+    char reply[2048];
+    int refresh = 0;
+
+    size_t queryLength = makeQuery(query, "big.example.com", 1, 0, 0);
+    size_t responseLength = makeResponse(response, query, queryLength, 0);
+    for (int i = 1; i < 64; i++) {                          // 64条A记录，共1000多字节
+        memcpy(response + responseLength, response + queryLength, 16);
+        response[responseLength + 15] = (char)i;
+        responseLength += 16;
+    }
+    response[7] = 64;
+    cacheStore(cache, query, queryLength, response, responseLength);
+
+    queryLength = makeQuery(query, "big.example.com", 200, 0, 0);
+    size_t replyLength = cacheLookup(cache, query, queryLength, reply, sizeof(reply), DNS_CLASSIC_UDP_SIZE,
+                                     &refresh);
+    if (replyLength == 0 || replyLength > DNS_CLASSIC_UDP_SIZE || !(reply[2] & 0x02) ||
+        (uint8_t)reply[1] != 200 || memcmp(reply + 12, query + 12, queryLength - 12) != 0) {
+        fprintf(stderr, "超长条目未按上限截断: 长度%zu\n", replyLength);
+        return 0;
+    }
+    replyLength = cacheLookup(cache, query, queryLength, reply, sizeof(reply), sizeof(reply), &refresh);
+    if (replyLength != responseLength || (reply[2] & 0x02)) {
+        fprintf(stderr, "放得下的超长条目未完整返回: 长度%zu\n", replyLength);
+        return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    ResponseCache* cache = createCache(CACHE_DEFAULT_BYTES, 1, CACHE_DEFAULT_STALE);
+    if (!cache) return 1;
+    if (!keyTest(cache) || !oversizeTest(cache)) {
+        destroyCache(cache);
+        return 1;
+    }
+    printf("键区分测试通过\n");
+
+    static char queries[NAME_COUNT][128];
+    static size_t queryLengths[NAME_COUNT];
+    char name[64];
+    char response[512];
+    for (int i = 0; i < NAME_COUNT; i++) {
+        snprintf(name, sizeof(name), "host%d.bench.example.com", i);
+        queryLengths[i] = makeQuery(queries[i], name, (uint16_t)i, i & 1, 0);
+        size_t responseLength = makeResponse(response, queries[i], queryLengths[i], i & 1);
+        cacheStore(cache, queries[i], queryLengths[i], response, responseLength);
+    }
+
+    char reply[512];
+    int refresh = 0;
+    size_t checksum = 0;
+    uint64_t start = dnsNowNs();
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t n = i % NAME_COUNT;
+        checksum += cacheLookup(cache, queries[n], queryLengths[n], reply, sizeof(reply), sizeof(reply),
+                                &refresh);
+    }
+    double lookupNs = (double)(dnsNowNs() - start) / ITERATIONS;
+    printf("命中查找: %.1f ns/次（校验和 %zu）\n", lookupNs, checksum);
+    printf("RESULT lookup_ns=%.1f\n", lookupNs);
+
+    destroyCache(cache);
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file bench_index.c
+ * @brief 域名索引微基准测试
+ * @details 在1k、100k、1M条记录规模下，对比哈希索引与原先逐条strcmp顺序扫描的查找耗时
+ */
+
+#include "dns_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 原先resolveLocally的实现方式：并行数组 + 顺序扫描
+typedef struct {
+    char** domains;
+    uint32_t* ips;
+    size_t count;
+} LinearTable;
+
+static int linearLookup(const LinearTable* table, const char* domain, uint32_t* ip) {
+    for (size_t i = 0; i < table->count; i++) {
+        if (strcmp(table->domains[i], domain) == 0) {
+            *ip = table->ips[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void makeName(char* buf, size_t size, uint32_t n) {
+    snprintf(buf, size, "host%u.zone%u.example.com", n, n % 97);
+}
+
+static double elapsedNs(clock_t start, clock_t end, size_t ops) {
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / (double)ops;
+}
+
+static void runBench(size_t entries) {
+    char name[64];
+    LinearTable table;
+    DomainIndex index;
+
+    table.domains = (char**)malloc(entries * sizeof(char*));
+    table.ips = (uint32_t*)malloc(entries * sizeof(uint32_t));
+    table.count = entries;
+    if (!table.domains || !table.ips || !domainIndexInit(&index, entries)) {
+        fprintf(stderr, "内存分配失败\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < entries; i++) {
+        makeName(name, sizeof(name), (uint32_t)i);
+        table.domains[i] = (char*)malloc(strlen(name) + 1);
+        strcpy(table.domains[i], name);
+        table.ips[i] = (uint32_t)i;
+        domainIndexInsert(&index, name, (uint32_t)i, NULL);
+    }
+
+    // 查询集合：一半命中，一半未命中
+    const size_t queryCount = 4096;
+    char (*queries)[64] = malloc(queryCount * sizeof(*queries));
+    uint32_t seed = 2463534242u;
+    for (size_t i = 0; i < queryCount; i++) {
+        uint32_t r = nextRandom(&seed);
+        if (r & 1) {
+            makeName(queries[i], sizeof(queries[i]), r % (uint32_t)entries);
+        } else {
+            snprintf(queries[i], sizeof(queries[i]), "miss%u.example.org", r);
+        }
+    }
+
+    // 顺序扫描耗时随规模线性增长，控制总比较次数
+    size_t linearOps = 200000000 / entries;
+    if (linearOps < 64) linearOps = 64;
+    if (linearOps > queryCount) linearOps = queryCount;
+    size_t indexOps = 4000000;
+
+    uint32_t ip;
+    size_t hits = 0;
+    clock_t start = clock();
+    for (size_t i = 0; i < linearOps; i++) {
+        hits += linearLookup(&table, queries[i % queryCount], &ip);
+    }
+    clock_t end = clock();
+    double linearNs = elapsedNs(start, end, linearOps);
+
+    start = clock();
+    for (size_t i = 0; i < indexOps; i++) {
+        hits += domainIndexLookup(&index, queries[i % queryCount], &ip);
+    }
+    end = clock();
+    double indexNs = elapsedNs(start, end, indexOps);
+
+    printf("%8zu 条记录: 顺序扫描 %12.1f ns/次  哈希索引 %8.1f ns/次  加速比 %10.1fx  (命中计数 %zu)\n",
+           entries, linearNs, indexNs, indexNs > 0 ? linearNs / indexNs : 0.0, hits);
+
+    for (size_t i = 0; i < entries; i++) {
+        free(table.domains[i]);
+    }
+    free(table.domains);
+    free(table.ips);
+    free(queries);
+    domainIndexFree(&index);
+}
+
+int main(void) {
+    static const size_t sizes[] = { 1000, 100000, 1000000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        runBench(sizes[i]);
+    }
+    return 0;
+}
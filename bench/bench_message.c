@@ -0,0 +1,249 @@
+/**
+ * @file bench_message.c
+ * @brief 本地应答路径基准测试
+ * @details 对查询报文执行解析、本地查找和原地构建应答，统计每次应答的耗时和堆分配次数。
+ *          分别测量逐字段编码记录的构建器（resolveLocally + buildLocalAnswer）和
+ *          复制预编码记录的模板路径（qnameNormalize + resolveLocalAnswer），测量前先确认两者的应答逐字节相同；
+ *          另外单独测量构建应答这一步（不含解析和查找），并单独列出多地址名字的结果。
+ *          规则须来自文本文件（精确规则），运行时复制到bench_message.txt并追加一个带8个IPv4和
+ *          8个IPv6地址的名字，使截断前的整段记录复制也被覆盖。
+ *          glibc下通过替换malloc系列函数计数，本地应答路径的分配次数应为0
+ */
+
+#include "dns_message.h"
+#include "dns_resolver.h"
+#include "dns_qname.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t allocationCount = 0;
+
+#ifdef __GLIBC__
+// 覆盖malloc系列函数以统计堆分配次数
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) { allocationCount++; return __libc_malloc(size); }
+void* calloc(size_t count, size_t size) { allocationCount++; return __libc_calloc(count, size); }
+void* realloc(void* ptr, size_t size) { allocationCount++; return __libc_realloc(ptr, size); }
+void free(void* ptr) { __libc_free(ptr); }
+#define ALLOCATION_COUNTING 1
+#endif
+
+// 构造一个查询
+static size_t makeQuery(char* packet, const char* domain, uint16_t id, uint16_t qtype) {
+    struct DNSHeader* header = (struct DNSHeader*)packet;
+    memset(header, 0, sizeof(*header));
+    header->id = htons(id);
+    header->flags = htons(0x0100);
+    header->qdcount = htons(1);
+
+    size_t pos = sizeof(struct DNSHeader);
+    const char* label = domain;
+    while (*label) {
+        const char* dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        packet[pos++] = (char)len;
+        memcpy(packet + pos, label, len);
+        pos += len;
+        label += len + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+    packet[pos++] = (char)(qtype >> 8); packet[pos++] = (char)qtype;
+    packet[pos++] = 0; packet[pos++] = 1;  // QCLASS IN
+    return pos;
+}
+
+// 逐字段编码记录的构建器
+static size_t answerWithBuilder(DNSResolver* resolver, const char* query, size_t length,
+                            char* response, size_t responseSize) {
+    DNSQuestion question;
+    char domain[DNS_MAX_NAME_LEN + 1];
+    if (!parseDNSQuery(query, length, &question) ||
+        questionDomain(query, &question, domain, sizeof(domain)) == 0) {
+        return buildErrorResponse(query, length, DNS_RCODE_FORMERR, response, responseSize);
+    }
+
+    AddressList addresses;
+    EdnsInfo edns;
+    if (!resolveLocally(resolver, domain, &addresses) ||
+        !parseEdns(query, length, &question, &edns)) {
+        return 0;
+    }
+    size_t limit = udpResponseLimit(&edns);
+    if (limit > responseSize) limit = responseSize;
+    return buildLocalAnswer(response, limit, query, &question, &edns, &addresses);
+}
+
+// 与handleQuery本地应答分支相同的处理步骤：复制预编码的记录
+static size_t answerWithTemplate(DNSResolver* resolver, const char* query, size_t length,
+                                 char* response, size_t responseSize) {
+    DNSQuestion question;
+    char domain[DNS_MAX_NAME_LEN + 1];
+    uint32_t hash;
+    size_t domainLength;
+    if (!parseDNSQuery(query, length, &question) ||
+        (domainLength = qnameNormalize(query, length, question.nameOffset, domain, &hash)) == 0) {
+        return buildErrorResponse(query, length, DNS_RCODE_FORMERR, response, responseSize);
+    }
+
+    EdnsInfo edns;
+    LocalAnswer answer;
+    if (!parseEdns(query, length, &question, &edns)) return 0;
+    size_t limit = udpResponseLimit(&edns);
+    if (limit > responseSize) limit = responseSize;
+    if (!resolveLocalAnswer(resolver, domain, domainLength, hash, query, &question, &edns,
+                            response, limit, &answer)) {
+        return 0;
+    }
+    return answer.length;
+}
+
+typedef size_t (*AnswerFunction)(DNSResolver*, const char*, size_t, char*, size_t);
+
+#define NAME_COUNT 5
+#define QUERY_COUNT (NAME_COUNT * 3)
+#define MULTI_NAME "multi.bench.test"
+#define MULTI_ADDRESSES 8
+#define ITERATIONS 5000000
+
+// 轮流应答全部查询，返回每次应答的平均耗时（纳秒）
+static double measure(AnswerFunction answer, DNSResolver* resolver, char queries[][512],
+                      const size_t* lengths, size_t* allocations, size_t* totalBytes) {
+    char response[512];
+    // 预热：线程首次查询时注册回收记录，属于一次性分配
+    answer(resolver, queries[0], lengths[0], response, sizeof(response));
+
+    size_t allocationsBefore = allocationCount;
+    size_t bytes = 0;
+    uint64_t start = dnsNowNs();
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t n = i % QUERY_COUNT;
+        bytes += answer(resolver, queries[n], lengths[n], response, sizeof(response));
+    }
+    uint64_t end = dnsNowNs();
+    *allocations = allocationCount - allocationsBefore;
+    *totalBytes = bytes;
+    return (double)(end - start) / (double)ITERATIONS;
+}
+
+// 只测量构建应答这一步：地址和集合事先查好，比较逐字段编码与复制模板。
+// 只轮流使用编号first起、间隔step的查询
+static void measureBuildOnly(DNSResolver* resolver, char queries[][512], const size_t* lengths,
+                             size_t first, size_t step, double* builderNs, double* templateNs) {
+    const ResolverSnapshot* snapshot = atomic_load(&resolver->current);
+    DNSQuestion questions[QUERY_COUNT];
+    EdnsInfo edns[QUERY_COUNT];
+    AddressList addresses[QUERY_COUNT];
+    uint32_t sets[QUERY_COUNT];
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        char domain[DNS_MAX_NAME_LEN + 1];
+        parseDNSQuery(queries[i], lengths[i], &questions[i]);
+        parseEdns(queries[i], lengths[i], &questions[i], &edns[i]);
+        questionDomain(queries[i], &questions[i], domain, sizeof(domain));
+        resolveLocally(resolver, domain, &addresses[i]);
+        domainIndexLookup(&snapshot->index, domain, &sets[i]);
+    }
+
+    char response[512];
+    size_t bytes = 0;
+    uint64_t start = dnsNowNs();
+    size_t used = (QUERY_COUNT - first + step - 1) / step;
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t n = first + (i % used) * step;
+        bytes += buildLocalAnswer(response, sizeof(response), queries[n], &questions[n], &edns[n], &addresses[n]);
+    }
+    uint64_t middle = dnsNowNs();
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t n = first + (i % used) * step;
+        bytes += buildTemplateAnswer(response, sizeof(response), queries[n], &questions[n], &edns[n],
+                                     &snapshot->answers, &snapshot->addresses.sets[sets[n]], sets[n]);
+    }
+    uint64_t end = dnsNowNs();
+    *builderNs = (double)(middle - start) / (double)ITERATIONS;
+    *templateNs = (double)(end - middle) / (double)ITERATIONS;
+    if (bytes == 0) printf("\n");  // 防止循环被优化掉
+}
+
+static void report(const char* label, double ns, size_t allocations, size_t totalBytes) {
+    printf("%s: %.1f ns/次, 共%zu字节\n", label, ns, totalBytes);
+#ifdef ALLOCATION_COUNTING
+    printf("堆分配: %zu 次 / %d 次应答\n", allocations, ITERATIONS);
+#else
+    (void)allocations;
+    printf("堆分配: 当前平台不支持计数\n");
+#endif
+}
+
+// 复制域名文件并追加多地址的名字
+static int writeRules(const char* path, const char* mapFile) {
+    FILE* in = fopen(mapFile, "r");
+    if (!in) return 0;
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fclose(in);
+        return 0;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), in)) {
+        fputs(line, out);
+    }
+    fclose(in);
+    fputc('\n', out);
+    for (int i = 0; i < MULTI_ADDRESSES; i++) {
+        fprintf(out, "10.0.0.%d %s\n", i + 1, MULTI_NAME);
+        fprintf(out, "2001:db8::%d %s\n", i + 1, MULTI_NAME);
+    }
+    return fclose(out) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* mapFile = argc > 1 ? argv[1] : "dnsrelay.txt";
+    const char* ruleFile = "bench_message.txt";
+    DNSResolver* resolver = createResolver();
+    if (!resolver || !writeRules(ruleFile, mapFile) || !loadDomainMap(resolver, ruleFile)) {
+        fprintf(stderr, "无法加载域名文件 %s\n", mapFile);
+        return 1;
+    }
+
+    static const char* names[NAME_COUNT] = { "test1", "www.y.com.cn", "WWW.FM1058.CC", "008.cn", MULTI_NAME };
+    static const uint16_t qtypes[] = { DNS_TYPE_A, DNS_TYPE_AAAA, DNS_TYPE_ANY };
+    char queries[QUERY_COUNT][512];
+    size_t lengths[QUERY_COUNT];
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        lengths[i] = makeQuery(queries[i], names[i % NAME_COUNT], (uint16_t)(0x1000 + i), qtypes[i / NAME_COUNT]);
+    }
+
+    // 两条路径的应答必须逐字节相同
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        char expected[512], actual[512];
+        size_t expectedLength = answerWithBuilder(resolver, queries[i], lengths[i], expected, sizeof(expected));
+        size_t actualLength = answerWithTemplate(resolver, queries[i], lengths[i], actual, sizeof(actual));
+        if (expectedLength != actualLength || memcmp(expected, actual, expectedLength) != 0) {
+            fprintf(stderr, "模板应答与构建器不一致: %s 类型%u\n", names[i % NAME_COUNT],
+                    (unsigned)qtypes[i / NAME_COUNT]);
+            return 1;
+        }
+    }
+
+    size_t builderAllocations, templateAllocations, builderBytes, templateBytes;
+    double builderNs = measure(answerWithBuilder, resolver, queries, lengths, &builderAllocations, &builderBytes);
+    double templateNs = measure(answerWithTemplate, resolver, queries, lengths, &templateAllocations, &templateBytes);
+    double builderBuildNs, templateBuildNs, builderMultiNs, templateMultiNs;
+    measureBuildOnly(resolver, queries, lengths, 0, 1, &builderBuildNs, &templateBuildNs);
+    measureBuildOnly(resolver, queries, lengths, NAME_COUNT - 1, NAME_COUNT, &builderMultiNs, &templateMultiNs);
+    report("逐字段构建", builderNs, builderAllocations, builderBytes);
+    report("模板应答", templateNs, templateAllocations, templateBytes);
+    printf("仅构建应答: 逐字段 %.1f ns/次，模板 %.1f ns/次\n", builderBuildNs, templateBuildNs);
+    printf("仅构建应答（%s）: 逐字段 %.1f ns/次，模板 %.1f ns/次\n", MULTI_NAME, builderMultiNs, templateMultiNs);
+    printf("RESULT builder_ns=%.1f template_ns=%.1f builder_build_ns=%.1f template_build_ns=%.1f "
+           "builder_multi_ns=%.1f template_multi_ns=%.1f builder_allocs=%zu template_allocs=%zu\n",
+           builderNs, templateNs, builderBuildNs, templateBuildNs, builderMultiNs, templateMultiNs,
+           builderAllocations, templateAllocations);
+
+    destroyResolver(resolver);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file bench_prefilter.c
+ * @brief 规则预过滤器基准测试
+ * @details 生成一份合成的域名映射文件（默认500万条规则，1%为通配符规则），分别在不建和建立
+ *          预过滤器的情况下加载，测量两种查询负载的每秒查找次数：全部未命中（生产环境中大部分查询
+ *          既不被屏蔽也不在本地规则中），以及命中与未命中各半。
+ *          未命中的名字与规则同属一个区域（missN.zoneM.example.com），后缀树要逐级走到最后一个标签。
+ *          另外统计过滤器对未命中名字的误判率和过滤器占用的内存
+ */
+
+#include "dns_resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_RULES 5000000
+#define LOOKUPS 4000000
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void makeName(char* buf, size_t size, uint32_t n) {
+    snprintf(buf, size, "host%u.zone%u.example.com", n, n % 97);
+}
+
+static void makeMiss(char* buf, size_t size, uint32_t n) {
+    snprintf(buf, size, "miss%u.zone%u.example.com", n, n % 97);
+}
+
+static int writeRules(const char* path, size_t rules) {
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+    char name[64];
+    uint32_t seed = 2463534242u;
+    for (size_t i = 0; i < rules; i++) {
+        uint32_t r = nextRandom(&seed);
+        makeName(name, sizeof(name), (uint32_t)i);
+        const char* prefix = (i % 100 == 99) ? "*." : "";
+        if (r % 10 < 2) {
+            fprintf(file, "0.0.0.0 %s%s\n", prefix, name);
+        } else {
+            fprintf(file, "100.%u.%u.%u %s%s\n", (r >> 8) & 0xFF, (r >> 16) & 0xFF,
+                    (r >> 24) & 0xFF, prefix, name);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+// 返回每秒查找次数；hitPercent为命中规则的查询占比
+static double measure(DNSResolver* resolver, size_t rules, int hitPercent, size_t* hits) {
+    char name[64];
+    AddressList addresses;
+    uint32_t seed = 88172645u;
+    *hits = 0;
+    uint64_t start = dnsNowNs();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        uint32_t r = nextRandom(&seed);
+        if ((int)(r % 100) < hitPercent) {
+            makeName(name, sizeof(name), (r >> 7) % (uint32_t)rules);
+        } else {
+            makeMiss(name, sizeof(name), r >> 7);
+        }
+        *hits += (size_t)resolveLocally(resolver, name, &addresses);
+    }
+    return (double)LOOKUPS * 1e9 / (double)(dnsNowNs() - start);
+}
+
+// 过滤器对未命中名字判为“可能匹配”的比例
+static double falsePositiveRate(DNSResolver* resolver) {
+    const ResolverSnapshot* snapshot = atomic_load(&resolver->current);
+    char name[64];
+    uint32_t seed = 1234567u;
+    size_t positives = 0;
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        makeMiss(name, sizeof(name), nextRandom(&seed));
+        size_t length = strlen(name);
+        positives += (size_t)prefilterMayMatch(&snapshot->filter, name, length, hashDomain(name, length));
+    }
+    return (double)positives / LOOKUPS;
+}
+
+int main(int argc, char** argv) {
+    size_t rules = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_RULES;
+    const char* path = argc > 2 ? argv[2] : "bench_prefilter.txt";
+    if (rules == 0 || !writeRules(path, rules)) {
+        fprintf(stderr, "无法生成规则文件 %s\n", path);
+        return 1;
+    }
+
+    double missQps[2], mixedQps[2];
+    double fpr = 0.0;
+    size_t filterBytes = 0;
+    for (int filtered = 0; filtered < 2; filtered++) {
+        DNSResolver* resolver = createResolver();
+        if (!resolver) return 1;
+        resolver->prefilterBits = filtered ? PREFILTER_DEFAULT_BITS : 0;
+        uint64_t start = dnsNowNs();
+        if (!loadDomainMap(resolver, path)) {
+            fprintf(stderr, "加载规则文件失败\n");
+            return 1;
+        }
+        double loadMs = (double)(dnsNowNs() - start) / 1e6;
+
+        size_t missHits, mixedHits;
+        missQps[filtered] = measure(resolver, rules, 0, &missHits);
+        mixedQps[filtered] = measure(resolver, rules, 50, &mixedHits);
+        printf("%s: 加载 %.0f ms，全部未命中 %.2f M次/秒（命中 %zu），命中一半 %.2f M次/秒（命中 %zu）\n",
+               filtered ? "预过滤器" : "无过滤器", loadMs, missQps[filtered] / 1e6, missHits,
+               mixedQps[filtered] / 1e6, mixedHits);
+        if (filtered) {
+            const ResolverSnapshot* snapshot = atomic_load(&resolver->current);
+            filterBytes = (size_t)snapshot->filter.blockCount * 32;
+            fpr = falsePositiveRate(resolver);
+            printf("过滤器: %.1f MB（%u位/键），未命中名字的误判率 %.3f%%\n",
+                   (double)filterBytes / (1024.0 * 1024.0), resolver->prefilterBits, fpr * 100.0);
+        }
+        destroyResolver(resolver);
+    }
+
+    printf("RESULT rules=%zu filter_bytes=%zu fpr=%.5f miss_qps=%.0f miss_qps_filtered=%.0f "
+           "mixed_qps=%.0f mixed_qps_filtered=%.0f\n",
+           rules, filterBytes, fpr, missQps[0], missQps[1], mixedQps[0], mixedQps[1]);
+    remove(path);
+    return 0;
+}
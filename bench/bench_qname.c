@@ -0,0 +1,206 @@
+/**
+ * @file bench_qname.c
+ * @brief 查询域名规范化的差分测试和吞吐量基准测试
+ * @details 先用随机生成的线格式域名（含大小写、高位字节、0字节、超长标签、压缩指针和截断的报文）
+ *          对比每种实现（含标量实现）与逐字节参考实现的返回值、输出和哈希，
+ *          有任何不一致即退出并返回1。
+ *          之后用一组常见长度的域名测量每种实现的吞吐量，并与原先的路径
+ *          （questionDomain + normalizeDomain + hashDomain）比较
+ */
+
+#include "dns_qname.h"
+#include "dns_index.h"
+#include "dns_message.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_CASES 1000000
+#define CORPUS_SIZE 4096
+#define ITERATIONS 20000000
+#define HEADER_SIZE 12
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// 逐字节的参考实现：与qnameNormalize的约定相同，不追求速度
+static size_t referenceNormalize(const uint8_t* packet, size_t length, size_t offset,
+                                 char* name, uint32_t* hash) {
+    size_t pos = offset;
+    size_t out = 0;
+    for (;;) {
+        if (pos >= length) return 0;
+        size_t labelLen = packet[pos++];
+        if (labelLen == 0) break;
+        if (labelLen > 63 || pos + labelLen > length) return 0;
+        if (out > 0) name[out++] = '.';
+        for (size_t i = 0; i < labelLen; i++) {
+            uint8_t c = packet[pos++];
+            if (c == 0) return 0;
+            name[out++] = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+        }
+        if (pos - offset >= 255) return 0;
+    }
+    if (out == 0) return 0;
+    name[out] = '\0';
+    *hash = hashDomain(name, out);
+    return out;
+}
+
+static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_";
+
+// 生成一个随机的查询报文，返回报文长度；域名可能无效
+static size_t randomPacket(uint8_t* packet, size_t size, uint32_t* seed) {
+    memset(packet, 0, HEADER_SIZE);
+    size_t pos = HEADER_SIZE;
+    uint32_t r = nextRandom(seed);
+    int labels = (int)(r % 9);
+    int longLabels = (r >> 4) % 4 == 0;
+    for (int l = 0; l < labels && pos < size - 80; l++) {
+        uint32_t s = nextRandom(seed);
+        size_t labelLen = longLabels ? 40 + s % 24 : 1 + s % 20;
+        if (s % 97 == 0) labelLen = 64 + (s >> 8) % 192;   // 超长标签或压缩指针
+        packet[pos++] = (uint8_t)labelLen;
+        if (labelLen > 63) break;
+        for (size_t i = 0; i < labelLen; i++) {
+            uint32_t c = nextRandom(seed);
+            if (c % 211 == 0) packet[pos++] = (uint8_t)(c >> 8);            // 任意字节（含0和'.'）
+            else packet[pos++] = (uint8_t)alphabet[(c >> 8) % (sizeof(alphabet) - 1)];
+        }
+    }
+    packet[pos++] = 0;
+    packet[pos++] = 0; packet[pos++] = DNS_TYPE_A;
+    packet[pos++] = 0; packet[pos++] = DNS_CLASS_IN;
+    // 偶尔截断报文
+    if ((r >> 8) % 13 == 0) pos = HEADER_SIZE + (r >> 12) % (pos - HEADER_SIZE + 1);
+    return pos;
+}
+
+static int differentialTest(void) {
+    uint8_t packet[1024];
+    uint32_t seed = 2463534242u;
+    size_t valid = 0;
+    for (size_t n = 0; n < FUZZ_CASES; n++) {
+        size_t length = randomPacket(packet, sizeof(packet), &seed);
+        char expected[DNS_MAX_NAME_LEN + 1];
+        uint32_t expectedHash = 0;
+        size_t expectedLength = referenceNormalize(packet, length, HEADER_SIZE, expected, &expectedHash);
+        valid += expectedLength > 0;
+
+        for (int impl = 0; impl < QNAME_IMPL_COUNT; impl++) {
+            if (!qnameImplSupported((QnameImpl)impl)) continue;
+            char actual[DNS_MAX_NAME_LEN + 1];
+            uint32_t hash = 0;
+            size_t actualLength = qnameNormalizeWith((QnameImpl)impl, (const char*)packet, length,
+                                                     HEADER_SIZE, actual, &hash);
+            if (actualLength != expectedLength ||
+                (expectedLength > 0 && (hash != expectedHash ||
+                                        memcmp(actual, expected, expectedLength + 1) != 0))) {
+                fprintf(stderr, "%s实现与参考实现不一致（第%zu例）: 期望%zu字节，得到%zu字节\n",
+                        qnameImplName((QnameImpl)impl), n, expectedLength, actualLength);
+                return 0;
+            }
+        }
+    }
+    printf("差分测试: %d 例一致（有效域名 %zu 例）\n", FUZZ_CASES, valid);
+    return 1;
+}
+
+// 常见长度的域名，大小写混合
+static size_t makeCorpus(uint8_t (*packets)[512], size_t* lengths) {
+    static const char* const zones[] = { "com", "net", "org", "cn", "com.cn", "co.uk" };
+    uint32_t seed = 88172645u;
+    size_t totalChars = 0;
+    for (size_t n = 0; n < CORPUS_SIZE; n++) {
+        uint8_t* packet = packets[n];
+        memset(packet, 0, HEADER_SIZE);
+        size_t pos = HEADER_SIZE;
+        uint32_t r = nextRandom(&seed);
+        int labels = 1 + (int)(r % 4);
+        for (int l = 0; l < labels; l++) {
+            size_t labelLen = 2 + nextRandom(&seed) % (l == 0 && (r & 0x100) ? 30 : 12);
+            packet[pos++] = (uint8_t)labelLen;
+            for (size_t i = 0; i < labelLen; i++) {
+                packet[pos++] = (uint8_t)alphabet[nextRandom(&seed) % 62];
+            }
+            totalChars += labelLen + 1;
+        }
+        const char* zone = zones[(r >> 12) % 6];
+        while (*zone) {
+            const char* dot = strchr(zone, '.');
+            size_t labelLen = dot ? (size_t)(dot - zone) : strlen(zone);
+            packet[pos++] = (uint8_t)labelLen;
+            memcpy(packet + pos, zone, labelLen);
+            pos += labelLen;
+            totalChars += labelLen + 1;
+            zone += labelLen + (dot ? 1 : 0);
+        }
+        packet[pos++] = 0;
+        packet[pos++] = 0; packet[pos++] = DNS_TYPE_A;
+        packet[pos++] = 0; packet[pos++] = DNS_CLASS_IN;
+        lengths[n] = pos;
+    }
+    return totalChars - CORPUS_SIZE;
+}
+
+// 原先的路径：先转换成点号形式，再规范化并计算哈希
+static size_t previousPath(const char* packet, size_t length, char* name, uint32_t* hash) {
+    DNSQuestion question;
+    char domain[DNS_MAX_NAME_LEN + 1];
+    (void)length;
+    question.nameOffset = HEADER_SIZE;                  // 报文已由parseDNSQuery校验过
+    if (questionDomain(packet, &question, domain, sizeof(domain)) == 0) {
+        return 0;
+    }
+    size_t n = normalizeDomain(domain, name);
+    if (n > 0) *hash = hashDomain(name, n);
+    return n;
+}
+
+int main(void) {
+    if (!differentialTest()) return 1;
+
+    static uint8_t packets[CORPUS_SIZE][512];
+    static size_t lengths[CORPUS_SIZE];
+    size_t corpusChars = makeCorpus(packets, lengths);
+    double averageLength = (double)corpusChars / CORPUS_SIZE;
+
+    char name[DNS_MAX_NAME_LEN + 1];
+    uint32_t hash = 0;
+    uint32_t checksum = 0;
+    uint64_t start = dnsNowNs();
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t n = i % CORPUS_SIZE;
+        checksum += (uint32_t)previousPath((const char*)packets[n], lengths[n], name, &hash) + hash;
+    }
+    double previousNs = (double)(dnsNowNs() - start) / ITERATIONS;
+    printf("原路径: %.1f ns/个, %.0f MB/s（平均域名长度 %.1f）\n",
+           previousNs, averageLength * 1e3 / previousNs, averageLength);
+
+    double results[QNAME_IMPL_COUNT] = { 0 };
+    for (int impl = 0; impl < QNAME_IMPL_COUNT; impl++) {
+        if (!qnameImplSupported((QnameImpl)impl)) {
+            printf("%s: 当前CPU不支持\n", qnameImplName((QnameImpl)impl));
+            continue;
+        }
+        start = dnsNowNs();
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            size_t n = i % CORPUS_SIZE;
+            checksum += (uint32_t)qnameNormalizeWith((QnameImpl)impl, (const char*)packets[n], lengths[n],
+                                                     HEADER_SIZE, name, &hash) + hash;
+        }
+        results[impl] = (double)(dnsNowNs() - start) / ITERATIONS;
+        printf("%s: %.1f ns/个, %.0f MB/s\n", qnameImplName((QnameImpl)impl),
+               results[impl], averageLength * 1e3 / results[impl]);
+    }
+    printf("运行时选择: %s（校验和 %08x）\n", qnameImplName(qnameSelectedImpl()), checksum);
+    printf("RESULT previous_ns=%.1f scalar_ns=%.1f sse2_ns=%.1f avx2_ns=%.1f selected=%s\n",
+           previousNs, results[QNAME_IMPL_SCALAR], results[QNAME_IMPL_SSE2], results[QNAME_IMPL_AVX2],
+           qnameImplName(qnameSelectedImpl()));
+    return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file bench_ratelimit.c
+ * @brief 客户端限速的开销和行为基准测试
+ * @details 测量rateLimiterCheck在三种情形下每次判定的耗时：
+ *          少数客户端（桶常驻缓存）、大量不同源地址（模拟伪造源地址的洪泛，桶表不断被替换）、
+ *          单个客户端持续超限（丢弃和slip路径）。
+ *          另外用模拟时钟检查放行速率：一个客户端以限速的4倍发送10秒，放行数应接近rate * 10 + burst
+ */
+
+#include "dns_ratelimit.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ITERATIONS 20000000
+#define RATE 100
+#define BURST 200
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// 地址由addressOf给出，时间每1024次前进1毫秒（与按批取时间的服务器相近）
+static double measure(RateLimiter* limiter, int scenario, size_t counts[3]) {
+    uint32_t seed = 2463534242u;
+    uint64_t clock = 1000000000ull;
+    counts[0] = counts[1] = counts[2] = 0;
+    uint64_t start = dnsNowNs();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        uint32_t address;
+        if (scenario == 0) address = 0x0A000000u | (i & 63);            // 64个客户端
+        else if (scenario == 1) address = nextRandom(&seed);            // 随机源地址
+        else address = 0x0A000001u;                                     // 单个客户端
+        if ((i & 1023) == 0) clock += 1000000;
+        counts[rateLimiterCheck(limiter, address, clock)]++;
+    }
+    return (double)(dnsNowNs() - start) / ITERATIONS;
+}
+
+int main(void) {
+    RateLimitConfig config = { RATE, BURST, RATE_DEFAULT_SLIP };
+    static const char* const names[] = { "64个客户端", "随机源地址", "单客户端超限" };
+    static const char* const keys[] = { "few_clients", "random_sources", "flood" };
+    double results[3];
+
+    for (int scenario = 0; scenario < 3; scenario++) {
+        RateLimiter* limiter = createRateLimiter(&config, RATE_DEFAULT_BUCKETS);
+        if (!limiter) return 1;
+        size_t counts[3];
+        results[scenario] = measure(limiter, scenario, counts);
+        printf("%s: %.1f ns/次（放行 %zu，丢弃 %zu，TC %zu）\n", names[scenario], results[scenario],
+               counts[RATE_PASS], counts[RATE_DROP], counts[RATE_SLIP]);
+        destroyRateLimiter(limiter);
+    }
+
+    // 以4倍速率发送10秒，检查放行数
+    RateLimiter* limiter = createRateLimiter(&config, RATE_DEFAULT_BUCKETS);
+    if (!limiter) return 1;
+    size_t counts[3] = { 0, 0, 0 };
+    uint64_t clock = 1000000000ull;
+    for (int i = 0; i < RATE * 4 * 10; i++) {
+        clock += 1000000000ull / (RATE * 4);
+        counts[rateLimiterCheck(limiter, 0x0A000001u, clock)]++;
+    }
+    destroyRateLimiter(limiter);
+    printf("4倍速率发送10秒: 放行 %zu（期望约 %d），丢弃 %zu，TC %zu\n",
+           counts[RATE_PASS], RATE * 10 + BURST, counts[RATE_DROP], counts[RATE_SLIP]);
+
+    printf("RESULT");
+    for (int scenario = 0; scenario < 3; scenario++) {
+        printf(" %s_ns=%.1f", keys[scenario], results[scenario]);
+    }
+    printf(" passed_10s=%zu expected_10s=%d\n", counts[RATE_PASS], RATE * 10 + BURST);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file bench_rules.c
+ * @brief 规则内存占用基准测试
+ * @details 生成一份合成的域名映射文件（默认100万条规则），用解析器加载后统计堆占用，
+ *          输出每条规则平均占用的字节数、加载耗时和本地查找耗时。
+ *          地址分布模仿dnsrelay.txt：约两成屏蔽（0.0.0.0），大部分规则共用少数几个地址，
+ *          其余为各不相同的地址；另有1%的通配符规则。
+ *          堆占用用glibc的mallinfo2统计，其他平台只输出耗时
+ */
+
+#include "dns_resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define DEFAULT_RULES 1000000
+#define LOOKUPS 2000000
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void makeName(char* buf, size_t size, uint32_t n) {
+    snprintf(buf, size, "host%u.zone%u.example.com", n, n % 97);
+}
+
+static size_t heapInUse(void) {
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static int writeRules(const char* path, size_t rules) {
+    static const char* const shared[] = {
+        "210.242.125.98", "202.108.33.32", "11.111.11.111", "61.135.169.121",
+        "192.168.1.1", "10.0.0.1", "127.0.0.1", "203.208.46.146"
+    };
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+
+    char name[64];
+    uint32_t seed = 2463534242u;
+    for (size_t i = 0; i < rules; i++) {
+        uint32_t r = nextRandom(&seed);
+        makeName(name, sizeof(name), (uint32_t)i);
+        const char* prefix = (i % 100 == 99) ? "*." : "";
+        if (r % 10 < 2) {
+            fprintf(file, "0.0.0.0 %s%s\n", prefix, name);
+        } else if (r % 10 < 8) {
+            fprintf(file, "%s %s%s\n", shared[(r >> 8) % 8], prefix, name);
+        } else {
+            fprintf(file, "100.%u.%u.%u %s%s\n", (r >> 8) & 0xFF, (r >> 16) & 0xFF,
+                    (r >> 24) & 0xFF, prefix, name);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv) {
+    size_t rules = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_RULES;
+    const char* path = argc > 2 ? argv[2] : "bench_rules.txt";
+    if (rules == 0 || !writeRules(path, rules)) {
+        fprintf(stderr, "无法生成规则文件 %s\n", path);
+        return 1;
+    }
+
+    DNSResolver* resolver = createResolver();
+    if (!resolver) return 1;
+    size_t heapBefore = heapInUse();
+    uint64_t start = dnsNowNs();
+    if (!loadDomainMap(resolver, path)) {
+        fprintf(stderr, "加载规则文件失败\n");
+        return 1;
+    }
+    double loadMs = (double)(dnsNowNs() - start) / 1e6;
+    size_t heapBytes = heapInUse() - heapBefore;
+    size_t loaded = atomic_load(&resolver->current)->ruleCount;
+
+    // 一半命中精确规则，一半未命中
+    char name[64];
+    AddressList addresses;
+    uint32_t seed = 88172645u;
+    size_t hits = 0;
+    start = dnsNowNs();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        uint32_t r = nextRandom(&seed);
+        if (r & 1) {
+            makeName(name, sizeof(name), r % (uint32_t)rules);
+        } else {
+            snprintf(name, sizeof(name), "miss%u.example.org", r);
+        }
+        hits += (size_t)resolveLocally(resolver, name, &addresses);
+    }
+    double lookupNs = (double)(dnsNowNs() - start) / LOOKUPS;
+
+    printf("%zu 条规则: 堆占用 %.1f MB，每条 %.1f 字节，加载 %.0f ms，查找 %.1f ns/次（命中 %zu）\n",
+           loaded, (double)heapBytes / (1024.0 * 1024.0),
+           loaded ? (double)heapBytes / (double)loaded : 0.0, loadMs, lookupNs, hits);
+    printf("RESULT rules=%zu heap_bytes=%zu bytes_per_rule=%.1f load_ms=%.0f lookup_ns=%.1f\n",
+           loaded, heapBytes, loaded ? (double)heapBytes / (double)loaded : 0.0, loadMs, lookupNs);
+
+    destroyResolver(resolver);
+    remove(path);
+    return 0;
+}
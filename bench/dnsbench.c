@@ -0,0 +1,396 @@
+/**
+ * @file dnsbench.c
+ * @brief UDP压测工具
+ * @details 向运行中的服务器持续发送查询，每个线程维持固定数量的未完成查询（闭环压测），
+ *          统计吞吐量和延迟分位数。查询来源可以是名称列表文件，也可以从域名映射文件中
+ *          按"本地命中/屏蔽/未命中"的比例生成；未命中的名称每次都不同，会经缓存转发到上游。
+ *          最后一行以key=value形式输出结果，便于脚本记录和比较
+ */
+
+#include "dns_platform.h"
+#include "dns_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define MAX_THREADS 64
+#define ID_SPACE 65536
+#define HIST_SUB_BITS 5                          // 每个2的幂区间再分32档，相对误差约3%
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB_COUNT)
+#define EXPIRE_INTERVAL_NS 100000000ULL          // 每100ms扫描一次超时查询
+
+// 查询类别
+enum { CLASS_LOCAL, CLASS_BLOCKED, CLASS_MISS, CLASS_COUNT };
+
+typedef struct {
+    char** names;
+    size_t count;
+    size_t capacity;
+} NameList;
+
+// 对数线性直方图（纳秒）
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+typedef struct {
+    struct sockaddr_in server;
+    int threads;
+    int window;                // 每个线程的未完成查询数
+    double seconds;
+    int timeoutMs;
+    int weights[CLASS_COUNT];  // 各类别的比例
+    NameList lists[CLASS_COUNT];
+} BenchConfig;
+
+typedef struct {
+    const BenchConfig* config;
+    int id;
+    DNSThread thread;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t lost;
+    uint64_t rcodes[16];
+    Histogram histogram;
+    uint64_t* sendTimes;       // 按查询ID记录发送时间，0表示空闲
+} BenchThread;
+
+static atomic_int benchRunning;
+
+static int histogramIndex(uint64_t value) {
+    if (value < 2 * HIST_SUB_COUNT) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (int)((value >> shift) & (HIST_SUB_COUNT - 1));
+}
+
+static uint64_t histogramValue(int index) {
+    if (index < 2 * HIST_SUB_COUNT) return (uint64_t)index;
+    int shift = index / HIST_SUB_COUNT - 1;
+    uint64_t sub = (uint64_t)(index % HIST_SUB_COUNT);
+    return (HIST_SUB_COUNT + sub) << shift;
+}
+
+static void histogramRecord(Histogram* h, uint64_t value) {
+    h->counts[histogramIndex(value)]++;
+    h->total++;
+    if (value > h->max) h->max = value;
+}
+
+static void histogramMerge(Histogram* dst, const Histogram* src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t histogramPercentile(const Histogram* h, double percentile) {
+    if (h->total == 0) return 0;
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) return histogramValue(i);
+    }
+    return h->max;
+}
+
+static int addName(NameList* list, const char* name) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        char** names = (char**)realloc(list->names, capacity * sizeof(char*));
+        if (!names) return 0;
+        list->names = names;
+        list->capacity = capacity;
+    }
+    list->names[list->count] = _strdup(name);
+    return list->names[list->count++] != NULL;
+}
+
+// 从域名映射文件生成本地命中和屏蔽名称（跳过通配规则）
+static int loadMapNames(BenchConfig* config, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        char* ip = strtok(line, " \t\r\n");
+        char* domain = strtok(NULL, " \t\r\n");
+        if (!ip || !domain || domain[0] == '*' || domain[0] == '.') continue;
+        int blocked = strcmp(ip, "0.0.0.0") == 0;
+        if (!addName(&config->lists[blocked ? CLASS_BLOCKED : CLASS_LOCAL], domain)) break;
+    }
+    fclose(file);
+    return 1;
+}
+
+// 读取名称列表文件，每行一个域名，全部按原样查询
+static int loadMixFile(BenchConfig* config, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        char* name = strtok(line, " \t\r\n");
+        if (name && !addName(&config->lists[CLASS_LOCAL], name)) break;
+    }
+    fclose(file);
+    return 1;
+}
+
+static size_t buildQuery(char* packet, const char* domain, uint16_t id) {
+    struct DNSHeader* header = (struct DNSHeader*)packet;
+    memset(header, 0, sizeof(*header));
+    header->id = htons(id);
+    header->flags = htons(0x0100);
+    header->qdcount = htons(1);
+
+    size_t pos = sizeof(struct DNSHeader);
+    const char* label = domain;
+    while (*label && pos < 300) {
+        const char* dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        if (len > 63) len = 63;
+        packet[pos++] = (char)len;
+        memcpy(packet + pos, label, len);
+        pos += len;
+        label += len + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+    packet[pos++] = 0; packet[pos++] = 1;  // QTYPE A
+    packet[pos++] = 0; packet[pos++] = 1;  // QCLASS IN
+    return pos;
+}
+
+static uint32_t nextRandom(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (uint32_t)(*state >> 32);
+}
+
+// 按比例选一个类别并取出名称；未命中类别每次生成新名称，避免被缓存
+static const char* pickName(BenchThread* self, uint64_t* rng, uint64_t* missCounter, char* buffer) {
+    const BenchConfig* config = self->config;
+    int total = config->weights[CLASS_LOCAL] + config->weights[CLASS_BLOCKED] +
+                config->weights[CLASS_MISS];
+    int roll = (int)(nextRandom(rng) % (uint32_t)total);
+    int cls = CLASS_LOCAL;
+    while (roll >= config->weights[cls]) {
+        roll -= config->weights[cls];
+        cls++;
+    }
+
+    if (cls == CLASS_MISS) {
+        snprintf(buffer, 128, "m%d-%llu.bench.invalid", self->id,
+                 (unsigned long long)(*missCounter)++);
+        return buffer;
+    }
+    const NameList* list = &config->lists[cls];
+    return list->names[nextRandom(rng) % list->count];
+}
+
+static void benchMain(void* arg) {
+    BenchThread* self = (BenchThread*)arg;
+    const BenchConfig* config = self->config;
+
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET ||
+        connect(sock, (const struct sockaddr*)&config->server, sizeof(config->server)) != 0) {
+        fprintf(stderr, "线程%d无法创建套接字\n", self->id);
+        return;
+    }
+    dnsSetNonBlocking(sock);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)(self->id + 1) * 0xBF58476D1CE4E5B9ULL);
+    uint64_t missCounter = 0;
+    uint16_t nextId = (uint16_t)nextRandom(&rng);
+    int outstanding = 0;
+    uint64_t timeoutNs = (uint64_t)config->timeoutMs * 1000000ULL;
+    uint64_t lastExpire = dnsNowNs();
+    char packet[512];
+    char nameBuffer[128];
+
+    while (atomic_load_explicit(&benchRunning, memory_order_relaxed)) {
+        // 补足窗口
+        while (outstanding < config->window) {
+            while (self->sendTimes[nextId]) nextId++;
+            const char* name = pickName(self, &rng, &missCounter, nameBuffer);
+            size_t length = buildQuery(packet, name, nextId);
+            uint64_t now = dnsNowNs();
+            if (send(sock, packet, (int)length, 0) < 0) break;
+            self->sendTimes[nextId++] = now;
+            self->sent++;
+            outstanding++;
+        }
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        struct timeval tv = { 0, 10000 };
+        select((int)sock + 1, &readSet, NULL, NULL, &tv);
+
+        for (;;) {
+            int n = recv(sock, packet, sizeof(packet), 0);
+            if (n < (int)sizeof(struct DNSHeader)) break;
+            uint64_t now = dnsNowNs();
+            uint16_t id = (uint16_t)(((unsigned char)packet[0] << 8) | (unsigned char)packet[1]);
+            uint64_t sentAt = self->sendTimes[id];
+            if (!sentAt) continue;  // 已判定超时的迟到应答
+            self->sendTimes[id] = 0;
+            outstanding--;
+            self->received++;
+            self->rcodes[packet[3] & 0x0F]++;
+            histogramRecord(&self->histogram, now - sentAt);
+        }
+
+        uint64_t now = dnsNowNs();
+        if (now - lastExpire >= EXPIRE_INTERVAL_NS) {
+            lastExpire = now;
+            for (int id = 0; id < ID_SPACE; id++) {
+                if (self->sendTimes[id] && now - self->sendTimes[id] > timeoutNs) {
+                    self->sendTimes[id] = 0;
+                    self->lost++;
+                    outstanding--;
+                }
+            }
+        }
+    }
+    closesocket(sock);
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "用法: %s [选项]\n", program);
+    fprintf(stderr, "  -s <地址[:端口]>  被测服务器（默认127.0.0.1:53）\n");
+    fprintf(stderr, "  -m <文件>   从域名映射文件生成查询（默认dnsrelay.txt）\n");
+    fprintf(stderr, "  -f <文件>   从名称列表文件读取查询，每行一个域名，忽略-p\n");
+    fprintf(stderr, "  -p <命中,屏蔽,未命中>  查询比例（默认70,20,10）\n");
+    fprintf(stderr, "  -d <秒>     压测时长（默认10）\n");
+    fprintf(stderr, "  -t <数量>   发送线程数（默认2）\n");
+    fprintf(stderr, "  -w <数量>   每个线程的未完成查询数（默认64）\n");
+    fprintf(stderr, "  -T <毫秒>   查询超时，超时计为丢失（默认1000）\n");
+}
+
+int main(int argc, char* argv[]) {
+    static BenchConfig config;
+    const char* mapFile = "dnsrelay.txt";
+    const char* mixFile = NULL;
+    const char* serverText = "127.0.0.1:53";
+    config.threads = 2;
+    config.window = 64;
+    config.seconds = 10;
+    config.timeoutMs = 1000;
+    config.weights[CLASS_LOCAL] = 70;
+    config.weights[CLASS_BLOCKED] = 20;
+    config.weights[CLASS_MISS] = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-s") == 0) serverText = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0) mapFile = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0) mixFile = argv[++i];
+        else if (strcmp(argv[i], "-d") == 0) config.seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0) config.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0) config.window = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0) config.timeoutMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0) {
+            if (sscanf(argv[++i], "%d,%d,%d", &config.weights[CLASS_LOCAL],
+                       &config.weights[CLASS_BLOCKED], &config.weights[CLASS_MISS]) != 3) {
+                fprintf(stderr, "错误: 无效的比例 %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!dnsNetInit()) return 1;
+    if (!dnsParseAddress(serverText, 53, &config.server)) {
+        fprintf(stderr, "错误: 无效的服务器地址 %s\n", serverText);
+        return 1;
+    }
+    if (config.threads < 1 || config.threads > MAX_THREADS) config.threads = 2;
+    if (config.window < 1 || config.window > ID_SPACE / 2) config.window = 64;
+
+    if (mixFile) {
+        if (!loadMixFile(&config, mixFile) || config.lists[CLASS_LOCAL].count == 0) {
+            fprintf(stderr, "错误: 无法读取名称列表 %s\n", mixFile);
+            return 1;
+        }
+        config.weights[CLASS_LOCAL] = 1;
+        config.weights[CLASS_BLOCKED] = config.weights[CLASS_MISS] = 0;
+    } else if (!loadMapNames(&config, mapFile)) {
+        fprintf(stderr, "错误: 无法读取域名映射文件 %s\n", mapFile);
+        return 1;
+    }
+    // 没有可用名称的类别不参与
+    for (int c = CLASS_LOCAL; c < CLASS_MISS; c++) {
+        if (config.lists[c].count == 0) config.weights[c] = 0;
+    }
+    if (config.weights[CLASS_LOCAL] + config.weights[CLASS_BLOCKED] + config.weights[CLASS_MISS] <= 0) {
+        fprintf(stderr, "错误: 查询比例全部为0\n");
+        return 1;
+    }
+
+    printf("压测 %s：%d线程 x %d并发，%.0f秒，比例 命中%d/屏蔽%d/未命中%d\n",
+           serverText, config.threads, config.window, config.seconds,
+           config.weights[CLASS_LOCAL], config.weights[CLASS_BLOCKED], config.weights[CLASS_MISS]);
+
+    BenchThread* threads = (BenchThread*)calloc((size_t)config.threads, sizeof(BenchThread));
+    if (!threads) return 1;
+    atomic_store(&benchRunning, 1);
+    int started = 0;
+    for (int i = 0; i < config.threads; i++) {
+        threads[i].config = &config;
+        threads[i].id = i;
+        threads[i].sendTimes = (uint64_t*)calloc(ID_SPACE, sizeof(uint64_t));
+        if (!threads[i].sendTimes || !dnsThreadCreate(&threads[i].thread, benchMain, &threads[i])) {
+            break;
+        }
+        started++;
+    }
+
+    uint64_t start = dnsNowNs();
+    dnsSleepMs((int)(config.seconds * 1000));
+    atomic_store(&benchRunning, 0);
+    for (int i = 0; i < started; i++) dnsThreadJoin(threads[i].thread);
+    double elapsed = (double)(dnsNowNs() - start) / 1e9;
+
+    static Histogram total;
+    uint64_t sent = 0, received = 0, lost = 0, rcodes[16] = { 0 };
+    for (int i = 0; i < started; i++) {
+        sent += threads[i].sent;
+        received += threads[i].received;
+        lost += threads[i].lost;
+        for (int r = 0; r < 16; r++) rcodes[r] += threads[i].rcodes[r];
+        histogramMerge(&total, &threads[i].histogram);
+        free(threads[i].sendTimes);
+    }
+    free(threads);
+
+    double qps = (double)received / elapsed;
+    double p50 = (double)histogramPercentile(&total, 50) / 1000.0;
+    double p99 = (double)histogramPercentile(&total, 99) / 1000.0;
+    double p999 = (double)histogramPercentile(&total, 99.9) / 1000.0;
+    double maxUs = (double)total.max / 1000.0;
+
+    printf("发送 %llu，收到 %llu，超时 %llu\n", (unsigned long long)sent,
+           (unsigned long long)received, (unsigned long long)lost);
+    printf("应答码: NOERROR %llu, FORMERR %llu, SERVFAIL %llu, NXDOMAIN %llu, REFUSED %llu\n",
+           (unsigned long long)rcodes[0], (unsigned long long)rcodes[1],
+           (unsigned long long)rcodes[2], (unsigned long long)rcodes[3],
+           (unsigned long long)rcodes[5]);
+    printf("吞吐量: %.0f QPS\n", qps);
+    printf("延迟(us): p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", p50, p99, p999, maxUs);
+    printf("RESULT qps=%.0f p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f sent=%llu lost=%llu\n",
+           qps, p50, p99, p999, maxUs, (unsigned long long)sent, (unsigned long long)lost);
+
+    dnsNetCleanup();
+    return 0;
+}
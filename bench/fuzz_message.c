@@ -0,0 +1,244 @@
+/**
+ * @file fuzz_message.c
+ * @brief 报文解析函数的模糊测试
+ * @details 对任意字节序列依次调用parseDNSQuery、parseEdns、extractQuestionKey、collectTtlOffsets、
+ *          findNegativeTtl、truncateResponse和buildErrorResponse，并检查返回的长度和偏移都落在
+ *          报文和输出缓冲区之内；任何不一致都调用abort。
+ *          提供LLVMFuzzerTestOneInput入口，可用libFuzzer构建：
+ *              clang -g -O1 -fsanitize=fuzzer,address -DDNS_FUZZ_LIBFUZZER -I. bench/fuzz_message.c
+ *                    dns_message.c dns_index.c dns_platform.c -lpthread
+ *          不定义DNS_FUZZ_LIBFUZZER时由main以固定种子对一组合法的查询和应答做随机变异
+ *          （改写、插入、删除字节，截断，拼接），用法：fuzz_message [次数] [种子]。
+ *          每个输入都复制到恰好等长的堆内存中，配合-fsanitize=address可发现越界读取
+ */
+
+#include "dns_message.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_ITERATIONS 2000000
+#define MAX_INPUT 4096
+#define MAX_OFFSETS 64
+#define KEY_SIZE 261                 // 线格式域名最长255字节 + QTYPE + QCLASS + 标志字节
+
+static void fuzzFail(const char* what, size_t value, size_t size) {
+    fprintf(stderr, "模糊测试检查失败: %s（值%zu，输入%zu字节）\n", what, value, size);
+    abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > MAX_INPUT) return 0;
+    char* packet = (char*)malloc(size ? size : 1);
+    if (!packet) return 0;
+    memcpy(packet, data, size);
+
+    DNSQuestion question;
+    if (parseDNSQuery(packet, size, &question)) {
+        if (question.questionEnd > size || question.nameOffset >= question.questionEnd) {
+            fuzzFail("问题部分越界", question.questionEnd, size);
+        }
+        EdnsInfo edns;
+        if (parseEdns(packet, size, &question, &edns) && edns.udpSize < DNS_CLASSIC_UDP_SIZE) {
+            fuzzFail("EDNS载荷上限小于512", edns.udpSize, size);
+        }
+    }
+
+    uint8_t key[KEY_SIZE];
+    size_t questionLength = 0;
+    size_t keyLength = extractQuestionKey(packet, size, key, sizeof(key), &questionLength);
+    if (keyLength > sizeof(key)) fuzzFail("问题键越界", keyLength, size);
+    if (keyLength > 0 && 12 + questionLength > size) fuzzFail("问题长度越界", questionLength, size);
+
+    {
+        uint16_t offsets[MAX_OFFSETS];
+        uint32_t minTtl = 0;
+        int count = collectTtlOffsets(packet, size, offsets, MAX_OFFSETS, &minTtl);
+        if (count > MAX_OFFSETS) fuzzFail("TTL偏移数超出容量", (size_t)count, size);
+        for (int i = 0; i < count; i++) {
+            if ((size_t)offsets[i] + 4 > size) fuzzFail("TTL偏移越界", offsets[i], size);
+        }
+        uint32_t negativeTtl = 0;
+        findNegativeTtl(packet, size, &negativeTtl);
+    }
+
+    // 截断到几个典型上限，输出缓冲区与上限等长，越界写入由地址检查发现
+    static const size_t limits[] = { 12, 64, 512, 1232 };
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        size_t limit = limits[i];
+        char* out = (char*)malloc(limit);
+        if (!out) break;
+        size_t outLength = truncateResponse(packet, size, limit, out, limit);
+        if (outLength > limit) fuzzFail("截断后仍超出上限", outLength, size);
+        free(out);
+    }
+    char* copy = (char*)malloc(size ? size : 1);
+    if (copy) {
+        memcpy(copy, packet, size);
+        size_t outLength = truncateResponse(copy, size, 512, copy, size);
+        if (outLength > size) fuzzFail("原地截断越界", outLength, size);
+        free(copy);
+    }
+
+    char response[MAX_INPUT + 11];
+    size_t errorLength = buildErrorResponse(packet, size, DNS_RCODE_SERVFAIL, response, sizeof(response));
+    if (errorLength > size + 11) fuzzFail("错误响应长于查询加OPT", errorLength, size);
+
+    free(packet);
+    return 0;
+}
+
+#ifndef DNS_FUZZ_LIBFUZZER
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static size_t appendName(uint8_t* p, const char* name) {
+    size_t pos = 0;
+    while (*name) {
+        const char* dot = strchr(name, '.');
+        size_t len = dot ? (size_t)(dot - name) : strlen(name);
+        p[pos++] = (uint8_t)len;
+        memcpy(p + pos, name, len);
+        pos += len;
+        name += len + (dot ? 1 : 0);
+    }
+    p[pos++] = 0;
+    return pos;
+}
+
+static size_t appendRecord(uint8_t* p, uint16_t type, uint32_t ttl, const uint8_t* data, uint16_t length) {
+    const uint8_t fixed[12] = { 0xC0, 12, (uint8_t)(type >> 8), (uint8_t)type, 0, DNS_CLASS_IN,
+                                (uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+                                (uint8_t)(length >> 8), (uint8_t)length };
+    memcpy(p, fixed, sizeof(fixed));
+    memcpy(p + sizeof(fixed), data, length);
+    return sizeof(fixed) + length;
+}
+
+static const uint8_t optRecord[11] = { 0, 0, DNS_TYPE_OPT, 0x04, 0xD0, 0, 0, 0x80, 0, 0, 0 };
+
+// 种子：普通查询、带OPT的查询、A/AAAA应答、带SOA的NXDOMAIN、带OPT的应答
+static size_t makeSeed(int kind, uint8_t* p) {
+    static const uint8_t v4[4] = { 192, 0, 2, 1 };
+    static const uint8_t v6[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+    uint8_t soa[64];
+    size_t soaLength = appendName(soa, "ns.example.com");
+    soaLength += appendName(soa + soaLength, "admin.example.com");
+    memset(soa + soaLength, 0, 20);
+    soa[soaLength + 19] = 60;                           // MINIMUM
+    soaLength += 20;
+
+    memset(p, 0, 12);
+    p[0] = 0x12; p[1] = 0x34;
+    p[2] = kind >= 2 ? 0x81 : 0x01;
+    p[3] = kind == 3 ? 0x83 : (kind >= 2 ? 0x80 : 0);
+    p[5] = 1;
+    size_t pos = 12 + appendName(p + 12, kind == 3 ? "missing.example.com" : "www.Example.com");
+    p[pos++] = 0; p[pos++] = kind == 4 ? DNS_TYPE_AAAA : DNS_TYPE_A;
+    p[pos++] = 0; p[pos++] = DNS_CLASS_IN;
+    if (kind == 2 || kind == 4) {
+        for (int i = 0; i < 6; i++) {
+            pos += kind == 2 ? appendRecord(p + pos, DNS_TYPE_A, 300 + i, v4, 4)
+                             : appendRecord(p + pos, DNS_TYPE_AAAA, 300 + i, v6, 16);
+        }
+        p[7] = 6;
+    }
+    if (kind == 3) {
+        pos += appendRecord(p + pos, DNS_TYPE_SOA, 3600, soa, (uint16_t)soaLength);
+        p[9] = 1;
+    }
+    if (kind == 1 || kind == 4) {
+        memcpy(p + pos, optRecord, sizeof(optRecord));
+        pos += sizeof(optRecord);
+        p[11] = 1;
+    }
+    return pos;
+}
+
+#define SEED_KINDS 5
+
+// 对输入做1到8次随机变异
+static size_t mutate(uint8_t* p, size_t length, uint32_t* seed) {
+    int rounds = 1 + (int)(nextRandom(seed) % 8);
+    for (int r = 0; r < rounds; r++) {
+        uint32_t x = nextRandom(seed);
+        size_t at = length ? (x >> 8) % length : 0;
+        switch (x % 7) {
+        case 0:                                         // 翻转一位
+            if (length) p[at] ^= (uint8_t)(1u << ((x >> 4) % 8));
+            break;
+        case 1:                                         // 改写为边界值
+            if (length) {
+                static const uint8_t values[] = { 0, 1, 0x3F, 0x40, 0x7F, 0x80, 0xC0, 0xFF };
+                p[at] = values[(x >> 4) % sizeof(values)];
+            }
+            break;
+        case 2:                                         // 改写头部的计数
+            if (length >= 12) p[4 + ((x >> 4) % 8)] = (uint8_t)(x >> 16);
+            break;
+        case 3:                                         // 插入一个字节
+            if (length < MAX_INPUT) {
+                memmove(p + at + 1, p + at, length - at);
+                p[at] = (uint8_t)(x >> 16);
+                length++;
+            }
+            break;
+        case 4:                                         // 删除一个字节
+            if (length) {
+                memmove(p + at, p + at + 1, length - at - 1);
+                length--;
+            }
+            break;
+        case 5:                                         // 截断
+            length = at;
+            break;
+        default:                                        // 复制报文中的一段到另一处
+            if (length > 2) {
+                size_t from = (x >> 4) % length;
+                size_t span = 1 + (x >> 20) % 16;
+                if (from + span > length) span = length - from;
+                if (at + span > length) span = length - at;
+                memmove(p + at, p + from, span);
+            }
+            break;
+        }
+    }
+    return length;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 2463534242u;
+    if (seed == 0) seed = 1;
+
+    static uint8_t seeds[SEED_KINDS][MAX_INPUT];
+    size_t seedLengths[SEED_KINDS];
+    for (int k = 0; k < SEED_KINDS; k++) {
+        seedLengths[k] = makeSeed(k, seeds[k]);
+        LLVMFuzzerTestOneInput(seeds[k], seedLengths[k]);
+    }
+
+    static uint8_t input[MAX_INPUT + 1];
+    size_t parsed = 0;
+    for (size_t n = 0; n < iterations; n++) {
+        int kind = (int)(nextRandom(&seed) % SEED_KINDS);
+        size_t length = seedLengths[kind];
+        memcpy(input, seeds[kind], length);
+        length = mutate(input, length, &seed);
+        DNSQuestion question;
+        parsed += length >= 12 && parseDNSQuery((const char*)input, length, &question);
+        LLVMFuzzerTestOneInput(input, length);
+    }
+    printf("模糊测试: %zu个输入，其中%zu个问题部分可解析，未发现问题\n", iterations, parsed);
+    printf("RESULT inputs=%zu parsed=%zu\n", iterations, parsed);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#!/bin/sh
+# 转发服务器性能回归测试（Linux）
+# 先执行compile.sh编译，再在仓库根目录运行: sh bench/run_bench.sh [结果文件]
+# 依次启动桩上游和服务器，按几种典型比例压测，每个场景输出一行RESULT；
+# 最后换成三个注入了丢包和延迟的桩上游，压测多上游选择、对冲和剔除；
+# 指定结果文件时追加带时间戳和提交号的记录，便于跟踪回归
+
+PORT=${PORT:-5353}
+STUB_PORT=${STUB_PORT:-5300}
+DURATION=${DURATION:-5}
+WORKERS=${WORKERS:-2}
+OUT=$1
+
+./stubdns -p $STUB_PORT > /dev/null &
+STUB_PID=$!
+./dns $PORT dnsrelay.txt -w $WORKERS -u 127.0.0.1:$STUB_PORT -l error < /dev/null > /dev/null &
+DNS_PID=$!
+trap 'kill $DNS_PID $STUB_PID $STUB_PIDS 2>/dev/null' EXIT
+sleep 1
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+run_scenario() {
+    LINE=$(./dnsbench -s 127.0.0.1:$PORT -p $2 -d $DURATION | grep '^RESULT' | sed "s/^RESULT/RESULT scenario=$1/")
+    echo "$LINE"
+    if [ -n "$OUT" ]; then
+        echo "$(date '+%Y-%m-%dT%H:%M:%S') commit=$COMMIT $LINE" >> "$OUT"
+    fi
+}
+
+for MIX in "local 100,0,0" "blocked 0,100,0" "miss 0,0,100" "mixed 70,20,10"; do
+    run_scenario $MIX
+done
+
+# 多上游：丢包30%、延迟30毫秒、延迟2毫秒且丢包2%
+kill $DNS_PID $STUB_PID 2>/dev/null
+wait $DNS_PID 2>/dev/null
+STUB_PIDS=
+for STUB in "1 -l 0.3" "2 -d 30" "3 -d 2 -l 0.02"; do
+    set -- $STUB
+    OFFSET=$1
+    shift
+    ./stubdns -p $((STUB_PORT + OFFSET)) "$@" > /dev/null &
+    STUB_PIDS="$STUB_PIDS $!"
+done
+./dns $PORT dnsrelay.txt -w $WORKERS -l error -t 300 -H 20 \
+    -u 127.0.0.1:$((STUB_PORT + 1)) -u 127.0.0.1:$((STUB_PORT + 2)) -u 127.0.0.1:$((STUB_PORT + 3)) \
+    < /dev/null > /dev/null &
+DNS_PID=$!
+sleep 1
+run_scenario multi-upstream 0,0,100
@@ -0,0 +1,64 @@
+#!/bin/sh
+# 多核扩展性测试（Linux）
+# 先执行compile.sh编译，再在仓库根目录运行: sh bench/scale_bench.sh [结果文件]
+# 工作线程数从1开始逐次翻倍直到CPU核数（或MAX_WORKERS），每次启动绑核的服务器
+# （-A，缓存分片数等于工作线程数），先预热一万个转发名称，再分别压测缓存命中和本地命中，
+# 每个场景输出一行RESULT并附上相对单线程的加速比。
+# 压测客户端与服务器在同一台机器上，核数较少时客户端本身会成为瓶颈，
+# 可以用taskset把客户端限制在其余核上，或调大CLIENT_THREADS
+
+PORT=${PORT:-5353}
+STUB_PORT=${STUB_PORT:-5300}
+DURATION=${DURATION:-5}
+MAX_WORKERS=${MAX_WORKERS:-$(nproc)}
+CLIENT_THREADS=${CLIENT_THREADS:-4}
+NAMES=${NAMES:-10000}
+OUT=$1
+
+NAME_FILE=$(mktemp)
+i=0
+while [ $i -lt $NAMES ]; do
+    echo "c$i.scale.invalid"
+    i=$((i + 1))
+done > "$NAME_FILE"
+
+./stubdns -p $STUB_PORT -T 3600 > /dev/null &
+STUB_PID=$!
+DNS_PID=
+trap 'kill $DNS_PID $STUB_PID 2>/dev/null; rm -f "$NAME_FILE"' EXIT
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+BASE_cached=
+BASE_local=
+run_scenario() {
+    LINE=$(./dnsbench -s 127.0.0.1:$PORT -t $CLIENT_THREADS -d $DURATION "$@" | grep '^RESULT')
+    QPS=$(echo "$LINE" | sed 's/.*qps=\([0-9]*\).*/\1/')
+    eval "BASE=\$BASE_$SCENARIO"
+    if [ -z "$BASE" ]; then
+        BASE=$QPS
+        eval "BASE_$SCENARIO=$QPS"
+    fi
+    SPEEDUP=$(awk -v q="$QPS" -v b="$BASE" 'BEGIN { printf "%.2f", (b > 0 ? q / b : 0) }')
+    LINE=$(echo "$LINE" | sed "s/^RESULT/RESULT scenario=$SCENARIO workers=$WORKERS speedup=$SPEEDUP/")
+    echo "$LINE"
+    if [ -n "$OUT" ]; then
+        echo "$(date '+%Y-%m-%dT%H:%M:%S') commit=$COMMIT $LINE" >> "$OUT"
+    fi
+}
+
+WORKERS=1
+while [ $WORKERS -le $MAX_WORKERS ]; do
+    ./dns $PORT dnsrelay.txt -w $WORKERS -A -u 127.0.0.1:$STUB_PORT -l error < /dev/null > /dev/null &
+    DNS_PID=$!
+    sleep 1
+    ./dnsbench -s 127.0.0.1:$PORT -f "$NAME_FILE" -d 1 > /dev/null
+
+    SCENARIO=cached
+    run_scenario -f "$NAME_FILE"
+    SCENARIO=local
+    run_scenario -p 100,0,0
+
+    kill $DNS_PID 2>/dev/null
+    wait $DNS_PID 2>/dev/null
+    WORKERS=$((WORKERS * 2))
+done
@@ -0,0 +1,170 @@
+/**
+ * @file stubdns.c
+ * @brief 本地桩上游DNS服务器
+ * @details 对任何A查询返回固定地址，其他类型返回无记录的NOERROR，
+ *          用于在没有外网的环境下压测转发路径（配合dns的-u参数使用）。
+ *          可注入固定延迟和随机丢包，启动多个实例模拟快慢不一、不可靠的上游
+ */
+
+#include "dns_platform.h"
+#include "dns_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 跳过问题区的域名，返回问题区结束位置，失败返回0
+static size_t questionEnd(const unsigned char* packet, size_t length) {
+    size_t pos = sizeof(struct DNSHeader);
+    while (pos < length && packet[pos] != 0) {
+        if (packet[pos] & 0xC0) return 0;
+        pos += (size_t)packet[pos] + 1;
+    }
+    pos += 1 + 4;  // 结尾的0、QTYPE、QCLASS
+    return pos <= length ? pos : 0;
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "用法: %s [选项]\n", program);
+    fprintf(stderr, "  -p <端口>   监听端口（默认5300）\n");
+    fprintf(stderr, "  -a <地址>   A记录返回的地址（默认1.2.3.4）\n");
+    fprintf(stderr, "  -T <秒>     应答TTL（默认60）\n");
+    fprintf(stderr, "  -d <毫秒>   每个应答延迟发送（默认0）\n");
+    fprintf(stderr, "  -l <比例>   随机丢弃的查询比例，0~1（默认0）\n");
+}
+
+#define DELAY_QUEUE_SIZE 8192  // 延迟发送队列容量，满时丢弃新应答
+
+// 等待延迟发送的应答，延迟固定，队列按到期时刻有序
+typedef struct {
+    uint64_t dueNs;
+    struct sockaddr_in client;
+    int length;
+    unsigned char packet[512];
+} DelayedReply;
+
+static uint32_t rngState = 2463534242u;
+
+static double randomUnit(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return (double)rngState / 4294967296.0;
+}
+
+// 把查询改写为应答，返回应答长度，不是合法查询时返回0
+static size_t buildAnswer(unsigned char* packet, int n, uint32_t answer, uint32_t ttl) {
+    size_t end = questionEnd(packet, (size_t)n);
+    if (end == 0 || (packet[2] & 0x80)) return 0;
+
+    uint16_t qtype = (uint16_t)((packet[end - 4] << 8) | packet[end - 3]);
+    packet[2] = (unsigned char)(0x80 | (packet[2] & 0x01));  // QR + 保留RD
+    packet[3] = 0x80;                                       // RA，NOERROR
+    packet[6] = 0; packet[7] = qtype == 1 ? 1 : 0;          // ANCOUNT
+    memset(packet + 8, 0, 4);                               // NSCOUNT、ARCOUNT
+
+    size_t length = end;
+    if (qtype == 1) {
+        unsigned char record[16] = { 0xC0, 0x0C, 0, 1, 0, 1,
+                                     (unsigned char)(ttl >> 24), (unsigned char)(ttl >> 16),
+                                     (unsigned char)(ttl >> 8), (unsigned char)ttl, 0, 4 };
+        memcpy(record + 12, &answer, 4);
+        memcpy(packet + length, record, sizeof(record));
+        length += sizeof(record);
+    }
+    return length;
+}
+
+int main(int argc, char* argv[]) {
+    int port = 5300;
+    const char* answerText = "1.2.3.4";
+    uint32_t ttl = 60;
+    int delayMs = 0;
+    double loss = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-p") == 0) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0) answerText = argv[++i];
+        else if (strcmp(argv[i], "-T") == 0) ttl = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-d") == 0) delayMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0) loss = atof(argv[++i]);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!dnsNetInit()) return 1;
+    uint32_t answer = inet_addr(answerText);
+
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (sock == INVALID_SOCKET || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "错误: 无法绑定端口 %d\n", port);
+        return 1;
+    }
+    printf("桩上游监听 127.0.0.1:%d，A记录应答 %s，TTL %u，延迟%d毫秒，丢包率%g\n",
+           port, answerText, (unsigned)ttl, delayMs, loss);
+    fflush(stdout);
+    rngState ^= (uint32_t)port * 2654435761u;
+
+    DelayedReply* queue = NULL;
+    if (delayMs > 0) {
+        queue = (DelayedReply*)malloc(DELAY_QUEUE_SIZE * sizeof(DelayedReply));
+        if (!queue || !dnsSetNonBlocking(sock)) {
+            fprintf(stderr, "错误: 延迟队列初始化失败\n");
+            return 1;
+        }
+    }
+    size_t head = 0, count = 0;
+
+    unsigned char packet[1024];
+    for (;;) {
+        if (queue) {
+            // 发送所有到期的应答，再等待新查询或下一个到期时刻
+            uint64_t now = dnsNowNs();
+            while (count > 0 && queue[head].dueNs <= now) {
+                DelayedReply* reply = &queue[head];
+                sendto(sock, (const char*)reply->packet, reply->length, 0,
+                       (struct sockaddr*)&reply->client, sizeof(reply->client));
+                head = (head + 1) % DELAY_QUEUE_SIZE;
+                count--;
+            }
+            uint64_t waitUs = count > 0 ? (queue[head].dueNs - now) / 1000 + 1 : 100000;
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(sock, &readSet);
+            struct timeval tv;
+            tv.tv_sec = (long)(waitUs / 1000000);
+            tv.tv_usec = (long)(waitUs % 1000000);
+            if (select((int)sock + 1, &readSet, NULL, NULL, &tv) <= 0) continue;
+        }
+
+        struct sockaddr_in client;
+        socklen_t clientLength = sizeof(client);
+        int n = recvfrom(sock, (char*)packet, 512, 0, (struct sockaddr*)&client, &clientLength);
+        if (n < (int)sizeof(struct DNSHeader)) continue;
+        if (loss > 0 && randomUnit() < loss) continue;
+
+        size_t length = buildAnswer(packet, n, answer, ttl);
+        if (length == 0) continue;
+        if (!queue) {
+            sendto(sock, (const char*)packet, (int)length, 0, (struct sockaddr*)&client, clientLength);
+            continue;
+        }
+        if (count == DELAY_QUEUE_SIZE || length > sizeof(queue[0].packet)) continue;
+        DelayedReply* reply = &queue[(head + count) % DELAY_QUEUE_SIZE];
+        reply->dueNs = dnsNowNs() + (uint64_t)delayMs * 1000000ULL;
+        reply->client = client;
+        reply->length = (int)length;
+        memcpy(reply->packet, packet, length);
+        count++;
+    }
+}
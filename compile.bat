@@ -1,7 +1,44 @@
-@echo off
-REM 编译DNS服务器程序
-REM 使用gcc编译器
-REM 链接Windows Socket库(ws2_32)
-REM 输出文件名为dns.exe
-
-gcc main.c dns_server.c dns_resolver.c dns_message.c -o dns.exe -lws2_32 
\ No newline at end of file
+@echo off
+REM 编译DNS服务器程序
+REM 使用gcc编译器，开启-Wall -Wextra警告
+REM 链接Windows Socket库(ws2_32)
+REM 输出文件名为dns.exe
+
+gcc -O2 -Wall -Wextra main.c dns_server.c dns_resolver.c dns_message.c dns_qname.c dns_prefilter.c dns_index.c dns_trie.c dns_ruledb.c dns_addrset.c dns_epoch.c dns_platform.c dns_event.c dns_forwarder.c dns_tcp.c dns_arena.c dns_ratelimit.c dns_capture.c dns_cache.c dns_log.c dns_metrics.c dns_stats.c -o dns.exe -lws2_32
+
+REM 编译域名索引微基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_index.c dns_index.c -o bench_index.exe
+
+REM 编译本地应答路径基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_message.c dns_message.c dns_qname.c dns_resolver.c dns_prefilter.c dns_index.c dns_trie.c dns_ruledb.c dns_addrset.c dns_epoch.c dns_platform.c dns_log.c -o bench_message.exe -lws2_32
+
+REM 编译域名规范化差分测试和吞吐量基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_qname.c dns_qname.c dns_index.c dns_message.c dns_platform.c -o bench_qname.exe -lws2_32
+
+REM 编译报文解析模糊测试（用libFuzzer时见bench/fuzz_message.c的说明）
+gcc -O2 -Wall -Wextra -I. bench/fuzz_message.c dns_message.c dns_index.c dns_platform.c -o fuzz_message.exe -lws2_32
+
+REM 编译客户端限速基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_ratelimit.c dns_ratelimit.c dns_platform.c -o bench_ratelimit.exe -lws2_32
+
+REM 编译响应缓存键区分测试和命中路径基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_cache.c dns_cache.c dns_message.c dns_index.c dns_platform.c -o bench_cache.exe -lws2_32
+
+REM 编译内存区和对象池基准测试（加 -DDNS_ARENA_DEBUG 编译任一目标可启用越界写入、释放后写入、重复释放和泄漏检查）
+gcc -O2 -Wall -Wextra -I. bench/bench_arena.c dns_arena.c dns_platform.c -o bench_arena.exe -lws2_32
+
+REM 编译规则内存占用基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_rules.c dns_resolver.c dns_prefilter.c dns_message.c dns_index.c dns_trie.c dns_ruledb.c dns_addrset.c dns_epoch.c dns_platform.c dns_log.c -o bench_rules.exe -lws2_32
+
+REM 编译规则预过滤器基准测试
+gcc -O2 -Wall -Wextra -I. bench/bench_prefilter.c dns_resolver.c dns_prefilter.c dns_message.c dns_index.c dns_trie.c dns_ruledb.c dns_addrset.c dns_epoch.c dns_platform.c dns_log.c -o bench_prefilter.exe -lws2_32
+
+REM 编译规则库编译工具
+gcc -O2 -Wall -Wextra -I. tools/rulec.c dns_ruledb.c dns_addrset.c dns_trie.c dns_index.c dns_platform.c -o rulec.exe -lws2_32
+
+REM 编译抓包回放工具
+gcc -O2 -Wall -Wextra -I. tools/dnsreplay.c dns_capture.c dns_platform.c -o dnsreplay.exe -lws2_32
+
+REM 编译压测工具和本地桩上游
+gcc -O2 -Wall -Wextra -I. bench/dnsbench.c dns_platform.c -o dnsbench.exe -lws2_32
+gcc -O2 -Wall -Wextra -I. bench/stubdns.c dns_platform.c -o stubdns.exe -lws2_32
\ No newline at end of file
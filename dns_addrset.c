@@ -0,0 +1,232 @@
+#include "dns_addrset.h"
+#include "dns_platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 整理前的一条地址，按追加顺序存放
+typedef struct {
+    uint32_t set;
+    uint8_t family;
+    uint8_t address[16];
+} PendingAddress;
+
+int addressTableInit(AddressTable* table) {
+    memset(table, 0, sizeof(*table));
+    table->capacity = 64;
+    table->sets = (AddressSet*)calloc(table->capacity, sizeof(AddressSet));
+    return table->sets != NULL;
+}
+
+void addressTableFree(AddressTable* table) {
+    free(table->sets);
+    free(table->pool);
+    free(table->pending);
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t addressTableCreateSet(AddressTable* table) {
+    if (table->count == table->capacity) {
+        if (table->capacity >= ADDRSET_NONE / 2) return ADDRSET_NONE;
+        AddressSet* grown = (AddressSet*)realloc(table->sets, (size_t)table->capacity * 2 * sizeof(AddressSet));
+        if (!grown) return ADDRSET_NONE;
+        table->sets = grown;
+        table->capacity *= 2;
+    }
+    memset(&table->sets[table->count], 0, sizeof(AddressSet));
+    return table->count++;
+}
+
+int addressTableAdd(AddressTable* table, uint32_t set, int family, const uint8_t* address) {
+    if (set >= table->count || (family != AF_INET && family != AF_INET6)) return 0;
+    if (table->pendingCount == table->pendingCapacity) {
+        size_t capacity = table->pendingCapacity ? table->pendingCapacity * 2 : 1024;
+        PendingAddress* grown = (PendingAddress*)realloc(table->pending, capacity * sizeof(PendingAddress));
+        if (!grown) return 0;
+        table->pending = grown;
+        table->pendingCapacity = capacity;
+    }
+    PendingAddress* entry = &((PendingAddress*)table->pending)[table->pendingCount++];
+    entry->set = set;
+    entry->family = (uint8_t)family;
+    memset(entry->address, 0, sizeof(entry->address));
+    memcpy(entry->address, address, family == AF_INET ? 4 : 16);
+    return 1;
+}
+
+static int isUnspecified(const uint8_t* address, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (address[i]) return 0;
+    }
+    return 1;
+}
+
+// 集合中已有相同地址时返回1
+static int containsAddress(const uint8_t* first, int count, const uint8_t* address, size_t length) {
+    for (int i = 0; i < count; i++) {
+        if (memcmp(first + (size_t)i * length, address, length) == 0) return 1;
+    }
+    return 0;
+}
+
+int addressTableFinish(AddressTable* table) {
+    const PendingAddress* pending = (const PendingAddress*)table->pending;
+
+    // 第一遍统计每个集合的地址数（重复地址稍后去掉，先按上限预留）
+    for (size_t i = 0; i < table->pendingCount; i++) {
+        AddressSet* set = &table->sets[pending[i].set];
+        if (pending[i].family == AF_INET) {
+            if (set->v4Count < ADDRSET_MAX_PER_FAMILY) set->v4Count++;
+        } else if (set->v6Count < ADDRSET_MAX_PER_FAMILY) {
+            set->v6Count++;
+        }
+    }
+
+    size_t poolSize = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        AddressSet* set = &table->sets[i];
+        set->offset = (uint32_t)poolSize;
+        poolSize += (size_t)set->v4Count * 4 + (size_t)set->v6Count * 16;
+        if (poolSize > UINT32_MAX) return 0;
+        set->v4Count = 0;
+        set->v6Count = 0;
+    }
+
+    uint8_t* pool = (uint8_t*)malloc(poolSize ? poolSize : 1);
+    if (!pool) return 0;
+
+    uint8_t* v6Counts = (uint8_t*)calloc(table->count ? table->count : 1, 1);
+    if (!v6Counts) {
+        free(pool);
+        return 0;
+    }
+
+    // 第二遍按追加顺序放入IPv4地址，第三遍在每个集合的IPv4地址之后放入IPv6地址
+    for (size_t i = 0; i < table->pendingCount; i++) {
+        const PendingAddress* entry = &pending[i];
+        AddressSet* set = &table->sets[entry->set];
+        uint8_t* base = pool + set->offset;
+        if (entry->family == AF_INET) {
+            if (set->v4Count >= ADDRSET_MAX_PER_FAMILY ||
+                containsAddress(base, set->v4Count, entry->address, 4)) {
+                continue;
+            }
+            if (isUnspecified(entry->address, 4)) set->flags |= ADDRSET_BLOCKED;
+            memcpy(base + (size_t)set->v4Count * 4, entry->address, 4);
+            set->v4Count++;
+        }
+    }
+    for (size_t i = 0; i < table->pendingCount; i++) {
+        const PendingAddress* entry = &pending[i];
+        AddressSet* set = &table->sets[entry->set];
+        uint8_t* base = pool + set->offset + (size_t)set->v4Count * 4;
+        uint8_t count = v6Counts[entry->set];
+        if (entry->family != AF_INET6 || count >= ADDRSET_MAX_PER_FAMILY ||
+            containsAddress(base, count, entry->address, 16)) {
+            continue;
+        }
+        if (isUnspecified(entry->address, 16)) set->flags |= ADDRSET_BLOCKED;
+        memcpy(base + (size_t)count * 16, entry->address, 16);
+        v6Counts[entry->set] = (uint8_t)(count + 1);
+    }
+    for (uint32_t i = 0; i < table->count; i++) {
+        table->sets[i].v6Count = v6Counts[i];
+    }
+
+    free(v6Counts);
+    free(table->pending);
+    table->pending = NULL;
+    table->pendingCount = 0;
+    table->pendingCapacity = 0;
+    free(table->pool);
+    table->pool = pool;
+    table->poolSize = poolSize;
+    return 1;
+}
+
+static size_t setBytes(const AddressSet* set) {
+    return (size_t)set->v4Count * 4 + (size_t)set->v6Count * 16;
+}
+
+// FNV-1a，覆盖地址数、标志和全部地址
+static uint32_t hashSet(const AddressSet* set, const uint8_t* bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ set->v4Count) * 16777619u;
+    hash = (hash ^ set->v6Count) * 16777619u;
+    hash = (hash ^ set->flags) * 16777619u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t* addressTableIntern(AddressTable* table) {
+    uint32_t count = table->count;
+    size_t capacity = 64;
+    while (capacity < (size_t)count * 2) capacity <<= 1;
+
+    uint32_t* remap = (uint32_t*)malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t* slots = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    uint8_t* pool = (uint8_t*)malloc(table->poolSize ? table->poolSize : 1);
+    if (!remap || !slots || !pool) {
+        free(remap);
+        free(slots);
+        free(pool);
+        return NULL;
+    }
+    memset(slots, 0xFF, capacity * sizeof(uint32_t));
+
+    // 去重后的集合依次写回集合表前部（写入位置不超过读取位置），地址写入新的地址池
+    size_t poolSize = 0;
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        AddressSet set = table->sets[i];
+        const uint8_t* bytes = table->pool + set.offset;
+        size_t length = setBytes(&set);
+        size_t pos = hashSet(&set, bytes, length) & (capacity - 1);
+        while (slots[pos] != ADDRSET_NONE) {
+            const AddressSet* other = &table->sets[slots[pos]];
+            if (other->v4Count == set.v4Count && other->v6Count == set.v6Count &&
+                other->flags == set.flags && memcmp(pool + other->offset, bytes, length) == 0) {
+                break;
+            }
+            pos = (pos + 1) & (capacity - 1);
+        }
+        if (slots[pos] == ADDRSET_NONE) {
+            memcpy(pool + poolSize, bytes, length);
+            set.offset = (uint32_t)poolSize;
+            poolSize += length;
+            table->sets[unique] = set;
+            slots[pos] = unique++;
+        }
+        remap[i] = slots[pos];
+    }
+    free(slots);
+
+    free(table->pool);
+    uint8_t* compact = (uint8_t*)realloc(pool, poolSize ? poolSize : 1);
+    table->pool = compact ? compact : pool;
+    table->poolSize = poolSize;
+    table->count = unique;
+    // 合并后集合通常只剩很少几个，收回多余的容量
+    AddressSet* shrunk = (AddressSet*)realloc(table->sets, (unique ? unique : 1) * sizeof(AddressSet));
+    if (shrunk) {
+        table->sets = shrunk;
+        table->capacity = unique ? unique : 1;
+    }
+    return remap;
+}
+
+int addressSetExpand(const AddressSet* set, const uint8_t* pool, size_t poolSize, AddressList* list) {
+    size_t length = (size_t)set->v4Count * 4 + (size_t)set->v6Count * 16;
+    if (set->v4Count > ADDRSET_MAX_PER_FAMILY || set->v6Count > ADDRSET_MAX_PER_FAMILY ||
+        set->offset > poolSize || length > poolSize - set->offset) {
+        return 0;
+    }
+    const uint8_t* base = pool + set->offset;
+    list->blocked = (set->flags & ADDRSET_BLOCKED) != 0;
+    list->v4Count = set->v4Count;
+    list->v6Count = set->v6Count;
+    memcpy(list->v4, base, (size_t)set->v4Count * 4);
+    memcpy(list->v6, base + (size_t)set->v4Count * 4, (size_t)set->v6Count * 16);
+    return 1;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file dns_addrset.h
+ * @brief 本地规则地址集合的头文件定义
+ * @details 域名映射文件中同一条规则可以出现在多行，IPv4和IPv6地址合并为一个地址集合。
+ *          索引、后缀树和规则库镜像中只保存集合编号；集合表和地址池都是连续数组，
+ *          可以原样写入规则库镜像并直接映射使用。
+ *          整理完成后内容相同的集合合并为一个（大量规则指向同一个地址或被屏蔽），
+ *          屏蔽标志是集合上的一个位，查询时不需要比较地址
+ */
+
+#ifndef DNS_ADDRSET_H
+#define DNS_ADDRSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADDRSET_MAX_PER_FAMILY 32    ///< 每个集合中每种地址族最多保留的地址数
+#define ADDRSET_BLOCKED 0x01         ///< 集合中含0.0.0.0或::，表示屏蔽该域名
+#define ADDRSET_NONE 0xFFFFFFFFu     ///< 无效的集合编号
+
+/**
+ * @struct AddressSet
+ * @brief 一个地址集合
+ */
+typedef struct {
+    uint32_t offset;     ///< 在地址池中的偏移：v4Count个IPv4地址之后紧跟v6Count个IPv6地址
+    uint8_t v4Count;     ///< IPv4地址数
+    uint8_t v6Count;     ///< IPv6地址数
+    uint16_t flags;      ///< ADDRSET_BLOCKED
+} AddressSet;
+
+/**
+ * @struct AddressTable
+ * @brief 地址集合表
+ * @details 加载期间先记录每条地址，addressTableFinish时按集合整理进连续的地址池
+ */
+typedef struct {
+    AddressSet* sets;        ///< 集合数组
+    uint32_t count;          ///< 集合数
+    uint32_t capacity;
+    uint8_t* pool;           ///< 地址池（网络字节序）
+    size_t poolSize;         ///< 地址池字节数
+    void* pending;           ///< 尚未整理的地址，Finish后释放
+    size_t pendingCount;
+    size_t pendingCapacity;
+} AddressTable;
+
+/**
+ * @struct AddressList
+ * @brief 查询结果：从集合中复制出的地址，不引用规则快照
+ */
+typedef struct {
+    int blocked;                                     ///< 是否屏蔽
+    int v4Count;                                     ///< IPv4地址数
+    int v6Count;                                     ///< IPv6地址数
+    uint8_t v4[ADDRSET_MAX_PER_FAMILY][4];           ///< IPv4地址（网络字节序）
+    uint8_t v6[ADDRSET_MAX_PER_FAMILY][16];          ///< IPv6地址
+} AddressList;
+
+/**
+ * @brief 初始化空的集合表
+ * @return 成功返回1，失败返回0
+ */
+int addressTableInit(AddressTable* table);
+
+/**
+ * @brief 释放集合表
+ */
+void addressTableFree(AddressTable* table);
+
+/**
+ * @brief 新建一个空集合
+ * @return 集合编号，失败返回ADDRSET_NONE
+ */
+uint32_t addressTableCreateSet(AddressTable* table);
+
+/**
+ * @brief 向集合追加一个地址
+ * @param table 集合表
+ * @param set 集合编号
+ * @param family AF_INET或AF_INET6
+ * @param address 地址（4或16字节，网络字节序）
+ * @return 成功返回1，失败返回0
+ * @details 同一集合内重复的地址只保留一个，超过ADDRSET_MAX_PER_FAMILY的地址被忽略
+ */
+int addressTableAdd(AddressTable* table, uint32_t set, int family, const uint8_t* address);
+
+/**
+ * @brief 把已追加的地址按集合整理进地址池，之后集合表只读
+ * @return 成功返回1，失败返回0
+ */
+int addressTableFinish(AddressTable* table);
+
+/**
+ * @brief 合并内容相同的集合并压缩地址池，须在addressTableFinish之后调用
+ * @param table 集合表
+ * @return 长度为合并前集合数的映射表，remap[旧编号]为新编号，由调用方free；失败返回NULL（集合表不变）
+ * @details 调用方据此改写索引和后缀树中保存的集合编号
+ */
+uint32_t* addressTableIntern(AddressTable* table);
+
+/**
+ * @brief 把集合中的地址复制到查询结果
+ * @param set 集合
+ * @param pool 地址池
+ * @param poolSize 地址池字节数（集合可能来自映射的镜像文件，复制前检查边界）
+ * @param list 输出结果
+ * @return 成功返回1，集合越界或地址数超限返回0
+ */
+int addressSetExpand(const AddressSet* set, const uint8_t* pool, size_t poolSize, AddressList* list);
+
+#endif // DNS_ADDRSET_H
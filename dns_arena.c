@@ -0,0 +1,186 @@
+#include "dns_arena.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t size;           // 数据区字节数
+};
+
+// 数据区紧跟在块头之后，从缓存行边界开始
+#define CHUNK_HEADER DNS_CACHE_LINE
+#define POISON 0xDD
+
+static inline size_t alignUp(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static inline char* chunkData(ArenaChunk* chunk) {
+    return (char*)chunk + CHUNK_HEADER;
+}
+
+#ifdef DNS_ARENA_DEBUG
+
+static void arenaFail(const char* what, const void* p) {
+    fprintf(stderr, "内存区检查失败: %s (%p)\n", what, p);
+    abort();
+}
+
+// 填充被写过的位置说明有越界写入或释放后仍被使用的指针
+static void checkPoison(const void* p, size_t size, const char* what) {
+    const unsigned char* bytes = (const unsigned char*)p;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != POISON) arenaFail(what, bytes + i);
+    }
+}
+
+#endif
+
+void arenaInit(Arena* arena, size_t chunkSize) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->offset = 0;
+    arena->chunkSize = chunkSize ? alignUp(chunkSize) : ARENA_DEFAULT_CHUNK;
+    arena->reserved = 0;
+}
+
+// 当前块放不下时申请新块接在链表末尾，当前块剩余的空间不再使用
+static ArenaChunk* nextChunk(Arena* arena, size_t size) {
+    size_t dataSize = size > arena->chunkSize ? size : arena->chunkSize;
+    if (dataSize > SIZE_MAX - CHUNK_HEADER) return NULL;
+    ArenaChunk* chunk = (ArenaChunk*)dnsAlignedAlloc(CHUNK_HEADER + dataSize);
+    if (!chunk) return NULL;
+    chunk->size = dataSize;
+    chunk->next = NULL;
+#ifdef DNS_ARENA_DEBUG
+    memset(chunkData(chunk), POISON, dataSize);
+#endif
+    if (arena->current) {
+        arena->current->next = chunk;
+    } else {
+        arena->first = chunk;
+    }
+    arena->reserved += CHUNK_HEADER + dataSize;
+    arena->current = chunk;
+    arena->offset = 0;
+    return chunk;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    if (size > SIZE_MAX - ARENA_ALIGN) return NULL;
+    size = alignUp(size ? size : 1);
+    ArenaChunk* chunk = arena->current;
+    if (!chunk || chunk->size - arena->offset < size) {
+        chunk = nextChunk(arena, size);
+        if (!chunk) return NULL;
+    }
+    char* p = chunkData(chunk) + arena->offset;
+    arena->offset += size;
+#ifdef DNS_ARENA_DEBUG
+    checkPoison(p, size, "内存区未分配的位置被写入");
+#endif
+    return p;
+}
+
+void* arenaCalloc(Arena* arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* p = arenaAlloc(arena, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+void arenaDestroy(Arena* arena) {
+    ArenaChunk* chunk = arena->first;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        dnsAlignedFree(chunk);
+        chunk = next;
+    }
+    arenaInit(arena, arena->chunkSize);
+}
+
+// 调试模式下每个对象前有一个头，记录所属的池和状态
+#ifdef DNS_ARENA_DEBUG
+typedef struct {
+    const SlabPool* owner;
+    uint32_t state;
+} SlabHeader;
+#define SLAB_HEADER alignUp(sizeof(SlabHeader))
+#define SLAB_LIVE 0x4C495645u
+#define SLAB_FREE 0x46524545u
+#else
+#define SLAB_HEADER 0
+#endif
+
+void slabInit(SlabPool* pool, Arena* arena, size_t objectSize, size_t perRefill) {
+    if (objectSize < sizeof(void*)) objectSize = sizeof(void*);
+    pool->arena = arena;
+    pool->objectSize = objectSize;
+    pool->stride = alignUp(SLAB_HEADER + objectSize);
+    if (perRefill == 0) perRefill = arena->chunkSize / pool->stride;
+    pool->perRefill = perRefill ? perRefill : 1;
+    pool->freeList = NULL;
+    pool->live = 0;
+}
+
+static inline void pushFree(SlabPool* pool, char* object) {
+    *(void**)object = pool->freeList;
+    pool->freeList = object;
+}
+
+static int refill(SlabPool* pool) {
+    size_t count = pool->perRefill;
+    if (count > SIZE_MAX / pool->stride) return 0;
+    char* block = (char*)arenaAlloc(pool->arena, count * pool->stride);
+    if (!block) return 0;
+    for (size_t i = count; i-- > 0;) {
+        char* object = block + i * pool->stride + SLAB_HEADER;
+#ifdef DNS_ARENA_DEBUG
+        SlabHeader* header = (SlabHeader*)(object - SLAB_HEADER);
+        header->owner = pool;
+        header->state = SLAB_FREE;
+#endif
+        pushFree(pool, object);
+    }
+    return 1;
+}
+
+void* slabAlloc(SlabPool* pool) {
+    if (!pool->freeList && !refill(pool)) return NULL;
+    char* object = (char*)pool->freeList;
+    pool->freeList = *(void**)object;
+    pool->live++;
+#ifdef DNS_ARENA_DEBUG
+    SlabHeader* header = (SlabHeader*)(object - SLAB_HEADER);
+    if (header->owner != pool || header->state != SLAB_FREE) arenaFail("空闲对象的头被覆盖", object);
+    checkPoison(object + sizeof(void*), pool->objectSize - sizeof(void*), "对象释放后仍被写入");
+    header->state = SLAB_LIVE;
+#endif
+    return object;
+}
+
+void slabFree(SlabPool* pool, void* object) {
+    if (!object) return;
+#ifdef DNS_ARENA_DEBUG
+    SlabHeader* header = (SlabHeader*)((char*)object - SLAB_HEADER);
+    if (header->owner != pool) arenaFail("释放不属于本池的对象", object);
+    if (header->state != SLAB_LIVE) arenaFail("对象重复释放", object);
+    header->state = SLAB_FREE;
+    memset((char*)object + sizeof(void*), POISON, pool->objectSize - sizeof(void*));
+#endif
+    pool->live--;
+    pushFree(pool, (char*)object);
+}
+
+size_t slabCheckLeaks(const SlabPool* pool, const char* name) {
+#ifdef DNS_ARENA_DEBUG
+    if (pool->live > 0) {
+        fprintf(stderr, "对象池%s有%zu个对象未归还\n", name, pool->live);
+    }
+#else
+    (void)name;
+#endif
+    return pool->live;
+}
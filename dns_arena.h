@@ -0,0 +1,104 @@
+/**
+ * @file dns_arena.h
+ * @brief 线程私有的内存区和定长对象池
+ * @details Arena按块向系统申请内存，分配只移动指针，不逐个释放，所有块在arenaDestroy时一并归还系统，
+ *          用于随所有者一起释放的表和缓冲区。SlabPool从Arena切出定长对象，释放的对象挂在空闲链表上
+ *          供下次分配，稳定运行后不再调用malloc，目前用于TCP连接的发送缓冲。
+ *          两者都不加锁：只能由一个线程使用，或由调用方已经持有的锁保护。
+ *          编译时定义DNS_ARENA_DEBUG启用检查：新块和释放的对象填充0xDD，分配时检查填充是否完好，
+ *          发现越过前一次分配末尾的写入和释放之后的写入；对象池还检查重复释放和不属于本池的指针，
+ *          销毁时报告未归还的对象。
+ *          检查失败时打印到stderr并abort
+ */
+
+#ifndef DNS_ARENA_H
+#define DNS_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 16                 ///< 分配结果的对齐
+#define ARENA_DEFAULT_CHUNK 65536      ///< 默认块大小
+
+typedef struct ArenaChunk ArenaChunk;
+
+/**
+ * @struct Arena
+ * @brief 指针递增的内存区
+ */
+typedef struct {
+    ArenaChunk* first;     ///< 块链表，按申请顺序
+    ArenaChunk* current;   ///< 正在分配的块
+    size_t offset;         ///< 当前块已用字节数
+    size_t chunkSize;      ///< 新块的默认大小，超过它的分配单独占一块
+    size_t reserved;       ///< 已向系统申请的字节数
+} Arena;
+
+/**
+ * @struct SlabPool
+ * @brief 定长对象池
+ */
+typedef struct {
+    Arena* arena;          ///< 对象所在的内存区，池不拥有它
+    size_t stride;         ///< 每个对象占用的字节数（含调试头，按ARENA_ALIGN对齐）
+    size_t objectSize;     ///< 调用方请求的对象大小
+    size_t perRefill;      ///< 空闲链表为空时一次切出的对象数
+    void* freeList;        ///< 空闲对象，链接指针存放在对象开头
+    size_t live;           ///< 已分配未归还的对象数
+} SlabPool;
+
+/**
+ * @brief 初始化内存区，不立即申请内存
+ * @param arena 内存区
+ * @param chunkSize 块大小，0表示ARENA_DEFAULT_CHUNK
+ */
+void arenaInit(Arena* arena, size_t chunkSize);
+
+/**
+ * @brief 分配内存，内容未初始化
+ * @return ARENA_ALIGN对齐的内存，内存不足返回NULL
+ */
+void* arenaAlloc(Arena* arena, size_t size);
+
+/**
+ * @brief 分配count * size字节并清零
+ * @return 内存，溢出或内存不足返回NULL
+ */
+void* arenaCalloc(Arena* arena, size_t count, size_t size);
+
+/**
+ * @brief 把所有块归还系统，之后可以重新使用（相当于重新arenaInit）
+ */
+void arenaDestroy(Arena* arena);
+
+/**
+ * @brief 初始化对象池
+ * @param pool 对象池
+ * @param arena 提供内存的内存区，在池使用期间不能销毁
+ * @param objectSize 对象大小
+ * @param perRefill 每次补充的对象数，0表示按内存区的块大小计算
+ */
+void slabInit(SlabPool* pool, Arena* arena, size_t objectSize, size_t perRefill);
+
+/**
+ * @brief 取一个对象，内容未初始化
+ * @return 对象，内存不足返回NULL
+ */
+void* slabAlloc(SlabPool* pool);
+
+/**
+ * @brief 归还对象
+ * @param object slabAlloc返回的对象，NULL时不做任何事
+ */
+void slabFree(SlabPool* pool, void* object);
+
+/**
+ * @brief 检查未归还的对象
+ * @param pool 对象池
+ * @param name 报告中使用的池名称
+ * @return 未归还的对象数；调试模式下不为0时打印到stderr
+ * @details 在释放内存区之前调用，所有对象都应已归还
+ */
+size_t slabCheckLeaks(const SlabPool* pool, const char* name);
+
+#endif // DNS_ARENA_H
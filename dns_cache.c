@@ -0,0 +1,422 @@
+#include "dns_cache.h"
+#include "dns_message.h"
+#include "dns_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_KEY_SIZE 261          // 线格式域名最长255字节 + QTYPE + QCLASS + 标志字节
+#define MIN_BUCKETS 1024
+
+// 条目种类，只用于统计
+enum { ENTRY_POSITIVE, ENTRY_NEGATIVE, ENTRY_FAILURE };
+
+// 一个缓存条目，键、TTL偏移和响应报文紧随结构体存放
+typedef struct CacheEntry {
+    struct CacheEntry* chain;       // 哈希桶链表
+    struct CacheEntry* clockPrev;   // CLOCK环
+    struct CacheEntry* clockNext;
+    uint64_t storedNs;              // 写入时刻
+    uint64_t expireNs;              // 过期时刻
+    uint64_t staleNs;               // 过期后仍可应答的截止时刻，不允许过期应答时等于expireNs
+    uint64_t refreshNs;             // 最近一次要求后台刷新的时刻，0表示未要求过
+    uint32_t hits;                  // 写入以来的命中次数
+    uint32_t hash;
+    uint16_t keyLength;
+    uint16_t responseLength;
+    uint16_t ttlCount;
+    uint8_t referenced;             // CLOCK访问位
+    uint8_t data[];                 // key | ttlOffsets | response
+} CacheEntry;
+
+// 一个分片：独立的锁、哈希桶、CLOCK环和容量。分片按缓存行对齐，
+// 不同线程频繁写入的锁和统计不会落在同一缓存行上
+typedef struct {
+    _Alignas(DNS_CACHE_LINE) DNSMutex lock;
+    CacheEntry** buckets;
+    size_t bucketMask;
+    CacheEntry* hand;               // CLOCK指针
+    size_t maxBytes;
+    CacheStats stats;
+} CacheShard;
+
+struct ResponseCache {
+    CacheShard* shards;
+    uint32_t shardCount;
+    uint64_t staleWindowNs;         // 过期后继续应答的时长
+};
+
+static uint16_t* entryTtlOffsets(CacheEntry* entry) {
+    return (uint16_t*)(entry->data + ((entry->keyLength + 1u) & ~1u));
+}
+
+static uint8_t* entryResponse(CacheEntry* entry) {
+    return (uint8_t*)(entryTtlOffsets(entry) + entry->ttlCount);
+}
+
+static size_t entrySize(size_t keyLength, size_t ttlCount, size_t responseLength) {
+    return sizeof(CacheEntry) + ((keyLength + 1) & ~(size_t)1) +
+           ttlCount * sizeof(uint16_t) + responseLength;
+}
+
+static void freeShard(CacheShard* shard) {
+    for (size_t i = 0; i <= shard->bucketMask; i++) {
+        CacheEntry* entry = shard->buckets[i];
+        while (entry) {
+            CacheEntry* next = entry->chain;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    dnsMutexDestroy(&shard->lock);
+}
+
+ResponseCache* createCache(size_t maxBytes, int shardCount, uint32_t staleSeconds) {
+    if (shardCount < 1) shardCount = 1;
+    if (shardCount > CACHE_MAX_SHARDS) shardCount = CACHE_MAX_SHARDS;
+
+    ResponseCache* cache = (ResponseCache*)calloc(1, sizeof(ResponseCache));
+    if (!cache) return NULL;
+    cache->shards = (CacheShard*)dnsAlignedAlloc((size_t)shardCount * sizeof(CacheShard));
+    if (!cache->shards) {
+        free(cache);
+        return NULL;
+    }
+    cache->staleWindowNs = (uint64_t)staleSeconds * 1000000000ULL;
+
+    // 容量平均分给各分片，桶数按平均每条约256字节估算
+    size_t shardBytes = maxBytes / (size_t)shardCount;
+    size_t buckets = MIN_BUCKETS;
+    while (buckets < shardBytes / 256) buckets <<= 1;
+    for (int i = 0; i < shardCount; i++) {
+        CacheShard* shard = &cache->shards[i];
+        shard->buckets = (CacheEntry**)calloc(buckets, sizeof(CacheEntry*));
+        if (!shard->buckets) {
+            destroyCache(cache);
+            return NULL;
+        }
+        shard->bucketMask = buckets - 1;
+        shard->maxBytes = shardBytes;
+        dnsMutexInit(&shard->lock);
+        cache->shardCount++;
+    }
+    return cache;
+}
+
+void destroyCache(ResponseCache* cache) {
+    if (!cache) return;
+    for (uint32_t i = 0; i < cache->shardCount; i++) {
+        freeShard(&cache->shards[i]);
+    }
+    dnsAlignedFree(cache->shards);
+    free(cache);
+}
+
+// 用哈希的高位选分片，低位留给分片内的桶，两者互不相关
+static CacheShard* shardFor(ResponseCache* cache, uint32_t hash) {
+    return &cache->shards[((uint64_t)hash * cache->shardCount) >> 32];
+}
+
+// 从哈希表和CLOCK环中摘除并释放条目（调用方持有锁）
+static void removeEntry(CacheShard* shard, CacheEntry* entry) {
+    CacheEntry** link = &shard->buckets[entry->hash & shard->bucketMask];
+    while (*link != entry) link = &(*link)->chain;
+    *link = entry->chain;
+
+    if (entry->clockNext == entry) {
+        shard->hand = NULL;
+    } else {
+        entry->clockPrev->clockNext = entry->clockNext;
+        entry->clockNext->clockPrev = entry->clockPrev;
+        if (shard->hand == entry) shard->hand = entry->clockNext;
+    }
+
+    shard->stats.entries--;
+    shard->stats.bytes -= entrySize(entry->keyLength, entry->ttlCount, entry->responseLength);
+    free(entry);
+}
+
+static CacheEntry* findEntry(CacheShard* shard, const uint8_t* key,
+                             size_t keyLength, uint32_t hash) {
+    CacheEntry* entry = shard->buckets[hash & shard->bucketMask];
+    while (entry) {
+        if (entry->hash == hash && entry->keyLength == keyLength &&
+            memcmp(entry->data, key, keyLength) == 0) {
+            return entry;
+        }
+        entry = entry->chain;
+    }
+    return NULL;
+}
+
+// CLOCK淘汰：跳过最近访问过的条目并清除其访问位，淘汰第一个未访问或已不能应答的条目
+static void evictUntil(CacheShard* shard, size_t needed, uint64_t now) {
+    while (shard->hand && shard->stats.bytes + needed > shard->maxBytes) {
+        CacheEntry* victim = shard->hand;
+        if (victim->referenced && victim->staleNs > now) {
+            victim->referenced = 0;
+            shard->hand = victim->clockNext;
+            continue;
+        }
+        shard->stats.evictions++;
+        removeEntry(shard, victim);
+    }
+}
+
+// 刷新间隔内只发起一次后台刷新；上游不可用时每隔这么久重试一次
+static int claimRefresh(CacheEntry* entry, uint64_t now) {
+    if (entry->refreshNs != 0 && now - entry->refreshNs < CACHE_REFRESH_RETRY_MS * 1000000ULL) {
+        return 0;
+    }
+    entry->refreshNs = now;
+    return 1;
+}
+
+static void writeTtl(uint8_t* p, uint32_t ttl) {
+    p[0] = (uint8_t)(ttl >> 24);
+    p[1] = (uint8_t)(ttl >> 16);
+    p[2] = (uint8_t)(ttl >> 8);
+    p[3] = (uint8_t)ttl;
+}
+
+size_t cacheLookup(ResponseCache* cache, const char* query, size_t length,
+                   char* response, size_t responseSize, size_t limit, int* refresh) {
+    *refresh = 0;
+    uint8_t key[CACHE_KEY_SIZE];
+    size_t questionLength = 0;
+    size_t keyLength = extractQuestionKey(query, length, key, sizeof(key), &questionLength);
+    if (keyLength == 0) return 0;
+
+    uint32_t hash = hashDomain((const char*)key, keyLength);
+    uint64_t now = dnsNowNs();
+    CacheShard* shard = shardFor(cache, hash);
+
+    if (limit > responseSize) limit = responseSize;
+    dnsMutexLock(&shard->lock);
+    CacheEntry* entry = findEntry(shard, key, keyLength, hash);
+    if (!entry) {
+        shard->stats.misses++;
+        dnsMutexUnlock(&shard->lock);
+        return 0;
+    }
+    if (entry->staleNs <= now) {
+        shard->stats.misses++;
+        shard->stats.expired++;
+        removeEntry(shard, entry);
+        dnsMutexUnlock(&shard->lock);
+        return 0;
+    }
+
+    // 放不下的条目直接截断成TC应答：只剩问题部分和OPT，没有需要递减的TTL
+    size_t responseLength = entry->responseLength;
+    int truncated = responseLength > limit;
+    if (truncated) {
+        responseLength = truncateResponse((const char*)entryResponse(entry), responseLength, limit,
+                                          response, responseSize);
+        if (responseLength == 0) {
+            shard->stats.misses++;
+            dnsMutexUnlock(&shard->lock);
+            return 0;
+        }
+    }
+
+    entry->referenced = 1;
+    entry->hits++;
+    shard->stats.hits++;
+    int stale = entry->expireNs <= now;
+    if (stale) {
+        // 已过期但仍在serve-stale窗口内：先用过期数据应答，同时在后台刷新
+        shard->stats.stale++;
+        *refresh = claimRefresh(entry, now);
+    } else if (entry->hits >= CACHE_PREFETCH_HITS &&
+               (entry->expireNs - now) * CACHE_PREFETCH_DIVISOR <= entry->expireNs - entry->storedNs &&
+               claimRefresh(entry, now)) {
+        // 热门条目临近过期时提前刷新，新数据写入前仍按原条目应答
+        shard->stats.prefetches++;
+        *refresh = 1;
+    }
+
+    if (!truncated) {
+        memcpy(response, entryResponse(entry), responseLength);
+
+        // 按已缓存的时间递减每条记录的TTL；过期数据统一使用较短的TTL
+        uint32_t elapsed = (uint32_t)((now - entry->storedNs) / 1000000000ULL);
+        uint16_t* offsets = entryTtlOffsets(entry);
+        for (uint16_t i = 0; i < entry->ttlCount; i++) {
+            uint8_t* p = (uint8_t*)response + offsets[i];
+            uint32_t ttl = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+            if (stale) {
+                ttl = CACHE_STALE_TTL;
+            } else {
+                ttl = ttl > elapsed ? ttl - elapsed : 0;
+            }
+            writeTtl(p, ttl);
+        }
+    }
+    dnsMutexUnlock(&shard->lock);
+
+    // 事务ID和问题部分（保留客户端的大小写）取自本次查询
+    memcpy(response, query, 2);
+    memcpy(response + 12, query + 12, questionLength);
+    return responseLength;
+}
+
+// 把新条目放入分片；keep为非0时已有的同名条目保留、新条目被丢弃
+static void insertEntry(CacheShard* shard, CacheEntry* entry, int kind, int keep) {
+    size_t size = entrySize(entry->keyLength, entry->ttlCount, entry->responseLength);
+
+    dnsMutexLock(&shard->lock);
+    CacheEntry* old = findEntry(shard, entry->data, entry->keyLength, entry->hash);
+    if (old && keep) {
+        dnsMutexUnlock(&shard->lock);
+        free(entry);
+        return;
+    }
+    if (old) removeEntry(shard, old);
+    evictUntil(shard, size, entry->storedNs);
+
+    CacheEntry** bucket = &shard->buckets[entry->hash & shard->bucketMask];
+    entry->chain = *bucket;
+    *bucket = entry;
+
+    // 新条目插在CLOCK指针之前，即最后一个被检查
+    if (shard->hand) {
+        entry->clockNext = shard->hand;
+        entry->clockPrev = shard->hand->clockPrev;
+        shard->hand->clockPrev->clockNext = entry;
+        shard->hand->clockPrev = entry;
+    } else {
+        entry->clockNext = entry;
+        entry->clockPrev = entry;
+        shard->hand = entry;
+    }
+
+    shard->stats.inserts++;
+    if (kind == ENTRY_NEGATIVE) shard->stats.negative++;
+    if (kind == ENTRY_FAILURE) shard->stats.failures++;
+    shard->stats.entries++;
+    shard->stats.bytes += size;
+    dnsMutexUnlock(&shard->lock);
+}
+
+// 分配并填写条目，超出分片容量或内存不足时返回NULL
+static CacheEntry* newEntry(CacheShard* shard, const uint8_t* key, size_t keyLength, uint32_t hash,
+                            const uint16_t* offsets, int ttlCount,
+                            const char* response, size_t responseLength, uint32_t ttl) {
+    size_t size = entrySize(keyLength, (size_t)ttlCount, responseLength);
+    if (size > shard->maxBytes) return NULL;
+
+    CacheEntry* entry = (CacheEntry*)malloc(size);
+    if (!entry) return NULL;
+    entry->hash = hash;
+    entry->keyLength = (uint16_t)keyLength;
+    entry->responseLength = (uint16_t)responseLength;
+    entry->ttlCount = (uint16_t)ttlCount;
+    entry->referenced = 0;
+    entry->hits = 0;
+    entry->refreshNs = 0;
+    entry->storedNs = dnsNowNs();
+    entry->expireNs = entry->storedNs + (uint64_t)ttl * 1000000000ULL;
+    entry->staleNs = entry->expireNs;
+    memcpy(entry->data, key, keyLength);
+    if (ttlCount > 0) memcpy(entryTtlOffsets(entry), offsets, (size_t)ttlCount * sizeof(uint16_t));
+    memcpy(entryResponse(entry), response, responseLength);
+    return entry;
+}
+
+void cacheStore(ResponseCache* cache, const char* query, size_t queryLength,
+                const char* response, size_t responseLength) {
+    if (responseLength < 12 || responseLength > 0xFFFF) return;
+
+    // 截断的响应不完整，SERVFAIL等其他错误由cacheStoreFailure处理
+    uint16_t flags = (uint16_t)(((uint8_t)response[2] << 8) | (uint8_t)response[3]);
+    uint16_t ancount = (uint16_t)(((uint8_t)response[6] << 8) | (uint8_t)response[7]);
+    int rcode = flags & 0x000F;
+    if ((flags & 0x0200) || (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN)) return;
+    int negative = rcode == DNS_RCODE_NXDOMAIN || ancount == 0;
+
+    uint8_t key[CACHE_KEY_SIZE];
+    size_t keyLength = extractQuestionKey(query, queryLength, key, sizeof(key), NULL);
+    if (keyLength == 0) return;
+
+    uint16_t offsets[CACHE_MAX_RECORDS];
+    uint32_t ttl = 0;
+    int ttlCount = collectTtlOffsets(response, responseLength, offsets,
+                                     CACHE_MAX_RECORDS, &ttl);
+    if (ttlCount <= 0) return;
+    if (negative) {
+        // RFC 2308：否定应答只有带SOA时才缓存，时长取SOA的TTL与MINIMUM中的较小值
+        uint32_t negativeTtl = 0;
+        if (!findNegativeTtl(response, responseLength, &negativeTtl)) return;
+        if (negativeTtl < ttl) ttl = negativeTtl;
+        if (ttl > CACHE_MAX_NEGATIVE_TTL) ttl = CACHE_MAX_NEGATIVE_TTL;
+    } else if (ttl > CACHE_MAX_TTL) {
+        ttl = CACHE_MAX_TTL;
+    }
+    if (ttl == 0) return;
+
+    uint32_t hash = hashDomain((const char*)key, keyLength);
+    CacheShard* shard = shardFor(cache, hash);
+    CacheEntry* entry = newEntry(shard, key, keyLength, hash, offsets, ttlCount,
+                                 response, responseLength, ttl);
+    if (!entry) return;
+    entry->staleNs = entry->expireNs + cache->staleWindowNs;
+
+    // 否定应答中所有记录（主要是SOA）的TTL都不超过否定缓存时长
+    if (negative) {
+        uint8_t* stored = entryResponse(entry);
+        for (int i = 0; i < ttlCount; i++) {
+            uint8_t* p = stored + offsets[i];
+            uint32_t recordTtl = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                                 ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+            if (recordTtl > ttl) writeTtl(p, ttl);
+        }
+    }
+
+    insertEntry(shard, entry, negative ? ENTRY_NEGATIVE : ENTRY_POSITIVE, 0);
+}
+
+void cacheStoreFailure(ResponseCache* cache, const char* query, size_t queryLength) {
+    char response[12 + CACHE_KEY_SIZE + 11];        // 头部 + 问题 + OPT
+    size_t responseLength = buildErrorResponse(query, queryLength, DNS_RCODE_SERVFAIL,
+                                               response, sizeof(response));
+    if (responseLength == 0) return;
+
+    uint8_t key[CACHE_KEY_SIZE];
+    size_t keyLength = extractQuestionKey(query, queryLength, key, sizeof(key), NULL);
+    if (keyLength == 0) return;
+
+    uint32_t hash = hashDomain((const char*)key, keyLength);
+    CacheShard* shard = shardFor(cache, hash);
+    CacheEntry* entry = newEntry(shard, key, keyLength, hash, NULL, 0,
+                                 response, responseLength, CACHE_FAILURE_TTL);
+    if (!entry) return;
+
+    // 已有的条目（即使已过期）比失败记录更有用，不覆盖
+    insertEntry(shard, entry, ENTRY_FAILURE, 1);
+}
+
+void cacheGetStats(ResponseCache* cache, CacheStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < cache->shardCount; i++) {
+        CacheShard* shard = &cache->shards[i];
+        dnsMutexLock(&shard->lock);
+        stats->hits += shard->stats.hits;
+        stats->misses += shard->stats.misses;
+        stats->inserts += shard->stats.inserts;
+        stats->evictions += shard->stats.evictions;
+        stats->expired += shard->stats.expired;
+        stats->stale += shard->stats.stale;
+        stats->prefetches += shard->stats.prefetches;
+        stats->negative += shard->stats.negative;
+        stats->failures += shard->stats.failures;
+        stats->entries += shard->stats.entries;
+        stats->bytes += shard->stats.bytes;
+        dnsMutexUnlock(&shard->lock);
+    }
+}
+
+int cacheShardCount(const ResponseCache* cache) {
+    return (int)cache->shardCount;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file dns_cache.h
+ * @brief 中继响应缓存的头文件定义
+ * @details 以(qname, qtype, qclass)和影响应答内容的查询标志（RD、CD、是否带EDNS及DO位）为键
+ *          缓存上游的线格式响应及其过期时间，与中继合并相同查询用的键一致。
+ *          命中时只改写事务ID并按经过的时间递减TTL，不重新编码报文。
+ *          缓存总字节数有上限，超出时按CLOCK算法淘汰。
+ *          NXDOMAIN和NODATA按RFC 2308以SOA决定的时长做否定缓存；上游失败时短暂缓存SERVFAIL，
+ *          避免随后的查询再等一次上游超时。条目过期后在serve-stale窗口内仍以较短的TTL应答，
+ *          由调用方在后台刷新；临近过期的热门条目也会提前刷新。
+ *          缓存按查询名哈希分为若干分片，每个分片有独立的锁和容量，
+ *          多个工作线程同时查找不同的名字时不会争用同一把锁
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include "dns_platform.h"
+
+#define CACHE_DEFAULT_BYTES (16 * 1024 * 1024)  ///< 默认缓存容量（字节）
+#define CACHE_MAX_TTL 86400                      ///< 缓存时间上限（秒）
+#define CACHE_MAX_RECORDS 64                     ///< 单个响应可缓存的最大记录数
+#define CACHE_MAX_SHARDS 256                     ///< 分片数上限
+#define CACHE_MAX_NEGATIVE_TTL 10800             ///< 否定缓存时间上限（秒，RFC 2308建议1至3小时）
+#define CACHE_FAILURE_TTL 5                      ///< 上游失败后缓存SERVFAIL的时间（秒，RFC 2308要求不超过5分钟）
+#define CACHE_DEFAULT_STALE 86400                ///< 默认serve-stale窗口（秒）
+#define CACHE_STALE_TTL 30                       ///< 过期数据应答中使用的TTL（秒，RFC 8767建议值）
+#define CACHE_REFRESH_RETRY_MS 5000              ///< 同一条目两次后台刷新之间的最短间隔
+#define CACHE_PREFETCH_HITS 3                    ///< 写入以来命中达到该次数的条目才会预取
+#define CACHE_PREFETCH_DIVISOR 10                ///< 剩余时间不足原TTL的1/10时预取
+
+/**
+ * @struct CacheStats
+ * @brief 缓存统计
+ */
+typedef struct {
+    uint64_t hits;        ///< 命中次数
+    uint64_t misses;      ///< 未命中次数（含已过期）
+    uint64_t inserts;     ///< 写入次数
+    uint64_t evictions;   ///< 因容量不足淘汰的条目数
+    uint64_t expired;     ///< 因过期删除的条目数
+    uint64_t stale;       ///< 用过期数据应答的次数（计入hits）
+    uint64_t prefetches;  ///< 临近过期而要求预取的次数
+    uint64_t negative;    ///< 写入的否定应答数（计入inserts）
+    uint64_t failures;    ///< 写入的SERVFAIL记录数（计入inserts）
+    size_t entries;       ///< 当前条目数
+    size_t bytes;         ///< 当前占用字节数
+} CacheStats;
+
+typedef struct ResponseCache ResponseCache;
+
+/**
+ * @brief 创建响应缓存
+ * @param maxBytes 缓存容量上限（字节），平均分给各分片
+ * @param shardCount 分片数，通常取工作线程数；小于1时按1处理，超过CACHE_MAX_SHARDS时取上限
+ * @param staleSeconds 条目过期后继续应答的最长时间（秒），0表示不使用过期数据
+ * @return 缓存，失败返回NULL
+ */
+ResponseCache* createCache(size_t maxBytes, int shardCount, uint32_t staleSeconds);
+
+/**
+ * @brief 销毁响应缓存
+ */
+void destroyCache(ResponseCache* cache);
+
+/**
+ * @brief 查找缓存
+ * @param cache 缓存
+ * @param query 客户端查询报文
+ * @param length 查询长度
+ * @param response 输出缓冲区
+ * @param responseSize 输出缓冲区大小
+ * @param limit 客户端可接收的应答长度（UDP见udpResponseLimit），不超过responseSize
+ * @param refresh 输出：非0表示调用方应当把该查询转发到上游刷新缓存（条目已过期或临近过期），
+ *                同一条目在CACHE_REFRESH_RETRY_MS内只要求一次
+ * @return 命中时返回响应长度（已改写事务ID与TTL），未命中返回0
+ * @details 条目超出limit时（多为上游TC后经TCP取回的大应答）仍算命中，
+ *          按truncateResponse截断为只含问题部分和OPT的TC应答，客户端随后改用TCP取完整应答
+ */
+size_t cacheLookup(ResponseCache* cache, const char* query, size_t length,
+                   char* response, size_t responseSize, size_t limit, int* refresh);
+
+/**
+ * @brief 缓存上游响应
+ * @param cache 缓存
+ * @param query 对应的查询报文
+ * @param queryLength 查询长度
+ * @param response 上游响应
+ * @param responseLength 响应长度
+ * @details 带回答记录的NOERROR响应按所有记录的最小TTL缓存；NXDOMAIN和NODATA只在带SOA时缓存。
+ *          截断的响应和其他错误不缓存
+ */
+void cacheStore(ResponseCache* cache, const char* query, size_t queryLength,
+                const char* response, size_t responseLength);
+
+/**
+ * @brief 记录上游查询失败，随后CACHE_FAILURE_TTL秒内的相同查询直接得到SERVFAIL
+ * @param cache 缓存
+ * @param query 失败的查询报文
+ * @param queryLength 查询长度
+ * @details 已有同名条目（包括可用作过期应答的条目）时不写入
+ */
+void cacheStoreFailure(ResponseCache* cache, const char* query, size_t queryLength);
+
+/**
+ * @brief 读取缓存统计（各分片之和）
+ */
+void cacheGetStats(ResponseCache* cache, CacheStats* stats);
+
+/**
+ * @brief 获取实际的分片数
+ */
+int cacheShardCount(const ResponseCache* cache);
+
+#endif // DNS_CACHE_H
@@ -0,0 +1,182 @@
+#include "dns_capture.h"
+#include "dns_platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_SIZE 4096
+#define MAX_FRAME (sizeof(CaptureFrame) + 2 * 65535 + 8)
+
+static inline uint64_t alignFrame(uint64_t length) {
+    return (length + 7) & ~(uint64_t)7;
+}
+
+// pos处的帧长度；回绕标记或已到数据区末尾时返回0
+static inline uint32_t frameLengthAt(const uint8_t* data, uint64_t pos, uint64_t size) {
+    if (pos + sizeof(uint32_t) > size) return 0;
+    uint32_t length;
+    memcpy(&length, data + pos, sizeof(length));
+    return length;
+}
+
+CaptureFile* createCapture(const char* path, size_t bytes, int segments) {
+    if (segments <= 0) return NULL;
+    size_t headerSize = sizeof(CaptureFileHeader) + (size_t)segments * sizeof(CaptureSegment);
+    size_t dataOffset = (headerSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    if (bytes <= dataOffset) return NULL;
+    uint64_t segmentSize = (uint64_t)(bytes - dataOffset) / (uint64_t)segments & ~(uint64_t)7;
+    if (segmentSize < CAPTURE_MIN_SEGMENT) return NULL;
+
+    CaptureFile* capture = (CaptureFile*)calloc(1, sizeof(CaptureFile));
+    if (!capture) return NULL;
+    capture->size = dataOffset + (size_t)(segmentSize * (uint64_t)segments);
+    capture->base = (uint8_t*)dnsCreateMappedFile(path, capture->size);
+    if (!capture->base) {
+        free(capture);
+        return NULL;
+    }
+    // 预先写一遍，分配好文件块并建立页表
+    memset(capture->base, 0, capture->size);
+
+    CaptureFileHeader* header = (CaptureFileHeader*)capture->base;
+    memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = CAPTURE_VERSION;
+    header->segmentCount = (uint32_t)segments;
+    header->segmentSize = segmentSize;
+    header->dataOffset = dataOffset;
+    header->createdMs = dnsWallTimeMs();
+    header->createdNs = dnsNowNs();
+
+    capture->segments = (CaptureSegment*)(header + 1);
+    capture->data = capture->base + dataOffset;
+    capture->segmentCount = (uint32_t)segments;
+    capture->segmentSize = segmentSize;
+    return capture;
+}
+
+void destroyCapture(CaptureFile* capture) {
+    if (!capture) return;
+    dnsUnmapFile(capture->base, capture->size);
+    free(capture);
+}
+
+void captureRecord(CaptureFile* capture, int segment, const CaptureFrame* info,
+                   const char* query, size_t queryLength, const char* response, size_t responseLength) {
+    if ((uint32_t)segment >= capture->segmentCount || queryLength > 0xFFFF || responseLength > 0xFFFF) return;
+    CaptureSegment* seg = &capture->segments[segment];
+    uint8_t* data = capture->data + (size_t)segment * capture->segmentSize;
+    uint64_t size = capture->segmentSize;
+    uint64_t length = alignFrame(sizeof(CaptureFrame) + queryLength + responseLength);
+    uint64_t head = seg->head;
+    uint64_t tail = seg->tail;
+    uint64_t overwritten = 0;
+
+    // 末尾放不下：写回绕标记从头开始，标记之后的旧帧一并丢弃
+    if (head + length > size) {
+        if (seg->wrapped) {
+            while (tail >= head) {
+                uint32_t old = frameLengthAt(data, tail, size);
+                if (old == 0) break;
+                tail += old;
+                overwritten++;
+            }
+        }
+        if (size - head >= sizeof(uint32_t)) memset(data + head, 0, sizeof(uint32_t));
+        head = 0;
+        tail = 0;
+        seg->wrapped = 1;
+    }
+    // 跳过将被本帧覆盖的旧帧；走到回绕标记说明旧帧已全部覆盖，剩下的都是回绕后写入的
+    if (seg->wrapped) {
+        while (tail >= head && tail < head + length) {
+            uint32_t old = frameLengthAt(data, tail, size);
+            if (old == 0) {
+                tail = 0;
+                break;
+            }
+            tail += old;
+            overwritten++;
+        }
+    }
+
+    CaptureFrame* frame = (CaptureFrame*)(data + head);
+    *frame = *info;
+    frame->length = (uint32_t)length;
+    frame->queryLength = (uint16_t)queryLength;
+    frame->responseLength = (uint16_t)responseLength;
+    memcpy(frame + 1, query, queryLength);
+    memcpy((uint8_t*)(frame + 1) + queryLength, response, responseLength);
+
+    seg->head = head + length;
+    seg->tail = tail;
+    seg->frames++;
+    seg->overwritten += overwritten;
+}
+
+int captureOpenView(CaptureView* view, const char* path) {
+    memset(view, 0, sizeof(*view));
+    size_t size = 0;
+    const uint8_t* base = (const uint8_t*)dnsMapFile(path, &size);
+    if (!base) return 0;
+
+    const CaptureFileHeader* header = (const CaptureFileHeader*)base;
+    if (size < sizeof(*header) || memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CAPTURE_VERSION || header->segmentCount == 0 ||
+        header->dataOffset < sizeof(*header) + (uint64_t)header->segmentCount * sizeof(CaptureSegment) ||
+        header->segmentSize < CAPTURE_MIN_SEGMENT ||
+        header->dataOffset + header->segmentSize * header->segmentCount > size) {
+        dnsUnmapFile(base, size);
+        return 0;
+    }
+    view->base = base;
+    view->size = size;
+    view->header = header;
+    view->segments = (const CaptureSegment*)(header + 1);
+    view->data = base + header->dataOffset;
+    return 1;
+}
+
+void captureCloseView(CaptureView* view) {
+    dnsUnmapFile(view->base, view->size);
+    memset(view, 0, sizeof(*view));
+}
+
+void captureCursorInit(const CaptureView* view, uint32_t segment, CaptureCursor* cursor) {
+    const CaptureSegment* seg = &view->segments[segment];
+    uint64_t size = view->header->segmentSize;
+    cursor->data = view->data + (size_t)segment * size;
+    cursor->size = size;
+    cursor->head = seg->head <= size ? seg->head : 0;
+    if (!seg->wrapped) {
+        cursor->pos = 0;
+        cursor->end = cursor->head;
+        cursor->phase = 1;
+    } else if (seg->tail < cursor->head) {
+        cursor->pos = seg->tail;
+        cursor->end = cursor->head;
+        cursor->phase = 1;
+    } else {
+        cursor->pos = seg->tail;
+        cursor->end = size;
+        cursor->phase = 0;
+    }
+}
+
+const CaptureFrame* captureNext(CaptureCursor* cursor) {
+    for (;;) {
+        uint32_t length = frameLengthAt(cursor->data, cursor->pos, cursor->end);
+        if (length == 0 && cursor->phase == 0) {
+            cursor->pos = 0;
+            cursor->end = cursor->head;
+            cursor->phase = 1;
+            continue;
+        }
+        if (length < sizeof(CaptureFrame) || length > MAX_FRAME || length % 8 != 0 ||
+            cursor->pos + length > cursor->end) {
+            return NULL;
+        }
+        const CaptureFrame* frame = (const CaptureFrame*)(cursor->data + cursor->pos);
+        if (sizeof(CaptureFrame) + (uint64_t)frame->queryLength + frame->responseLength > length) return NULL;
+        cursor->pos += length;
+        return frame;
+    }
+}
@@ -0,0 +1,179 @@
+/**
+ * @file dns_capture.h
+ * @brief 查询抓包：内存映射的二进制环形文件
+ * @details 每个应答（本地、屏蔽、缓存、中继和失败）记录为一帧：收到查询的时刻、客户端地址、
+ *          传输方式、处理路径、耗时，以及原始查询和应答报文。
+ *          文件分为若干段，每个工作线程写一段（转发的查询也在收到它的工作线程中完成并记录），
+ *          段内是环形缓冲区，写满后覆盖最早的帧；
+ *          写入只是向映射内存复制数据，不加锁、不调用系统调用，数据由操作系统写回文件，
+ *          进程异常退出也不会丢失已写入的帧。
+ *          文件布局：CaptureFileHeader | CaptureSegment[segmentCount] | 对齐到4096 | 各段数据区。
+ *          数据区内每帧以CaptureFrame开头，随后是查询和应答报文，整帧按8字节对齐；
+ *          length为0的帧是回绕标记，表示本段其余部分无效、下一帧从数据区开头继续。
+ *          读取接口供离线工具（如dnsreplay）使用，应在服务器停止后读取，或读取文件的副本
+ */
+
+#ifndef DNS_CAPTURE_H
+#define DNS_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "DNSCAP01"
+#define CAPTURE_VERSION 1
+#define CAPTURE_DEFAULT_BYTES (64u << 20)   ///< 默认抓包文件大小
+#define CAPTURE_MIN_SEGMENT (1u << 20)       ///< 每段最小字节数，保证最大的帧也只占一小部分
+
+/**
+ * @brief 帧的传输方式
+ */
+enum { CAPTURE_UDP = 0, CAPTURE_TCP = 1 };
+
+/**
+ * @struct CaptureFileHeader
+ * @brief 文件头（64字节）
+ */
+typedef struct {
+    char magic[8];           ///< CAPTURE_MAGIC
+    uint32_t version;        ///< CAPTURE_VERSION
+    uint32_t segmentCount;   ///< 段数
+    uint64_t segmentSize;    ///< 每段数据区字节数
+    uint64_t dataOffset;     ///< 第一段数据区在文件中的偏移
+    uint64_t createdMs;      ///< 创建时的墙上时间（毫秒）
+    uint64_t createdNs;      ///< 创建时的dnsNowNs，帧时间戳减去它再加createdMs即为墙上时间
+    uint8_t reserved[16];
+} CaptureFileHeader;
+
+/**
+ * @struct CaptureSegment
+ * @brief 段状态（64字节，各段由不同线程写入，互不共享缓存行）
+ */
+typedef struct {
+    uint64_t head;           ///< 下一帧的写入位置
+    uint64_t tail;           ///< 最早的完整帧的位置（回绕后有效）
+    uint64_t frames;         ///< 累计写入的帧数
+    uint64_t overwritten;    ///< 被覆盖的帧数
+    uint32_t wrapped;        ///< 是否已经回绕过
+    uint8_t reserved[28];
+} CaptureSegment;
+
+/**
+ * @struct CaptureFrame
+ * @brief 帧头（32字节），随后是queryLength字节的查询和responseLength字节的应答
+ */
+typedef struct {
+    uint32_t length;         ///< 整帧长度（含帧头，8字节对齐），0表示回绕标记
+    uint16_t queryLength;
+    uint16_t responseLength;
+    uint64_t timestampNs;    ///< 收到查询的时刻（dnsNowNs）
+    uint32_t latencyNs;      ///< 从收到查询到发出应答，超出范围时饱和
+    uint32_t client;         ///< 客户端IPv4地址（网络字节序）
+    uint16_t clientPort;     ///< 客户端端口（网络字节序）
+    uint8_t path;            ///< 处理路径（MetricPath）
+    uint8_t transport;       ///< CAPTURE_UDP或CAPTURE_TCP
+    uint32_t reserved;
+} CaptureFrame;
+
+/**
+ * @struct CaptureFile
+ * @brief 写入端
+ */
+typedef struct {
+    uint8_t* base;           ///< 文件映射
+    size_t size;
+    CaptureSegment* segments;
+    uint8_t* data;           ///< 第一段数据区
+    uint32_t segmentCount;
+    uint64_t segmentSize;
+} CaptureFile;
+
+/**
+ * @struct CaptureView
+ * @brief 只读端
+ */
+typedef struct {
+    const uint8_t* base;
+    size_t size;
+    const CaptureFileHeader* header;
+    const CaptureSegment* segments;
+    const uint8_t* data;
+} CaptureView;
+
+/**
+ * @struct CaptureCursor
+ * @brief 按从旧到新的顺序遍历一段中的帧
+ */
+typedef struct {
+    const uint8_t* data;     ///< 段数据区
+    uint64_t size;           ///< 段数据区字节数
+    uint64_t pos;
+    uint64_t end;            ///< 当前阶段的结束位置
+    uint64_t head;
+    int phase;               ///< 0：回绕前的旧帧，读到回绕标记后转到1；1：从开头到head
+} CaptureCursor;
+
+/**
+ * @brief 创建抓包文件（已存在时覆盖）
+ * @param path 文件路径
+ * @param bytes 文件大小，平均分给各段
+ * @param segments 段数（写入线程数）
+ * @return 写入端，失败（含每段小于CAPTURE_MIN_SEGMENT）返回NULL
+ * @details 创建时把整个文件写一遍，热路径上不再发生缺页
+ */
+CaptureFile* createCapture(const char* path, size_t bytes, int segments);
+
+/**
+ * @brief 解除映射并释放写入端，已写入的帧保留在文件中
+ */
+void destroyCapture(CaptureFile* capture);
+
+/**
+ * @brief 写入一帧，只能由该段的写入线程调用
+ * @param capture 写入端
+ * @param segment 段号
+ * @param info 帧头，由调用方填写时间、客户端、路径和传输方式，长度字段由本函数填写
+ * @param query 查询报文
+ * @param queryLength 查询长度
+ * @param response 应答报文
+ * @param responseLength 应答长度
+ */
+void captureRecord(CaptureFile* capture, int segment, const CaptureFrame* info,
+                   const char* query, size_t queryLength, const char* response, size_t responseLength);
+
+/**
+ * @brief 映射并校验抓包文件
+ * @return 成功返回1，文件不存在或格式不符返回0
+ */
+int captureOpenView(CaptureView* view, const char* path);
+
+/**
+ * @brief 解除映射
+ */
+void captureCloseView(CaptureView* view);
+
+/**
+ * @brief 定位到一段中最早的帧
+ */
+void captureCursorInit(const CaptureView* view, uint32_t segment, CaptureCursor* cursor);
+
+/**
+ * @brief 取下一帧
+ * @return 帧，遍历结束或遇到损坏的帧时返回NULL
+ */
+const CaptureFrame* captureNext(CaptureCursor* cursor);
+
+/**
+ * @brief 帧中的查询报文
+ */
+static inline const char* captureQuery(const CaptureFrame* frame) {
+    return (const char*)(frame + 1);
+}
+
+/**
+ * @brief 帧中的应答报文
+ */
+static inline const char* captureResponse(const CaptureFrame* frame) {
+    return (const char*)(frame + 1) + frame->queryLength;
+}
+
+#endif // DNS_CAPTURE_H
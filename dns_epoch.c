@@ -0,0 +1,57 @@
+#include "dns_epoch.h"
+#include "dns_platform.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define SYNC_SLEEP_MS 1
+
+// 每个读者线程一条记录，首次进入临界区时注册，之后不再释放（工作线程数固定）。
+// 每次查询都要写两次epoch，记录独占一个缓存行，避免相邻线程的记录互相使缓存行失效
+typedef struct EpochRecord {
+    _Alignas(DNS_CACHE_LINE) atomic_uint_fast64_t epoch; // 所在临界区开始时的全局纪元，0表示不在临界区
+    struct EpochRecord* next;
+} EpochRecord;
+
+static atomic_uint_fast64_t globalEpoch = 1;
+static EpochRecord* _Atomic records;
+static atomic_flag registryLock = ATOMIC_FLAG_INIT;  // 仅在注册新线程时使用
+static _Thread_local EpochRecord* localRecord;
+
+static EpochRecord* currentRecord(void) {
+    if (localRecord) return localRecord;
+
+    EpochRecord* record = (EpochRecord*)dnsAlignedAlloc(sizeof(EpochRecord));
+    if (!record) abort();  // 无法注册就无法保证安全，不能静默继续
+
+    while (atomic_flag_test_and_set_explicit(&registryLock, memory_order_acquire)) {
+    }
+    record->next = atomic_load(&records);
+    atomic_store(&records, record);
+    atomic_flag_clear_explicit(&registryLock, memory_order_release);
+
+    localRecord = record;
+    return record;
+}
+
+void dnsEpochEnter(void) {
+    EpochRecord* record = currentRecord();
+    // 公告必须先于之后对共享指针的读取对写者可见，因此使用顺序一致的存储
+    atomic_store(&record->epoch, atomic_load(&globalEpoch));
+}
+
+void dnsEpochExit(void) {
+    atomic_store_explicit(&localRecord->epoch, 0, memory_order_release);
+}
+
+void dnsEpochSynchronize(void) {
+    // 调用前共享指针已被替换；此后公告的纪元都大于target，只可能看到新对象
+    uint64_t target = atomic_fetch_add(&globalEpoch, 1);
+
+    for (EpochRecord* record = atomic_load(&records); record; record = record->next) {
+        for (;;) {
+            uint64_t epoch = atomic_load(&record->epoch);
+            if (epoch == 0 || epoch > target) break;
+            dnsSleepMs(SYNC_SLEEP_MS);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+/**
+ * @file dns_epoch.h
+ * @brief 基于纪元的内存回收（EBR）
+ * @details 读者在访问共享的不可变对象前后调用dnsEpochEnter/dnsEpochExit，不加锁也不等待；
+ *          写者用原子指针替换对象后调用dnsEpochSynchronize，等到所有可能看到旧对象的
+ *          读者都离开临界区再释放旧对象。适合读多写少、写者可以阻塞的场景（如规则重新加载）
+ */
+
+#ifndef DNS_EPOCH_H
+#define DNS_EPOCH_H
+
+/**
+ * @brief 进入读临界区
+ * @details 不可嵌套；临界区内读到的共享对象在dnsEpochExit之前保持有效
+ */
+void dnsEpochEnter(void);
+
+/**
+ * @brief 离开读临界区
+ */
+void dnsEpochExit(void);
+
+/**
+ * @brief 等待当前所有读临界区结束
+ * @details 写者在替换共享指针之后调用，返回后旧对象不再被任何读者引用。
+ *          之后开始的读临界区只会看到新对象，不会被等待
+ */
+void dnsEpochSynchronize(void);
+
+#endif // DNS_EPOCH_H
@@ -0,0 +1,274 @@
+// select后端需要在包含winsock2.h之前放大FD_SETSIZE（Windows默认只有64）
+#ifndef FD_SETSIZE
+#define FD_SETSIZE 1024
+#endif
+
+#include "dns_event.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DNS_HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#define MAX_EVENTS_PER_WAIT 64
+
+// 一个已注册的套接字
+typedef struct Registration {
+    SOCKET sock;
+    int events;
+    int removed;                // 已注销，等待本轮结束后释放
+    EventHandler handler;
+    void* ctx;
+    struct Registration* nextDead;
+} Registration;
+
+struct EventLoop {
+#ifdef DNS_HAVE_EPOLL
+    int epfd;
+    Registration** byFd;        // 以文件描述符为下标的注册表
+    size_t byFdCapacity;
+#else
+    Registration* regs[FD_SETSIZE];
+    int regCount;
+#endif
+    Registration* dead;         // 延迟释放的注册项
+};
+
+static void freeDead(EventLoop* loop) {
+    while (loop->dead) {
+        Registration* next = loop->dead->nextDead;
+        free(loop->dead);
+        loop->dead = next;
+    }
+}
+
+#ifdef DNS_HAVE_EPOLL
+
+static uint32_t toEpollEvents(int events) {
+    uint32_t result = 0;
+    if (events & EVENT_READ) result |= EPOLLIN;
+    if (events & EVENT_WRITE) result |= EPOLLOUT;
+    return result;
+}
+
+EventLoop* eventLoopCreate(void) {
+    EventLoop* loop = (EventLoop*)calloc(1, sizeof(EventLoop));
+    if (!loop) return NULL;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void eventLoopDestroy(EventLoop* loop) {
+    if (!loop) return;
+    for (size_t i = 0; i < loop->byFdCapacity; i++) {
+        free(loop->byFd[i]);
+    }
+    free(loop->byFd);
+    freeDead(loop);
+    close(loop->epfd);
+    free(loop);
+}
+
+int eventLoopAdd(EventLoop* loop, SOCKET sock, int events,
+                 EventHandler handler, void* ctx) {
+    if (sock < 0) return 0;
+    if ((size_t)sock >= loop->byFdCapacity) {
+        size_t newCapacity = loop->byFdCapacity ? loop->byFdCapacity : 64;
+        while (newCapacity <= (size_t)sock) newCapacity *= 2;
+        Registration** newTable = (Registration**)realloc(loop->byFd,
+                                        newCapacity * sizeof(Registration*));
+        if (!newTable) return 0;
+        memset(newTable + loop->byFdCapacity, 0,
+               (newCapacity - loop->byFdCapacity) * sizeof(Registration*));
+        loop->byFd = newTable;
+        loop->byFdCapacity = newCapacity;
+    }
+    if (loop->byFd[sock]) return 0;
+
+    Registration* reg = (Registration*)calloc(1, sizeof(Registration));
+    if (!reg) return 0;
+    reg->sock = sock;
+    reg->events = events;
+    reg->handler = handler;
+    reg->ctx = ctx;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.ptr = reg;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sock, &ev) != 0) {
+        free(reg);
+        return 0;
+    }
+    loop->byFd[sock] = reg;
+    return 1;
+}
+
+int eventLoopModify(EventLoop* loop, SOCKET sock, int events) {
+    if (sock < 0 || (size_t)sock >= loop->byFdCapacity || !loop->byFd[sock]) {
+        return 0;
+    }
+    Registration* reg = loop->byFd[sock];
+    if (reg->events == events) return 1;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.ptr = reg;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, sock, &ev) != 0) return 0;
+    reg->events = events;
+    return 1;
+}
+
+void eventLoopRemove(EventLoop* loop, SOCKET sock) {
+    if (sock < 0 || (size_t)sock >= loop->byFdCapacity || !loop->byFd[sock]) {
+        return;
+    }
+    Registration* reg = loop->byFd[sock];
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, sock, NULL);
+    loop->byFd[sock] = NULL;
+    reg->removed = 1;
+    reg->nextDead = loop->dead;
+    loop->dead = reg;
+}
+
+int eventLoopRunOnce(EventLoop* loop, int timeoutMs) {
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    int n = epoll_wait(loop->epfd, events, MAX_EVENTS_PER_WAIT, timeoutMs);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        Registration* reg = (Registration*)events[i].data.ptr;
+        if (reg->removed) continue;
+        int fired = 0;
+        // 错误和挂断交给读回调处理，由其在recv时发现
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) fired |= EVENT_READ;
+        if (events[i].events & EPOLLOUT) fired |= EVENT_WRITE;
+        reg->handler(reg->ctx, reg->sock, fired);
+    }
+
+    freeDead(loop);
+    return n;
+}
+
+#else
+
+EventLoop* eventLoopCreate(void) {
+    return (EventLoop*)calloc(1, sizeof(EventLoop));
+}
+
+void eventLoopDestroy(EventLoop* loop) {
+    if (!loop) return;
+    for (int i = 0; i < loop->regCount; i++) {
+        free(loop->regs[i]);
+    }
+    freeDead(loop);
+    free(loop);
+}
+
+static int findRegistration(EventLoop* loop, SOCKET sock) {
+    for (int i = 0; i < loop->regCount; i++) {
+        if (loop->regs[i]->sock == sock) return i;
+    }
+    return -1;
+}
+
+int eventLoopAdd(EventLoop* loop, SOCKET sock, int events,
+                 EventHandler handler, void* ctx) {
+    if (loop->regCount >= FD_SETSIZE || findRegistration(loop, sock) >= 0) {
+        return 0;
+    }
+    Registration* reg = (Registration*)calloc(1, sizeof(Registration));
+    if (!reg) return 0;
+    reg->sock = sock;
+    reg->events = events;
+    reg->handler = handler;
+    reg->ctx = ctx;
+    loop->regs[loop->regCount++] = reg;
+    return 1;
+}
+
+int eventLoopModify(EventLoop* loop, SOCKET sock, int events) {
+    int i = findRegistration(loop, sock);
+    if (i < 0) return 0;
+    loop->regs[i]->events = events;
+    return 1;
+}
+
+void eventLoopRemove(EventLoop* loop, SOCKET sock) {
+    int i = findRegistration(loop, sock);
+    if (i < 0) return;
+    Registration* reg = loop->regs[i];
+    loop->regs[i] = loop->regs[--loop->regCount];
+    reg->removed = 1;
+    reg->nextDead = loop->dead;
+    loop->dead = reg;
+}
+
+int eventLoopRunOnce(EventLoop* loop, int timeoutMs) {
+    fd_set readSet, writeSet, exceptSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    FD_ZERO(&exceptSet);
+    SOCKET maxSock = 0;
+
+    if (loop->regCount == 0) {
+        // Windows的select不接受空集合
+        if (timeoutMs > 0) dnsSleepMs(timeoutMs);
+        return 0;
+    }
+
+    for (int i = 0; i < loop->regCount; i++) {
+        Registration* reg = loop->regs[i];
+        if (reg->events & EVENT_READ) FD_SET(reg->sock, &readSet);
+        if (reg->events & EVENT_WRITE) {
+            FD_SET(reg->sock, &writeSet);
+            FD_SET(reg->sock, &exceptSet);
+        }
+        if (reg->sock > maxSock) maxSock = reg->sock;
+    }
+
+    struct timeval tv;
+    struct timeval* tvp = NULL;
+    if (timeoutMs >= 0) {
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        tvp = &tv;
+    }
+
+    int n = select((int)maxSock + 1, &readSet, &writeSet, &exceptSet, tvp);
+    if (n <= 0) {
+        return n == 0 ? 0 : -1;
+    }
+
+    // 回调中可能增删注册项，先拷贝一份快照
+    Registration* snapshot[FD_SETSIZE];
+    int count = loop->regCount;
+    memcpy(snapshot, loop->regs, (size_t)count * sizeof(Registration*));
+
+    int dispatched = 0;
+    for (int i = 0; i < count; i++) {
+        Registration* reg = snapshot[i];
+        if (reg->removed) continue;
+        int fired = 0;
+        if (FD_ISSET(reg->sock, &readSet)) fired |= EVENT_READ;
+        // Windows在exceptfds中报告非阻塞connect失败，按可写事件分发，由回调检查SO_ERROR时发现
+        if (FD_ISSET(reg->sock, &writeSet) || FD_ISSET(reg->sock, &exceptSet)) fired |= EVENT_WRITE;
+        if (fired) {
+            reg->handler(reg->ctx, reg->sock, fired);
+            dispatched++;
+        }
+    }
+
+    freeDead(loop);
+    return dispatched;
+}
+
+#endif
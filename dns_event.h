@@ -0,0 +1,68 @@
+/**
+ * @file dns_event.h
+ * @brief 事件循环的头文件定义
+ * @details 每个工作线程拥有一个事件循环。Linux下基于epoll，其他平台退化为select
+ */
+
+#ifndef DNS_EVENT_H
+#define DNS_EVENT_H
+
+#include "dns_platform.h"
+
+#define EVENT_READ  0x1  ///< 可读事件
+#define EVENT_WRITE 0x2  ///< 可写事件
+
+/**
+ * @brief 事件回调
+ * @param ctx 注册时传入的上下文
+ * @param sock 触发事件的套接字
+ * @param events 触发的事件（EVENT_READ/EVENT_WRITE的组合）
+ */
+typedef void (*EventHandler)(void* ctx, SOCKET sock, int events);
+
+typedef struct EventLoop EventLoop;
+
+/**
+ * @brief 创建事件循环
+ * @return 事件循环，失败返回NULL
+ */
+EventLoop* eventLoopCreate(void);
+
+/**
+ * @brief 销毁事件循环（不关闭已注册的套接字）
+ */
+void eventLoopDestroy(EventLoop* loop);
+
+/**
+ * @brief 注册套接字
+ * @param loop 事件循环
+ * @param sock 套接字（需已设置为非阻塞）
+ * @param events 关注的事件
+ * @param handler 事件回调
+ * @param ctx 回调上下文
+ * @return 成功返回1，失败返回0
+ */
+int eventLoopAdd(EventLoop* loop, SOCKET sock, int events,
+                 EventHandler handler, void* ctx);
+
+/**
+ * @brief 修改套接字关注的事件
+ * @return 成功返回1，失败返回0
+ */
+int eventLoopModify(EventLoop* loop, SOCKET sock, int events);
+
+/**
+ * @brief 注销套接字
+ * @details 可以在事件回调中调用，本轮尚未分发的事件会被丢弃
+ */
+void eventLoopRemove(EventLoop* loop, SOCKET sock);
+
+/**
+ * @brief 等待并分发一轮事件
+ * @param loop 事件循环
+ * @param timeoutMs 最长等待时间（毫秒），-1表示无限等待
+ * @return 分发的事件数，出错返回-1
+ */
+int eventLoopRunOnce(EventLoop* loop, int timeoutMs);
+
+#endif // DNS_EVENT_H
@@ -0,0 +1,1045 @@
+#include "dns_forwarder.h"
+#include "dns_arena.h"
+#include "dns_log.h"
+#include "dns_metrics.h"
+#include "dns_message.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ENTRY 0xFFFFFFFFu
+#define POLL_INTERVAL_MS 50
+#define KEY_SIZE 261                 // 线格式域名最长255字节 + QTYPE + QCLASS + 标志字节
+#define WAITER_PACKET_SIZE 284       // 报文头 + 最长的问题部分 + OPT
+#define STREAM_BUFFER_SIZE (2 + FORWARD_MAX_RESPONSE_SIZE) // TCP接收缓冲：长度前缀 + 最长报文
+#define SEND_BATCH 64                // 一轮事件处理中最多攒下的新查询，攒满时立即发出
+
+// 定时链表：超时和对冲延迟各自固定，按加入顺序即按到期时刻有序
+enum { LIST_TIMEOUT = 0, LIST_HEDGE = 1, LIST_COUNT };
+
+typedef struct {
+    uint32_t prev;
+    uint32_t next;               // 超时链表的next也用作空闲链表
+} TimerLink;
+
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+} TimerList;
+
+// 上游状态，只由所属工作线程读写
+typedef struct {
+    uint32_t srttUs;             // 平滑RTT（微秒），0表示尚无样本
+    int failures;                // 连续超时次数
+    uint64_t downUntilNs;        // 剔除期截止时刻，0表示未剔除
+    uint32_t backoffMs;          // 下一次剔除的时长
+} UpstreamState;
+
+// 发布给统计线程的上游状态：所属线程每次改动后用relaxed原子写入，getUpstreamStatus读取
+typedef struct {
+    atomic_uint srttUs;
+    atomic_int failures;
+    atomic_uint_fast64_t downUntilNs;
+    atomic_uint_fast64_t queries;
+    atomic_uint_fast64_t answers;
+    atomic_uint_fast64_t timeouts;
+} UpstreamSnapshot;
+
+typedef struct {
+    struct sockaddr_in addr;     // 创建后不再改变
+    UpstreamState state;
+    UpstreamSnapshot published;
+} Upstream;
+
+// 到一个上游的TCP连接
+typedef struct {
+    Forwarder* owner;
+    int upstream;                // 上游下标
+    SOCKET sock;                 // INVALID_SOCKET表示未连接
+    int connected;               // 非阻塞connect是否已完成
+    uint64_t lastUsedNs;         // 最近一次收发的时刻
+    char* rx;                    // 接收缓冲（首次连接时分配）
+    size_t rxLength;
+    char* tx;                    // 待发送的查询（已带长度前缀）
+    size_t txOffset;
+    size_t txLength;
+    size_t txCapacity;
+} UpstreamStream;
+
+// 一个在途查询
+typedef struct {
+    int active;                  // 是否在用
+    uint16_t upstreamId;         // 发往上游的事务ID
+    int sockIndex;               // 最近一次发送使用的上游套接字
+    int attempts;                // 已发送次数
+    uint64_t deadlineNs;         // 本次尝试的超时时刻
+    uint64_t hedgeNs;            // 对冲时刻
+    int hedgePending;            // 是否在对冲链表中
+    int stream;                  // 上游UDP应答被截断，已改用TCP查询
+    TimerLink links[LIST_COUNT];
+    uint32_t sentMask;           // 发送过的上游，只接受这些上游的应答
+    uint32_t attemptMask;        // 本次尝试发往的上游
+    uint64_t sentNs[FORWARD_MAX_UPSTREAMS]; // 最近一次发往各上游的时刻
+    ForwardClient client;        // 发起查询的客户端
+    uint16_t length;             // 查询长度
+    char packet[FORWARD_MAX_QUERY_SIZE]; // 查询报文（事务ID为上游ID）
+    uint32_t keyHash;            // 问题键哈希，0表示不参与合并
+    uint32_t keyNext;            // 同一哈希桶中的下一个在途查询
+    uint32_t waiters;            // 合并到本查询、等待同一应答的查询链表
+    uint16_t keyLength;
+    uint8_t key[KEY_SIZE];       // 问题键
+} PendingQuery;
+
+// 已提交、尚未发往上游的新查询
+typedef struct {
+    uint32_t index;              // 在途表项
+    uint16_t upstreamId;         // 表项的事务ID，发送时核对表项未被完成后重用
+    int upstream;                // 发往的上游
+} QueuedSend;
+
+// 合并到在途查询上的相同查询，只保存报文头、问题部分和规整后的OPT（查询带EDNS时）
+typedef struct {
+    ForwardClient client;
+    uint32_t next;
+    uint16_t length;
+    uint16_t questionEnd;        // 问题部分结束的位置
+    char packet[WAITER_PACKET_SIZE];
+} CoalescedQuery;
+
+struct Forwarder {
+    EventLoop* loop;             // 所属工作线程的事件循环
+    ForwarderConfig config;
+    ForwardCallback callback;
+    ForwardFlush flush;
+    void* userData;
+    int delivered;               // 本轮是否发生过结果回调
+
+    SOCKET* sockets;             // 上游套接字池
+    uint32_t nextSocket;         // 轮转选择套接字，每发出一批新查询换一个
+    QueuedSend* sendQueue;       // 本轮新提交的查询，在本轮结束时一起发出
+    int sendCount;
+#ifdef DNS_HAVE_MMSG
+    struct mmsghdr* sendMsgs;    // 批量发送新查询使用的消息数组
+    struct iovec* sendIovs;
+#endif
+
+    Upstream upstreams[FORWARD_MAX_UPSTREAMS];
+    int upstreamCount;
+    PendingQuery* entries;       // 在途查询表
+    uint32_t* idMap;             // 上游事务ID -> 表项下标
+    uint32_t freeHead;           // 空闲表项链表
+    TimerList lists[LIST_COUNT]; // 超时链表和对冲链表
+    uint32_t rng;                // 事务ID随机数状态
+    uint32_t* keyBuckets;        // 问题键哈希 -> 在途查询链表，用于合并相同查询
+    uint32_t keyMask;
+    CoalescedQuery* waiters;     // 合并查询池
+    uint32_t waiterFree;         // 空闲的合并查询链表
+
+    UpstreamStream streams[FORWARD_MAX_UPSTREAMS]; // 每个上游一条复用的TCP连接
+    char* responseBuffer;        // 接收UDP应答的缓冲区
+    char* replyBuffer;           // 为合并查询改写应答的缓冲区
+
+    Arena arena;                 // 以上各表和缓冲区的内存，随转发器一起释放
+};
+
+void initForwarderConfig(ForwarderConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->socketCount = FORWARD_DEFAULT_SOCKETS;
+    config->timeoutMs = FORWARD_DEFAULT_TIMEOUT;
+    config->maxRetries = FORWARD_DEFAULT_RETRIES;
+    config->maxInflight = FORWARD_DEFAULT_INFLIGHT;
+    config->hedgeMs = FORWARD_DEFAULT_HEDGE;
+}
+
+int addForwarderUpstream(ForwarderConfig* config, const struct sockaddr_in* addr) {
+    if (config->upstreamCount >= FORWARD_MAX_UPSTREAMS) return 0;
+    config->upstreams[config->upstreamCount++] = *addr;
+    return 1;
+}
+
+static uint16_t randomId(Forwarder* forwarder) {
+    uint32_t x = forwarder->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    forwarder->rng = x;
+    return (uint16_t)(x >> 8);
+}
+
+static void unlinkTimer(Forwarder* forwarder, int list, uint32_t index) {
+    TimerList* timers = &forwarder->lists[list];
+    TimerLink* link = &forwarder->entries[index].links[list];
+    if (link->prev != NO_ENTRY) forwarder->entries[link->prev].links[list].next = link->next;
+    else timers->head = link->next;
+    if (link->next != NO_ENTRY) forwarder->entries[link->next].links[list].prev = link->prev;
+    else timers->tail = link->prev;
+}
+
+static void appendTimer(Forwarder* forwarder, int list, uint32_t index) {
+    TimerList* timers = &forwarder->lists[list];
+    TimerLink* link = &forwarder->entries[index].links[list];
+    link->next = NO_ENTRY;
+    link->prev = timers->tail;
+    if (timers->tail != NO_ENTRY) forwarder->entries[timers->tail].links[list].next = index;
+    else timers->head = index;
+    timers->tail = index;
+}
+
+// 开始一次尝试：设置超时，允许对冲时同时加入对冲链表。
+// 改用TCP的查询不再对冲，对冲的UDP查询多半也会被截断
+static void scheduleAttempt(Forwarder* forwarder, uint32_t index, uint64_t now) {
+    PendingQuery* entry = &forwarder->entries[index];
+    entry->deadlineNs = now + (uint64_t)forwarder->config.timeoutMs * 1000000ULL;
+    appendTimer(forwarder, LIST_TIMEOUT, index);
+    if (forwarder->config.hedgeMs > 0 && forwarder->upstreamCount > 1 && !entry->stream) {
+        entry->hedgeNs = now + (uint64_t)forwarder->config.hedgeMs * 1000000ULL;
+        entry->hedgePending = 1;
+        appendTimer(forwarder, LIST_HEDGE, index);
+    }
+}
+
+static void cancelHedge(Forwarder* forwarder, uint32_t index) {
+    PendingQuery* entry = &forwarder->entries[index];
+    if (entry->hedgePending) {
+        unlinkTimer(forwarder, LIST_HEDGE, index);
+        entry->hedgePending = 0;
+    }
+}
+
+// 上游得分，越小越好：平滑RTT按连续失败次数放大；尚无样本的上游得分为0，优先试探
+static uint64_t upstreamScore(const UpstreamState* upstream) {
+    return (uint64_t)upstream->srttUs * (uint64_t)(1 + upstream->failures);
+}
+
+// 单写者累加，不需要带锁前缀的读-改-写指令
+static void bump(atomic_uint_fast64_t* value) {
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// 把上游的RTT、失败次数和剔除期发布给统计线程
+static void publishState(Upstream* upstream) {
+    atomic_store_explicit(&upstream->published.srttUs, upstream->state.srttUs, memory_order_relaxed);
+    atomic_store_explicit(&upstream->published.failures, upstream->state.failures, memory_order_relaxed);
+    atomic_store_explicit(&upstream->published.downUntilNs, upstream->state.downUntilNs, memory_order_relaxed);
+}
+
+// 选择得分最好、未被排除且不在剔除期的上游。
+// 剔除期已到的上游直接选中作为试探；全部被剔除时选最早到期的，全部被排除时返回-1
+static int selectUpstream(Forwarder* forwarder, uint32_t excludeMask, uint64_t now) {
+    int best = -1;
+    int fallback = -1;
+    for (int i = 0; i < forwarder->upstreamCount; i++) {
+        if (excludeMask & (1u << i)) continue;
+        UpstreamState* upstream = &forwarder->upstreams[i].state;
+        if (upstream->downUntilNs != 0) {
+            if (upstream->downUntilNs <= now) {
+                upstream->downUntilNs = 0;
+                publishState(&forwarder->upstreams[i]);
+                dnsLog(DNS_LOG_INFO, "上游%d剔除期结束，开始试探", i);
+                return i;
+            }
+            if (fallback < 0 || upstream->downUntilNs < forwarder->upstreams[fallback].state.downUntilNs) {
+                fallback = i;
+            }
+            continue;
+        }
+        if (best < 0 || upstreamScore(upstream) < upstreamScore(&forwarder->upstreams[best].state)) {
+            best = i;
+        }
+    }
+    return best >= 0 ? best : fallback;
+}
+
+// 记录一次发往上游
+static void markSent(Forwarder* forwarder, PendingQuery* entry, int upstream, uint64_t now) {
+    entry->sentMask |= 1u << upstream;
+    entry->attemptMask |= 1u << upstream;
+    entry->sentNs[upstream] = now;
+    bump(&forwarder->upstreams[upstream].published.queries);
+}
+
+// 按新的RTT样本更新平滑RTT（权重1/8）
+static void updateSrtt(UpstreamState* upstream, uint64_t sampleUs) {
+    if (sampleUs > 0xFFFFFFFFu) sampleUs = 0xFFFFFFFFu;
+    if (upstream->srttUs == 0) {
+        upstream->srttUs = (uint32_t)sampleUs;
+    } else {
+        int64_t delta = (int64_t)sampleUs - (int64_t)upstream->srttUs;
+        upstream->srttUs = (uint32_t)((int64_t)upstream->srttUs + delta / 8);
+    }
+}
+
+// 上游未能应答：计入失败，连续失败过多的上游按指数退避剔除
+static void recordFailure(Forwarder* forwarder, int index, uint64_t now) {
+    UpstreamState* upstream = &forwarder->upstreams[index].state;
+    bump(&forwarder->upstreams[index].published.timeouts);
+    upstream->failures++;
+    updateSrtt(upstream, (uint64_t)forwarder->config.timeoutMs * 1000);
+    if (upstream->failures >= FORWARD_EVICT_FAILURES && upstream->downUntilNs == 0) {
+        upstream->downUntilNs = now + (uint64_t)upstream->backoffMs * 1000000ULL;
+        dnsLog(DNS_LOG_WARN, "上游%d连续超时%d次，剔除%u毫秒", index, upstream->failures,
+               (unsigned)upstream->backoffMs);
+        upstream->backoffMs = upstream->backoffMs * 2 > FORWARD_MAX_BACKOFF
+                            ? FORWARD_MAX_BACKOFF : upstream->backoffMs * 2;
+        metricsIncrement(METRIC_UPSTREAM_EVICTIONS);
+    }
+    publishState(&forwarder->upstreams[index]);
+}
+
+// 上游应答：更新RTT并清除失败记录；同一查询发往的其他上游尚未应答，
+// 至少慢了这么久，按下界更新它们的RTT，使慢的上游逐渐失去首选地位
+static void recordAnswer(Forwarder* forwarder, const PendingQuery* entry, int upstream, uint64_t now) {
+    UpstreamState* winner = &forwarder->upstreams[upstream].state;
+    uint64_t rttUs = (now - entry->sentNs[upstream]) / 1000;
+    if (winner->failures >= FORWARD_EVICT_FAILURES) winner->srttUs = 0;  // 恢复后重新估计
+    updateSrtt(winner, rttUs);
+    winner->failures = 0;
+    winner->backoffMs = FORWARD_MIN_BACKOFF;
+    bump(&forwarder->upstreams[upstream].published.answers);
+    publishState(&forwarder->upstreams[upstream]);
+
+    for (int i = 0; i < forwarder->upstreamCount; i++) {
+        if (i == upstream || !(entry->attemptMask & (1u << i))) continue;
+        UpstreamState* loser = &forwarder->upstreams[i].state;
+        if (loser->failures >= FORWARD_EVICT_FAILURES) {
+            // 正在试探的上游连对冲延迟都没赶上，试探失败
+            recordFailure(forwarder, i, now);
+            continue;
+        }
+        uint64_t waitedUs = (now - entry->sentNs[i]) / 1000;
+        if (waitedUs > loser->srttUs) {
+            updateSrtt(loser, waitedUs);
+            publishState(&forwarder->upstreams[i]);
+        }
+    }
+}
+
+// 本次尝试发往的上游全部超时
+static void recordTimeout(Forwarder* forwarder, const PendingQuery* entry, uint64_t now) {
+    for (int i = 0; i < forwarder->upstreamCount; i++) {
+        if (entry->attemptMask & (1u << i)) recordFailure(forwarder, i, now);
+    }
+}
+
+// 问题键：小写的线格式问题 + 影响应答内容的标志（RD、CD、是否带EDNS及DO位），与缓存键相同
+static size_t buildKey(const char* query, size_t length, uint8_t* key, uint32_t* hash) {
+    size_t keyLength = extractQuestionKey(query, length, key, KEY_SIZE, NULL);
+    if (keyLength == 0) return 0;
+
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < keyLength; i++) {
+        h = (h ^ key[i]) * 16777619u;
+    }
+    *hash = h ? h : 1;
+    return keyLength;
+}
+
+// 查找问题键相同的在途查询
+static uint32_t findLeader(Forwarder* forwarder, const uint8_t* key, size_t keyLength, uint32_t hash) {
+    uint32_t index = forwarder->keyBuckets[hash & forwarder->keyMask];
+    while (index != NO_ENTRY) {
+        const PendingQuery* entry = &forwarder->entries[index];
+        if (entry->keyHash == hash && entry->keyLength == keyLength &&
+            memcmp(entry->key, key, keyLength) == 0) {
+            return index;
+        }
+        index = entry->keyNext;
+    }
+    return NO_ENTRY;
+}
+
+static void unlinkKey(Forwarder* forwarder, uint32_t index) {
+    PendingQuery* entry = &forwarder->entries[index];
+    if (entry->keyHash == 0) return;
+    uint32_t* link = &forwarder->keyBuckets[entry->keyHash & forwarder->keyMask];
+    while (*link != NO_ENTRY && *link != index) {
+        link = &forwarder->entries[*link].keyNext;
+    }
+    if (*link == index) *link = entry->keyNext;
+    entry->keyHash = 0;
+}
+
+// 释放表项，返回摘下的合并查询链表
+static uint32_t releaseEntry(Forwarder* forwarder, uint32_t index) {
+    PendingQuery* entry = &forwarder->entries[index];
+    uint32_t waiters = entry->waiters;
+    unlinkTimer(forwarder, LIST_TIMEOUT, index);
+    cancelHedge(forwarder, index);
+    unlinkKey(forwarder, index);
+    forwarder->idMap[entry->upstreamId] = NO_ENTRY;
+    entry->active = 0;
+    entry->waiters = NO_ENTRY;
+    entry->links[LIST_TIMEOUT].next = forwarder->freeHead;
+    forwarder->freeHead = index;
+    return waiters;
+}
+
+static void onUpstreamReadable(void* ctx, SOCKET sock, int events);
+static void onStreamEvent(void* ctx, SOCKET sock, int events);
+
+Forwarder* createForwarder(EventLoop* loop, const ForwarderConfig* config, ForwardCallback callback,
+                           ForwardFlush flush, void* userData) {
+    Forwarder* forwarder = (Forwarder*)calloc(1, sizeof(Forwarder));
+    if (!forwarder) return NULL;
+
+    forwarder->loop = loop;
+    forwarder->config = *config;
+    if (forwarder->config.socketCount <= 0) forwarder->config.socketCount = FORWARD_DEFAULT_SOCKETS;
+    if (forwarder->config.timeoutMs <= 0) forwarder->config.timeoutMs = FORWARD_DEFAULT_TIMEOUT;
+    if (forwarder->config.maxRetries < 0) forwarder->config.maxRetries = 0;
+    // 在途数不能超过16位事务ID空间的一半，保证随机选ID时冲突很少
+    if (forwarder->config.maxInflight <= 0 || forwarder->config.maxInflight > 32768) {
+        forwarder->config.maxInflight = FORWARD_DEFAULT_INFLIGHT;
+    }
+    if (forwarder->config.hedgeMs < 0 || forwarder->config.hedgeMs >= forwarder->config.timeoutMs) {
+        forwarder->config.hedgeMs = 0;
+    }
+    forwarder->callback = callback;
+    forwarder->flush = flush;
+    forwarder->userData = userData;
+
+    if (forwarder->config.upstreamCount <= 0) {
+        forwarder->config.upstreamCount = 1;
+        forwarder->config.upstreams[0].sin_family = AF_INET;
+        forwarder->config.upstreams[0].sin_port = htons(53);
+        forwarder->config.upstreams[0].sin_addr.s_addr = inet_addr("8.8.8.8");
+    }
+    forwarder->upstreamCount = forwarder->config.upstreamCount;
+    for (int i = 0; i < forwarder->upstreamCount; i++) {
+        forwarder->upstreams[i].addr = forwarder->config.upstreams[i];
+        forwarder->upstreams[i].state.backoffMs = FORWARD_MIN_BACKOFF;
+    }
+
+    size_t inflight = (size_t)forwarder->config.maxInflight;
+    Arena* arena = &forwarder->arena;
+    arenaInit(arena, 0);
+    forwarder->entries = (PendingQuery*)arenaCalloc(arena, inflight, sizeof(PendingQuery));
+    forwarder->idMap = (uint32_t*)arenaAlloc(arena, 65536 * sizeof(uint32_t));
+    forwarder->sockets = (SOCKET*)arenaAlloc(arena, (size_t)forwarder->config.socketCount * sizeof(SOCKET));
+    forwarder->keyMask = 1;
+    while (forwarder->keyMask + 1 < inflight) forwarder->keyMask = forwarder->keyMask * 2 + 1;
+    forwarder->keyBuckets = (uint32_t*)arenaAlloc(arena, ((size_t)forwarder->keyMask + 1) * sizeof(uint32_t));
+    forwarder->waiters = (CoalescedQuery*)arenaAlloc(arena, inflight * sizeof(CoalescedQuery));
+    forwarder->responseBuffer = (char*)arenaAlloc(arena, FORWARD_MAX_RESPONSE_SIZE);
+    forwarder->replyBuffer = (char*)arenaAlloc(arena, FORWARD_MAX_RESPONSE_SIZE);
+    forwarder->sendQueue = (QueuedSend*)arenaAlloc(arena, SEND_BATCH * sizeof(QueuedSend));
+#ifdef DNS_HAVE_MMSG
+    forwarder->sendMsgs = (struct mmsghdr*)arenaCalloc(arena, SEND_BATCH, sizeof(struct mmsghdr));
+    forwarder->sendIovs = (struct iovec*)arenaCalloc(arena, SEND_BATCH, sizeof(struct iovec));
+    if (!forwarder->sendMsgs || !forwarder->sendIovs) {
+        arenaDestroy(arena);
+        free(forwarder);
+        return NULL;
+    }
+    for (int i = 0; i < SEND_BATCH; i++) {
+        forwarder->sendMsgs[i].msg_hdr.msg_iov = &forwarder->sendIovs[i];
+        forwarder->sendMsgs[i].msg_hdr.msg_iovlen = 1;
+        forwarder->sendMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+#endif
+    if (!forwarder->entries || !forwarder->idMap || !forwarder->sockets ||
+        !forwarder->keyBuckets || !forwarder->waiters || !forwarder->sendQueue ||
+        !forwarder->responseBuffer || !forwarder->replyBuffer) {
+        arenaDestroy(arena);
+        free(forwarder);
+        return NULL;
+    }
+    for (int i = 0; i < FORWARD_MAX_UPSTREAMS; i++) {
+        forwarder->streams[i].owner = forwarder;
+        forwarder->streams[i].upstream = i;
+        forwarder->streams[i].sock = INVALID_SOCKET;
+    }
+
+    for (size_t i = 0; i < 65536; i++) forwarder->idMap[i] = NO_ENTRY;
+    for (size_t i = 0; i < inflight; i++) {
+        forwarder->entries[i].links[LIST_TIMEOUT].next = (i + 1 < inflight) ? (uint32_t)(i + 1) : NO_ENTRY;
+        forwarder->entries[i].waiters = NO_ENTRY;
+        forwarder->waiters[i].next = (i + 1 < inflight) ? (uint32_t)(i + 1) : NO_ENTRY;
+    }
+    for (size_t i = 0; i <= forwarder->keyMask; i++) forwarder->keyBuckets[i] = NO_ENTRY;
+    forwarder->waiterFree = 0;
+    forwarder->freeHead = 0;
+    for (int list = 0; list < LIST_COUNT; list++) {
+        forwarder->lists[list].head = NO_ENTRY;
+        forwarder->lists[list].tail = NO_ENTRY;
+    }
+    // 各工作线程的转发器几乎同时创建，混入对象地址使事务ID序列互不相同
+    forwarder->rng = ((uint32_t)dnsNowNs() ^ (uint32_t)((uintptr_t)forwarder >> 4)) | 1;
+
+
+    for (int i = 0; i < forwarder->config.socketCount; i++) {
+        forwarder->sockets[i] = INVALID_SOCKET;
+    }
+    for (int i = 0; i < forwarder->config.socketCount; i++) {
+        SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET || !dnsSetNonBlocking(sock) ||
+            !eventLoopAdd(loop, sock, EVENT_READ, onUpstreamReadable, forwarder)) {
+            dnsLog(DNS_LOG_ERROR, "上游套接字创建失败: %d", dnsSocketError());
+            if (sock != INVALID_SOCKET) closesocket(sock);
+            destroyForwarder(forwarder);
+            return NULL;
+        }
+        forwarder->sockets[i] = sock;
+    }
+    return forwarder;
+}
+
+void destroyForwarder(Forwarder* forwarder) {
+    if (!forwarder) return;
+
+    for (int i = 0; i < forwarder->config.socketCount; i++) {
+        if (forwarder->sockets[i] != INVALID_SOCKET) {
+            eventLoopRemove(forwarder->loop, forwarder->sockets[i]);
+            closesocket(forwarder->sockets[i]);
+        }
+    }
+    for (int i = 0; i < FORWARD_MAX_UPSTREAMS; i++) {
+        UpstreamStream* stream = &forwarder->streams[i];
+        if (stream->sock != INVALID_SOCKET) {
+            eventLoopRemove(forwarder->loop, stream->sock);
+            closesocket(stream->sock);
+        }
+        free(stream->tx);
+    }
+    arenaDestroy(&forwarder->arena);
+    free(forwarder);
+}
+
+static int sendUpstream(Forwarder* forwarder, int sockIndex, int upstream,
+                        const char* packet, size_t length) {
+    const struct sockaddr_in* addr = &forwarder->upstreams[upstream].addr;
+    int sent = sendto(forwarder->sockets[sockIndex], packet, (int)length, 0,
+                      (const struct sockaddr*)addr, sizeof(*addr));
+    return sent != SOCKET_ERROR;
+}
+
+// 发出本轮攒下的新查询，它们使用同一个套接字，Linux下一次sendmmsg发出。
+// 发送失败等同于一次超时，交给重试逻辑处理
+static void flushSends(Forwarder* forwarder) {
+    int count = forwarder->sendCount;
+    if (count == 0) return;
+    forwarder->sendCount = 0;
+    SOCKET sock = forwarder->sockets[forwarder->nextSocket++ % (uint32_t)forwarder->config.socketCount];
+
+#ifdef DNS_HAVE_MMSG
+    int messages = 0;
+    for (int i = 0; i < count; i++) {
+        const QueuedSend* queued = &forwarder->sendQueue[i];
+        PendingQuery* entry = &forwarder->entries[queued->index];
+        // 发送前被迟到的同ID应答完成的表项跳过，重用后的表项已另行排队
+        if (!entry->active || entry->upstreamId != queued->upstreamId) continue;
+        forwarder->sendIovs[messages].iov_base = entry->packet;
+        forwarder->sendIovs[messages].iov_len = entry->length;
+        forwarder->sendMsgs[messages].msg_hdr.msg_name = &forwarder->upstreams[queued->upstream].addr;
+        messages++;
+    }
+    int sent = 0;
+    while (sent < messages) {
+        int n = sendmmsg(sock, forwarder->sendMsgs + sent, (unsigned int)(messages - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            dnsLog(DNS_LOG_WARN, "上游sendmmsg失败: %d", dnsSocketError());
+            break;
+        }
+        sent += n;
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        const QueuedSend* queued = &forwarder->sendQueue[i];
+        const PendingQuery* entry = &forwarder->entries[queued->index];
+        if (!entry->active || entry->upstreamId != queued->upstreamId) continue;
+        const struct sockaddr_in* addr = &forwarder->upstreams[queued->upstream].addr;
+        if (sendto(sock, entry->packet, (int)entry->length, 0, (const struct sockaddr*)addr,
+                   sizeof(*addr)) == SOCKET_ERROR) {
+            dnsLog(DNS_LOG_WARN, "上游sendto失败: %d", dnsSocketError());
+        }
+    }
+#endif
+}
+
+int forwardQuery(Forwarder* forwarder, const char* query, size_t length,
+                 const ForwardClient* client) {
+    if (length < 12 || length > FORWARD_MAX_QUERY_SIZE) return 0;
+
+    uint8_t key[KEY_SIZE];
+    uint32_t keyHash = 0;
+    size_t keyLength = buildKey(query, length, key, &keyHash);
+
+    // 已有相同问题的查询在途时不再发往上游，等待同一个应答
+    if (keyLength > 0 && forwarder->waiterFree != NO_ENTRY) {
+        uint32_t leader = findLeader(forwarder, key, keyLength, keyHash);
+        size_t questionEnd = 12 + keyLength - 1;
+        if (leader != NO_ENTRY && questionEnd + 11 <= WAITER_PACKET_SIZE) {
+            uint32_t waiterIndex = forwarder->waiterFree;
+            CoalescedQuery* waiter = &forwarder->waiters[waiterIndex];
+            forwarder->waiterFree = waiter->next;
+            waiter->client = *client;
+            waiter->client.coalesced = 1;
+            memcpy(waiter->packet, query, questionEnd);
+            waiter->questionEnd = (uint16_t)questionEnd;
+            // 失败时据此构建的SERVFAIL也要带OPT，只保留一条不带选项的OPT
+            int hasOpt = (key[keyLength - 1] & DNS_KEY_FLAG_EDNS) != 0;
+            memset(waiter->packet + 6, 0, 6);
+            waiter->packet[11] = (char)(hasOpt ? 1 : 0);
+            if (hasOpt) {
+                DNSQuestion question;
+                EdnsInfo edns;
+                parseDNSQuery(query, length, &question);
+                parseEdns(query, length, &question, &edns);
+                char* opt = waiter->packet + questionEnd;
+                opt[0] = 0;
+                opt[1] = 0; opt[2] = DNS_TYPE_OPT;
+                opt[3] = (char)(edns.udpSize >> 8); opt[4] = (char)edns.udpSize;
+                opt[5] = 0; opt[6] = (char)edns.version;
+                opt[7] = (char)(edns.flags >> 8); opt[8] = (char)edns.flags;
+                opt[9] = 0; opt[10] = 0;
+                questionEnd += 11;
+            }
+            waiter->length = (uint16_t)questionEnd;
+            waiter->next = forwarder->entries[leader].waiters;
+            forwarder->entries[leader].waiters = waiterIndex;
+
+            metricsIncrement(METRIC_COALESCED);
+            return 1;
+        }
+    }
+
+    uint32_t index = forwarder->freeHead;
+    if (index == NO_ENTRY) {
+        dnsLog(DNS_LOG_WARN, "在途查询已满，丢弃转发");
+        return 0;
+    }
+    PendingQuery* entry = &forwarder->entries[index];
+    forwarder->freeHead = entry->links[LIST_TIMEOUT].next;
+
+    uint16_t id;
+    do {
+        id = randomId(forwarder);
+    } while (forwarder->idMap[id] != NO_ENTRY);
+    forwarder->idMap[id] = index;
+
+    uint64_t now = dnsNowNs();
+    int upstream = selectUpstream(forwarder, 0, now);
+    entry->active = 1;
+    entry->upstreamId = id;
+    entry->attempts = 1;
+    entry->stream = 0;
+    entry->sockIndex = (int)(forwarder->nextSocket % (uint32_t)forwarder->config.socketCount);
+    entry->sentMask = 0;
+    entry->attemptMask = 0;
+    markSent(forwarder, entry, upstream, now);
+    entry->client = *client;
+    entry->length = (uint16_t)length;
+    memcpy(entry->packet, query, length);
+    uint16_t netId = htons(id);
+    memcpy(entry->packet, &netId, 2);
+    scheduleAttempt(forwarder, index, now);
+    entry->waiters = NO_ENTRY;
+    entry->keyHash = keyLength > 0 ? keyHash : 0;
+    if (keyLength > 0) {
+        entry->keyLength = (uint16_t)keyLength;
+        memcpy(entry->key, key, keyLength);
+        uint32_t* bucket = &forwarder->keyBuckets[keyHash & forwarder->keyMask];
+        entry->keyNext = *bucket;
+        *bucket = index;
+    }
+
+
+    // 同一轮提交的查询攒到本轮结束时一起发出，上游每批只被唤醒一次
+    QueuedSend* queued = &forwarder->sendQueue[forwarder->sendCount++];
+    queued->index = index;
+    queued->upstreamId = id;
+    queued->upstream = upstream;
+    if (forwarder->sendCount == SEND_BATCH) flushSends(forwarder);
+    return 1;
+}
+
+// 把报文中的事务ID改回客户端ID
+static void restoreId(char* packet, uint16_t clientId) {
+    uint16_t netId = htons(clientId);
+    memcpy(packet, &netId, 2);
+}
+
+// 交付一个查询的结果
+static void deliver(Forwarder* forwarder, const ForwardClient* client, const char* query, size_t queryLength,
+                    const char* response, size_t responseLength) {
+    forwarder->callback(forwarder->userData, client, query, queryLength, response, responseLength);
+    forwarder->delivered = 1;
+}
+
+// 本轮交付过结果时调用收尾回调
+static void finishRound(Forwarder* forwarder) {
+    if (forwarder->delivered) {
+        forwarder->delivered = 0;
+        if (forwarder->flush) forwarder->flush(forwarder->userData);
+    }
+}
+
+// 把应答（失败时response为NULL）交给合并的查询，各自使用自己的事务ID和问题大小写，最后归还到池中
+static void deliverWaiters(Forwarder* forwarder, uint32_t head,
+                           const char* response, size_t responseLength) {
+    if (head == NO_ENTRY) return;
+    char* reply = forwarder->replyBuffer;
+
+    uint32_t tail = head;
+    for (uint32_t index = head; index != NO_ENTRY; index = forwarder->waiters[index].next) {
+        CoalescedQuery* waiter = &forwarder->waiters[index];
+        tail = index;
+        if (!response) {
+            deliver(forwarder, &waiter->client, waiter->packet,
+                                waiter->length, NULL, 0);
+            continue;
+        }
+        memcpy(reply, response, responseLength);
+        // 应答的问题部分与查询等长（问题键相同），按查询原样覆盖以保留大小写
+        if (responseLength >= waiter->questionEnd) {
+            memcpy(reply + 12, waiter->packet + 12, waiter->questionEnd - 12);
+        }
+        restoreId(reply, waiter->client.id);
+        deliver(forwarder, &waiter->client, waiter->packet,
+                            waiter->length, reply, responseLength);
+    }
+
+    forwarder->waiters[tail].next = forwarder->waiterFree;
+    forwarder->waiterFree = head;
+}
+
+static void closeStream(UpstreamStream* stream) {
+    if (stream->sock != INVALID_SOCKET) {
+        eventLoopRemove(stream->owner->loop, stream->sock);
+        closesocket(stream->sock);
+    }
+    stream->sock = INVALID_SOCKET;
+    stream->connected = 0;
+    stream->rxLength = 0;
+    stream->txOffset = 0;
+    stream->txLength = 0;
+}
+
+// 发出连接上尽可能多的待发查询，出错时关闭连接（在途查询由超时重试接管）
+static void flushStream(UpstreamStream* stream) {
+    while (stream->txOffset < stream->txLength) {
+        int n = send(stream->sock, stream->tx + stream->txOffset,
+                     (int)(stream->txLength - stream->txOffset), DNS_MSG_NOSIGNAL);
+        if (n == SOCKET_ERROR) {
+            if (dnsSocketError() != DNS_EWOULDBLOCK) closeStream(stream);
+            return;
+        }
+        stream->txOffset += (size_t)n;
+    }
+    stream->txOffset = 0;
+    stream->txLength = 0;
+}
+
+// 按连接状态更新关注的事件：连接建立前等待可写，之后始终等待可读，有待发数据时同时等待可写
+static void updateStreamEvents(UpstreamStream* stream) {
+    if (stream->sock == INVALID_SOCKET) return;
+    int events = !stream->connected ? EVENT_WRITE : EVENT_READ | (stream->txLength > 0 ? EVENT_WRITE : 0);
+    eventLoopModify(stream->owner->loop, stream->sock, events);
+}
+
+// 经TCP把查询发往上游，没有连接时先发起非阻塞连接
+static void sendStream(Forwarder* forwarder, int upstream, const char* packet, size_t length, uint64_t now) {
+    UpstreamStream* stream = &forwarder->streams[upstream];
+    if (stream->sock == INVALID_SOCKET) {
+        // 接收缓冲在连接断开后保留，重连时复用
+        if (!stream->rx) {
+            stream->rx = (char*)arenaAlloc(&forwarder->arena, STREAM_BUFFER_SIZE);
+            if (!stream->rx) return;
+        }
+        SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (sock == INVALID_SOCKET) return;
+        const struct sockaddr_in* addr = &forwarder->upstreams[upstream].addr;
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        if (!dnsSetNonBlocking(sock) ||
+            (connect(sock, (const struct sockaddr*)addr, sizeof(*addr)) == SOCKET_ERROR &&
+             dnsSocketError() != DNS_EINPROGRESS)) {
+            dnsLog(DNS_LOG_WARN, "连接上游%d的TCP端口失败: %d", upstream, dnsSocketError());
+            closesocket(sock);
+            return;
+        }
+        if (!eventLoopAdd(forwarder->loop, sock, EVENT_WRITE, onStreamEvent, stream)) {
+            closesocket(sock);
+            return;
+        }
+        stream->sock = sock;
+        stream->connected = 0;
+        stream->rxLength = 0;
+    }
+
+    if (stream->txLength + 2 + length > stream->txCapacity) {
+        size_t capacity = stream->txCapacity ? stream->txCapacity : 4096;
+        while (capacity < stream->txLength + 2 + length) capacity *= 2;
+        char* grown = (char*)realloc(stream->tx, capacity);
+        if (!grown) return;
+        stream->tx = grown;
+        stream->txCapacity = capacity;
+    }
+    stream->tx[stream->txLength] = (char)(length >> 8);
+    stream->tx[stream->txLength + 1] = (char)length;
+    memcpy(stream->tx + stream->txLength + 2, packet, length);
+    stream->txLength += 2 + length;
+    stream->lastUsedNs = now;
+    if (stream->connected) flushStream(stream);
+    updateStreamEvents(stream);
+}
+
+// 处理一个上游应答：完成对应的在途查询并回调；UDP应答被截断时改用TCP向该上游重新查询
+static void acceptAnswer(Forwarder* forwarder, int upstream, char* response, size_t length, int viaStream) {
+    char query[FORWARD_MAX_QUERY_SIZE];
+    uint16_t id;
+    memcpy(&id, response, 2);
+    id = ntohs(id);
+
+    uint32_t index = forwarder->idMap[id];
+    // 已完成或超时放弃的查询的迟到响应，或并未发往该上游
+    if (index == NO_ENTRY || !(forwarder->entries[index].sentMask & (1u << upstream))) return;
+    PendingQuery* entry = &forwarder->entries[index];
+    uint64_t now = dnsNowNs();
+
+    if (!viaStream && (response[2] & 0x02)) {
+        // 已在TCP上重新查询，对冲发出的UDP查询同样被截断
+        if (entry->stream) return;
+        // 截断的应答同样说明上游可用，按UDP的往返时间记录
+        recordAnswer(forwarder, entry, upstream, now);
+        entry->stream = 1;
+        entry->attemptMask = 0;
+        markSent(forwarder, entry, upstream, now);
+        unlinkTimer(forwarder, LIST_TIMEOUT, index);
+        cancelHedge(forwarder, index);
+        scheduleAttempt(forwarder, index, now);
+
+        metricsIncrement(METRIC_UPSTREAM_TCP);
+        dnsLog(DNS_LOG_DEBUG, "上游%d的应答被截断，改用TCP查询", upstream);
+        sendStream(forwarder, upstream, entry->packet, entry->length, now);
+        return;
+    }
+
+    // TCP应答的往返时间含建立连接的时间，不计入平滑RTT
+    if (!viaStream) recordAnswer(forwarder, entry, upstream, now);
+    ForwardClient client = entry->client;
+    size_t queryLength = entry->length;
+    memcpy(query, entry->packet, queryLength);
+    uint32_t waiters = releaseEntry(forwarder, index);
+
+    deliverWaiters(forwarder, waiters, response, length);
+    restoreId(query, client.id);
+    restoreId(response, client.id);
+    deliver(forwarder, &client, query, queryLength, response, length);
+}
+
+// 读取TCP连接上已到达的数据并逐条处理完整的应答，对端关闭或出错时关闭连接
+static void readStream(Forwarder* forwarder, int upstream, uint64_t now) {
+    UpstreamStream* stream = &forwarder->streams[upstream];
+    int n = recv(stream->sock, stream->rx + stream->rxLength,
+                 (int)(STREAM_BUFFER_SIZE - stream->rxLength), 0);
+    if (n == 0 || (n == SOCKET_ERROR && dnsSocketError() != DNS_EWOULDBLOCK)) {
+        dnsLog(DNS_LOG_DEBUG, "上游%d的TCP连接已关闭", upstream);
+        closeStream(stream);
+        return;
+    }
+    if (n == SOCKET_ERROR) return;
+    stream->rxLength += (size_t)n;
+    stream->lastUsedNs = now;
+
+    size_t consumed = 0;
+    while (stream->rxLength - consumed >= 2) {
+        char* frame = stream->rx + consumed;
+        size_t length = ((size_t)(uint8_t)frame[0] << 8) | (uint8_t)frame[1];
+        if (stream->rxLength - consumed < 2 + length) break;
+        consumed += 2 + length;
+        if (length >= 12) acceptAnswer(forwarder, upstream, frame + 2, length, 1);
+    }
+    if (consumed > 0) {
+        memmove(stream->rx, stream->rx + consumed, stream->rxLength - consumed);
+        stream->rxLength -= consumed;
+    }
+}
+
+// 非阻塞connect完成：出错时关闭，成功时发出排队的查询
+static void finishConnect(Forwarder* forwarder, int upstream) {
+    UpstreamStream* stream = &forwarder->streams[upstream];
+    int error = 0;
+    socklen_t errorLength = sizeof(error);
+    if (getsockopt(stream->sock, SOL_SOCKET, SO_ERROR, (char*)&error, &errorLength) != 0 || error != 0) {
+        dnsLog(DNS_LOG_WARN, "连接上游%d的TCP端口失败: %d", upstream, error);
+        closeStream(stream);
+        return;
+    }
+    stream->connected = 1;
+    flushStream(stream);
+}
+
+// 读取一个上游套接字上所有已到达的响应
+static void drainSocket(Forwarder* forwarder, SOCKET sock) {
+    char* response = forwarder->responseBuffer;
+
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        int len = recvfrom(sock, response, FORWARD_MAX_RESPONSE_SIZE, 0,
+                           (struct sockaddr*)&from, &fromLen);
+        if (len == SOCKET_ERROR) {
+#ifdef _WIN32
+            if (dnsSocketError() == WSAECONNRESET) continue;
+#endif
+            return;
+        }
+        if (len < 12) continue;
+
+        // 只接受来自上游地址的响应
+        int upstream = -1;
+        for (int i = 0; i < forwarder->upstreamCount; i++) {
+            if (from.sin_addr.s_addr == forwarder->upstreams[i].addr.sin_addr.s_addr &&
+                from.sin_port == forwarder->upstreams[i].addr.sin_port) {
+                upstream = i;
+                break;
+            }
+        }
+        if (upstream < 0) continue;
+        acceptAnswer(forwarder, upstream, response, (size_t)len, 0);
+    }
+}
+
+static void onUpstreamReadable(void* ctx, SOCKET sock, int events) {
+    Forwarder* forwarder = (Forwarder*)ctx;
+    (void)events;
+    drainSocket(forwarder, sock);
+    finishRound(forwarder);
+}
+
+// 上游TCP连接上的事件。连接完成或失败都报告为可写（epoll下失败报告为可读），由finishConnect按SO_ERROR区分
+static void onStreamEvent(void* ctx, SOCKET sock, int events) {
+    UpstreamStream* stream = (UpstreamStream*)ctx;
+    Forwarder* forwarder = stream->owner;
+    (void)sock;
+
+    if (!stream->connected) {
+        finishConnect(forwarder, stream->upstream);
+    } else {
+        if (events & EVENT_WRITE) flushStream(stream);
+        if ((events & EVENT_READ) && stream->sock != INVALID_SOCKET) {
+            readStream(forwarder, stream->upstream, dnsNowNs());
+        }
+    }
+    updateStreamEvents(stream);
+    finishRound(forwarder);
+}
+
+// 首选上游超过对冲延迟仍未应答的查询，同时发往次优的上游
+static void sendHedges(Forwarder* forwarder, uint64_t now) {
+    for (;;) {
+        uint32_t index = forwarder->lists[LIST_HEDGE].head;
+        if (index == NO_ENTRY || forwarder->entries[index].hedgeNs > now) return;
+        PendingQuery* entry = &forwarder->entries[index];
+        cancelHedge(forwarder, index);
+        int upstream = selectUpstream(forwarder, entry->attemptMask, now);
+        if (upstream < 0) continue;
+        markSent(forwarder, entry, upstream, now);
+
+        metricsIncrement(METRIC_UPSTREAM_HEDGES);
+        sendUpstream(forwarder, entry->sockIndex, upstream, entry->packet, entry->length);
+    }
+}
+
+// 处理所有已超时的查询：未用完重试次数则换上游重发，否则回调失败
+static void expireTimeouts(Forwarder* forwarder, uint64_t now) {
+    char packet[FORWARD_MAX_QUERY_SIZE];
+
+    for (;;) {
+        uint32_t index = forwarder->lists[LIST_TIMEOUT].head;
+        if (index == NO_ENTRY || forwarder->entries[index].deadlineNs > now) {
+            return;
+        }
+
+        PendingQuery* entry = &forwarder->entries[index];
+        recordTimeout(forwarder, entry, now);
+
+        if (entry->attempts <= forwarder->config.maxRetries) {
+            // 换一个套接字，优先换一个上游重发，并重新排入定时链表
+            int upstream = selectUpstream(forwarder, entry->attemptMask, now);
+            if (upstream < 0) upstream = selectUpstream(forwarder, 0, now);
+            entry->attempts++;
+            entry->sockIndex = (entry->sockIndex + 1) % forwarder->config.socketCount;
+            entry->attemptMask = 0;
+            markSent(forwarder, entry, upstream, now);
+            unlinkTimer(forwarder, LIST_TIMEOUT, index);
+            cancelHedge(forwarder, index);
+            scheduleAttempt(forwarder, index, now);
+
+            metricsIncrement(METRIC_UPSTREAM_RETRIES);
+            dnsLog(DNS_LOG_DEBUG, "上游超时，第%d次重试发往上游%d", entry->attempts - 1, upstream);
+            if (entry->stream) {
+                sendStream(forwarder, upstream, entry->packet, entry->length, now);
+            } else {
+                sendUpstream(forwarder, entry->sockIndex, upstream, entry->packet, entry->length);
+            }
+            continue;
+        }
+
+        // 表项释放后可能被交付回调中的新查询重用，先复制出查询报文
+        ForwardClient client = entry->client;
+        size_t length = entry->length;
+        memcpy(packet, entry->packet, length);
+        uint32_t waiters = releaseEntry(forwarder, index);
+
+        metricsIncrement(METRIC_UPSTREAM_TIMEOUTS);
+        dnsLog(DNS_LOG_WARN, "上游查询超时，放弃");
+        deliverWaiters(forwarder, waiters, NULL, 0);
+        restoreId(packet, client.id);
+        deliver(forwarder, &client, packet, length, NULL, 0);
+    }
+}
+
+// 距离最早的对冲或超时时刻的毫秒数，不超过轮询间隔
+static int nextWakeMs(Forwarder* forwarder, uint64_t now) {
+    uint64_t wake = now + (uint64_t)POLL_INTERVAL_MS * 1000000ULL;
+    uint32_t index = forwarder->lists[LIST_TIMEOUT].head;
+    if (index != NO_ENTRY && forwarder->entries[index].deadlineNs < wake) {
+        wake = forwarder->entries[index].deadlineNs;
+    }
+    index = forwarder->lists[LIST_HEDGE].head;
+    if (index != NO_ENTRY && forwarder->entries[index].hedgeNs < wake) {
+        wake = forwarder->entries[index].hedgeNs;
+    }
+    return wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+}
+
+// 关闭空闲过久的上游TCP连接
+static void closeIdleStreams(Forwarder* forwarder, uint64_t now) {
+    uint64_t idleNs = (uint64_t)FORWARD_TCP_IDLE_MS * 1000000ULL;
+    for (int i = 0; i < forwarder->upstreamCount; i++) {
+        UpstreamStream* stream = &forwarder->streams[i];
+        if (stream->sock != INVALID_SOCKET && stream->txLength == 0 &&
+            stream->lastUsedNs + idleNs < now) {
+            closeStream(stream);
+        }
+    }
+}
+
+int forwarderPoll(Forwarder* forwarder, uint64_t now) {
+    flushSends(forwarder);
+    sendHedges(forwarder, now);
+    expireTimeouts(forwarder, now);
+    closeIdleStreams(forwarder, now);
+    finishRound(forwarder);
+    return nextWakeMs(forwarder, now);
+}
+
+int getUpstreamStatus(Forwarder* forwarder, UpstreamStatus* status, int maxCount) {
+    uint64_t now = dnsNowNs();
+    int count = forwarder->upstreamCount < maxCount ? forwarder->upstreamCount : maxCount;
+    for (int i = 0; i < count; i++) {
+        // 各字段分别读取，彼此之间可能相差一次更新，用于导出指标足够
+        UpstreamSnapshot* published = &forwarder->upstreams[i].published;
+        status[i].addr = forwarder->upstreams[i].addr;
+        status[i].srttUs = atomic_load_explicit(&published->srttUs, memory_order_relaxed);
+        status[i].failures = atomic_load_explicit(&published->failures, memory_order_relaxed);
+        status[i].evicted = atomic_load_explicit(&published->downUntilNs, memory_order_relaxed) > now;
+        status[i].queries = atomic_load_explicit(&published->queries, memory_order_relaxed);
+        status[i].answers = atomic_load_explicit(&published->answers, memory_order_relaxed);
+        status[i].timeouts = atomic_load_explicit(&published->timeouts, memory_order_relaxed);
+    }
+    return count;
+}
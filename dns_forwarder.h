@@ -0,0 +1,164 @@
+/**
+ * @file dns_forwarder.h
+ * @brief 异步上游转发器的头文件定义
+ * @details 使用少量长期存在的上游套接字转发查询。转发时改写事务ID，
+ *          以新ID为键记录在途查询，异步匹配响应、处理超时与重试。
+ *          转发器没有自己的线程：每个工作线程拥有一个转发器，上游套接字注册在该线程的事件循环上，
+ *          超时和对冲由事件循环每轮调用forwarderPoll处理。转发出去的查询挂起在在途表的表项中
+ *          （表项预先分配成池，挂起一个查询只占一个表项，不占线程和栈），应答到达后在同一线程中回调，
+ *          接着完成写缓存和应答客户端，查询始终不离开收到它的线程。
+ *          问题（域名、类型、类别）相同的查询在途时只向上游发送一次，
+ *          后来的查询等待同一个应答，再各自换回自己的事务ID。
+ *          可配置多个上游：为每个上游维护平滑RTT和连续失败次数，查询发往得分最好的上游；
+ *          超过对冲延迟仍未应答时再发往次优上游，采用先到的应答；
+ *          连续失败的上游按指数退避暂时剔除，到期后用一次查询试探。
+ *          上游UDP应答被截断（TC位）时改用TCP向同一上游重新查询：每个上游保持一条复用的TCP连接，
+ *          多个查询在连接上流水线发送、按事务ID匹配应答，空闲一段时间后关闭
+ */
+
+#ifndef DNS_FORWARDER_H
+#define DNS_FORWARDER_H
+
+#include "dns_platform.h"
+#include "dns_event.h"
+
+#define FORWARD_DEFAULT_SOCKETS   4     ///< 默认上游套接字数
+#define FORWARD_DEFAULT_TIMEOUT   800   ///< 默认单次尝试超时（毫秒）
+#define FORWARD_DEFAULT_RETRIES   2     ///< 默认重试次数
+#define FORWARD_DEFAULT_INFLIGHT  8192  ///< 默认最大在途查询数
+#define FORWARD_MIN_INFLIGHT      256   ///< 按工作线程平分在途上限时每个转发器至少保留的表项数
+#define FORWARD_MAX_QUERY_SIZE    1024  ///< 可转发的最大查询长度
+#define FORWARD_MAX_RESPONSE_SIZE 65535 ///< 接收上游响应的缓冲区大小（TCP报文的长度上限）
+#define FORWARD_MAX_UPSTREAMS     8     ///< 最多配置的上游数
+#define FORWARD_DEFAULT_HEDGE     100   ///< 默认对冲延迟（毫秒）
+#define FORWARD_EVICT_FAILURES    3     ///< 连续超时多少次后暂时剔除上游
+#define FORWARD_MIN_BACKOFF       1000  ///< 首次剔除的时长（毫秒），之后每次加倍
+#define FORWARD_MAX_BACKOFF       60000 ///< 剔除时长上限（毫秒）
+#define FORWARD_TCP_IDLE_MS       10000 ///< 上游TCP连接空闲多久后关闭（毫秒）
+
+/**
+ * @struct ForwardClient
+ * @brief 等待应答的客户端
+ */
+typedef struct {
+    SOCKET sock;                 ///< 应答客户端使用的套接字
+    struct sockaddr_in addr;     ///< 客户端地址
+    uint16_t id;                 ///< 客户端原始事务ID（主机字节序）
+    uint64_t startNs;            ///< 收到查询的时刻（dnsNowNs），用于统计中继耗时
+    int coalesced;               ///< 由转发器设置：合并到相同的在途查询上，应答已由首个查询缓存
+    uint32_t stream;             ///< 0表示UDP客户端，否则为TCP连接句柄（由服务器解释）
+    int worker;                  ///< 收到查询的工作线程
+    uint16_t maxLength;          ///< 客户端可接收的应答长度，UDP应答超出时截断并置TC位
+    int refresh;                 ///< 非0表示缓存的后台刷新，没有等待应答的客户端
+} ForwardClient;
+
+/**
+ * @brief 转发结果回调，在拥有转发器的工作线程中调用
+ * @param userData 创建转发器时传入的用户数据
+ * @param client 发起查询的客户端
+ * @param query 原始查询报文（事务ID已恢复）
+ * @param queryLength 查询长度
+ * @param response 上游响应（事务ID已恢复为客户端ID），超时失败时为NULL
+ * @param responseLength 响应长度
+ */
+typedef void (*ForwardCallback)(void* userData, const ForwardClient* client,
+                                const char* query, size_t queryLength,
+                                const char* response, size_t responseLength);
+
+/**
+ * @brief 一轮事件处理中发生过结果回调时，在该轮结束前调用一次，用于一并提交回调中积攒的工作（如批量发送应答）
+ * @param userData 创建转发器时传入的用户数据
+ */
+typedef void (*ForwardFlush)(void* userData);
+
+/**
+ * @struct ForwarderConfig
+ * @brief 转发器配置
+ */
+typedef struct {
+    struct sockaddr_in upstreams[FORWARD_MAX_UPSTREAMS]; ///< 上游DNS服务器地址
+    int upstreamCount;            ///< 上游数，0表示使用默认的8.8.8.8:53
+    int socketCount;              ///< 上游套接字池大小
+    int timeoutMs;                ///< 单次尝试超时（毫秒）
+    int maxRetries;               ///< 超时后的重试次数
+    int maxInflight;              ///< 最大在途查询数
+    int hedgeMs;                  ///< 首选上游多久未应答后同时发往次优上游（毫秒），0表示不对冲
+} ForwarderConfig;
+
+/**
+ * @struct UpstreamStatus
+ * @brief 上游的当前状态，用于导出指标
+ */
+typedef struct {
+    struct sockaddr_in addr;      ///< 上游地址
+    uint32_t srttUs;              ///< 平滑RTT（微秒），0表示尚无样本
+    int failures;                 ///< 连续超时次数
+    int evicted;                  ///< 是否处于剔除期
+    uint64_t queries;             ///< 发往该上游的查询（含重试和对冲）
+    uint64_t answers;             ///< 采用的应答
+    uint64_t timeouts;            ///< 超时
+} UpstreamStatus;
+
+typedef struct Forwarder Forwarder;
+
+/**
+ * @brief 用默认值填充转发器配置（未添加上游时使用8.8.8.8:53）
+ */
+void initForwarderConfig(ForwarderConfig* config);
+
+/**
+ * @brief 向配置中添加一个上游
+ * @return 成功返回1，超过FORWARD_MAX_UPSTREAMS返回0
+ */
+int addForwarderUpstream(ForwarderConfig* config, const struct sockaddr_in* addr);
+
+/**
+ * @brief 创建转发器并把上游套接字注册到事件循环
+ * @param loop 所属工作线程的事件循环，转发器的所有接口（getUpstreamStatus除外）只能在该线程调用
+ * @param config 转发器配置
+ * @param callback 结果回调
+ * @param flush 每轮结束时的回调，可以为NULL
+ * @param userData 回调用户数据
+ * @return 转发器，失败返回NULL
+ */
+Forwarder* createForwarder(EventLoop* loop, const ForwarderConfig* config, ForwardCallback callback,
+                           ForwardFlush flush, void* userData);
+
+/**
+ * @brief 注销套接字并释放转发器，未完成的查询不再回调
+ */
+void destroyForwarder(Forwarder* forwarder);
+
+/**
+ * @brief 发出本轮提交的查询，处理到期的对冲和超时，关闭空闲的上游TCP连接
+ * @param forwarder 转发器
+ * @param now 当前时刻（dnsNowNs）
+ * @return 距离下一个对冲或超时时刻的毫秒数，不超过轮询间隔，供事件循环作为等待时间
+ * @details 工作线程每轮等待事件之前调用
+ */
+int forwarderPoll(Forwarder* forwarder, uint64_t now);
+
+/**
+ * @brief 提交一个查询到上游
+ * @param forwarder 转发器
+ * @param query 客户端查询报文
+ * @param length 报文长度
+ * @param client 发起查询的客户端
+ * @return 成功提交返回1，在途表已满或发送失败返回0
+ * @details 立即返回，不会在本函数内回调。同一轮事件处理中提交的查询攒到forwarderPoll时一起发出，
+ *          结果在之后的事件处理中通过回调交付
+ */
+int forwardQuery(Forwarder* forwarder, const char* query, size_t length,
+                 const ForwardClient* client);
+
+/**
+ * @brief 读取各上游的状态，可以在任意线程调用
+ * @param forwarder 转发器
+ * @param status 输出数组
+ * @param maxCount 数组容量
+ * @return 写入的上游数
+ * @details 不加锁，读取所属线程用relaxed原子发布的副本，各字段之间可能相差一次更新
+ */
+int getUpstreamStatus(Forwarder* forwarder, UpstreamStatus* status, int maxCount);
+
+#endif // DNS_FORWARDER_H
@@ -0,0 +1,183 @@
+#include "dns_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_INDEX_CAPACITY 64
+#define MIN_ARENA_CAPACITY 4096
+
+static size_t roundUpPow2(size_t n) {
+    size_t cap = MIN_INDEX_CAPACITY;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+// 分配槽位数组，只有哈希数组需要清零
+static int allocSlots(size_t capacity, uint32_t** hashes, DomainEntry** entries) {
+    *hashes = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    *entries = (DomainEntry*)malloc(capacity * sizeof(DomainEntry));
+    if (*hashes && *entries) return 1;
+    free(*hashes);
+    free(*entries);
+    return 0;
+}
+
+int domainIndexInit(DomainIndex* index, size_t expected) {
+    memset(index, 0, sizeof(*index));
+    size_t capacity = roundUpPow2(expected * 2);
+    if (!allocSlots(capacity, &index->hashes, &index->entries)) return 0;
+    index->mask = capacity - 1;
+    return 1;
+}
+
+void domainIndexFree(DomainIndex* index) {
+    free(index->hashes);
+    free(index->entries);
+    free(index->arena);
+    memset(index, 0, sizeof(*index));
+}
+
+size_t normalizeDomain(const char* src, char* dst) {
+    size_t len = 0;
+    while (src[len]) {
+        if (len >= DNS_MAX_NAME_LEN + 1) return 0;
+        char c = src[len];
+        dst[len++] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+    // 去掉末尾的点号（FQDN形式）
+    if (len > 0 && dst[len - 1] == '.') len--;
+    if (len == 0 || len > DNS_MAX_NAME_LEN) return 0;
+    dst[len] = '\0';
+    return len;
+}
+
+uint32_t hashDomain(const char* name, size_t len) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ (uint64_t)len;
+    uint64_t word;
+
+    // 每次处理8字节
+    while (len >= 8) {
+        memcpy(&word, name, 8);
+        h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+        name += 8;
+        len -= 8;
+    }
+    if (len > 0) {
+        word = 0;
+        memcpy(&word, name, len);
+        h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+
+    h ^= h >> 29;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 32;
+    uint32_t result = (uint32_t)h;
+    return result ? result : 1;  // 0保留给空槽
+}
+
+// 扩容并重新散列所有槽位，域名留在字符池中不动
+static int growIndex(DomainIndex* index) {
+    size_t oldCapacity = index->mask + 1;
+    size_t newCapacity = oldCapacity * 2;
+    uint32_t* hashes;
+    DomainEntry* entries;
+    if (!allocSlots(newCapacity, &hashes, &entries)) return 0;
+
+    size_t newMask = newCapacity - 1;
+    for (size_t i = 0; i < oldCapacity; i++) {
+        uint32_t hash = index->hashes[i];
+        if (!hash) continue;
+        size_t pos = hash & newMask;
+        while (hashes[pos]) {
+            pos = (pos + 1) & newMask;
+        }
+        hashes[pos] = hash;
+        entries[pos] = index->entries[i];
+    }
+
+    free(index->hashes);
+    free(index->entries);
+    index->hashes = hashes;
+    index->entries = entries;
+    index->mask = newMask;
+    return 1;
+}
+
+// 把域名（含结尾的'\0'）追加到字符池，返回偏移；失败返回UINT32_MAX
+static uint32_t appendName(DomainIndex* index, const char* name, size_t len) {
+    if (index->arenaSize + len + 1 > index->arenaCapacity) {
+        size_t capacity = index->arenaCapacity ? index->arenaCapacity * 2 : MIN_ARENA_CAPACITY;
+        while (capacity < index->arenaSize + len + 1) capacity *= 2;
+        if (capacity > UINT32_MAX) return UINT32_MAX;
+        char* grown = (char*)realloc(index->arena, capacity);
+        if (!grown) return UINT32_MAX;
+        index->arena = grown;
+        index->arenaCapacity = capacity;
+    }
+    uint32_t offset = (uint32_t)index->arenaSize;
+    memcpy(index->arena + offset, name, len + 1);
+    index->arenaSize += len + 1;
+    return offset;
+}
+
+int domainIndexInsert(DomainIndex* index, const char* domain, uint32_t value, uint32_t* stored) {
+    char name[DNS_MAX_NAME_LEN + 1];
+    size_t len = normalizeDomain(domain, name);
+    if (len == 0) return 0;
+
+    // 装载因子保持在1/2以下，探测链足够短
+    if ((index->count + 1) * 2 > index->mask + 1) {
+        if (!growIndex(index)) return 0;
+    }
+
+    uint32_t hash = hashDomain(name, len);
+    size_t pos = hash & index->mask;
+    while (index->hashes[pos]) {
+        if (index->hashes[pos] == hash && strcmp(index->arena + index->entries[pos].name, name) == 0) {
+            if (stored) *stored = index->entries[pos].value;
+            return 1;  // 与原先的顺序扫描一致：先出现的记录优先
+        }
+        pos = (pos + 1) & index->mask;
+    }
+
+    uint32_t offset = appendName(index, name, len);
+    if (offset == UINT32_MAX) return 0;
+
+    index->hashes[pos] = hash;
+    index->entries[pos].name = offset;
+    index->entries[pos].value = value;
+    index->count++;
+    if (stored) *stored = value;
+    return 1;
+}
+
+void domainIndexRemap(DomainIndex* index, const uint32_t* remap) {
+    for (size_t i = 0; i <= index->mask; i++) {
+        if (index->hashes[i]) index->entries[i].value = remap[index->entries[i].value];
+    }
+}
+
+int domainIndexLookupNormalized(const DomainIndex* index, const char* name,
+                                size_t len, uint32_t hash, uint32_t* value) {
+    size_t pos = hash & index->mask;
+    while (index->hashes[pos]) {
+        if (index->hashes[pos] == hash) {
+            const DomainEntry* entry = &index->entries[pos];
+            const char* stored = index->arena + entry->name;
+            if (strncmp(stored, name, len) == 0 && stored[len] == '\0') {
+                *value = entry->value;
+                return 1;
+            }
+        }
+        pos = (pos + 1) & index->mask;
+    }
+    return 0;
+}
+
+int domainIndexLookup(const DomainIndex* index, const char* domain, uint32_t* value) {
+    char name[DNS_MAX_NAME_LEN + 1];
+    size_t len = normalizeDomain(domain, name);
+    if (len == 0) return 0;
+    return domainIndexLookupNormalized(index, name, len, hashDomain(name, len), value);
+}
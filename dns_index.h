@@ -0,0 +1,113 @@
+/**
+ * @file dns_index.h
+ * @brief 域名哈希索引的头文件定义
+ * @details 基于开放寻址（线性探测）的大小写不敏感域名索引，查找过程不分配内存。
+ *          槽位按数组结构（SoA）分开存放：探测只读取紧凑的哈希数组（一个缓存行16个槽位），
+ *          哈希相同时才访问同一下标的名称偏移和值。规范化后的域名依次追加在一块连续的字符池中，不为每个域名单独分配。
+ *          规则的值是地址集合编号（见dns_addrset.h）
+ */
+
+#ifndef DNS_INDEX_H
+#define DNS_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// 规范化域名的最大长度（不含结尾的'\0'）
+#define DNS_MAX_NAME_LEN 253
+
+/**
+ * @struct DomainEntry
+ * @brief 槽位中探测时用不到的部分
+ */
+typedef struct {
+    uint32_t name;   ///< 域名在字符池中的偏移
+    uint32_t value;  ///< 规则的值（地址集合编号）
+} DomainEntry;
+
+/**
+ * @struct DomainIndex
+ * @brief 开放寻址域名索引
+ * @details 容量始终为2的幂，装载因子超过1/2时扩容。hashes与entries下标一一对应
+ */
+typedef struct {
+    uint32_t* hashes;     ///< 各槽位的域名哈希值，0表示空槽
+    DomainEntry* entries; ///< 各槽位的名称偏移和值，空槽的内容未定义
+    size_t mask;          ///< 容量 - 1
+    size_t count;         ///< 已存储的域名数量
+    char* arena;          ///< 字符池：规范化后的域名（小写、无末尾点号），各以'\0'结尾
+    size_t arenaSize;     ///< 字符池已用字节数
+    size_t arenaCapacity; ///< 字符池容量
+} DomainIndex;
+
+/**
+ * @brief 初始化索引
+ * @param index 索引
+ * @param expected 预计存储的域名数量
+ * @return 成功返回1，失败返回0
+ */
+int domainIndexInit(DomainIndex* index, size_t expected);
+
+/**
+ * @brief 释放索引占用的内存
+ * @param index 索引
+ */
+void domainIndexFree(DomainIndex* index);
+
+/**
+ * @brief 规范化域名
+ * @param src 原始域名
+ * @param dst 输出缓冲区，至少DNS_MAX_NAME_LEN + 1字节
+ * @return 规范化后的长度，域名非法时返回0
+ * @details 转换为小写并去掉末尾的点号
+ */
+size_t normalizeDomain(const char* src, char* dst);
+
+/**
+ * @brief 计算规范化域名的哈希值
+ * @param name 规范化后的域名
+ * @param len 域名长度
+ * @return 非0的32位哈希值
+ * @details 按8字节分组计算，便于后续用向量化的解析路径直接产出同一哈希
+ */
+uint32_t hashDomain(const char* name, size_t len);
+
+/**
+ * @brief 向索引中插入域名
+ * @param index 索引
+ * @param domain 域名（无需预先规范化）
+ * @param value 规则的值
+ * @param stored 输出索引中实际保存的值（域名已存在时为原值），可为NULL
+ * @return 成功返回1（域名已存在时保留原值），失败返回0
+ */
+int domainIndexInsert(DomainIndex* index, const char* domain, uint32_t value, uint32_t* stored);
+
+/**
+ * @brief 按映射表改写所有规则值，用于地址集合合并之后
+ * @param index 索引
+ * @param remap remap[旧值]为新值
+ */
+void domainIndexRemap(DomainIndex* index, const uint32_t* remap);
+
+/**
+ * @brief 在索引中查找已规范化的域名
+ * @param index 索引
+ * @param name 规范化后的域名
+ * @param len 域名长度
+ * @param hash hashDomain(name, len)的结果
+ * @param value 输出规则的值
+ * @return 找到返回1，否则返回0
+ */
+int domainIndexLookupNormalized(const DomainIndex* index, const char* name,
+                                size_t len, uint32_t hash, uint32_t* value);
+
+/**
+ * @brief 在索引中查找域名（大小写不敏感）
+ * @param index 索引
+ * @param domain 待查找的域名
+ * @param value 输出规则的值
+ * @return 找到返回1，否则返回0
+ */
+int domainIndexLookup(const DomainIndex* index, const char* domain, uint32_t* value);
+
+#endif // DNS_INDEX_H
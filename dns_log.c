@@ -0,0 +1,324 @@
+#include "dns_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <limits.h>
+#endif
+
+#define RING_MASK (DNS_LOG_RING_SIZE - 1)
+#define MAX_MESSAGE 2048          // 单条日志最大长度（含十六进制转储）
+#define BATCH_RECORDS 256         // 每次批量写出的最大条数
+#define PREFIX_SIZE 64
+#define IDLE_SLEEP_MS 20
+#define WRAP_MARKER 0xFFFFFFFFu   // 记录不跨越缓冲区末尾，剩余空间用此标记跳过
+
+// 环形缓冲区中每条记录的头部，消息文本（以换行结尾）紧随其后
+typedef struct {
+    uint32_t size;                // 记录总长度（含头部，按8字节对齐）
+    uint32_t length;              // 消息文本长度
+    uint64_t timeMs;              // 墙上时钟毫秒
+    unsigned long threadId;
+    int level;
+} LogRecord;
+
+// 单生产者单消费者环形缓冲区：所属线程写，后台线程读
+typedef struct LogRing {
+    atomic_uint_fast64_t head;    // 生产者写入位置（单调递增）
+    atomic_uint_fast64_t tail;    // 消费者读取位置（单调递增）
+    atomic_uint_fast64_t dropped; // 因空间不足丢弃的条数
+    unsigned long threadId;
+    struct LogRing* next;         // 全局注册链表
+    char data[DNS_LOG_RING_SIZE];
+} LogRing;
+
+atomic_int dnsLogLevel = DNS_LOG_INFO;
+
+static atomic_int logRunning;
+static DNSMutex registryLock;     // 仅在线程首次写日志时注册缓冲区
+static LogRing* _Atomic rings;
+static DNSThread writerThread;
+static FILE* logFile;
+static _Thread_local LogRing* localRing;
+
+static const char* const levelNames[] = { "ERROR", "WARN", "INFO", "DEBUG", "TRACE" };
+
+static LogRing* currentRing(void) {
+    if (localRing) return localRing;
+
+    LogRing* ring = (LogRing*)calloc(1, sizeof(LogRing));
+    if (!ring) return NULL;
+    ring->threadId = dnsThreadId();
+
+    dnsMutexLock(&registryLock);
+    ring->next = atomic_load(&rings);
+    atomic_store(&rings, ring);
+    dnsMutexUnlock(&registryLock);
+
+    localRing = ring;
+    return ring;
+}
+
+// 把已格式化的消息放入当前线程的环形缓冲区，空间不足时丢弃
+static void pushRecord(DNSLogLevel level, const char* message, size_t length) {
+    LogRing* ring = currentRing();
+    if (!ring) return;
+
+    uint32_t size = (uint32_t)((sizeof(LogRecord) + length + 7) & ~(size_t)7);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t offset = (size_t)(head & RING_MASK);
+    size_t contiguous = DNS_LOG_RING_SIZE - offset;
+    uint64_t needed = size <= contiguous ? size : contiguous + size;
+
+    if (head + needed - tail > DNS_LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (size > contiguous) {
+        // 末尾空间不足，写跳转标记后从头开始
+        uint32_t marker = WRAP_MARKER;
+        memcpy(ring->data + offset, &marker, sizeof(marker));
+        head += contiguous;
+        offset = 0;
+    }
+
+    LogRecord record;
+    record.size = size;
+    record.length = (uint32_t)length;
+    record.timeMs = dnsWallTimeMs();
+    record.threadId = ring->threadId;
+    record.level = (int)level;
+    memcpy(ring->data + offset, &record, sizeof(record));
+    memcpy(ring->data + offset + sizeof(record), message, length);
+
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+}
+
+void dnsLog(DNSLogLevel level, const char* format, ...) {
+    if (!dnsLogEnabled(level) || !atomic_load_explicit(&logRunning, memory_order_relaxed)) {
+        return;
+    }
+
+    char message[MAX_MESSAGE];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(message, sizeof(message) - 1, format, args);
+    va_end(args);
+    if (n < 0) return;
+    if ((size_t)n > sizeof(message) - 2) n = (int)sizeof(message) - 2;
+    message[n++] = '\n';
+    pushRecord(level, message, (size_t)n);
+}
+
+void dnsLogHex(DNSLogLevel level, const char* prefix, const void* data, size_t length) {
+    if (!dnsLogEnabled(level) || !atomic_load_explicit(&logRunning, memory_order_relaxed)) {
+        return;
+    }
+
+    static const char digits[] = "0123456789ABCDEF";
+    char message[MAX_MESSAGE];
+    int n = snprintf(message, sizeof(message), "%s: ", prefix);
+    if (n < 0) return;
+    size_t pos = (size_t)n < sizeof(message) ? (size_t)n : sizeof(message) - 1;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length && pos + 4 < sizeof(message); i++) {
+        message[pos++] = digits[bytes[i] >> 4];
+        message[pos++] = digits[bytes[i] & 0xF];
+        message[pos++] = ' ';
+    }
+    message[pos++] = '\n';
+    pushRecord(level, message, pos);
+}
+
+// 一批待写出的数据片段
+typedef struct {
+    const char* base;
+    size_t length;
+} LogSlice;
+
+static void writeSlices(const LogSlice* slices, int count) {
+#ifdef _WIN32
+    // Windows没有writev，依靠FILE缓冲合并后一次刷新
+    for (int i = 0; i < count; i++) {
+        fwrite(slices[i].base, 1, slices[i].length, logFile);
+    }
+    fflush(logFile);
+#else
+    struct iovec iov[BATCH_RECORDS * 2];
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = (void*)slices[i].base;
+        iov[i].iov_len = slices[i].length;
+    }
+    int fd = fileno(logFile);
+    int done = 0;
+    while (done < count) {
+        int chunk = count - done;
+        if (chunk > IOV_MAX) chunk = IOV_MAX;
+        ssize_t written = writev(fd, iov + done, chunk);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        // 处理部分写入
+        while (done < count && written >= (ssize_t)iov[done].iov_len) {
+            written -= (ssize_t)iov[done].iov_len;
+            done++;
+        }
+        if (done < count && written > 0) {
+            iov[done].iov_base = (char*)iov[done].iov_base + written;
+            iov[done].iov_len -= (size_t)written;
+        }
+    }
+#endif
+}
+
+// 格式化日志前缀，同一秒内复用localtime的结果
+static size_t formatPrefix(char* buffer, const LogRecord* record) {
+    static time_t cachedSecond = (time_t)-1;
+    static char cachedTime[64];              // 按int的最大宽度留足空间，避免格式化被截断
+
+    time_t second = (time_t)(record->timeMs / 1000);
+    if (second != cachedSecond) {
+        struct tm* t = localtime(&second);
+        snprintf(cachedTime, sizeof(cachedTime), "%04d-%02d-%02d %02d:%02d:%02d",
+                 t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
+                 t->tm_hour, t->tm_min, t->tm_sec);
+        cachedSecond = second;
+    }
+
+    int level = record->level;
+    if (level < 0 || level > DNS_LOG_TRACE) level = DNS_LOG_INFO;
+    int n = snprintf(buffer, PREFIX_SIZE, "[%s][TID:%lu][%s] ",
+                     cachedTime, record->threadId, levelNames[level]);
+    return n > 0 ? (size_t)n : 0;
+}
+
+// 从所有线程的缓冲区取出一批日志并写出，返回写出的条数
+static int drainRings(void) {
+    static char prefixes[BATCH_RECORDS][PREFIX_SIZE];
+    LogSlice slices[BATCH_RECORDS * 2];
+    int records = 0;
+    int total = 0;
+
+    for (LogRing* ring = atomic_load(&rings); ring; ring = ring->next) {
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        while (tail != head) {
+            size_t offset = (size_t)(tail & RING_MASK);
+            LogRecord record;
+            memcpy(&record.size, ring->data + offset, sizeof(record.size));
+            if (record.size == WRAP_MARKER) {
+                tail += DNS_LOG_RING_SIZE - offset;
+                continue;
+            }
+            memcpy(&record, ring->data + offset, sizeof(record));
+
+            size_t prefixLength = formatPrefix(prefixes[records], &record);
+            slices[records * 2].base = prefixes[records];
+            slices[records * 2].length = prefixLength;
+            slices[records * 2 + 1].base = ring->data + offset + sizeof(record);
+            slices[records * 2 + 1].length = record.length;
+            records++;
+            tail += record.size;
+
+            if (records == BATCH_RECORDS) {
+                // 写出后才能释放缓冲区空间，片段直接指向环形缓冲区
+                writeSlices(slices, records * 2);
+                atomic_store_explicit(&ring->tail, tail, memory_order_release);
+                total += records;
+                records = 0;
+            }
+        }
+
+        if (records > 0) {
+            writeSlices(slices, records * 2);
+            total += records;
+            records = 0;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    return total;
+}
+
+static void writerMain(void* arg) {
+    (void)arg;
+    while (atomic_load(&logRunning)) {
+        if (drainRings() == 0) {
+            dnsSleepMs(IDLE_SLEEP_MS);
+        }
+    }
+    drainRings();
+}
+
+int dnsLogInit(const char* path, DNSLogLevel level) {
+    if (atomic_load(&logRunning)) return 1;
+
+    logFile = fopen(path, "a");
+    if (!logFile) return 0;
+#ifdef _WIN32
+    setvbuf(logFile, NULL, _IOFBF, 64 * 1024);
+#endif
+
+    dnsMutexInit(&registryLock);
+    atomic_store(&dnsLogLevel, (int)level);
+    atomic_store(&logRunning, 1);
+    if (!dnsThreadCreate(&writerThread, writerMain, NULL)) {
+        atomic_store(&logRunning, 0);
+        fclose(logFile);
+        logFile = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void dnsLogShutdown(void) {
+    if (!atomic_load(&logRunning)) return;
+    atomic_store(&logRunning, 0);
+    dnsThreadJoin(writerThread);
+
+    LogRing* ring = atomic_load(&rings);
+    while (ring) {
+        LogRing* next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    atomic_store(&rings, NULL);
+    localRing = NULL;
+    dnsMutexDestroy(&registryLock);
+    fclose(logFile);
+    logFile = NULL;
+}
+
+void dnsLogSetLevel(DNSLogLevel level) {
+    atomic_store(&dnsLogLevel, (int)level);
+}
+
+int dnsLogParseLevel(const char* name) {
+    for (int i = 0; i <= DNS_LOG_TRACE; i++) {
+        const char* expected = levelNames[i];
+        size_t j = 0;
+        while (name[j] && expected[j] &&
+               (name[j] == expected[j] || name[j] == expected[j] - 'A' + 'a')) {
+            j++;
+        }
+        if (name[j] == '\0' && expected[j] == '\0') return i;
+    }
+    return -1;
+}
+
+uint64_t dnsLogDropped(void) {
+    uint64_t dropped = 0;
+    for (LogRing* ring = atomic_load(&rings); ring; ring = ring->next) {
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
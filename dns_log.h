@@ -0,0 +1,83 @@
+/**
+ * @file dns_log.h
+ * @brief 异步日志的头文件定义
+ * @details 每个线程把日志写入自己的无锁环形缓冲区，由单个后台线程批量取出并写入文件。
+ *          环形缓冲区满时直接丢弃并计数，不阻塞调用线程
+ */
+
+#ifndef DNS_LOG_H
+#define DNS_LOG_H
+
+#include "dns_platform.h"
+#include <stdatomic.h>
+
+/**
+ * @brief 日志级别，数值越大越详细
+ */
+typedef enum {
+    DNS_LOG_ERROR = 0,  ///< 错误
+    DNS_LOG_WARN,       ///< 警告
+    DNS_LOG_INFO,       ///< 启动、退出等运行信息（默认级别）
+    DNS_LOG_DEBUG,      ///< 逐条查询的处理过程
+    DNS_LOG_TRACE       ///< 报文十六进制转储
+} DNSLogLevel;
+
+#define DNS_LOG_RING_SIZE (64 * 1024)  ///< 每个线程的环形缓冲区大小（字节）
+
+/// 当前日志级别，热路径上直接读取
+extern atomic_int dnsLogLevel;
+
+/**
+ * @brief 判断某级别的日志是否需要输出
+ * @details 参数求值代价较高时（如地址转换、十六进制转储）应先调用本函数
+ */
+#define dnsLogEnabled(level) \
+    ((int)(level) <= atomic_load_explicit(&dnsLogLevel, memory_order_relaxed))
+
+/**
+ * @brief 初始化日志并启动后台写线程
+ * @param path 日志文件路径（追加写入）
+ * @param level 初始日志级别
+ * @return 成功返回1，失败返回0
+ * @details 初始化之前的日志调用会被忽略
+ */
+int dnsLogInit(const char* path, DNSLogLevel level);
+
+/**
+ * @brief 写出剩余日志并停止后台写线程
+ */
+void dnsLogShutdown(void);
+
+/**
+ * @brief 运行时修改日志级别
+ */
+void dnsLogSetLevel(DNSLogLevel level);
+
+/**
+ * @brief 解析日志级别名称（error/warn/info/debug/trace）
+ * @return 级别，名称无效时返回-1
+ */
+int dnsLogParseLevel(const char* name);
+
+/**
+ * @brief 输出一条日志
+ * @param level 日志级别
+ * @param format printf风格的格式串
+ */
+void dnsLog(DNSLogLevel level, const char* format, ...);
+
+/**
+ * @brief 以十六进制输出一段数据
+ * @param level 日志级别
+ * @param prefix 前缀说明
+ * @param data 数据
+ * @param length 数据长度
+ */
+void dnsLogHex(DNSLogLevel level, const char* prefix, const void* data, size_t length);
+
+/**
+ * @brief 获取因环形缓冲区已满而丢弃的日志条数
+ */
+uint64_t dnsLogDropped(void);
+
+#endif // DNS_LOG_H
@@ -1,143 +1,552 @@
-#include "dns_message.h"
-#include <winsock2.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-char* extractDomain(const char* buffer, size_t length) {
-    if (length < sizeof(struct DNSHeader)) {
-        return NULL;
-    }
-
-    char* domain = (char*)malloc(length);
-    if (!domain) return NULL;
-    
-    size_t pos = sizeof(struct DNSHeader);
-    size_t domainPos = 0;
-
-    // 解析域名标签
-    while (pos < length && buffer[pos] != 0) {
-        uint8_t labelLen = buffer[pos++];
-        if (pos + labelLen > length) {
-            free(domain);
-            return NULL;
-        }
-
-        // 添加标签内容
-        memcpy(domain + domainPos, buffer + pos, labelLen);
-        domainPos += labelLen;
-        domain[domainPos++] = '.';
-        pos += labelLen;
-    }
-
-    // 移除最后一个点号
-    if (domainPos > 0) {
-        domain[domainPos - 1] = '\0';
-    } else {
-        domain[0] = '\0';
-    }
-
-    return domain;
-}
-
-char* buildDNSResponse(uint16_t id, const char* domain, 
-                      const char* ip, int isError, size_t* responseLength) {
-    if (!domain || !responseLength) {
-        return NULL;
-    }
-
-    // 计算响应大小
-    size_t domainLen = strlen(domain);
-    size_t totalSize = sizeof(struct DNSHeader) + domainLen + 2 + 4;  // 头部 + 域名 + 类型和类 + TTL等
-    if (!isError) {
-        totalSize += 16;  // 回答部分的大小
-    }
-
-    char* response = (char*)malloc(totalSize);
-    if (!response) return NULL;
-
-    // 设置DNS报文头部
-    struct DNSHeader* header = (struct DNSHeader*)response;
-    header->id = htons(id);
-    header->flags = htons(0x8180);  // 标准查询响应
-    header->qdcount = htons(1);
-    header->ancount = htons(isError ? 0 : 1);
-    header->nscount = htons(0);
-    header->arcount = htons(0);
-
-    // 构建问题部分
-    size_t pos = sizeof(struct DNSHeader);
-    char* domainPtr = response + pos;
-    size_t start = 0;
-    size_t end = 0;
-
-    // 解析域名标签
-    while (1) {
-        char* dot = strchr(domain + start, '.');
-        if (!dot) break;  // 没有找到点号
-
-        end = dot - domain;
-        size_t labelLen = end - start;
-        if (labelLen > 63) {  // DNS标签最大长度为63字节
-            free(response);
-            return NULL;
-        }
-
-        response[pos++] = (char)labelLen;
-        memcpy(response + pos, domain + start, labelLen);
-        pos += labelLen;
-        start = end + 1;
-    }
-
-    // 处理最后一个标签
-    size_t lastLabelLen = strlen(domain) - start;
-    if (lastLabelLen > 63) {
-        free(response);
-        return NULL;
-    }
-    response[pos++] = (char)lastLabelLen;
-    memcpy(response + pos, domain + start, lastLabelLen);
-    pos += lastLabelLen;
-    response[pos++] = 0;  // 域名结束标记
-
-    // 添加查询类型和类
-    uint16_t qtype = htons(1);   // A记录类型
-    uint16_t qclass = htons(1);  // IN类
-    memcpy(response + pos, &qtype, 2);
-    pos += 2;
-    memcpy(response + pos, &qclass, 2);
-    pos += 2;
-
-    if (!isError) {
-        // 构建回答部分
-        uint16_t namePtr = htons(0xC000 | sizeof(struct DNSHeader));
-        memcpy(response + pos, &namePtr, 2);
-        pos += 2;
-        memcpy(response + pos, &qtype, 2);
-        pos += 2;
-        memcpy(response + pos, &qclass, 2);
-        pos += 2;
-
-        uint32_t ttl = htonl(300);  // TTL值（5分钟）
-        memcpy(response + pos, &ttl, 4);
-        pos += 4;
-
-        uint16_t rdlength = htons(4);  // IP地址长度（4字节）
-        memcpy(response + pos, &rdlength, 2);
-        pos += 2;
-
-        // 转换并添加IP地址
-        struct in_addr addr;
-        addr.s_addr = inet_addr(ip);
-        if (addr.s_addr == INADDR_NONE) {
-            free(response);
-            return NULL;
-        }
-
-        memcpy(response + pos, &addr.s_addr, 4);
-        pos += 4;
-    }
-
-    *responseLength = pos;
-    return response;
-} 
\ No newline at end of file
+#include "dns_message.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int parseDNSQuery(const char* packet, size_t length, DNSQuestion* question) {
+    if (length < sizeof(struct DNSHeader) + 5) {
+        return 0;
+    }
+
+    const struct DNSHeader* header = (const struct DNSHeader*)packet;
+    if (ntohs(header->qdcount) != 1) {
+        return 0;
+    }
+
+    // 逐个标签校验长度，查询的问题部分不应出现压缩指针
+    size_t pos = sizeof(struct DNSHeader);
+    for (;;) {
+        if (pos >= length) return 0;                    // 域名未以根标签结束
+        uint8_t labelLen = (uint8_t)packet[pos];
+        if (labelLen > 63 || pos + labelLen + 1 > length) {
+            return 0;
+        }
+        pos += labelLen + 1;
+        if (labelLen == 0) break;
+    }
+    if (pos - sizeof(struct DNSHeader) > 255 || pos + 4 > length) {
+        return 0;
+    }
+
+    question->id = ntohs(header->id);
+    question->flags = ntohs(header->flags);
+    question->nameOffset = sizeof(struct DNSHeader);
+    question->nameLength = pos - sizeof(struct DNSHeader);
+    question->qtype = (uint16_t)(((uint8_t)packet[pos] << 8) | (uint8_t)packet[pos + 1]);
+    question->qclass = (uint16_t)(((uint8_t)packet[pos + 2] << 8) | (uint8_t)packet[pos + 3]);
+    question->questionEnd = pos + 4;
+    return 1;
+}
+
+size_t questionDomain(const char* packet, const DNSQuestion* question,
+                      char* domain, size_t domainSize) {
+    const char* name = packet + question->nameOffset;
+    size_t pos = 0;
+    size_t out = 0;
+
+    while ((uint8_t)name[pos] != 0) {
+        uint8_t labelLen = (uint8_t)name[pos++];
+        // 标签内容 + 分隔点号（或结尾'\0'）
+        if (out + (out > 0) + labelLen + 1 > domainSize) {
+            return 0;
+        }
+        if (out > 0) {
+            domain[out++] = '.';
+        }
+        for (uint8_t i = 0; i < labelLen; i++) {
+            char c = name[pos++];
+            domain[out++] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+    }
+
+    if (domainSize == 0) return 0;
+    domain[out] = '\0';
+    return out;
+}
+
+static size_t skipName(const char* packet, size_t length, size_t pos);
+static uint16_t readU16(const char* p);
+
+int parseEdns(const char* packet, size_t length, const DNSQuestion* question, EdnsInfo* edns) {
+    const struct DNSHeader* header = (const struct DNSHeader*)packet;
+    unsigned records = (unsigned)ntohs(header->ancount) + ntohs(header->nscount) + ntohs(header->arcount);
+    unsigned additionalStart = (unsigned)ntohs(header->ancount) + ntohs(header->nscount);
+
+    edns->present = 0;
+    edns->udpSize = DNS_CLASSIC_UDP_SIZE;
+    edns->version = 0;
+    edns->flags = 0;
+
+    size_t pos = question->questionEnd;
+    for (unsigned i = 0; i < records; i++) {
+        size_t nameStart = pos;
+        pos = skipName(packet, length, pos);
+        if (pos == 0 || pos + 10 > length) return 0;
+        uint16_t type = readU16(packet + pos);
+        size_t rdLength = readU16(packet + pos + 8);
+        if (pos + 10 + rdLength > length) return 0;
+
+        if (type == DNS_TYPE_OPT) {
+            // OPT只能出现一次，位于附加部分，名称为根
+            if (edns->present || i < additionalStart || pos != nameStart + 1) return 0;
+            uint16_t udpSize = readU16(packet + pos + 2);
+            edns->present = 1;
+            edns->udpSize = udpSize < DNS_CLASSIC_UDP_SIZE ? DNS_CLASSIC_UDP_SIZE : udpSize;
+            edns->version = (uint8_t)packet[pos + 5];
+            edns->flags = readU16(packet + pos + 6);
+        }
+        pos += 10 + rdLength;
+    }
+    return 1;
+}
+
+// 在pos处写一条用压缩指针引用问题域名的资源记录
+static size_t writeRecord(uint8_t* out, const DNSQuestion* question, uint16_t type,
+                          const uint8_t* data, uint16_t dataLength) {
+    out[0] = 0xC0;                                      // 压缩指针指向问题域名
+    out[1] = (uint8_t)question->nameOffset;
+    out[2] = (uint8_t)(type >> 8); out[3] = (uint8_t)type;
+    out[4] = 0; out[5] = DNS_CLASS_IN;
+    out[6] = (uint8_t)(DNS_LOCAL_TTL >> 24); out[7] = (uint8_t)(DNS_LOCAL_TTL >> 16);
+    out[8] = (uint8_t)(DNS_LOCAL_TTL >> 8); out[9] = (uint8_t)DNS_LOCAL_TTL;
+    out[10] = (uint8_t)(dataLength >> 8); out[11] = (uint8_t)dataLength;
+    memcpy(out + 12, data, dataLength);                 // 已是网络字节序
+    return 12 + (size_t)dataLength;
+}
+
+// 本地应答的公共部分：检查EDNS版本、查询类和屏蔽标志，决定应答码和需要的地址族
+static void selectLocalAnswer(const DNSQuestion* question, const EdnsInfo* edns, int blocked,
+                              int* rcode, int* extendedRcode, int* wantV4, int* wantV6) {
+    *rcode = 0;
+    *extendedRcode = 0;
+    *wantV4 = 0;
+    *wantV6 = 0;
+    if (edns->present && edns->version != 0) {
+        *extendedRcode = 1;                             // BADVERS = 16，高8位放在OPT中
+    } else if (question->qclass != DNS_CLASS_IN && question->qclass != DNS_CLASS_ANY) {
+        *rcode = DNS_RCODE_REFUSED;
+    } else if (blocked) {
+        *rcode = DNS_RCODE_NXDOMAIN;
+    } else {
+        *wantV4 = question->qtype == DNS_TYPE_A || question->qtype == DNS_TYPE_ANY;
+        *wantV6 = question->qtype == DNS_TYPE_AAAA || question->qtype == DNS_TYPE_ANY;
+    }
+}
+
+// 写一条声明本服务器载荷上限的OPT伪记录，返回长度（11字节）
+static size_t writeOpt(uint8_t* out, int extendedRcode) {
+    out[0] = 0;                                         // 根域名
+    out[1] = 0; out[2] = DNS_TYPE_OPT;
+    out[3] = (uint8_t)(DNS_EDNS_UDP_SIZE >> 8); out[4] = (uint8_t)DNS_EDNS_UDP_SIZE;
+    out[5] = (uint8_t)extendedRcode;
+    out[6] = 0;                                         // 版本0
+    out[7] = 0; out[8] = 0;                             // 不支持DNSSEC，不回显DO位
+    out[9] = 0; out[10] = 0;                            // RDLENGTH
+    return 11;
+}
+
+// 在记录之后追加OPT并填写头部，返回应答长度
+static size_t finishLocalAnswer(char* response, size_t pos, const DNSQuestion* question,
+                                const EdnsInfo* edns, int rcode, int extendedRcode,
+                                int answers, int truncated) {
+    if (edns->present) {
+        pos += writeOpt((uint8_t*)response + pos, extendedRcode);
+    }
+
+    struct DNSHeader* header = (struct DNSHeader*)response;
+    header->flags = htons((uint16_t)(0x8080 | (question->flags & 0x7900) |
+                                     (truncated ? 0x0200 : 0) | rcode));
+    header->qdcount = htons(1);
+    header->ancount = htons((uint16_t)answers);
+    header->nscount = 0;
+    header->arcount = htons(edns->present ? 1 : 0);
+    return pos;
+}
+
+size_t buildLocalAnswer(char* response, size_t responseSize, const char* query,
+                        const DNSQuestion* question, const EdnsInfo* edns,
+                        const AddressList* addresses) {
+    size_t pos = question->questionEnd;
+    size_t optSize = edns->present ? 11 : 0;
+
+    // OPT必须放得下
+    size_t limit = responseSize;
+    if (pos + optSize > limit) {
+        return 0;
+    }
+
+    // 头部和问题部分直接沿用客户端的字节
+    if (response != query) {
+        memcpy(response, query, pos);
+    }
+
+    int rcode, extendedRcode, wantV4, wantV6;
+    selectLocalAnswer(question, edns, addresses->blocked, &rcode, &extendedRcode, &wantV4, &wantV6);
+
+    // 依次放入记录，放不下时截断并置TC位；没有匹配的记录即为NODATA
+    int answers = 0;
+    int truncated = 0;
+    uint8_t* out = (uint8_t*)response;
+    for (int i = 0; wantV4 && i < addresses->v4Count; i++) {
+        if (pos + 16 + optSize > limit) { truncated = 1; break; }
+        pos += writeRecord(out + pos, question, DNS_TYPE_A, addresses->v4[i], 4);
+        answers++;
+    }
+    for (int i = 0; wantV6 && !truncated && i < addresses->v6Count; i++) {
+        if (pos + 28 + optSize > limit) { truncated = 1; break; }
+        pos += writeRecord(out + pos, question, DNS_TYPE_AAAA, addresses->v6[i], 16);
+        answers++;
+    }
+
+    return finishLocalAnswer(response, pos, question, edns, rcode, extendedRcode, answers, truncated);
+}
+
+// 模板中一条记录的固定部分：压缩指针、类型、IN类、TTL和RDLENGTH
+static uint8_t* writeTemplateRecord(uint8_t* out, uint16_t type, const uint8_t* data, uint16_t dataLength) {
+    out[0] = 0xC0;                                      // 问题域名总在头部之后
+    out[1] = (uint8_t)sizeof(struct DNSHeader);
+    out[2] = (uint8_t)(type >> 8); out[3] = (uint8_t)type;
+    out[4] = 0; out[5] = DNS_CLASS_IN;
+    out[6] = (uint8_t)(DNS_LOCAL_TTL >> 24); out[7] = (uint8_t)(DNS_LOCAL_TTL >> 16);
+    out[8] = (uint8_t)(DNS_LOCAL_TTL >> 8); out[9] = (uint8_t)DNS_LOCAL_TTL;
+    out[10] = (uint8_t)(dataLength >> 8); out[11] = (uint8_t)dataLength;
+    memcpy(out + 12, data, dataLength);
+    return out + 12 + dataLength;
+}
+
+int buildAnswerTemplates(AnswerTemplates* templates, const AddressSet* sets, uint32_t count,
+                         const uint8_t* pool, size_t poolSize) {
+    memset(templates, 0, sizeof(*templates));
+    uint32_t* offsets = (uint32_t*)malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!offsets) return 0;
+
+    // 第一遍检查边界并确定每个集合的偏移
+    size_t size = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const AddressSet* set = &sets[i];
+        size_t length = (size_t)set->v4Count * 4 + (size_t)set->v6Count * 16;
+        if (set->v4Count > ADDRSET_MAX_PER_FAMILY || set->v6Count > ADDRSET_MAX_PER_FAMILY ||
+            set->offset > poolSize || length > poolSize - set->offset || size > UINT32_MAX) {
+            offsets[i] = ADDRSET_NONE;
+            continue;
+        }
+        offsets[i] = (uint32_t)size;
+        if (!(set->flags & ADDRSET_BLOCKED)) {
+            size += (size_t)set->v4Count * DNS_TEMPLATE_A_SIZE + (size_t)set->v6Count * DNS_TEMPLATE_AAAA_SIZE;
+        }
+    }
+
+    uint8_t* records = (uint8_t*)malloc(size ? size : 1);
+    if (!records) {
+        free(offsets);
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        const AddressSet* set = &sets[i];
+        if (offsets[i] == ADDRSET_NONE || (set->flags & ADDRSET_BLOCKED)) continue;
+        const uint8_t* address = pool + set->offset;
+        uint8_t* out = records + offsets[i];
+        for (int k = 0; k < set->v4Count; k++, address += 4) {
+            out = writeTemplateRecord(out, DNS_TYPE_A, address, 4);
+        }
+        for (int k = 0; k < set->v6Count; k++, address += 16) {
+            out = writeTemplateRecord(out, DNS_TYPE_AAAA, address, 16);
+        }
+    }
+
+    templates->records = records;
+    templates->offsets = offsets;
+    templates->count = count;
+    templates->size = size;
+    return 1;
+}
+
+void freeAnswerTemplates(AnswerTemplates* templates) {
+    free(templates->records);
+    free(templates->offsets);
+    memset(templates, 0, sizeof(*templates));
+}
+
+// 复制至少16字节：按16字节定长块复制，最后一块与前一块重叠地对齐到末尾。
+// 定长memcpy会展开成向量移动，避免变长memcpy的函数调用或rep movs启动开销
+static inline void copyBlock(char* out, const void* in, size_t length) {
+    const uint8_t* src = (const uint8_t*)in;
+    size_t offset = 0;
+    for (; offset + 16 < length; offset += 16) {
+        memcpy(out + offset, src + offset, 16);
+    }
+    memcpy(out + length - 16, src + length - 16, 16);
+}
+
+size_t buildTemplateAnswer(char* response, size_t responseSize, const char* query,
+                           const DNSQuestion* question, const EdnsInfo* edns,
+                           const AnswerTemplates* templates, const AddressSet* set, uint32_t index) {
+    size_t pos = question->questionEnd;
+    size_t optSize = edns->present ? 11 : 0;
+    if (pos + optSize > responseSize) {
+        return 0;
+    }
+    if (response != query) {
+        copyBlock(response, query, pos);               // 头部12字节 + 问题至少5字节
+    }
+
+    int rcode, extendedRcode, wantV4, wantV6;
+    selectLocalAnswer(question, edns, (set->flags & ADDRSET_BLOCKED) != 0,
+                      &rcode, &extendedRcode, &wantV4, &wantV6);
+
+    // 集合的A记录之后紧跟AAAA记录，所需的记录总是连续的一段，整段一次复制；
+    // 放不下时按固定的记录长度算出能放下的条数再复制
+    size_t v4 = wantV4 ? set->v4Count : 0;
+    size_t v6 = wantV6 ? set->v6Count : 0;
+    const uint8_t* records = templates->records + templates->offsets[index] +
+                             (wantV4 ? 0 : (size_t)set->v4Count * DNS_TEMPLATE_A_SIZE);
+    size_t room = responseSize - pos - optSize;
+    int truncated = 0;
+    if (v4 * DNS_TEMPLATE_A_SIZE + v6 * DNS_TEMPLATE_AAAA_SIZE > room) {
+        truncated = 1;
+        if (v4 * DNS_TEMPLATE_A_SIZE > room) {
+            v4 = room / DNS_TEMPLATE_A_SIZE;
+            v6 = 0;
+        } else {
+            v6 = (room - v4 * DNS_TEMPLATE_A_SIZE) / DNS_TEMPLATE_AAAA_SIZE;
+        }
+    }
+    size_t bytes = v4 * DNS_TEMPLATE_A_SIZE + v6 * DNS_TEMPLATE_AAAA_SIZE;
+    if (bytes > 0) {
+        copyBlock(response + pos, records, bytes);
+        pos += bytes;
+    }
+
+    return finishLocalAnswer(response, pos, question, edns, rcode, extendedRcode, (int)(v4 + v6), truncated);
+}
+
+size_t udpResponseLimit(const EdnsInfo* edns) {
+    return edns->present ? edns->udpSize : DNS_CLASSIC_UDP_SIZE;
+}
+
+size_t truncateResponse(const char* response, size_t length, size_t limit,
+                        char* out, size_t outSize) {
+    if (length < sizeof(struct DNSHeader)) return 0;
+    if (length <= limit) {
+        if (length > outSize) return 0;
+        if (out != response) memcpy(out, response, length);
+        return length;
+    }
+
+    const struct DNSHeader* header = (const struct DNSHeader*)response;
+    size_t pos = sizeof(struct DNSHeader);
+    int qdcount = ntohs(header->qdcount);
+    for (int i = 0; i < qdcount; i++) {
+        pos = skipName(response, length, pos);
+        if (pos == 0 || pos + 4 > length) return 0;
+        pos += 4;
+    }
+    size_t questionEnd = pos;
+
+    // 在附加部分中找OPT，记录格式错误时放弃保留OPT
+    unsigned records = (unsigned)ntohs(header->ancount) + ntohs(header->nscount) + ntohs(header->arcount);
+    unsigned additionalStart = (unsigned)ntohs(header->ancount) + ntohs(header->nscount);
+    size_t optStart = 0;
+    size_t optLength = 0;
+    for (unsigned i = 0; i < records; i++) {
+        size_t start = pos;
+        pos = skipName(response, length, pos);
+        if (pos == 0 || pos + 10 > length) break;
+        size_t end = pos + 10 + readU16(response + pos + 8);
+        if (end > length) break;
+        if (i >= additionalStart && readU16(response + pos) == DNS_TYPE_OPT) {
+            optStart = start;
+            optLength = end - start;
+            break;
+        }
+        pos = end;
+    }
+
+    if (questionEnd + optLength > limit) optLength = 0;
+    if (questionEnd > limit || questionEnd + optLength > outSize) return 0;
+    if (out != response) memcpy(out, response, questionEnd);
+    memmove(out + questionEnd, response + optStart, optLength);
+
+    // 原地截断时OPT只会向前移动，头部在最后改写
+    struct DNSHeader* outHeader = (struct DNSHeader*)out;
+    outHeader->flags = htons((uint16_t)(ntohs(outHeader->flags) | 0x0200));
+    outHeader->ancount = 0;
+    outHeader->nscount = 0;
+    outHeader->arcount = htons(optLength ? 1 : 0);
+    return questionEnd + optLength;
+}
+
+size_t buildErrorResponse(const char* query, size_t length, int rcode,
+                          char* response, size_t responseSize) {
+    if (length < sizeof(struct DNSHeader)) {
+        return 0;
+    }
+
+    const struct DNSHeader* queryHeader = (const struct DNSHeader*)query;
+    DNSQuestion question;
+    EdnsInfo edns;
+    int hasQuestion = parseDNSQuery(query, length, &question);
+    // OPT格式错误时按不带EDNS应答；原地构建时OPT会被覆盖，须先解析
+    int hasOpt = hasQuestion && parseEdns(query, length, &question, &edns) && edns.present;
+    size_t end = hasQuestion ? question.questionEnd : sizeof(struct DNSHeader);
+    if (end + (hasOpt ? 11 : 0) > responseSize) {
+        return 0;
+    }
+
+    if (response != query) {
+        memcpy(response, query, end);
+    }
+    struct DNSHeader* header = (struct DNSHeader*)response;
+    // 保留操作码和RD位，置QR和RA位
+    uint16_t flags = ntohs(queryHeader->flags);
+    header->flags = htons((uint16_t)(0x8080 | (flags & 0x7900) | (rcode & 0xF)));
+    header->qdcount = htons(hasQuestion ? 1 : 0);
+    header->ancount = 0;
+    header->nscount = 0;
+    header->arcount = htons(hasOpt ? 1 : 0);
+    if (hasOpt) {
+        end += writeOpt((uint8_t*)response + end, 0);
+    }
+    return end;
+}
+
+size_t buildSlipResponse(const char* query, size_t length, char* response, size_t responseSize) {
+    DNSQuestion question;
+    if (!parseDNSQuery(query, length, &question) || (question.flags & 0x8000) ||
+        question.questionEnd > responseSize) {
+        return 0;
+    }
+    if (response != query) {
+        memcpy(response, query, question.questionEnd);
+    }
+    struct DNSHeader* header = (struct DNSHeader*)response;
+    header->flags = htons((uint16_t)(0x8280 | (question.flags & 0x7900)));
+    header->qdcount = htons(1);
+    header->ancount = 0;
+    header->nscount = 0;
+    header->arcount = 0;
+    return question.questionEnd;
+}
+
+size_t extractQuestionKey(const char* packet, size_t length,
+                          uint8_t* key, size_t keySize, size_t* questionLength) {
+    DNSQuestion question;
+    EdnsInfo edns;
+    if (!parseDNSQuery(packet, length, &question) ||
+        !parseEdns(packet, length, &question, &edns) ||
+        question.nameLength + 5 > keySize) {
+        return 0;
+    }
+
+    const char* name = packet + question.nameOffset;
+    for (size_t i = 0; i < question.nameLength; i++) {
+        char c = name[i];
+        key[i] = (uint8_t)((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+    }
+    memcpy(key + question.nameLength, name + question.nameLength, 4);  // QTYPE + QCLASS
+    uint8_t flags = (uint8_t)((packet[2] & 0x01 ? DNS_KEY_FLAG_RD : 0) | (packet[3] & 0x10 ? DNS_KEY_FLAG_CD : 0));
+    if (edns.present) {
+        flags |= DNS_KEY_FLAG_EDNS;
+        if (edns.flags & 0x8000) flags |= DNS_KEY_FLAG_DO;
+    }
+    key[question.nameLength + 4] = flags;
+    if (questionLength) {
+        *questionLength = question.questionEnd - question.nameOffset;
+    }
+    return question.nameLength + 5;
+}
+
+// 跳过一个（可能压缩的）域名，返回其后的位置，出错返回0
+static size_t skipName(const char* packet, size_t length, size_t pos) {
+    while (pos < length) {
+        uint8_t labelLen = (uint8_t)packet[pos];
+        if (labelLen == 0) return pos + 1;
+        if ((labelLen & 0xC0) == 0xC0) {
+            return pos + 2 <= length ? pos + 2 : 0;  // 压缩指针结束域名
+        }
+        if (labelLen > 63) return 0;
+        pos += labelLen + 1;
+    }
+    return 0;
+}
+
+static uint16_t readU16(const char* p) {
+    return (uint16_t)(((uint8_t)p[0] << 8) | (uint8_t)p[1]);
+}
+
+static uint32_t readU32(const char* p) {
+    return ((uint32_t)(uint8_t)p[0] << 24) | ((uint32_t)(uint8_t)p[1] << 16) |
+           ((uint32_t)(uint8_t)p[2] << 8) | (uint32_t)(uint8_t)p[3];
+}
+
+int collectTtlOffsets(const char* packet, size_t length, uint16_t* offsets,
+                      int maxOffsets, uint32_t* minTtl) {
+    if (length < sizeof(struct DNSHeader)) return -1;
+
+    const struct DNSHeader* header = (const struct DNSHeader*)packet;
+    size_t pos = sizeof(struct DNSHeader);
+    int qdcount = ntohs(header->qdcount);
+    int rrcount = ntohs(header->ancount) + ntohs(header->nscount) + ntohs(header->arcount);
+
+    for (int i = 0; i < qdcount; i++) {
+        pos = skipName(packet, length, pos);
+        if (pos == 0 || pos + 4 > length) return -1;
+        pos += 4;
+    }
+
+    int count = 0;
+    uint32_t minimum = 0xFFFFFFFFu;
+    for (int i = 0; i < rrcount; i++) {
+        pos = skipName(packet, length, pos);
+        if (pos == 0 || pos + 10 > length) return -1;
+
+        uint16_t type = readU16(packet + pos);
+        uint16_t rdlength = readU16(packet + pos + 8);
+        if (type != DNS_TYPE_OPT) {          // OPT的TTL字段是扩展RCODE和标志，不是TTL
+            if (count >= maxOffsets) return -1;
+            uint32_t ttl = readU32(packet + pos + 4);
+            if (ttl < minimum) minimum = ttl;
+            offsets[count++] = (uint16_t)(pos + 4);
+        }
+        pos += 10 + rdlength;
+        if (pos > length) return -1;
+    }
+
+    *minTtl = count > 0 ? minimum : 0;
+    return count;
+}
+
+int findNegativeTtl(const char* packet, size_t length, uint32_t* ttl) {
+    if (length < sizeof(struct DNSHeader)) return 0;
+
+    const struct DNSHeader* header = (const struct DNSHeader*)packet;
+    size_t pos = sizeof(struct DNSHeader);
+    int qdcount = ntohs(header->qdcount);
+    int ancount = ntohs(header->ancount);
+    int nscount = ntohs(header->nscount);
+
+    for (int i = 0; i < qdcount; i++) {
+        pos = skipName(packet, length, pos);
+        if (pos == 0 || pos + 4 > length) return 0;
+        pos += 4;
+    }
+    for (int i = 0; i < ancount + nscount; i++) {
+        pos = skipName(packet, length, pos);
+        if (pos == 0 || pos + 10 > length) return 0;
+
+        uint16_t type = readU16(packet + pos);
+        uint16_t rdlength = readU16(packet + pos + 8);
+        size_t rdata = pos + 10;
+        if (rdata + rdlength > length) return 0;
+        // SOA的RDATA以MNAME、RNAME开头，MINIMUM是最后4字节，不需要解析两个名字
+        if (i >= ancount && type == DNS_TYPE_SOA && rdlength >= 22) {
+            uint32_t recordTtl = readU32(packet + pos + 4);
+            uint32_t minimum = readU32(packet + rdata + rdlength - 4);
+            *ttl = recordTtl < minimum ? recordTtl : minimum;
+            return 1;
+        }
+        pos = rdata + rdlength;
+    }
+    return 0;
+}
@@ -1,34 +1,248 @@
-/**
- * @file dns_message.h
- * @brief DNS消息处理相关的头文件
- * @details 定义了DNS消息的解析和构建函数
- */
-
-#ifndef DNS_MESSAGE_H
-#define DNS_MESSAGE_H
-
-#include <stddef.h>
-#include "dns_types.h"
-
-/**
- * @brief 从DNS查询报文中提取域名
- * @param buffer DNS查询报文数据
- * @param length 报文长度
- * @return 提取出的域名
- * @details 解析DNS查询报文，提取出查询的域名
- */
-char* extractDomain(const char* buffer, size_t length);
-
-/**
- * @brief 构建DNS响应报文
- * @param id 查询ID，用于匹配请求和响应
- * @param domain 查询的域名
- * @param ip 解析得到的IP地址
- * @param isError 是否为错误响应
- * @return 构建好的DNS响应报文
- * @details 根据查询ID、域名和IP地址构建DNS响应报文
- */
-char* buildDNSResponse(uint16_t id, const char* domain, 
-                      const char* ip, int isError, size_t* responseLength);
-
+/**
+ * @file dns_message.h
+ * @brief DNS消息处理相关的头文件
+ * @details 定义了DNS消息的解析和构建函数
+ */
+
+#ifndef DNS_MESSAGE_H
+#define DNS_MESSAGE_H
+
+#include <stddef.h>
+#include "dns_types.h"
+#include "dns_addrset.h"
+
+#define DNS_TYPE_A      1
+#define DNS_TYPE_SOA    6
+#define DNS_TYPE_AAAA   28
+#define DNS_TYPE_OPT    41
+#define DNS_TYPE_IXFR   251
+#define DNS_TYPE_AXFR   252
+#define DNS_TYPE_ANY    255
+#define DNS_CLASS_IN    1
+#define DNS_CLASS_ANY   255
+
+#define DNS_RCODE_FORMERR  1
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP   4
+#define DNS_RCODE_REFUSED  5
+
+#define DNS_CLASSIC_UDP_SIZE 512   ///< 不带EDNS时UDP应答的长度上限
+#define DNS_EDNS_UDP_SIZE 1232     ///< 本服务器在OPT中声明的UDP载荷上限（避免IP分片）
+#define DNS_LOCAL_TTL 300          ///< 本地应答的TTL（秒）
+#define DNS_TCP_MAX_MESSAGE 65535  ///< TCP报文的长度上限（2字节长度前缀）
+
+/**
+ * @struct DNSQuestion
+ * @brief 查询报文问题部分的视图
+ * @details 只记录偏移和字段值，不复制域名，引用的报文必须在使用期间保持有效
+ */
+typedef struct {
+    uint16_t id;           ///< 事务ID（主机字节序）
+    uint16_t flags;        ///< 标志字段（主机字节序）
+    size_t nameOffset;     ///< 线格式域名在报文中的偏移
+    size_t nameLength;     ///< 线格式域名长度（含结尾的0字节）
+    size_t questionEnd;    ///< 问题部分结束的偏移（QTYPE和QCLASS之后）
+    uint16_t qtype;        ///< 查询类型
+    uint16_t qclass;       ///< 查询类
+} DNSQuestion;
+
+/**
+ * @struct EdnsInfo
+ * @brief 查询中OPT伪记录（EDNS0）的内容
+ */
+typedef struct {
+    int present;           ///< 是否带OPT
+    uint16_t udpSize;      ///< 客户端可接收的UDP载荷上限，不带OPT时为512
+    uint8_t version;       ///< EDNS版本
+    uint16_t flags;        ///< 扩展标志（DO位等）
+} EdnsInfo;
+
+/**
+ * @brief 解析查询报文的问题部分
+ * @param packet DNS查询报文
+ * @param length 报文长度
+ * @param question 输出问题视图
+ * @return 成功返回1，报文格式错误返回0
+ * @details 要求恰好一个问题且域名不含压缩指针，不分配内存
+ */
+int parseDNSQuery(const char* packet, size_t length, DNSQuestion* question);
+
+/**
+ * @brief 把问题中的域名转换为规范化的点分形式
+ * @param packet DNS查询报文
+ * @param question parseDNSQuery得到的问题视图
+ * @param domain 输出缓冲区（小写、无末尾点号）
+ * @param domainSize 输出缓冲区大小
+ * @return 域名长度，缓冲区不足时返回0；根域名返回0并输出空串
+ */
+size_t questionDomain(const char* packet, const DNSQuestion* question,
+                      char* domain, size_t domainSize);
+
+/**
+ * @brief 查找查询附加部分中的OPT伪记录
+ * @param packet DNS查询报文
+ * @param length 报文长度
+ * @param question parseDNSQuery得到的问题视图
+ * @param edns 输出EDNS信息
+ * @return 成功返回1（没有OPT也算成功），问题之后的记录格式错误或OPT多于一个返回0
+ * @details 问题之后的记录中的域名可以使用压缩指针
+ */
+int parseEdns(const char* packet, size_t length, const DNSQuestion* question, EdnsInfo* edns);
+
+/**
+ * @brief 按本地规则构建应答
+ * @param response 输出缓冲区，可以与query相同以原地构建
+ * @param responseSize 应答长度上限：缓冲区大小与客户端可接收长度（UDP见udpResponseLimit）中的较小者
+ * @param query 查询报文
+ * @param question parseDNSQuery得到的问题视图
+ * @param edns parseEdns得到的EDNS信息
+ * @param addresses 规则的地址
+ * @return 响应长度，缓冲区不足时返回0
+ * @details 复用客户端的头部和问题部分：屏蔽的域名返回NXDOMAIN；A/AAAA/ANY查询返回对应地址族的
+ *          全部记录（用压缩指针引用问题域名），没有该类型的地址时返回NODATA；非IN类返回REFUSED。
+ *          查询带OPT时应答也带OPT，EDNS版本不支持时返回BADVERS。
+ *          记录超出长度上限时只放入能放下的部分并置TC位
+ */
+size_t buildLocalAnswer(char* response, size_t responseSize, const char* query,
+                        const DNSQuestion* question, const EdnsInfo* edns,
+                        const AddressList* addresses);
+
+#define DNS_TEMPLATE_A_SIZE 16     ///< 模板中一条A记录的长度
+#define DNS_TEMPLATE_AAAA_SIZE 28  ///< 模板中一条AAAA记录的长度
+
+/**
+ * @struct AnswerTemplates
+ * @brief 本地规则预先编码好的应答记录
+ * @details 加载规则时为每个地址集合生成一次：集合的A记录之后紧跟AAAA记录，
+ *          名称是指向问题域名（偏移12）的压缩指针，TTL为DNS_LOCAL_TTL，RDATA已是网络字节序。
+ *          屏蔽集合只返回NXDOMAIN，不生成记录
+ */
+typedef struct {
+    uint8_t* records;      ///< 所有集合的记录依次排列
+    uint32_t* offsets;     ///< 每个集合的第一条记录在records中的偏移，集合越界时为ADDRSET_NONE
+    uint32_t count;        ///< 集合数
+    size_t size;           ///< records的字节数
+} AnswerTemplates;
+
+/**
+ * @brief 为集合表中的每个集合生成应答记录
+ * @param templates 输出模板
+ * @param sets 集合数组
+ * @param count 集合数
+ * @param pool 地址池
+ * @param poolSize 地址池字节数（集合可能来自映射的镜像文件，生成前检查边界）
+ * @return 成功返回1，内存不足返回0
+ */
+int buildAnswerTemplates(AnswerTemplates* templates, const AddressSet* sets, uint32_t count,
+                         const uint8_t* pool, size_t poolSize);
+
+/**
+ * @brief 释放应答模板
+ */
+void freeAnswerTemplates(AnswerTemplates* templates);
+
+/**
+ * @brief 用预先编码的记录按本地规则构建应答
+ * @param response 输出缓冲区，可以与query相同以原地构建
+ * @param responseSize 应答长度上限，含义同buildLocalAnswer
+ * @param query 查询报文
+ * @param question parseDNSQuery得到的问题视图
+ * @param edns parseEdns得到的EDNS信息
+ * @param templates buildAnswerTemplates生成的模板
+ * @param set 规则的集合（sets[index]）
+ * @param index 集合编号，调用方保证模板中该集合有效
+ * @return 响应长度，缓冲区不足时返回0
+ * @details 应答与buildLocalAnswer逐字节相同：复制客户端的头部和问题部分后，
+ *          整段追加所需地址族的记录。每条记录长度固定，截断时按记录数计算能放下的部分
+ */
+size_t buildTemplateAnswer(char* response, size_t responseSize, const char* query,
+                           const DNSQuestion* question, const EdnsInfo* edns,
+                           const AnswerTemplates* templates, const AddressSet* set, uint32_t index);
+
+/**
+ * @brief UDP客户端可接收的应答长度
+ * @return 带OPT时为客户端声明的载荷上限（不小于512），否则为512
+ */
+size_t udpResponseLimit(const EdnsInfo* edns);
+
+/**
+ * @brief 把超出长度上限的应答截断为只含问题部分并置TC位
+ * @param response 完整应答
+ * @param length 应答长度
+ * @param limit 长度上限
+ * @param out 输出缓冲区，可以与response相同以原地截断
+ * @param outSize 输出缓冲区大小
+ * @return 截断后的长度；未超出上限时原样复制并返回length；应答格式错误或放不下问题部分时返回0
+ * @details 清空回答、授权和附加部分，只保留OPT伪记录（放得下时），
+ *          客户端看到TC位后应改用TCP重新查询
+ */
+size_t truncateResponse(const char* response, size_t length, size_t limit,
+                        char* out, size_t outSize);
+
+/**
+ * @brief 根据查询报文构建错误响应
+ * @param query 查询报文
+ * @param length 查询长度
+ * @param rcode 响应码（如2表示SERVFAIL）
+ * @param response 输出缓冲区
+ * @param responseSize 输出缓冲区大小
+ * @return 响应长度，查询格式错误时返回0
+ * @details 保留原查询的头部和问题部分，不携带应答记录；查询带OPT时附加一条OPT，
+ *          声明本服务器的载荷上限（OPT格式错误时不附加）
+ */
+size_t buildErrorResponse(const char* query, size_t length, int rcode,
+                          char* response, size_t responseSize);
+
+/**
+ * @brief 构建限速时的TC应答
+ * @param query 查询报文
+ * @param length 查询长度
+ * @param response 输出缓冲区
+ * @param responseSize 输出缓冲区大小
+ * @return 响应长度；报文不是格式正确的查询时返回0（直接丢弃）
+ * @details 只有头部和问题部分并置TC位，客户端应改用TCP重新查询（RRL的slip应答）
+ */
+size_t buildSlipResponse(const char* query, size_t length, char* response, size_t responseSize);
+
+#define DNS_KEY_FLAG_RD   0x01   ///< 问题键标志：期望递归
+#define DNS_KEY_FLAG_CD   0x10   ///< 问题键标志：禁用DNSSEC校验
+#define DNS_KEY_FLAG_DO   0x40   ///< 问题键标志：OPT中置了DO位
+#define DNS_KEY_FLAG_EDNS 0x80   ///< 问题键标志：带OPT伪记录
+
+/**
+ * @brief 提取问题部分和影响应答内容的标志作为缓存键和合并查询的键
+ * @param packet DNS报文
+ * @param length 报文长度
+ * @param key 输出缓冲区：小写的线格式域名 + QTYPE + QCLASS + 标志字节（DNS_KEY_FLAG_*的组合）
+ * @param keySize 输出缓冲区大小
+ * @param questionLength 输出问题部分（域名+类型+类）的长度，可为NULL
+ * @return 键长度，报文格式错误时返回0
+ * @details 带不带OPT、DO位是否置位的查询得到的应答不同（OPT记录、DNSSEC记录），键各不相同
+ */
+size_t extractQuestionKey(const char* packet, size_t length,
+                          uint8_t* key, size_t keySize, size_t* questionLength);
+
+/**
+ * @brief 收集报文中所有资源记录TTL字段的偏移
+ * @param packet DNS报文
+ * @param length 报文长度
+ * @param offsets 输出TTL字段相对报文起始的偏移
+ * @param maxOffsets offsets数组容量
+ * @param minTtl 输出所有记录中最小的TTL
+ * @return 记录数，报文格式错误或记录过多时返回-1
+ * @details OPT伪记录的TTL字段表示扩展标志，不计入
+ */
+int collectTtlOffsets(const char* packet, size_t length, uint16_t* offsets,
+                      int maxOffsets, uint32_t* minTtl);
+
+/**
+ * @brief 按RFC 2308取否定应答（NXDOMAIN或NODATA）的缓存时间
+ * @param packet DNS报文
+ * @param length 报文长度
+ * @param ttl 输出授权部分SOA记录的TTL与其MINIMUM字段中的较小值
+ * @return 授权部分有SOA记录时返回1，否则返回0（此时不应缓存该否定应答）
+ */
+int findNegativeTtl(const char* packet, size_t length, uint32_t* ttl);
+
 #endif // DNS_MESSAGE_H 
\ No newline at end of file
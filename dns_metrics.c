@@ -0,0 +1,225 @@
+#include "dns_metrics.h"
+#include "dns_platform.h"
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 每个线程一份，只有所属线程写入，读取方用relaxed原子读取
+typedef struct {
+    atomic_uint_fast64_t counts[METRIC_HIST_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sumNs;
+} ShardHistogram;
+
+// 按缓存行对齐，不同线程的分片不会落在同一缓存行上
+typedef struct MetricsShard {
+    _Alignas(DNS_CACHE_LINE) atomic_uint_fast64_t counters[METRIC_COUNTER_COUNT];
+    ShardHistogram paths[METRIC_PATH_COUNT];
+    struct MetricsShard* next;
+} MetricsShard;
+
+static MetricsShard* _Atomic shards;
+static atomic_flag registryLock = ATOMIC_FLAG_INIT;  // 仅在注册新线程时使用
+static _Thread_local MetricsShard* localShard;
+
+static const char* const counterNames[METRIC_COUNTER_COUNT][2] = {
+    { "dns_queries_total", "收到的查询" },
+    { "dns_malformed_total", "无法解析的报文" },
+    { "dns_cache_hits_total", "缓存命中" },
+    { "dns_cache_misses_total", "缓存未命中" },
+    { "dns_cache_refreshes_total", "为过期或临近过期的缓存条目发起的后台刷新" },
+    { "dns_forwarded_total", "转发到上游的查询" },
+    { "dns_forward_rejected_total", "在途查询已满而拒绝的转发" },
+    { "dns_coalesced_total", "合并到相同在途查询而节省的上游查询" },
+    { "dns_upstream_retries_total", "上游超时后的重试" },
+    { "dns_upstream_timeouts_total", "重试用尽后放弃的上游查询" },
+    { "dns_upstream_hedges_total", "首选上游未及时应答而发出的对冲查询" },
+    { "dns_upstream_evictions_total", "上游连续失败而被暂时剔除的次数" },
+    { "dns_upstream_tcp_total", "上游应答被截断而改用TCP重新查询" },
+    { "dns_truncated_total", "超出客户端UDP上限而截断的应答" },
+    { "dns_tcp_accepted_total", "接受的TCP连接" },
+    { "dns_tcp_rejected_total", "连接数已满而拒绝的TCP连接" },
+    { "dns_send_errors_total", "发送失败而丢弃的应答" },
+    { "dns_rate_limited_total", "超出客户端限速而丢弃的查询" },
+    { "dns_rate_slipped_total", "超出客户端限速而以TC应答的查询" },
+    { "dns_reloads_total", "成功重新加载域名文件的次数" },
+    { "dns_reload_failures_total", "重新加载域名文件失败的次数" },
+};
+
+static const char* const pathNames[METRIC_PATH_COUNT] = {
+    "blocked", "local", "cached", "relayed", "failed"
+};
+
+// 导出的Prometheus分桶上界（纳秒）
+static const uint64_t exportBounds[] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+    1000000, 2000000, 5000000, 10000000, 20000000, 50000000,
+    100000000, 200000000, 500000000, 1000000000, 2000000000, 5000000000ULL
+};
+
+static MetricsShard* currentShard(void) {
+    if (localShard) return localShard;
+
+    MetricsShard* shard = (MetricsShard*)dnsAlignedAlloc(sizeof(MetricsShard));
+    if (!shard) return NULL;
+
+    while (atomic_flag_test_and_set_explicit(&registryLock, memory_order_acquire)) {
+    }
+    shard->next = atomic_load(&shards);
+    atomic_store(&shards, shard);
+    atomic_flag_clear_explicit(&registryLock, memory_order_release);
+
+    localShard = shard;
+    return shard;
+}
+
+// 单写者累加，不需要带锁前缀的读-改-写指令
+static void bump(atomic_uint_fast64_t* value, uint64_t delta) {
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+}
+
+static int bucketIndex(uint64_t value) {
+    const int sub = 1 << METRIC_HIST_SUB_BITS;
+    if (value < (uint64_t)(2 * sub)) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - METRIC_HIST_SUB_BITS;
+    return (shift + 1) * sub + (int)((value >> shift) & (uint64_t)(sub - 1));
+}
+
+// 分桶的下界（纳秒）
+static uint64_t bucketLower(int index) {
+    const int sub = 1 << METRIC_HIST_SUB_BITS;
+    if (index < 2 * sub) return (uint64_t)index;
+    int shift = index / sub - 1;
+    return ((uint64_t)sub + (uint64_t)(index % sub)) << shift;
+}
+
+void metricsIncrement(MetricCounter counter) {
+    metricsAdd(counter, 1);
+}
+
+void metricsAdd(MetricCounter counter, uint64_t delta) {
+    MetricsShard* shard = currentShard();
+    if (shard) bump(&shard->counters[counter], delta);
+}
+
+void metricsRecordLatency(MetricPath path, uint64_t elapsedNs) {
+    MetricsShard* shard = currentShard();
+    if (!shard) return;
+    ShardHistogram* histogram = &shard->paths[path];
+    bump(&histogram->counts[bucketIndex(elapsedNs)], 1);
+    bump(&histogram->count, 1);
+    bump(&histogram->sumNs, elapsedNs);
+}
+
+void metricsCollect(MetricsSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    for (MetricsShard* shard = atomic_load(&shards); shard; shard = shard->next) {
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+            snapshot->counters[c] += atomic_load_explicit(&shard->counters[c], memory_order_relaxed);
+        }
+        for (int p = 0; p < METRIC_PATH_COUNT; p++) {
+            const ShardHistogram* src = &shard->paths[p];
+            MetricsHistogram* dst = &snapshot->paths[p];
+            for (int i = 0; i < METRIC_HIST_BUCKETS; i++) {
+                dst->counts[i] += atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+            }
+            dst->count += atomic_load_explicit(&src->count, memory_order_relaxed);
+            dst->sumNs += atomic_load_explicit(&src->sumNs, memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t metricsQuantile(const MetricsHistogram* histogram, double quantile) {
+    uint64_t total = 0;
+    for (int i = 0; i < METRIC_HIST_BUCKETS; i++) total += histogram->counts[i];
+    if (total == 0) return 0;
+
+    uint64_t target = (uint64_t)(quantile * (double)total + 0.5);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRIC_HIST_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= target) return bucketLower(i);
+    }
+    return bucketLower(METRIC_HIST_BUCKETS - 1);
+}
+
+static void appendf(char* buffer, size_t size, size_t* pos, const char* format, ...) {
+    if (*pos >= size) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + *pos, size - *pos, format, args);
+    va_end(args);
+    if (n < 0) return;
+    *pos += (size_t)n < size - *pos ? (size_t)n : size - *pos - 1;
+}
+
+size_t metricsFormatPrometheus(const MetricsSnapshot* snapshot, char* buffer, size_t size) {
+    size_t pos = 0;
+    if (size == 0) return 0;
+    buffer[0] = '\0';
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        metricsAppendValue(buffer, size, &pos, counterNames[c][0], "counter",
+                           counterNames[c][1], snapshot->counters[c]);
+    }
+
+    // 直方图：HDR分桶累加到固定的导出上界，分桶上界不超过导出上界的才计入
+    appendf(buffer, size, &pos,
+            "# HELP dns_query_duration_seconds 各处理路径从收到查询到发出应答的耗时\n"
+            "# TYPE dns_query_duration_seconds histogram\n");
+    const size_t boundCount = sizeof(exportBounds) / sizeof(exportBounds[0]);
+    for (int p = 0; p < METRIC_PATH_COUNT; p++) {
+        const MetricsHistogram* histogram = &snapshot->paths[p];
+        uint64_t cumulative = 0;
+        int bucket = 0;
+        for (size_t b = 0; b < boundCount; b++) {
+            while (bucket < METRIC_HIST_BUCKETS - 1 && bucketLower(bucket + 1) - 1 <= exportBounds[b]) {
+                cumulative += histogram->counts[bucket++];
+            }
+            appendf(buffer, size, &pos, "dns_query_duration_seconds_bucket{path=\"%s\",le=\"%g\"} %llu\n",
+                    pathNames[p], (double)exportBounds[b] / 1e9, (unsigned long long)cumulative);
+        }
+        appendf(buffer, size, &pos,
+                "dns_query_duration_seconds_bucket{path=\"%s\",le=\"+Inf\"} %llu\n"
+                "dns_query_duration_seconds_sum{path=\"%s\"} %.9f\n"
+                "dns_query_duration_seconds_count{path=\"%s\"} %llu\n",
+                pathNames[p], (unsigned long long)histogram->count,
+                pathNames[p], (double)histogram->sumNs / 1e9,
+                pathNames[p], (unsigned long long)histogram->count);
+    }
+
+    // 尾延迟分位数，直接由高精度分桶计算，便于告警
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    appendf(buffer, size, &pos,
+            "# HELP dns_query_latency_seconds 各处理路径的耗时分位数（自启动以来）\n"
+            "# TYPE dns_query_latency_seconds gauge\n");
+    for (int p = 0; p < METRIC_PATH_COUNT; p++) {
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            appendf(buffer, size, &pos, "dns_query_latency_seconds{path=\"%s\",quantile=\"%g\"} %.9f\n",
+                    pathNames[p], quantiles[q],
+                    (double)metricsQuantile(&snapshot->paths[p], quantiles[q]) / 1e9);
+        }
+    }
+    return pos;
+}
+
+void metricsAppendValue(char* buffer, size_t size, size_t* pos, const char* name,
+                        const char* type, const char* help, uint64_t value) {
+    appendf(buffer, size, pos, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+            name, help, name, type, name, (unsigned long long)value);
+}
+
+void metricsAppendFamily(char* buffer, size_t size, size_t* pos, const char* name,
+                         const char* type, const char* help) {
+    appendf(buffer, size, pos, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metricsAppendSample(char* buffer, size_t size, size_t* pos, const char* name,
+                         const char* labels, double value) {
+    appendf(buffer, size, pos, "%s{%s} %.9g\n", name, labels, value);
+}
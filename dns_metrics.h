@@ -0,0 +1,143 @@
+/**
+ * @file dns_metrics.h
+ * @brief 运行时指标的头文件定义
+ * @details 每个线程在首次记录时分配自己的计数器和延迟直方图，只由本线程写入，
+ *          热路径上没有锁也没有共享缓存行的竞争；读取时把所有线程的数据相加。
+ *          直方图采用HDR风格的对数线性分桶（每个2的幂区间再分16档），导出为Prometheus文本格式
+ */
+
+#ifndef DNS_METRICS_H
+#define DNS_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 计数器
+ */
+typedef enum {
+    METRIC_QUERIES = 0,        ///< 收到的查询
+    METRIC_MALFORMED,          ///< 无法解析的报文（含过短报文）
+    METRIC_CACHE_HITS,         ///< 缓存命中
+    METRIC_CACHE_MISSES,       ///< 缓存未命中
+    METRIC_CACHE_REFRESHES,    ///< 为过期或临近过期的缓存条目发起的后台刷新
+    METRIC_FORWARDED,          ///< 转发到上游
+    METRIC_FORWARD_REJECTED,   ///< 在途查询已满，直接返回SERVFAIL
+    METRIC_COALESCED,          ///< 合并到相同的在途查询上，节省的上游查询
+    METRIC_UPSTREAM_RETRIES,   ///< 上游超时后重试
+    METRIC_UPSTREAM_TIMEOUTS,  ///< 重试用尽后放弃
+    METRIC_UPSTREAM_HEDGES,    ///< 首选上游未及时应答而同时发往次优上游
+    METRIC_UPSTREAM_EVICTIONS, ///< 上游连续失败而被暂时剔除
+    METRIC_UPSTREAM_TCP,       ///< 上游应答被截断而改用TCP重新查询
+    METRIC_TRUNCATED,          ///< 超出客户端UDP上限而截断的应答
+    METRIC_TCP_ACCEPTED,       ///< 接受的TCP连接
+    METRIC_TCP_REJECTED,       ///< 连接数已满而拒绝的TCP连接
+    METRIC_SEND_ERRORS,        ///< 发送应答失败（应答被丢弃）
+    METRIC_RATE_LIMITED,       ///< 超出客户端限速而丢弃的查询
+    METRIC_RATE_SLIPPED,       ///< 超出客户端限速而以TC应答的查询
+    METRIC_RELOADS,            ///< 成功重新加载域名文件
+    METRIC_RELOAD_FAILURES,    ///< 重新加载失败
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+/**
+ * @brief 查询处理路径，每条路径一个延迟直方图
+ */
+typedef enum {
+    PATH_BLOCKED = 0,   ///< 命中屏蔽规则
+    PATH_LOCAL,         ///< 本地规则应答
+    PATH_CACHED,        ///< 缓存应答
+    PATH_RELAYED,       ///< 上游中继应答（从收到查询到发出应答）
+    PATH_FAILED,        ///< 格式错误或SERVFAIL
+    METRIC_PATH_COUNT
+} MetricPath;
+
+#define METRIC_HIST_SUB_BITS 4
+#define METRIC_HIST_BUCKETS (64 << METRIC_HIST_SUB_BITS)
+
+/**
+ * @struct MetricsHistogram
+ * @brief 延迟直方图（纳秒）
+ */
+typedef struct {
+    uint64_t counts[METRIC_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sumNs;
+} MetricsHistogram;
+
+/**
+ * @struct MetricsSnapshot
+ * @brief 所有线程汇总后的指标
+ */
+typedef struct {
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    MetricsHistogram paths[METRIC_PATH_COUNT];
+} MetricsSnapshot;
+
+/**
+ * @brief 计数器加一
+ */
+void metricsIncrement(MetricCounter counter);
+
+/**
+ * @brief 计数器加上指定值
+ */
+void metricsAdd(MetricCounter counter, uint64_t delta);
+
+/**
+ * @brief 记录一次查询处理的耗时
+ * @param path 处理路径
+ * @param elapsedNs 耗时（纳秒）
+ */
+void metricsRecordLatency(MetricPath path, uint64_t elapsedNs);
+
+/**
+ * @brief 汇总所有线程的指标
+ * @details 与写入并发进行，各计数器单独看是准确的，彼此之间不保证是同一时刻的值
+ */
+void metricsCollect(MetricsSnapshot* snapshot);
+
+/**
+ * @brief 从直方图估算分位数
+ * @param histogram 直方图
+ * @param quantile 分位数（0~1）
+ * @return 对应的耗时（纳秒），直方图为空时返回0
+ */
+uint64_t metricsQuantile(const MetricsHistogram* histogram, double quantile);
+
+/**
+ * @brief 以Prometheus文本格式输出汇总的指标
+ * @param snapshot 汇总结果
+ * @param buffer 输出缓冲区
+ * @param size 缓冲区大小
+ * @return 写入的长度（不含'\0'），缓冲区不足时截断
+ */
+size_t metricsFormatPrometheus(const MetricsSnapshot* snapshot, char* buffer, size_t size);
+
+/**
+ * @brief 追加一个Prometheus样本（含HELP和TYPE行），用于输出其他模块的统计
+ * @param buffer 输出缓冲区
+ * @param size 缓冲区大小
+ * @param pos 当前写入位置，返回时更新
+ * @param name 指标名
+ * @param type counter或gauge
+ * @param help 说明
+ * @param value 数值
+ */
+void metricsAppendValue(char* buffer, size_t size, size_t* pos, const char* name,
+                        const char* type, const char* help, uint64_t value);
+
+/**
+ * @brief 追加一个指标族的HELP和TYPE行，之后用metricsAppendSample追加带标签的样本
+ */
+void metricsAppendFamily(char* buffer, size_t size, size_t* pos, const char* name,
+                         const char* type, const char* help);
+
+/**
+ * @brief 追加一个带标签的样本
+ * @param labels 标签，如upstream="8.8.8.8:53"（不含花括号）
+ */
+void metricsAppendSample(char* buffer, size_t size, size_t* pos, const char* name,
+                         const char* labels, double value);
+
+#endif // DNS_METRICS_H
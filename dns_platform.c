@@ -0,0 +1,314 @@
+#include "dns_platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+int dnsParseAddress(const char* text, int defaultPort, struct sockaddr_in* addr) {
+    char host[64];
+    int port = defaultPort;
+
+    const char* colon = strchr(text, ':');
+    size_t hostLen = colon ? (size_t)(colon - text) : strlen(text);
+    if (hostLen == 0 || hostLen >= sizeof(host)) return 0;
+    memcpy(host, text, hostLen);
+    host[hostLen] = '\0';
+
+    if (colon) {
+        port = atoi(colon + 1);
+    }
+    if (port <= 0 || port > 65535) return 0;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    addr->sin_addr.s_addr = inet_addr(host);
+    return addr->sin_addr.s_addr != INADDR_NONE;
+}
+
+#ifdef _WIN32
+
+#include <process.h>
+
+int dnsNetInit(void) {
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+}
+
+void dnsNetCleanup(void) {
+    WSACleanup();
+}
+
+void dnsMutexInit(DNSMutex* mutex) { InitializeCriticalSection(mutex); }
+void dnsMutexDestroy(DNSMutex* mutex) { DeleteCriticalSection(mutex); }
+void dnsMutexLock(DNSMutex* mutex) { EnterCriticalSection(mutex); }
+void dnsMutexUnlock(DNSMutex* mutex) { LeaveCriticalSection(mutex); }
+
+// _beginthreadex要求__stdcall入口，这里做一次转接
+typedef struct {
+    DNSThreadFunc func;
+    void* arg;
+} ThreadStart;
+
+static unsigned __stdcall threadTrampoline(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+
+int dnsThreadCreate(DNSThread* thread, DNSThreadFunc func, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+    start->func = func;
+    start->arg = arg;
+
+    *thread = (HANDLE)_beginthreadex(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void dnsThreadJoin(DNSThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+unsigned long dnsThreadId(void) {
+    return (unsigned long)GetCurrentThreadId();
+}
+
+int dnsCpuCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+int dnsPinThread(int cpu) {
+    int count = dnsCpuCount();
+    if (cpu < 0 || count > (int)(sizeof(DWORD_PTR) * 8)) return 0;
+    cpu %= count;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+}
+
+void* dnsAlignedAlloc(size_t size) {
+    void* p = _aligned_malloc(size ? size : 1, DNS_CACHE_LINE);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+void dnsAlignedFree(void* p) {
+    _aligned_free(p);
+}
+
+int dnsSetNonBlocking(SOCKET sock) {
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+}
+
+uint64_t dnsNowNs(void) {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+}
+
+uint64_t dnsWallTimeMs(void) {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (t - 116444736000000000ULL) / 10000;  // FILETIME从1601年起，以100纳秒为单位
+}
+
+void dnsSleepMs(int ms) {
+    Sleep((DWORD)ms);
+}
+
+const void* dnsMapFile(const char* path, size_t* size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+
+    // 映射视图会保持对文件映射对象的引用，可以立即关闭句柄
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) return NULL;
+    *size = (size_t)fileSize.QuadPart;
+    return data;
+}
+
+void dnsUnmapFile(const void* data, size_t size) {
+    (void)size;
+    if (data) UnmapViewOfFile(data);
+}
+
+void* dnsCreateMappedFile(const char* path, size_t size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    uint64_t size64 = (uint64_t)size;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(size64 >> 32),
+                                        (DWORD)size64, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    void* data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    CloseHandle(mapping);
+    return data;
+}
+
+#else
+
+#include <fcntl.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int dnsNetInit(void) {
+    return 1;
+}
+
+void dnsNetCleanup(void) {
+}
+
+void dnsMutexInit(DNSMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void dnsMutexDestroy(DNSMutex* mutex) { pthread_mutex_destroy(mutex); }
+void dnsMutexLock(DNSMutex* mutex) { pthread_mutex_lock(mutex); }
+void dnsMutexUnlock(DNSMutex* mutex) { pthread_mutex_unlock(mutex); }
+
+typedef struct {
+    DNSThreadFunc func;
+    void* arg;
+} ThreadStart;
+
+static void* threadTrampoline(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return NULL;
+}
+
+int dnsThreadCreate(DNSThread* thread, DNSThreadFunc func, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+    start->func = func;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, threadTrampoline, start) != 0) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void dnsThreadJoin(DNSThread thread) {
+    pthread_join(thread, NULL);
+}
+
+unsigned long dnsThreadId(void) {
+#ifdef __linux__
+    return (unsigned long)syscall(SYS_gettid);
+#else
+    return (unsigned long)(uintptr_t)pthread_self();
+#endif
+}
+
+int dnsCpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int dnsPinThread(int cpu) {
+    if (cpu < 0) return 0;
+#ifdef __linux__
+    cpu %= dnsCpuCount();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return 0;
+#endif
+}
+
+void* dnsAlignedAlloc(size_t size) {
+    void* p = NULL;
+    if (posix_memalign(&p, DNS_CACHE_LINE, size ? size : 1) != 0) return NULL;
+    memset(p, 0, size);
+    return p;
+}
+
+void dnsAlignedFree(void* p) {
+    free(p);
+}
+
+int dnsSetNonBlocking(SOCKET sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0) return 0;
+    return fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+uint64_t dnsNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t dnsWallTimeMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+void dnsSleepMs(int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+const void* dnsMapFile(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return data;
+}
+
+void dnsUnmapFile(const void* data, size_t size) {
+    if (data) munmap((void*)data, size);
+}
+
+void* dnsCreateMappedFile(const char* path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return NULL;
+    if (size == 0 || ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+#endif
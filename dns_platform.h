@@ -0,0 +1,192 @@
+/**
+ * @file dns_platform.h
+ * @brief 平台抽象层
+ * @details 屏蔽Windows与POSIX(Linux)在套接字、线程、互斥锁和计时上的差异，
+ *          其余模块只包含本头文件，不直接包含平台相关头文件
+ */
+
+#ifndef DNS_PLATFORM_H
+#define DNS_PLATFORM_H
+
+// recvmmsg/sendmmsg等接口需要GNU扩展，必须在任何系统头文件之前定义
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+typedef CRITICAL_SECTION DNSMutex;   ///< 互斥锁
+typedef HANDLE DNSThread;            ///< 线程句柄
+
+#define dnsSocketError() WSAGetLastError()
+#define DNS_EWOULDBLOCK WSAEWOULDBLOCK
+#define DNS_EINPROGRESS WSAEWOULDBLOCK   ///< 非阻塞connect尚未完成
+#define DNS_MSG_NOSIGNAL 0
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#define _strdup strdup
+
+typedef pthread_mutex_t DNSMutex;    ///< 互斥锁
+typedef pthread_t DNSThread;         ///< 线程句柄
+
+#define dnsSocketError() errno
+#define DNS_EWOULDBLOCK EWOULDBLOCK
+#define DNS_EINPROGRESS EINPROGRESS      ///< 非阻塞connect尚未完成
+#ifdef MSG_NOSIGNAL
+#define DNS_MSG_NOSIGNAL MSG_NOSIGNAL    ///< 对端已关闭时send返回错误而不是触发SIGPIPE
+#else
+#define DNS_MSG_NOSIGNAL 0
+#endif
+
+#endif
+
+#ifdef __linux__
+#define DNS_HAVE_MMSG 1       ///< 支持recvmmsg/sendmmsg批量收发
+#define DNS_HAVE_REUSEPORT 1  ///< 支持SO_REUSEPORT在多个套接字间分流
+#define DNS_HAVE_EPOLL 1      ///< 支持epoll
+#endif
+
+#define DNS_CACHE_LINE 64     ///< 缓存行大小，各线程分别写入的数据按此对齐，避免伪共享
+
+/**
+ * @brief 线程入口函数
+ */
+typedef void (*DNSThreadFunc)(void* arg);
+
+/**
+ * @brief 初始化网络库
+ * @return 成功返回1，失败返回0
+ * @details Windows下调用WSAStartup，其他平台为空操作
+ */
+int dnsNetInit(void);
+
+/**
+ * @brief 清理网络库
+ */
+void dnsNetCleanup(void);
+
+void dnsMutexInit(DNSMutex* mutex);
+void dnsMutexDestroy(DNSMutex* mutex);
+void dnsMutexLock(DNSMutex* mutex);
+void dnsMutexUnlock(DNSMutex* mutex);
+
+/**
+ * @brief 创建线程
+ * @param thread 输出线程句柄
+ * @param func 线程入口函数
+ * @param arg 传给入口函数的参数
+ * @return 成功返回1，失败返回0
+ */
+int dnsThreadCreate(DNSThread* thread, DNSThreadFunc func, void* arg);
+
+/**
+ * @brief 等待线程结束并释放句柄
+ * @param thread 线程句柄
+ */
+void dnsThreadJoin(DNSThread thread);
+
+/**
+ * @brief 获取当前线程ID（用于日志）
+ */
+unsigned long dnsThreadId(void);
+
+/**
+ * @brief 获取CPU核数
+ */
+int dnsCpuCount(void);
+
+/**
+ * @brief 把当前线程绑定到指定的CPU
+ * @param cpu CPU编号（0起），超出CPU数时取模
+ * @return 成功返回1，不支持或失败返回0
+ */
+int dnsPinThread(int cpu);
+
+/**
+ * @brief 按缓存行对齐分配内存并清零
+ * @param size 字节数
+ * @return 内存地址，失败返回NULL；必须用dnsAlignedFree释放
+ */
+void* dnsAlignedAlloc(size_t size);
+
+/**
+ * @brief 释放dnsAlignedAlloc分配的内存
+ */
+void dnsAlignedFree(void* p);
+
+/**
+ * @brief 将套接字设置为非阻塞模式
+ * @return 成功返回1，失败返回0
+ */
+int dnsSetNonBlocking(SOCKET sock);
+
+/**
+ * @brief 解析"IPv4地址[:端口]"形式的地址
+ * @param text 地址文本
+ * @param defaultPort 未指定端口时使用的端口
+ * @param addr 输出地址
+ * @return 成功返回1，失败返回0
+ */
+int dnsParseAddress(const char* text, int defaultPort, struct sockaddr_in* addr);
+
+/**
+ * @brief 获取单调时钟（纳秒）
+ */
+uint64_t dnsNowNs(void);
+
+/**
+ * @brief 获取墙上时钟（自1970年起的毫秒数）
+ */
+uint64_t dnsWallTimeMs(void);
+
+/**
+ * @brief 休眠指定的毫秒数
+ */
+void dnsSleepMs(int ms);
+
+/**
+ * @brief 以只读方式把整个文件映射到内存
+ * @param path 文件路径
+ * @param size 输出文件大小
+ * @return 映射地址，失败或文件为空时返回NULL
+ * @details 映射为共享只读页，多个进程映射同一文件时共用页缓存
+ */
+const void* dnsMapFile(const char* path, size_t* size);
+
+/**
+ * @brief 解除dnsMapFile或dnsCreateMappedFile建立的映射
+ */
+void dnsUnmapFile(const void* data, size_t size);
+
+/**
+ * @brief 创建（已存在时截断）指定大小的文件并以可读写的共享方式映射
+ * @param path 文件路径
+ * @param size 文件大小，内容初始为0
+ * @return 映射地址，失败返回NULL
+ * @details 写入映射的数据由操作系统写回文件，进程异常退出也不会丢失
+ */
+void* dnsCreateMappedFile(const char* path, size_t size);
+
+#endif // DNS_PLATFORM_H
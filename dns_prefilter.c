@@ -0,0 +1,71 @@
+#include "dns_prefilter.h"
+#include "dns_index.h"
+#include "dns_platform.h"
+#include <string.h>
+
+#define BLOCK_WORDS 8
+
+// 块内每个字各取一位的乘数（与Parquet的分块布隆过滤器相同）
+static const uint32_t salts[BLOCK_WORDS] = {
+    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+    0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+int prefilterInit(Prefilter* filter, size_t keys, uint32_t bitsPerKey) {
+    memset(filter, 0, sizeof(*filter));
+    size_t bits = keys * bitsPerKey;
+    size_t blocks = (bits + BLOCK_WORDS * 32 - 1) / (BLOCK_WORDS * 32);
+    if (blocks == 0) blocks = 1;
+    if (blocks > UINT32_MAX) return 0;
+    filter->blocks = (uint32_t*)dnsAlignedAlloc(blocks * BLOCK_WORDS * sizeof(uint32_t));
+    if (!filter->blocks) return 0;
+    filter->blockCount = (uint32_t)blocks;
+    return 1;
+}
+
+void prefilterFree(Prefilter* filter) {
+    dnsAlignedFree(filter->blocks);
+    memset(filter, 0, sizeof(*filter));
+}
+
+// 32位哈希扩展成64位：高32位选块，低32位决定块内各字的位
+static inline uint32_t* blockFor(const Prefilter* filter, uint32_t hash, uint32_t* key) {
+    uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    *key = (uint32_t)mixed;
+    uint32_t index = (uint32_t)(((mixed >> 32) * filter->blockCount) >> 32);
+    return filter->blocks + (size_t)index * BLOCK_WORDS;
+}
+
+void prefilterAdd(Prefilter* filter, uint32_t hash) {
+    uint32_t key;
+    uint32_t* block = blockFor(filter, hash, &key);
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        block[i] |= 1u << ((key * salts[i]) >> 27);
+    }
+}
+
+int prefilterContains(const Prefilter* filter, uint32_t hash) {
+    uint32_t key;
+    const uint32_t* block = blockFor(filter, hash, &key);
+    uint32_t missing = 0;
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        missing |= ~block[i] & (1u << ((key * salts[i]) >> 27));
+    }
+    return missing == 0;
+}
+
+int prefilterMayMatch(const Prefilter* filter, const char* name, size_t length, uint32_t hash) {
+    if (!filter->blocks || prefilterContains(filter, hash)) return 1;
+    if (!filter->suffixes) return 0;
+
+    // 父域名可能是通配或后缀规则的基础域名
+    const char* end = name + length;
+    const char* dot = (const char*)memchr(name, '.', length);
+    while (dot) {
+        const char* parent = dot + 1;
+        size_t parentLength = (size_t)(end - parent);
+        if (prefilterContains(filter, hashDomain(parent, parentLength))) return 1;
+        dot = (const char*)memchr(parent, '.', parentLength);
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file dns_prefilter.h
+ * @brief 本地规则的概率预过滤器
+ * @details 分块布隆过滤器（split block Bloom filter）：每个键只落在一个32字节的块里，
+ *          块内8个32位字各置一位，查询只访问一个缓存行。
+ *          加载规则时把所有精确规则的域名和通配/后缀规则的基础域名（"*.example.com"和
+ *          ".example.com"都记为"example.com"）加入过滤器。查询时依次检查域名本身和它的
+ *          各级父域名，全部否定即可确定没有任何规则匹配，不必再访问索引和后缀树。
+ *          键是hashDomain的结果，与索引共用同一个哈希
+ */
+
+#ifndef DNS_PREFILTER_H
+#define DNS_PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PREFILTER_DEFAULT_BITS 10      ///< 默认每个键占用的位数（误判率约1%）
+#define PREFILTER_MIN_RULES 65536      ///< 规则数少于此值时索引本身就在缓存中，不建过滤器
+
+/**
+ * @struct Prefilter
+ * @brief 分块布隆过滤器，blocks为NULL时表示未建立（所有查询都视为可能命中）
+ */
+typedef struct {
+    uint32_t* blocks;      ///< blockCount个块，每块8个32位字，按缓存行对齐
+    uint32_t blockCount;
+    int suffixes;          ///< 是否含通配/后缀规则；没有时只需检查域名本身
+} Prefilter;
+
+/**
+ * @brief 按键数分配过滤器
+ * @param filter 过滤器
+ * @param keys 预计加入的键数
+ * @param bitsPerKey 每个键占用的位数
+ * @return 成功返回1，内存不足返回0
+ */
+int prefilterInit(Prefilter* filter, size_t keys, uint32_t bitsPerKey);
+
+/**
+ * @brief 释放过滤器
+ */
+void prefilterFree(Prefilter* filter);
+
+/**
+ * @brief 加入一个键
+ * @param filter 过滤器
+ * @param hash hashDomain(域名, 长度)
+ */
+void prefilterAdd(Prefilter* filter, uint32_t hash);
+
+/**
+ * @brief 检查一个键
+ * @return 可能存在返回1，一定不存在返回0
+ */
+int prefilterContains(const Prefilter* filter, uint32_t hash);
+
+/**
+ * @brief 判断规范化域名是否可能匹配某条规则
+ * @param filter 过滤器
+ * @param name 规范化后的域名
+ * @param length 域名长度
+ * @param hash hashDomain(name, length)
+ * @return 可能匹配返回1；返回0时确定没有精确、通配或后缀规则匹配
+ * @details 有通配/后缀规则时还要逐级检查父域名，每级计算一次hashDomain
+ */
+int prefilterMayMatch(const Prefilter* filter, const char* name, size_t length, uint32_t hash);
+
+#endif // DNS_PREFILTER_H
@@ -0,0 +1,164 @@
+#include "dns_qname.h"
+#include "dns_index.h"
+#include <stdatomic.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define QNAME_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// 把n字节的标签内容（含中间的长度字节）转小写复制到out，遇到0字节返回0
+typedef int (*CopyFunction)(const uint8_t* src, size_t n, char* out);
+
+static int copyLowerScalar(const uint8_t* src, size_t n, char* out) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = src[i];
+        if (c == 0) return 0;
+        out[i] = (char)((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+    }
+    return 1;
+}
+
+#ifdef QNAME_HAVE_X86
+
+// 'A'..'Z'加上0x80 - 'A'后恰好落在有符号的-128..-103，一次有符号比较即可选出大写字母；
+// 返回块中0字节的掩码
+__attribute__((target("sse2")))
+static inline __m128i lowerBlock16(const uint8_t* src, char* out) {
+    __m128i x = _mm_loadu_si128((const __m128i*)src);
+    __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - 'A')));
+    __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + 26)));
+    _mm_storeu_si128((__m128i*)out, _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    return _mm_cmpeq_epi8(x, _mm_setzero_si128());
+}
+
+// 整块处理，不足一块的尾部与前一块重叠（转小写对同一源字节的结果相同）
+__attribute__((target("sse2")))
+static int copyLowerSse2(const uint8_t* src, size_t n, char* out) {
+    if (n < 16) return copyLowerScalar(src, n, out);
+    __m128i zeros = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        zeros = _mm_or_si128(zeros, lowerBlock16(src + i, out + i));
+    }
+    if (i < n) {
+        zeros = _mm_or_si128(zeros, lowerBlock16(src + n - 16, out + n - 16));
+    }
+    return _mm_movemask_epi8(zeros) == 0;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lowerBlock32(const uint8_t* src, char* out) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)src);
+    __m256i shifted = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - 'A')));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 26)), shifted);
+    _mm256_storeu_si256((__m256i*)out, _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+    return _mm256_cmpeq_epi8(x, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static int copyLowerAvx2(const uint8_t* src, size_t n, char* out) {
+    if (n < 32) return copyLowerSse2(src, n, out);
+    __m256i zeros = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        zeros = _mm256_or_si256(zeros, lowerBlock32(src + i, out + i));
+    }
+    if (i < n) {
+        zeros = _mm256_or_si256(zeros, lowerBlock32(src + n - 32, out + n - 32));
+    }
+    return _mm256_movemask_epi8(zeros) == 0;
+}
+
+static const CopyFunction copyFunctions[QNAME_IMPL_COUNT] = {
+    copyLowerScalar, copyLowerSse2, copyLowerAvx2
+};
+
+int qnameImplSupported(QnameImpl impl) {
+    switch (impl) {
+    case QNAME_IMPL_SCALAR: return 1;
+    case QNAME_IMPL_SSE2: return __builtin_cpu_supports("sse2");
+    case QNAME_IMPL_AVX2: return __builtin_cpu_supports("avx2");
+    default: return 0;
+    }
+}
+
+#else
+
+static const CopyFunction copyFunctions[QNAME_IMPL_COUNT] = {
+    copyLowerScalar, copyLowerScalar, copyLowerScalar
+};
+
+int qnameImplSupported(QnameImpl impl) {
+    return impl == QNAME_IMPL_SCALAR;
+}
+
+#endif
+
+// -1表示尚未检测；并发的首次调用得到相同结果，重复写入无害
+static atomic_int selectedImpl = -1;
+
+QnameImpl qnameSelectedImpl(void) {
+    int impl = atomic_load_explicit(&selectedImpl, memory_order_relaxed);
+    if (impl < 0) {
+        impl = QNAME_IMPL_SCALAR;
+        if (qnameImplSupported(QNAME_IMPL_AVX2)) impl = QNAME_IMPL_AVX2;
+        else if (qnameImplSupported(QNAME_IMPL_SSE2)) impl = QNAME_IMPL_SSE2;
+        atomic_store_explicit(&selectedImpl, impl, memory_order_relaxed);
+    }
+    return (QnameImpl)impl;
+}
+
+const char* qnameImplName(QnameImpl impl) {
+    switch (impl) {
+    case QNAME_IMPL_SCALAR: return "scalar";
+    case QNAME_IMPL_SSE2: return "sse2";
+    case QNAME_IMPL_AVX2: return "avx2";
+    default: return "unknown";
+    }
+}
+
+// 校验标签并返回规范化后的长度：线格式长度去掉首个长度字节和结尾的0字节。
+// 根域名和无效域名返回0；压缩指针的高两位为1，同样被当作超长标签拒绝
+static size_t measureName(const uint8_t* packet, size_t length, size_t offset) {
+    size_t pos = offset;
+    for (;;) {
+        if (pos >= length) return 0;
+        uint8_t labelLen = packet[pos];
+        if (labelLen == 0) break;
+        if (labelLen > 63 || labelLen >= length - pos) return 0;
+        pos += 1 + (size_t)labelLen;
+        if (pos - offset >= 255) return 0;
+    }
+    size_t wireLength = pos - offset + 1;
+    return wireLength > 2 ? wireLength - 2 : 0;
+}
+
+static size_t normalize(CopyFunction copy, const char* packet, size_t length, size_t offset,
+                        char* name, uint32_t* hash) {
+    const uint8_t* wire = (const uint8_t*)packet;
+    size_t n = measureName(wire, length, offset);
+    // 第一个长度字节之后的n字节整段转小写，其中的长度字节再改成点号
+    const uint8_t* src = wire + offset + 1;
+    if (n == 0 || !copy(src, n, name)) {
+        name[0] = '\0';
+        return 0;
+    }
+    for (size_t i = wire[offset]; i < n; i += 1 + (size_t)src[i]) {
+        name[i] = '.';
+    }
+    name[n] = '\0';
+    // 结果还在L1缓存中，哈希直接复用hashDomain，与插入索引时的哈希一致
+    *hash = hashDomain(name, n);
+    return n;
+}
+
+size_t qnameNormalizeWith(QnameImpl impl, const char* packet, size_t length, size_t offset,
+                          char* name, uint32_t* hash) {
+    if (impl >= QNAME_IMPL_COUNT || !qnameImplSupported(impl)) impl = QNAME_IMPL_SCALAR;
+    return normalize(copyFunctions[impl], packet, length, offset, name, hash);
+}
+
+size_t qnameNormalize(const char* packet, size_t length, size_t offset, char* name, uint32_t* hash) {
+    return normalize(copyFunctions[qnameSelectedImpl()], packet, length, offset, name, hash);
+}
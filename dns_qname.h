@@ -0,0 +1,62 @@
+/**
+ * @file dns_qname.h
+ * @brief 查询域名规范化的头文件定义
+ * @details 把报文中的线格式域名直接转换成索引使用的规范形式（小写、点号分隔、无末尾点号），
+ *          同时校验标签长度并算出hashDomain哈希，结果可直接交给索引查找。
+ *          复制和转小写按16字节（SSE2）或32字节（AVX2）成块处理，另有逐字节的标量实现；
+ *          首次调用时按CPU支持的指令集选择最快的实现，各实现的结果逐字节相同
+ */
+
+#ifndef DNS_QNAME_H
+#define DNS_QNAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @enum QnameImpl
+ * @brief 规范化的实现
+ */
+typedef enum {
+    QNAME_IMPL_SCALAR = 0,   ///< 逐字节处理，所有平台可用
+    QNAME_IMPL_SSE2,         ///< 每次16字节（x86）
+    QNAME_IMPL_AVX2,         ///< 每次32字节（x86，运行时检测）
+    QNAME_IMPL_COUNT
+} QnameImpl;
+
+/**
+ * @brief 规范化报文中的线格式域名
+ * @param packet 报文
+ * @param length 报文长度
+ * @param offset 域名在报文中的偏移
+ * @param name 输出规范化后的域名，至少DNS_MAX_NAME_LEN + 1字节，以'\0'结尾（无效时为空串）
+ * @param hash 输出hashDomain(name, 返回值)
+ * @return 规范化域名的长度；根域名、标签超长或越界、含压缩指针、总长超过255字节
+ *         或标签中含0字节时返回0
+ * @details 只读取域名本身的字节，不越过报文末尾，也不写name中域名之后的字节
+ */
+size_t qnameNormalize(const char* packet, size_t length, size_t offset, char* name, uint32_t* hash);
+
+/**
+ * @brief 用指定实现规范化域名，参数和返回值同qnameNormalize
+ * @details 当前CPU不支持该实现时退回标量实现，供差分测试和基准测试使用
+ */
+size_t qnameNormalizeWith(QnameImpl impl, const char* packet, size_t length, size_t offset,
+                          char* name, uint32_t* hash);
+
+/**
+ * @brief 当前CPU是否支持该实现
+ */
+int qnameImplSupported(QnameImpl impl);
+
+/**
+ * @brief qnameNormalize使用的实现
+ */
+QnameImpl qnameSelectedImpl(void);
+
+/**
+ * @brief 实现的名称（"scalar"、"sse2"、"avx2"）
+ */
+const char* qnameImplName(QnameImpl impl);
+
+#endif // DNS_QNAME_H
@@ -0,0 +1,91 @@
+#include "dns_ratelimit.h"
+#include "dns_platform.h"
+#include <stdlib.h>
+
+#define TOKEN_UNIT 1000          // 一个令牌等于1000个计数单位，每毫秒补充rate个单位
+#define RATE_MAX 1000000         // rate和burst的上限，保证容量不超出32位
+
+RateLimiter* createRateLimiter(const RateLimitConfig* config, size_t buckets) {
+    if (config->rate == 0) return NULL;
+    size_t count = 2;
+    while (count < buckets && count < ((size_t)1 << 30)) count <<= 1;
+
+    RateLimiter* limiter = (RateLimiter*)calloc(1, sizeof(RateLimiter));
+    if (!limiter) return NULL;
+    // 相邻两个槽位组成一组，按缓存行对齐后一组总在同一行内
+    limiter->buckets = (RateBucket*)dnsAlignedAlloc(count * sizeof(RateBucket));
+    if (!limiter->buckets) {
+        free(limiter);
+        return NULL;
+    }
+    uint32_t rate = config->rate > RATE_MAX ? RATE_MAX : config->rate;
+    uint32_t burst = config->burst ? config->burst : rate;
+    if (burst > RATE_MAX) burst = RATE_MAX;
+    limiter->mask = (uint32_t)(count - 1);
+    limiter->rate = rate;
+    limiter->capacity = burst * TOKEN_UNIT;
+    limiter->slip = config->slip;
+    return limiter;
+}
+
+void destroyRateLimiter(RateLimiter* limiter) {
+    if (!limiter) return;
+    dnsAlignedFree(limiter->buckets);
+    free(limiter);
+}
+
+RateVerdict rateLimiterCheck(RateLimiter* limiter, uint32_t address, uint64_t nowNs) {
+    uint32_t now = (uint32_t)(nowNs / 1000000);
+    uint32_t hash = address * 0x9E3779B1u;
+    hash ^= hash >> 15;
+    RateBucket* pair = &limiter->buckets[hash & limiter->mask & ~1u];
+
+    RateBucket* bucket;
+    if (pair[0].key == address) {
+        bucket = &pair[0];
+    } else if (pair[1].key == address) {
+        bucket = &pair[1];
+    } else {
+        // 两个槽位都被别的地址占用：换掉较久未活动的那个
+        bucket = (uint32_t)(now - pair[0].stamp) >= (uint32_t)(now - pair[1].stamp) ? &pair[0] : &pair[1];
+        bucket->key = address;
+        bucket->stamp = now;
+        bucket->tokens = limiter->capacity;
+        bucket->excess = 0;
+    }
+
+    uint32_t elapsed = now - bucket->stamp;
+    if (elapsed > 0) {
+        uint64_t tokens = bucket->tokens + (uint64_t)elapsed * limiter->rate;
+        bucket->tokens = tokens > limiter->capacity ? limiter->capacity : (uint32_t)tokens;
+        bucket->stamp = now;
+    }
+    if (bucket->tokens >= TOKEN_UNIT) {
+        bucket->tokens -= TOKEN_UNIT;
+        return RATE_PASS;
+    }
+    bucket->excess++;
+    return limiter->slip > 0 && bucket->excess % limiter->slip == 0 ? RATE_SLIP : RATE_DROP;
+}
+
+int parseRateLimit(const char* text, RateLimitConfig* config) {
+    char* end;
+    config->burst = 0;
+    config->slip = RATE_DEFAULT_SLIP;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || value == 0 || value > RATE_MAX) return 0;
+    config->rate = (uint32_t)value;
+    if (*end == ':') {
+        text = end + 1;
+        value = strtoul(text, &end, 10);
+        if (end == text || value > RATE_MAX) return 0;
+        config->burst = (uint32_t)value;
+    }
+    if (*end == ':') {
+        text = end + 1;
+        value = strtoul(text, &end, 10);
+        if (end == text || value > 1000) return 0;
+        config->slip = (uint32_t)value;
+    }
+    return *end == '\0';
+}
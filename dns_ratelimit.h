@@ -0,0 +1,94 @@
+/**
+ * @file dns_ratelimit.h
+ * @brief 按客户端地址的UDP查询限速
+ * @details 每个客户端一个令牌桶：每秒补充rate个令牌，最多积累burst个，每个查询消耗一个。
+ *          桶存放在固定大小的哈希表中，不为客户端单独分配内存：地址哈希到相邻的两个槽位
+ *          （同一缓存行），都不是该地址时占用较久未活动的那个，被挤掉的客户端重新从满桶开始。
+ *          超限的查询在解析之前丢弃；按RRL的slip方式，每slip个超限查询回一个TC应答，
+ *          真实客户端据此改用TCP，伪造源地址的反射流量则得不到放大。
+ *          每个工作线程一张表，只由本线程访问，不需要加锁
+ */
+
+#ifndef DNS_RATELIMIT_H
+#define DNS_RATELIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RATE_DEFAULT_BUCKETS 65536   ///< 每张表的槽位数（2的幂）
+#define RATE_DEFAULT_SLIP 2          ///< 默认每2个超限查询回一个TC应答
+
+/**
+ * @struct RateLimitConfig
+ * @brief 限速配置
+ */
+typedef struct {
+    uint32_t rate;       ///< 每个客户端每秒允许的查询数，0表示不限速
+    uint32_t burst;      ///< 桶容量（允许的突发查询数），0表示等于rate
+    uint32_t slip;       ///< 每slip个超限查询回一个TC应答，0表示全部丢弃，1表示全部回TC
+} RateLimitConfig;
+
+/**
+ * @enum RateVerdict
+ * @brief 限速判定
+ */
+typedef enum {
+    RATE_PASS = 0,       ///< 未超限，正常处理
+    RATE_DROP,           ///< 超限，丢弃
+    RATE_SLIP            ///< 超限，回TC应答
+} RateVerdict;
+
+/**
+ * @struct RateBucket
+ * @brief 一个客户端的令牌桶
+ */
+typedef struct {
+    uint32_t key;        ///< 客户端地址（网络字节序）
+    uint32_t stamp;      ///< 上次补充令牌的时间（毫秒，回绕无妨）
+    uint32_t tokens;     ///< 剩余令牌（以千分之一个为单位）
+    uint32_t excess;     ///< 连续超限的查询数，用于slip计数
+} RateBucket;
+
+/**
+ * @struct RateLimiter
+ * @brief 令牌桶表
+ */
+typedef struct {
+    RateBucket* buckets;
+    uint32_t mask;       ///< 槽位数 - 1
+    uint32_t rate;
+    uint32_t capacity;   ///< 桶容量（千分之一个令牌）
+    uint32_t slip;
+} RateLimiter;
+
+/**
+ * @brief 创建令牌桶表
+ * @param config 限速配置，rate不能为0
+ * @param buckets 槽位数，向上取整为2的幂
+ * @return 表，失败返回NULL
+ */
+RateLimiter* createRateLimiter(const RateLimitConfig* config, size_t buckets);
+
+/**
+ * @brief 销毁令牌桶表
+ */
+void destroyRateLimiter(RateLimiter* limiter);
+
+/**
+ * @brief 为一个查询判定是否放行
+ * @param limiter 令牌桶表
+ * @param address 客户端IPv4地址（网络字节序）
+ * @param nowNs 当前时间（dnsNowNs），同一批报文可以共用一次取得的时间
+ * @return 判定结果
+ */
+RateVerdict rateLimiterCheck(RateLimiter* limiter, uint32_t address, uint64_t nowNs);
+
+/**
+ * @brief 解析限速参数"rate[:burst[:slip]]"
+ * @param text 参数文本
+ * @param config 输出配置，未给出的部分使用默认值
+ * @return 成功返回1，格式错误返回0
+ */
+int parseRateLimit(const char* text, RateLimitConfig* config);
+
+#endif // DNS_RATELIMIT_H
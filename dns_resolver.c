@@ -1,136 +1,315 @@
-#include "dns_resolver.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#define INITIAL_CAPACITY 100
-
-DNSResolver* createResolver(void) {
-    DNSResolver* resolver = (DNSResolver*)malloc(sizeof(DNSResolver));
-    if (!resolver) return NULL;
-
-    resolver->domains = (char**)malloc(INITIAL_CAPACITY * sizeof(char*));
-    resolver->ips = (char**)malloc(INITIAL_CAPACITY * sizeof(char*));
-    if (!resolver->domains || !resolver->ips) {
-        free(resolver->domains);
-        free(resolver->ips);
-        free(resolver);
-        return NULL;
-    }
-
-    resolver->count = 0;
-    resolver->capacity = INITIAL_CAPACITY;
-    InitializeCriticalSection(&resolver->cs);
-    return resolver;
-}
-
-void destroyResolver(DNSResolver* resolver) {
-    if (!resolver) return;
-
-    for (size_t i = 0; i < resolver->count; i++) {
-        free(resolver->domains[i]);
-        free(resolver->ips[i]);
-    }
-    free(resolver->domains);
-    free(resolver->ips);
-    DeleteCriticalSection(&resolver->cs);
-    free(resolver);
-}
-
-int loadDomainMap(DNSResolver* resolver, const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) return 0;
-
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        char* ip = strtok(line, " \t\n");
-        char* domain = strtok(NULL, " \t\n");
-        if (ip && domain) {
-            // 检查是否需要扩容
-            if (resolver->count >= resolver->capacity) {
-                size_t newCapacity = resolver->capacity * 2;
-                char** newDomains = (char**)realloc(resolver->domains, 
-                                                  newCapacity * sizeof(char*));
-                char** newIps = (char**)realloc(resolver->ips, 
-                                              newCapacity * sizeof(char*));
-                if (!newDomains || !newIps) {
-                    free(newDomains);
-                    free(newIps);
-                    fclose(file);
-                    return 0;
-                }
-                resolver->domains = newDomains;
-                resolver->ips = newIps;
-                resolver->capacity = newCapacity;
-            }
-
-            // 存储域名和IP
-            resolver->domains[resolver->count] = _strdup(domain);
-            resolver->ips[resolver->count] = _strdup(ip);
-            if (!resolver->domains[resolver->count] || 
-                !resolver->ips[resolver->count]) {
-                fclose(file);
-                return 0;
-            }
-            resolver->count++;
-        }
-    }
-
-    fclose(file);
-    return 1;
-}
-
-char* resolveLocally(DNSResolver* resolver, const char* domain, int* isBlocked) {
-    EnterCriticalSection(&resolver->cs);
-    
-    for (size_t i = 0; i < resolver->count; i++) {
-        if (strcmp(resolver->domains[i], domain) == 0) {
-            *isBlocked = (strcmp(resolver->ips[i], "0.0.0.0") == 0);
-            char* result = _strdup(resolver->ips[i]);
-            LeaveCriticalSection(&resolver->cs);
-            return result;
-        }
-    }
-    
-    LeaveCriticalSection(&resolver->cs);
-    *isBlocked = 0;
-    return NULL;
-}
-
-char* queryExternalDNS(const char* domain) {
-    struct hostent* he = gethostbyname(domain);
-    if (!he || !he->h_addr_list[0]) return NULL;
-
-    char* ipStr = inet_ntoa(*(struct in_addr*)he->h_addr_list[0]);
-    return ipStr ? _strdup(ipStr) : NULL;
-}
-
-void cacheExternalResult(DNSResolver* resolver, const char* domain, 
-                        const char* ip) {
-    EnterCriticalSection(&resolver->cs);
-
-    // 检查是否需要扩容
-    if (resolver->count >= resolver->capacity) {
-        size_t newCapacity = resolver->capacity * 2;
-        char** newDomains = (char**)realloc(resolver->domains, 
-                                          newCapacity * sizeof(char*));
-        char** newIps = (char**)realloc(resolver->ips, 
-                                      newCapacity * sizeof(char*));
-        if (!newDomains || !newIps) {
-            LeaveCriticalSection(&resolver->cs);
-            return;
-        }
-        resolver->domains = newDomains;
-        resolver->ips = newIps;
-        resolver->capacity = newCapacity;
-    }
-
-    // 存储新的域名-IP对
-    resolver->domains[resolver->count] = _strdup(domain);
-    resolver->ips[resolver->count] = _strdup(ip);
-    if (resolver->domains[resolver->count] && resolver->ips[resolver->count]) {
-        resolver->count++;
-    }
-
-    LeaveCriticalSection(&resolver->cs);
-} 
\ No newline at end of file
+#include "dns_resolver.h"
+#include "dns_log.h"
+#include "dns_epoch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 100
+
+// 创建空快照
+static ResolverSnapshot* createSnapshot(void) {
+    ResolverSnapshot* snapshot = (ResolverSnapshot*)calloc(1, sizeof(ResolverSnapshot));
+    if (!snapshot) return NULL;
+
+    if (!domainIndexInit(&snapshot->index, INITIAL_CAPACITY)) {
+        free(snapshot);
+        return NULL;
+    }
+    if (!trieInit(&snapshot->suffixes)) {
+        domainIndexFree(&snapshot->index);
+        free(snapshot);
+        return NULL;
+    }
+    if (!addressTableInit(&snapshot->addresses)) {
+        trieFree(&snapshot->suffixes);
+        domainIndexFree(&snapshot->index);
+        free(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+static void destroySnapshot(ResolverSnapshot* snapshot) {
+    if (!snapshot) return;
+    domainIndexFree(&snapshot->index);
+    trieFree(&snapshot->suffixes);
+    addressTableFree(&snapshot->addresses);
+    freeAnswerTemplates(&snapshot->answers);
+    prefilterFree(&snapshot->filter);
+    ruleDbClose(snapshot->image);
+    free(snapshot);
+}
+
+// 为文本规则建预过滤器：精确规则的哈希直接取自索引，通配/后缀规则的哈希由调用方收集
+static int buildTextFilter(ResolverSnapshot* snapshot, const uint32_t* suffixHashes,
+                           size_t suffixCount, uint32_t bits) {
+    if (bits == 0 || snapshot->ruleCount < PREFILTER_MIN_RULES) return 1;
+    const DomainIndex* index = &snapshot->index;
+    if (!prefilterInit(&snapshot->filter, index->count + suffixCount, bits)) return 0;
+    for (size_t i = 0; i <= index->mask; i++) {
+        if (index->hashes[i]) prefilterAdd(&snapshot->filter, index->hashes[i]);
+    }
+    for (size_t i = 0; i < suffixCount; i++) {
+        prefilterAdd(&snapshot->filter, suffixHashes[i]);
+    }
+    snapshot->filter.suffixes = suffixCount > 0;
+    return 1;
+}
+
+// 为规则库镜像建预过滤器，镜像中通配/后缀规则存的就是基础域名
+static int buildImageFilter(ResolverSnapshot* snapshot, uint32_t bits) {
+    const RuleDb* image = snapshot->image;
+    if (bits == 0 || image->entryCount < PREFILTER_MIN_RULES) return 1;
+    if (!prefilterInit(&snapshot->filter, image->entryCount, bits)) return 0;
+    for (uint32_t i = 0; i < image->entryCount; i++) {
+        const RuleDbEntry* entry = &image->entries[i];
+        if ((uint64_t)entry->nameOffset + entry->nameLength > image->namesSize) continue;
+        prefilterAdd(&snapshot->filter, hashDomain(image->names + entry->nameOffset, entry->nameLength));
+    }
+    snapshot->filter.suffixes = image->suffixCount > 0;
+    return 1;
+}
+
+// 从文件构建新快照，失败返回NULL
+static ResolverSnapshot* buildSnapshot(const char* filename, uint32_t prefilterBits) {
+    ResolverSnapshot* snapshot = createSnapshot();
+    if (!snapshot) return NULL;
+
+    // 预编译的镜像直接映射，不解析文本
+    if (ruleDbIsImage(filename)) {
+        snapshot->image = ruleDbOpen(filename);
+        if (!snapshot->image) {
+            destroySnapshot(snapshot);
+            return NULL;
+        }
+        const RuleDb* image = snapshot->image;
+        if (!buildAnswerTemplates(&snapshot->answers, image->sets, image->setCount,
+                                  image->pool, (size_t)image->poolSize)) {
+            destroySnapshot(snapshot);
+            return NULL;
+        }
+        snapshot->ruleCount = image->entryCount;
+        if (!buildImageFilter(snapshot, prefilterBits)) {
+            destroySnapshot(snapshot);
+            return NULL;
+        }
+        return snapshot;
+    }
+
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        destroySnapshot(snapshot);
+        return NULL;
+    }
+
+    char line[512];
+    char name[DNS_MAX_NAME_LEN + 1];
+    AddressTable* addresses = &snapshot->addresses;
+    uint32_t* suffixHashes = NULL;     // 通配/后缀规则基础域名的哈希，供预过滤器使用
+    size_t suffixCount = 0;
+    size_t suffixCapacity = 0;
+    while (fgets(line, sizeof(line), file)) {
+        int kind, family;
+        uint8_t address[16];
+        size_t length = parseRuleLine(line, name, &kind, &family, address);
+        if (length == 0) continue;
+
+        // 精确规则存入哈希索引，通配符和后缀规则编译进后缀树；
+        // 规则已存在时返回原有的集合编号，本行的地址并入该集合
+        uint32_t fresh = addressTableCreateSet(addresses);
+        uint32_t set = ADDRSET_NONE;
+        if (fresh == ADDRSET_NONE) {
+            free(suffixHashes);
+            fclose(file);
+            destroySnapshot(snapshot);
+            return NULL;
+        }
+        if (kind == RULE_EXACT) {
+            if (!domainIndexInsert(&snapshot->index, name, fresh, &set)) {
+                free(suffixHashes);
+                fclose(file);
+                destroySnapshot(snapshot);
+                return NULL;
+            }
+        } else if (!trieInsert(&snapshot->suffixes, name, length, kind, fresh, &set)) {
+            dnsLog(DNS_LOG_WARN, "忽略无效的通配规则: %s", name);
+        } else if (set == fresh) {
+            if (suffixCount == suffixCapacity) {
+                size_t capacity = suffixCapacity ? suffixCapacity * 2 : 1024;
+                uint32_t* grown = (uint32_t*)realloc(suffixHashes, capacity * sizeof(uint32_t));
+                if (!grown) {
+                    free(suffixHashes);
+                    fclose(file);
+                    destroySnapshot(snapshot);
+                    return NULL;
+                }
+                suffixHashes = grown;
+                suffixCapacity = capacity;
+            }
+            suffixHashes[suffixCount++] = hashDomain(name, length);
+        }
+        // 没有用上的新集合一定是最后创建的，直接收回
+        if (set != fresh) addresses->count--;
+        if (set != ADDRSET_NONE && !addressTableAdd(addresses, set, family, address)) {
+            free(suffixHashes);
+            fclose(file);
+            destroySnapshot(snapshot);
+            return NULL;
+        }
+    }
+    fclose(file);
+
+    // 整理地址池后合并内容相同的集合，索引和后缀树改指合并后的集合
+    uint32_t* remap = addressTableFinish(addresses) ? addressTableIntern(addresses) : NULL;
+    if (!remap) {
+        free(suffixHashes);
+        destroySnapshot(snapshot);
+        return NULL;
+    }
+    domainIndexRemap(&snapshot->index, remap);
+    trieRemap(&snapshot->suffixes, remap);
+    free(remap);
+
+    // 合并后集合很少，为每个集合预先编码应答记录
+    if (!buildAnswerTemplates(&snapshot->answers, addresses->sets, addresses->count,
+                              addresses->pool, addresses->poolSize)) {
+        free(suffixHashes);
+        destroySnapshot(snapshot);
+        return NULL;
+    }
+
+    snapshot->ruleCount = snapshot->index.count + snapshot->suffixes.ruleCount;
+    int filtered = buildTextFilter(snapshot, suffixHashes, suffixCount, prefilterBits);
+    free(suffixHashes);
+    if (!filtered) {
+        destroySnapshot(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+DNSResolver* createResolver(void) {
+    DNSResolver* resolver = (DNSResolver*)malloc(sizeof(DNSResolver));
+    if (!resolver) return NULL;
+
+    ResolverSnapshot* snapshot = createSnapshot();
+    if (!snapshot) {
+        free(resolver);
+        return NULL;
+    }
+    atomic_init(&resolver->current, snapshot);
+    resolver->path = NULL;
+    resolver->prefilterBits = PREFILTER_DEFAULT_BITS;
+    dnsMutexInit(&resolver->reloadLock);
+    return resolver;
+}
+
+void destroyResolver(DNSResolver* resolver) {
+    if (!resolver) return;
+
+    // 调用方保证此时已没有读者
+    destroySnapshot(atomic_load(&resolver->current));
+    free(resolver->path);
+    dnsMutexDestroy(&resolver->reloadLock);
+    free(resolver);
+}
+
+int loadDomainMap(DNSResolver* resolver, const char* filename) {
+    dnsMutexLock(&resolver->reloadLock);
+
+    uint64_t start = dnsNowNs();
+    ResolverSnapshot* snapshot = buildSnapshot(filename, resolver->prefilterBits);
+    if (!snapshot) {
+        dnsMutexUnlock(&resolver->reloadLock);
+        dnsLog(DNS_LOG_ERROR, "加载域名文件失败: %s，继续使用原有规则", filename);
+        return 0;
+    }
+
+    if (resolver->path != filename) {
+        char* path = _strdup(filename);
+        if (path) {
+            free(resolver->path);
+            resolver->path = path;
+        }
+    }
+
+    // 发布新快照，等待仍在读取旧快照的查询结束后再释放
+    ResolverSnapshot* old = atomic_exchange(&resolver->current, snapshot);
+    dnsEpochSynchronize();
+    destroySnapshot(old);
+
+    dnsMutexUnlock(&resolver->reloadLock);
+    dnsLog(DNS_LOG_INFO, "已加载域名文件 %s，共%u条规则，用时%.1f ms", filename,
+           (unsigned)snapshot->ruleCount, (double)(dnsNowNs() - start) / 1e6);
+    return 1;
+}
+
+int reloadDomainMap(DNSResolver* resolver) {
+    if (!resolver->path) return 0;
+    return loadDomainMap(resolver, resolver->path);
+}
+
+int resolveLocally(DNSResolver* resolver, const char* domain, AddressList* addresses) {
+    char name[DNS_MAX_NAME_LEN + 1];
+    size_t length = normalizeDomain(domain, name);
+    if (length == 0) return 0;
+    uint32_t hash = hashDomain(name, length);
+
+    // 读取快照不加锁；临界区内快照不会被释放
+    dnsEpochEnter();
+    const ResolverSnapshot* snapshot = atomic_load(&resolver->current);
+    // 精确匹配最具体，其次由后缀树给出最深的通配/后缀匹配；预过滤器否定时都不必查
+    uint32_t set;
+    int found;
+    if (!prefilterMayMatch(&snapshot->filter, name, length, hash)) {
+        found = 0;
+    } else if (snapshot->image) {
+        const RuleDb* image = snapshot->image;
+        found = ruleDbLookup(image, name, length, &set) &&
+                addressSetExpand(&image->sets[set], image->pool, (size_t)image->poolSize, addresses);
+    } else {
+        found = (domainIndexLookupNormalized(&snapshot->index, name, length, hash, &set) ||
+                 trieLookup(&snapshot->suffixes, name, length, &set)) &&
+                addressSetExpand(&snapshot->addresses.sets[set], snapshot->addresses.pool,
+                                 snapshot->addresses.poolSize, addresses);
+    }
+    dnsEpochExit();
+
+    // 集合中含0.0.0.0或::表示该域名被屏蔽
+    return found;
+}
+
+int resolveLocalAnswer(DNSResolver* resolver, const char* name, size_t length, uint32_t hash,
+                       const char* query, const DNSQuestion* question, const EdnsInfo* edns,
+                       char* response, size_t responseSize, LocalAnswer* answer) {
+    if (length == 0) return 0;
+
+    dnsEpochEnter();
+    const ResolverSnapshot* snapshot = atomic_load(&resolver->current);
+    const AddressSet* sets = NULL;
+    uint32_t set = 0;
+    int found;
+    if (!prefilterMayMatch(&snapshot->filter, name, length, hash)) {
+        found = 0;
+    } else if (snapshot->image) {
+        sets = snapshot->image->sets;
+        found = ruleDbLookup(snapshot->image, name, length, &set);
+    } else {
+        sets = snapshot->addresses.sets;
+        found = domainIndexLookupNormalized(&snapshot->index, name, length, hash, &set) ||
+                trieLookup(&snapshot->suffixes, name, length, &set);
+    }
+    // 模板引用快照，应答必须在临界区内构建完
+    found = found && set < snapshot->answers.count && snapshot->answers.offsets[set] != ADDRSET_NONE;
+    if (found) {
+        const AddressSet* entry = &sets[set];
+        answer->blocked = (entry->flags & ADDRSET_BLOCKED) != 0;
+        answer->v4Count = entry->v4Count;
+        answer->v6Count = entry->v6Count;
+        answer->length = buildTemplateAnswer(response, responseSize, query, question, edns,
+                                             &snapshot->answers, entry, set);
+    }
+    dnsEpochExit();
+    return found;
+}
@@ -1,29 +1,88 @@
-/**
- * @file dns_resolver.h
- * @brief DNS解析器类的头文件定义
- * @details 定义了DNS解析器的主要功能，包括本地解析、外部DNS查询和缓存管理
- */
-
-#ifndef DNS_RESOLVER_H
-#define DNS_RESOLVER_H
-
-#include <winsock2.h>
-
-// 域名解析器结构体
-typedef struct {
-    char** domains;     // 域名数组
-    char** ips;         // IP地址数组
-    size_t count;       // 域名-IP对的数量
-    size_t capacity;    // 数组容量
-    CRITICAL_SECTION cs; // 临界区
-} DNSResolver;
-
-// 函数声明
-DNSResolver* createResolver(void);
-void destroyResolver(DNSResolver* resolver);
-int loadDomainMap(DNSResolver* resolver, const char* filename);
-char* resolveLocally(DNSResolver* resolver, const char* domain, int* isBlocked);
-char* queryExternalDNS(const char* domain);
-void cacheExternalResult(DNSResolver* resolver, const char* domain, const char* ip);
-
-#endif // DNS_RESOLVER_H 
\ No newline at end of file
+/**
+ * @file dns_resolver.h
+ * @brief DNS解析器类的头文件定义
+ * @details 定义了DNS解析器的主要功能，包括本地解析、外部DNS查询和缓存管理
+ */
+
+#ifndef DNS_RESOLVER_H
+#define DNS_RESOLVER_H
+
+#include "dns_platform.h"
+#include "dns_index.h"
+#include "dns_trie.h"
+#include "dns_ruledb.h"
+#include "dns_addrset.h"
+#include "dns_message.h"
+#include "dns_prefilter.h"
+#include <stdatomic.h>
+
+// 不可变的规则快照，发布后只读
+typedef struct {
+    DomainIndex index;   // 精确规则哈希索引（大小写不敏感）
+    SuffixTrie suffixes; // 通配符和后缀规则（*.example.com / .example.com）
+    AddressTable addresses; // 上面两者的值所指向的地址集合
+    RuleDb* image;       // 预编译规则库，加载后取代上面三者
+    AnswerTemplates answers; // 每个地址集合预先编码好的应答记录
+    Prefilter filter;    // 所有规则域名的布隆过滤器，确定不匹配时跳过索引和后缀树
+    size_t ruleCount;    // 规则条数
+} ResolverSnapshot;
+
+// 域名解析器结构体
+typedef struct {
+    ResolverSnapshot* _Atomic current; // 当前快照，查询线程无锁读取
+    char* path;                        // 最近一次加载的域名文件，重新加载时使用
+    DNSMutex reloadLock;               // 串行化加载/重新加载
+    uint32_t prefilterBits;            // 预过滤器每个键的位数，0表示不建过滤器；下次加载时生效
+} DNSResolver;
+
+// 函数声明
+DNSResolver* createResolver(void);
+void destroyResolver(DNSResolver* resolver);
+/**
+ * @brief 加载域名文件并原子替换当前规则
+ * @details 在调用线程上构建新快照，替换后等待旧快照的读者结束再释放；
+ *          加载失败时保留原有规则。查询线程在此期间不受阻塞
+ */
+int loadDomainMap(DNSResolver* resolver, const char* filename);
+/**
+ * @brief 重新加载最近一次加载的域名文件
+ */
+int reloadDomainMap(DNSResolver* resolver);
+/**
+ * @brief 查找域名的本地规则
+ * @param resolver 解析器
+ * @param domain 域名
+ * @param addresses 输出规则的全部地址（IPv4和IPv6）及是否屏蔽
+ * @return 有匹配规则返回1，否则返回0
+ */
+int resolveLocally(DNSResolver* resolver, const char* domain, AddressList* addresses);
+/**
+ * @struct LocalAnswer
+ * @brief resolveLocalAnswer的结果
+ */
+typedef struct {
+    size_t length;       // 应答长度，缓冲区不足时为0
+    int blocked;         // 是否屏蔽
+    int v4Count;         // 规则的IPv4地址数
+    int v6Count;         // 规则的IPv6地址数
+} LocalAnswer;
+/**
+ * @brief 查找域名的本地规则，命中时直接用预先编码的记录构建应答
+ * @param resolver 解析器
+ * @param name 规范化后的域名（qnameNormalize或normalizeDomain的结果）
+ * @param length 域名长度
+ * @param hash hashDomain(name, length)，qnameNormalize已一并算出
+ * @param query 查询报文
+ * @param question parseDNSQuery得到的问题视图
+ * @param edns parseEdns得到的EDNS信息
+ * @param response 应答缓冲区，可以与query相同
+ * @param responseSize 应答长度上限，含义同buildLocalAnswer
+ * @param answer 输出应答长度和规则概况
+ * @return 有匹配规则返回1，否则返回0（不写response）
+ * @details 应答与resolveLocally加buildLocalAnswer的结果相同，但不复制地址，也不逐字段编码记录
+ */
+int resolveLocalAnswer(DNSResolver* resolver, const char* name, size_t length, uint32_t hash,
+                       const char* query, const DNSQuestion* question, const EdnsInfo* edns,
+                       char* response, size_t responseSize, LocalAnswer* answer);
+
+#endif // DNS_RESOLVER_H
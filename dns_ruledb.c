@@ -0,0 +1,358 @@
+#include "dns_ruledb.h"
+#include "dns_index.h"
+#include "dns_trie.h"
+#include "dns_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+size_t parseRuleLine(char* line, char* name, int* kind, int* family, uint8_t* address) {
+    char* ipText = strtok(line, " \t\r\n");
+    char* domain = strtok(NULL, " \t\r\n");
+    if (!ipText || !domain) return 0;
+
+    // 含冒号的是IPv6地址
+    if (strchr(ipText, ':')) {
+        if (inet_pton(AF_INET6, ipText, address) != 1) return 0;
+        *family = AF_INET6;
+    } else {
+        struct in_addr addr;
+        addr.s_addr = inet_addr(ipText);
+        if (addr.s_addr == INADDR_NONE && strcmp(ipText, "255.255.255.255") != 0) {
+            return 0;  // 跳过无法解析的IP
+        }
+        memcpy(address, &addr.s_addr, 4);
+        *family = AF_INET;
+    }
+
+    *kind = RULE_EXACT;
+    if (domain[0] == '*' && domain[1] == '.') {
+        *kind = TRIE_MATCH_WILDCARD;
+        domain += 2;
+    } else if (domain[0] == '.') {
+        *kind = TRIE_MATCH_SUFFIX;
+        domain += 1;
+    }
+    return normalizeDomain(domain, name);
+}
+
+// 同一域名的不同规则类型使用不同的哈希值
+static uint32_t ruleHash(const char* name, size_t length, int kind) {
+    uint32_t hash = hashDomain(name, length) ^ ((uint32_t)kind * 0x9E3779B1u);
+    return hash ? hash : 1;
+}
+
+int ruleDbIsImage(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    char magic[8];
+    int isImage = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                  memcmp(magic, RULEDB_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return isImage;
+}
+
+// 校验一个段是否完整落在映射范围内
+static int sectionValid(uint64_t offset, uint64_t length, size_t size) {
+    return (offset & 7) == 0 && offset <= size && length <= size - offset;
+}
+
+RuleDb* ruleDbOpen(const char* path) {
+    size_t size = 0;
+    const void* base = dnsMapFile(path, &size);
+    if (!base) return NULL;
+
+    const RuleDbHeader* header = (const RuleDbHeader*)base;
+    if (size < sizeof(RuleDbHeader) ||
+        memcmp(header->magic, RULEDB_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RULEDB_VERSION ||
+        header->byteOrder != RULEDB_BYTE_ORDER ||
+        header->fileSize != size ||
+        header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0 ||
+        header->slotCount <= header->entryCount ||
+        header->namesSize > UINT32_MAX ||
+        header->poolSize > UINT32_MAX ||
+        !sectionValid(header->entriesOffset, (uint64_t)header->entryCount * sizeof(RuleDbEntry), size) ||
+        !sectionValid(header->valuesOffset, (uint64_t)header->entryCount * sizeof(uint32_t), size) ||
+        !sectionValid(header->slotsOffset, (uint64_t)header->slotCount * sizeof(RuleDbSlot), size) ||
+        !sectionValid(header->setsOffset, (uint64_t)header->setCount * sizeof(AddressSet), size) ||
+        !sectionValid(header->poolOffset, header->poolSize, size) ||
+        !sectionValid(header->namesOffset, header->namesSize, size)) {
+        dnsUnmapFile(base, size);
+        return NULL;
+    }
+
+    RuleDb* db = (RuleDb*)malloc(sizeof(RuleDb));
+    if (!db) {
+        dnsUnmapFile(base, size);
+        return NULL;
+    }
+    const char* bytes = (const char*)base;
+    db->base = base;
+    db->size = size;
+    db->entries = (const RuleDbEntry*)(bytes + header->entriesOffset);
+    db->values = (const uint32_t*)(bytes + header->valuesOffset);
+    db->slots = (const RuleDbSlot*)(bytes + header->slotsOffset);
+    db->sets = (const AddressSet*)(bytes + header->setsOffset);
+    db->pool = (const uint8_t*)(bytes + header->poolOffset);
+    db->names = bytes + header->namesOffset;
+    db->entryCount = header->entryCount;
+    db->suffixCount = header->suffixCount;
+    db->slotMask = header->slotCount - 1;
+    db->setCount = header->setCount;
+    db->poolSize = header->poolSize;
+    db->namesSize = header->namesSize;
+    return db;
+}
+
+void ruleDbClose(RuleDb* db) {
+    if (!db) return;
+    dnsUnmapFile(db->base, db->size);
+    free(db);
+}
+
+// 查找指定类型的规则；条目内容来自文件，访问前逐项检查边界
+static int probe(const RuleDb* db, const char* name, size_t length, int kind, uint32_t* set) {
+    uint32_t hash = ruleHash(name, length, kind);
+    uint32_t pos = hash & db->slotMask;
+
+    for (uint32_t n = 0; n <= db->slotMask && db->slots[pos].hash; n++) {
+        const RuleDbSlot* slot = &db->slots[pos];
+        pos = (pos + 1) & db->slotMask;
+        if (slot->hash != hash || slot->entry >= db->entryCount) continue;
+
+        const RuleDbEntry* entry = &db->entries[slot->entry];
+        if (entry->kind == kind && entry->nameLength == length &&
+            (uint64_t)entry->nameOffset + length <= db->namesSize &&
+            memcmp(db->names + entry->nameOffset, name, length) == 0) {
+            if (db->values[slot->entry] >= db->setCount) return 0;
+            *set = db->values[slot->entry];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int ruleDbLookup(const RuleDb* db, const char* name, size_t length, uint32_t* set) {
+    if (probe(db, name, length, RULE_EXACT, set)) return 1;
+    if (db->suffixCount == 0) return 0;
+    if (probe(db, name, length, TRIE_MATCH_SUFFIX, set)) return 1;
+
+    // 从最具体的父域名开始逐级向上
+    const char* end = name + length;
+    const char* dot = (const char*)memchr(name, '.', length);
+    while (dot) {
+        const char* parent = dot + 1;
+        size_t parentLength = (size_t)(end - parent);
+        if (probe(db, parent, parentLength, TRIE_MATCH_WILDCARD, set) ||
+            probe(db, parent, parentLength, TRIE_MATCH_SUFFIX, set)) {
+            return 1;
+        }
+        dot = (const char*)memchr(parent, '.', parentLength);
+    }
+    return 0;
+}
+
+// 编译期间的一行规则，域名存放在临时字符池中
+typedef struct {
+    uint32_t poolOffset;
+    uint32_t order;     // 在文件中的行序，合并时地址保持文件中的顺序
+    uint8_t address[16];
+    uint8_t family;
+    uint8_t length;
+    uint8_t kind;
+} CompileRule;
+
+static const char* sortPool;  // qsort比较函数无法传递上下文
+
+static int compareRules(const void* a, const void* b) {
+    const CompileRule* x = (const CompileRule*)a;
+    const CompileRule* y = (const CompileRule*)b;
+    size_t common = x->length < y->length ? x->length : y->length;
+    int cmp = memcmp(sortPool + x->poolOffset, sortPool + y->poolOffset, common);
+    if (cmp != 0) return cmp;
+    if (x->length != y->length) return x->length < y->length ? -1 : 1;
+    if (x->kind != y->kind) return x->kind < y->kind ? -1 : 1;
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static int writePadded(FILE* file, const void* data, size_t length) {
+    static const char zeros[8] = { 0 };
+    if (length > 0 && fwrite(data, 1, length, file) != length) return 0;
+    size_t padding = (size_t)(ALIGN8(length) - length);
+    return padding == 0 || fwrite(zeros, 1, padding, file) == padding;
+}
+
+// 按已排序、已合并的规则写出镜像，rules[i]的地址集合为sets中的第setOf[i]个
+static int writeImage(FILE* file, const CompileRule* rules, uint32_t count,
+                      const char* pool, size_t poolSize, const AddressTable* sets,
+                      const uint32_t* setOf) {
+    uint32_t slotCount = 16;
+    while (slotCount < (uint64_t)count * 2) slotCount *= 2;
+
+    RuleDbEntry* entries = (RuleDbEntry*)calloc(count ? count : 1, sizeof(RuleDbEntry));
+    uint32_t* values = (uint32_t*)malloc((count ? count : 1) * sizeof(uint32_t));
+    RuleDbSlot* slots = (RuleDbSlot*)calloc(slotCount, sizeof(RuleDbSlot));
+    char* names = (char*)malloc(poolSize + 1);
+    int ok = entries && values && slots && names;
+
+    uint64_t namesSize = 0;
+    uint32_t suffixCount = 0;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const CompileRule* rule = &rules[i];
+        const char* name = pool + rule->poolOffset;
+
+        // 同名的不同类型规则在排序后相邻，共用字符池中的同一段
+        if (i > 0 && rules[i - 1].length == rule->length &&
+            memcmp(pool + rules[i - 1].poolOffset, name, rule->length) == 0) {
+            entries[i].nameOffset = entries[i - 1].nameOffset;
+        } else {
+            entries[i].nameOffset = (uint32_t)namesSize;
+            memcpy(names + namesSize, name, rule->length);
+            namesSize += rule->length;
+        }
+        entries[i].nameLength = rule->length;
+        entries[i].kind = rule->kind;
+        values[i] = setOf[i];
+        if (rule->kind != RULE_EXACT) suffixCount++;
+
+        uint32_t hash = ruleHash(name, rule->length, rule->kind);
+        uint32_t pos = hash & (slotCount - 1);
+        while (slots[pos].hash) pos = (pos + 1) & (slotCount - 1);
+        slots[pos].hash = hash;
+        slots[pos].entry = i;
+    }
+    if (namesSize > UINT32_MAX) ok = 0;
+
+    if (ok) {
+        RuleDbHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RULEDB_MAGIC, sizeof(header.magic));
+        header.version = RULEDB_VERSION;
+        header.byteOrder = RULEDB_BYTE_ORDER;
+        header.entryCount = count;
+        header.suffixCount = suffixCount;
+        header.slotCount = slotCount;
+        header.setCount = sets->count;
+        header.entriesOffset = ALIGN8(sizeof(RuleDbHeader));
+        header.valuesOffset = header.entriesOffset + ALIGN8((uint64_t)count * sizeof(RuleDbEntry));
+        header.slotsOffset = header.valuesOffset + ALIGN8((uint64_t)count * sizeof(uint32_t));
+        header.setsOffset = header.slotsOffset + ALIGN8((uint64_t)slotCount * sizeof(RuleDbSlot));
+        header.poolOffset = header.setsOffset + ALIGN8((uint64_t)sets->count * sizeof(AddressSet));
+        header.poolSize = sets->poolSize;
+        header.namesOffset = header.poolOffset + ALIGN8(sets->poolSize);
+        header.namesSize = namesSize;
+        header.fileSize = header.namesOffset + ALIGN8(namesSize);
+
+        ok = writePadded(file, &header, sizeof(header)) &&
+             writePadded(file, entries, (size_t)count * sizeof(RuleDbEntry)) &&
+             writePadded(file, values, (size_t)count * sizeof(uint32_t)) &&
+             writePadded(file, slots, (size_t)slotCount * sizeof(RuleDbSlot)) &&
+             writePadded(file, sets->sets, (size_t)sets->count * sizeof(AddressSet)) &&
+             writePadded(file, sets->pool, sets->poolSize) &&
+             writePadded(file, names, (size_t)namesSize);
+    }
+
+    free(entries);
+    free(values);
+    free(slots);
+    free(names);
+    return ok;
+}
+
+long ruleDbCompile(const char* textPath, const char* imagePath) {
+    FILE* input = fopen(textPath, "r");
+    if (!input) return -1;
+
+    size_t capacity = 1024, count = 0;
+    size_t poolCapacity = 64 * 1024, poolSize = 0;
+    CompileRule* rules = (CompileRule*)malloc(capacity * sizeof(CompileRule));
+    char* pool = (char*)malloc(poolCapacity);
+    int ok = rules && pool;
+
+    char line[512];
+    char name[DNS_MAX_NAME_LEN + 1];
+    while (ok && fgets(line, sizeof(line), input)) {
+        int kind, family;
+        uint8_t address[16];
+        size_t length = parseRuleLine(line, name, &kind, &family, address);
+        if (length == 0) continue;
+
+        if (count == capacity) {
+            CompileRule* grown = (CompileRule*)realloc(rules, capacity * 2 * sizeof(CompileRule));
+            if (!grown) { ok = 0; break; }
+            rules = grown;
+            capacity *= 2;
+        }
+        if (poolSize + length > poolCapacity) {
+            char* grown = (char*)realloc(pool, poolCapacity * 2);
+            if (!grown) { ok = 0; break; }
+            pool = grown;
+            poolCapacity *= 2;
+        }
+        memcpy(pool + poolSize, name, length);
+        rules[count].poolOffset = (uint32_t)poolSize;
+        rules[count].order = (uint32_t)count;
+        memcpy(rules[count].address, address, sizeof(address));
+        rules[count].family = (uint8_t)family;
+        rules[count].length = (uint8_t)length;
+        rules[count].kind = (uint8_t)kind;
+        poolSize += length;
+        count++;
+        if (count >= UINT32_MAX / 2 || poolSize >= UINT32_MAX - 1024) ok = 0;
+    }
+    fclose(input);
+
+    uint32_t unique = 0;
+    uint32_t* setOf = NULL;
+    AddressTable sets;
+    if (!addressTableInit(&sets)) ok = 0;
+    if (ok) {
+        sortPool = pool;
+        qsort(rules, count, sizeof(CompileRule), compareRules);
+        // 合并：同一(域名, 类型)的各行排序后相邻，地址按行序并入同一个集合
+        for (size_t i = 0; ok && i < count; i++) {
+            const CompileRule* last = unique > 0 ? &rules[unique - 1] : NULL;
+            if (!last || last->kind != rules[i].kind || last->length != rules[i].length ||
+                memcmp(pool + last->poolOffset, pool + rules[i].poolOffset, last->length) != 0) {
+                ok = addressTableCreateSet(&sets) == unique;
+                rules[unique++] = rules[i];
+            }
+            ok = ok && addressTableAdd(&sets, unique - 1, rules[i].family, rules[i].address);
+        }
+        ok = ok && addressTableFinish(&sets);
+        // 内容相同的集合只写一份，各规则经值数组指向合并后的集合
+        setOf = ok ? addressTableIntern(&sets) : NULL;
+        ok = setOf != NULL;
+    }
+
+    // 先写临时文件再改名，正在映射旧镜像的进程不受影响
+    char tempPath[1024];
+    if (ok && snprintf(tempPath, sizeof(tempPath), "%s.tmp", imagePath) >= (int)sizeof(tempPath)) {
+        ok = 0;
+    }
+    if (ok) {
+        FILE* output = fopen(tempPath, "wb");
+        ok = output != NULL;
+        if (ok) {
+            ok = writeImage(output, rules, unique, pool, poolSize, &sets, setOf);
+            ok = (fclose(output) == 0) && ok;
+            if (ok) {
+#ifdef _WIN32
+                ok = MoveFileExA(tempPath, imagePath, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+                ok = rename(tempPath, imagePath) == 0;
+#endif
+            }
+            if (!ok) remove(tempPath);
+        }
+    }
+
+    addressTableFree(&sets);
+    free(setOf);
+    free(rules);
+    free(pool);
+    return ok ? (long)unique : -1;
+}
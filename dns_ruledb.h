@@ -0,0 +1,141 @@
+/**
+ * @file dns_ruledb.h
+ * @brief 预编译规则库的头文件定义
+ * @details 规则库是由域名映射文件离线编译出的二进制镜像，服务器用mmap直接映射后查找，
+ *          启动时不解析文本、不为每条规则分配内存，多个进程可以共用同一份页缓存。
+ *
+ *          镜像布局（所有整数为写入机器的字节序，各段按8字节对齐）：
+ *          RuleDbHeader | RuleDbEntry[entryCount] | uint32_t set[entryCount] |
+ *          RuleDbSlot[slotCount] | AddressSet[setCount] | 地址池 | 域名字符池
+ *          条目按(域名, 规则类型)排序，字符池按同样的顺序存放域名（不含'\0'）；
+ *          哈希槽使用线性探测，哈希值与hashDomain一致，修改哈希函数时必须提升版本号
+ */
+
+#ifndef DNS_RULEDB_H
+#define DNS_RULEDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dns_addrset.h"
+
+#define RULEDB_MAGIC "DNSRULE"       ///< 文件魔数（含结尾'\0'共8字节）
+#define RULEDB_VERSION 2             ///< 镜像格式版本
+#define RULEDB_BYTE_ORDER 0x01020304 ///< 用于检测字节序不一致
+
+#define RULE_EXACT 0                 ///< 精确匹配（TRIE_MATCH_SUFFIX / TRIE_MATCH_WILDCARD见dns_trie.h）
+
+/**
+ * @struct RuleDbHeader
+ * @brief 镜像文件头
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t entryCount;      ///< 规则条数
+    uint32_t suffixCount;     ///< 其中通配符和后缀规则的条数
+    uint32_t slotCount;       ///< 哈希槽数量（2的幂）
+    uint32_t setCount;        ///< 地址集合数
+    uint64_t entriesOffset;
+    uint64_t valuesOffset;
+    uint64_t slotsOffset;
+    uint64_t setsOffset;
+    uint64_t poolOffset;
+    uint64_t poolSize;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+    uint64_t fileSize;
+} RuleDbHeader;
+
+/**
+ * @struct RuleDbEntry
+ * @brief 一条规则
+ */
+typedef struct {
+    uint32_t nameOffset;      ///< 域名在字符池中的偏移
+    uint8_t nameLength;       ///< 域名长度
+    uint8_t kind;             ///< RULE_EXACT / TRIE_MATCH_SUFFIX / TRIE_MATCH_WILDCARD
+    uint16_t reserved;
+} RuleDbEntry;
+
+/**
+ * @struct RuleDbSlot
+ * @brief 哈希槽
+ */
+typedef struct {
+    uint32_t hash;            ///< 规则哈希，0表示空槽
+    uint32_t entry;           ///< 条目下标
+} RuleDbSlot;
+
+/**
+ * @struct RuleDb
+ * @brief 已映射的规则库
+ */
+typedef struct {
+    const void* base;         ///< 映射地址
+    size_t size;              ///< 映射长度
+    const RuleDbEntry* entries;
+    const uint32_t* values;   ///< 地址集合编号，与entries一一对应
+    const RuleDbSlot* slots;
+    const AddressSet* sets;   ///< 地址集合
+    const uint8_t* pool;      ///< 地址池
+    const char* names;
+    uint32_t entryCount;
+    uint32_t suffixCount;
+    uint32_t slotMask;
+    uint32_t setCount;
+    uint64_t poolSize;
+    uint64_t namesSize;
+} RuleDb;
+
+/**
+ * @brief 解析域名映射文件的一行
+ * @param line 行内容（会被修改）
+ * @param name 输出规范化后的域名，至少DNS_MAX_NAME_LEN + 1字节
+ * @param kind 输出规则类型：RULE_EXACT、TRIE_MATCH_SUFFIX（".example.com"）
+ *             或TRIE_MATCH_WILDCARD（"*.example.com"）
+ * @param family 输出地址族：AF_INET或AF_INET6
+ * @param address 输出地址（网络字节序），至少16字节
+ * @return 规范化域名的长度，空行或无效行返回0
+ */
+size_t parseRuleLine(char* line, char* name, int* kind, int* family, uint8_t* address);
+
+/**
+ * @brief 判断文件是否为规则库镜像
+ */
+int ruleDbIsImage(const char* path);
+
+/**
+ * @brief 映射并校验规则库镜像
+ * @param path 镜像路径
+ * @return 规则库，失败返回NULL
+ */
+RuleDb* ruleDbOpen(const char* path);
+
+/**
+ * @brief 解除映射并释放规则库
+ */
+void ruleDbClose(RuleDb* db);
+
+/**
+ * @brief 查找最具体的匹配规则
+ * @param db 规则库
+ * @param name 规范化后的查询域名
+ * @param length 域名长度
+ * @param set 输出地址集合编号（小于db->setCount）
+ * @return 找到返回1，否则返回0
+ * @details 依次尝试精确匹配、本名的后缀规则，再逐级去掉最左边的标签尝试通配符和后缀规则，
+ *          与文本加载时DomainIndex + SuffixTrie的结果一致。不分配内存
+ */
+int ruleDbLookup(const RuleDb* db, const char* name, size_t length, uint32_t* set);
+
+/**
+ * @brief 把域名映射文件编译为规则库镜像
+ * @param textPath 域名映射文件
+ * @param imagePath 输出镜像路径
+ * @return 成功返回写入的规则条数，失败返回-1
+ * @details 同一(域名, 规则类型)出现多次时合并为一个地址集合，与文本加载的行为一致
+ */
+long ruleDbCompile(const char* textPath, const char* imagePath);
+
+#endif // DNS_RULEDB_H
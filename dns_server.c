@@ -1,309 +1,930 @@
-#include "dns_server.h"
-#include "dns_message.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <process.h>
-#include <string.h>
-#include <time.h>
-
-// 优化日志函数，支持时间戳、线程ID、日志级别、16进制数据
-void debug_log_hex(const char* prefix, const void* data, int len) {
-    FILE* log_file = fopen("dns_debug.log", "a");
-    if (!log_file) return;
-    // 时间戳
-    time_t now = time(NULL);
-    struct tm* t = localtime(&now);
-    fprintf(log_file, "[%04d-%02d-%02d %02d:%02d:%02d][TID:%lu][HEX] %s: ",
-        t->tm_year+1900, t->tm_mon+1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec,
-        (unsigned long)GetCurrentThreadId(), prefix);
-    for (int i = 0; i < len; ++i) {
-        fprintf(log_file, "%02X ", ((unsigned char*)data)[i]);
-    }
-    fprintf(log_file, "\n");
-    fclose(log_file);
-}
-
-void debug_log(const char* format, ...) {
-    FILE* log_file = fopen("dns_debug.log", "a");
-    if (!log_file) return;
-    // 时间戳
-    time_t now = time(NULL);
-    struct tm* t = localtime(&now);
-    fprintf(log_file, "[%04d-%02d-%02d %02d:%02d:%02d][TID:%lu][INFO] ",
-        t->tm_year+1900, t->tm_mon+1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec,
-        (unsigned long)GetCurrentThreadId());
-    va_list args;
-    va_start(args, format);
-    vfprintf(log_file, format, args);
-    va_end(args);
-    fprintf(log_file, "\n");
-    fclose(log_file);
-}
-
-DNSServer* createServer(void) {
-    debug_log("开始创建服务器");
-    DNSServer* server = (DNSServer*)malloc(sizeof(DNSServer));
-    if (!server) {
-        debug_log("内存分配失败");
-        return NULL;
-    }
-
-    server->sockfd = INVALID_SOCKET;
-    server->resolver = createResolver();
-    server->initialized = 0;
-
-    if (!server->resolver) {
-        debug_log("创建解析器失败");
-        free(server);
-        return NULL;
-    }
-
-    debug_log("服务器创建成功");
-    return server;
-}
-
-void destroyServer(DNSServer* server) {
-    if (!server) return;
-
-    if (server->sockfd != INVALID_SOCKET) {
-        closesocket(server->sockfd);
-    }
-    if (server->initialized) {
-        WSACleanup();
-    }
-    if (server->resolver) {
-        destroyResolver(server->resolver);
-    }
-    free(server);
-}
-
-int initServer(DNSServer* server, int port) {
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        fprintf(stderr, "WSAStartup failed: %d\n", WSAGetLastError());
-        return 0;
-    }
-    server->initialized = 1;
-
-    server->sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (server->sockfd == INVALID_SOCKET) {
-        fprintf(stderr, "Socket creation failed: %d\n", WSAGetLastError());
-        return 0;
-    }
-
-    struct sockaddr_in serverAddr;
-    memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(port);
-
-    if (bind(server->sockfd, (struct sockaddr*)&serverAddr, 
-             sizeof(serverAddr)) == SOCKET_ERROR) {
-        fprintf(stderr, "Bind failed: %d\n", WSAGetLastError());
-        return 0;
-    }
-
-    printf("DNS server running on port %d\n", port);
-    return 1;
-}
-
-int loadDomainFile(DNSServer* server, const char* filename) {
-    if (!loadDomainMap(server->resolver, filename)) {
-        fprintf(stderr, "Failed to load domain-IP mapping file: %s\n", filename);
-        return 0;
-    }
-    printf("Successfully loaded domain-IP mapping file\n");
-    return 1;
-}
-
-// 查询处理线程函数
-unsigned __stdcall queryHandler(void* arg) {
-    struct {
-        DNSServer* server;
-        char* buffer;
-        size_t length;
-        struct sockaddr_in clientAddr;
-    }* params = (struct {
-        DNSServer* server;
-        char* buffer;
-        size_t length;
-        struct sockaddr_in clientAddr;
-    }*)arg;
-
-    handleQuery(params->server, params->buffer, params->length, &params->clientAddr);
-    free(params->buffer);
-    free(params);
-    return 0;
-}
-
-// 中继功能：转发DNS请求到外部DNS服务器
-int relayToExternalDNS(const char* request, int reqLen, char* response, int* respLen) {
-    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock == INVALID_SOCKET) {
-        debug_log("中继socket创建失败: %d", WSAGetLastError());
-        return 0;
-    }
-    struct sockaddr_in dest;
-    dest.sin_family = AF_INET;
-    dest.sin_port = htons(53);
-    dest.sin_addr.s_addr = inet_addr("8.8.8.8"); // 可根据需要更换外部DNS
-
-    int ret = sendto(sock, request, reqLen, 0, (struct sockaddr*)&dest, sizeof(dest));
-    if (ret == SOCKET_ERROR) {
-        debug_log("中继sendto失败: %d", WSAGetLastError());
-        closesocket(sock);
-        return 0;
-    }
-
-    struct sockaddr_in from;
-    int fromlen = sizeof(from);
-    int len = recvfrom(sock, response, 512, 0, (struct sockaddr*)&from, &fromlen);
-    if (len == SOCKET_ERROR) {
-        debug_log("中继recvfrom失败: %d", WSAGetLastError());
-        closesocket(sock);
-        return 0;
-    }
-    closesocket(sock);
-    *respLen = len;
-    return 1;
-}
-
-void handleQuery(DNSServer* server, const char* buffer, size_t length, 
-                const struct sockaddr_in* clientAddr) {
-    debug_log("开始处理查询");
-    
-    if (!server || !buffer || !clientAddr) {
-        debug_log("无效的参数");
-        return;
-    }
-
-    if (length < sizeof(struct DNSHeader)) {
-        debug_log("DNS查询包太短");
-        return;
-    }
-
-    uint16_t originalId = ntohs(((struct DNSHeader*)buffer)->id);
-    char* domain = extractDomain(buffer, length);
-
-    if (!domain) {
-        debug_log("无法提取域名");
-        return;
-    }
-
-    debug_log("查询域名: %s", domain);
-
-    int isBlocked = 0;
-    char* ip = resolveLocally(server->resolver, domain, &isBlocked);
-    char* response = NULL;
-    size_t responseLength = 0;
-
-    if (isBlocked) {
-        debug_log("域名被屏蔽: %s", domain);
-        response = buildDNSResponse(originalId, domain, "", 1, &responseLength);
-    } else if (ip) {
-        debug_log("本地解析: %s -> %s", domain, ip);
-        response = buildDNSResponse(originalId, domain, ip, 0, &responseLength);
-        free(ip);
-    } else {
-        debug_log("转发查询: %s", domain);
-        // 新增：真正的中继功能
-        char relayResp[512];
-        int relayLen = 0;
-        if (relayToExternalDNS(buffer, (int)length, relayResp, &relayLen)) {
-            debug_log("已中继外部DNS响应，长度: %d", relayLen);
-            sendto(server->sockfd, relayResp, relayLen, 0, (struct sockaddr*)clientAddr, sizeof(*clientAddr));
-            free(domain);
-            debug_log("查询处理完成");
-            return;
-        } else {
-            debug_log("中继外部DNS失败: %s", domain);
-            response = buildDNSResponse(originalId, domain, "", 1, &responseLength);
-        }
-    }
-
-    if (response) {
-        debug_log("发送响应");
-        int sent = sendto(server->sockfd, response, (int)responseLength, 0,
-                         (struct sockaddr*)clientAddr, sizeof(*clientAddr));
-        if (sent == SOCKET_ERROR) {
-            debug_log("发送响应失败: %d", WSAGetLastError());
-        }
-        free(response);
-    }
-
-    free(domain);
-    debug_log("查询处理完成");
-}
-
-int startServer(DNSServer* server) {
-    if (!server) {
-        debug_log("服务器未初始化");
-        return 0;
-    }
-
-    debug_log("服务器开始监听");
-    
-    while (1) {
-        char* buffer = (char*)malloc(1024);
-        if (!buffer) {
-            debug_log("内存分配失败");
-            continue;
-        }
-
-        struct sockaddr_in clientAddr;
-        int clientLen = sizeof(clientAddr);
-
-        debug_log("等待接收数据");
-        int recvLen = recvfrom(server->sockfd, buffer, 1024, 0,
-                              (struct sockaddr*)&clientAddr, &clientLen);
-        if (recvLen == SOCKET_ERROR) {
-            debug_log("接收数据失败: %d", WSAGetLastError());
-            free(buffer);
-            continue;
-        }
-
-        if (recvLen == 0) {
-            debug_log("收到空数据包");
-            free(buffer);
-            continue;
-        }
-
-        debug_log("收到数据包，长度: %d", recvLen);
-        debug_log_hex("收到DNS请求", buffer, recvLen);
-
-        // 创建查询处理线程
-        struct {
-            DNSServer* server;
-            char* buffer;
-            size_t length;
-            struct sockaddr_in clientAddr;
-        }* params = (struct {
-            DNSServer* server;
-            char* buffer;
-            size_t length;
-            struct sockaddr_in clientAddr;
-        }*)malloc(sizeof(*params));
-
-        if (!params) {
-            debug_log("内存分配失败");
-            free(buffer);
-            continue;
-        }
-
-        params->server = server;
-        params->buffer = buffer;
-        params->length = recvLen;
-        params->clientAddr = clientAddr;
-
-        debug_log("创建处理线程");
-        HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, queryHandler, params, 0, NULL);
-        if (!thread) {
-            debug_log("创建线程失败");
-            free(params);
-            free(buffer);
-            continue;
-        }
-        CloseHandle(thread);
-    }
-    return 1;
-} 
\ No newline at end of file
+#include "dns_server.h"
+#include "dns_message.h"
+#include "dns_qname.h"
+#include "dns_log.h"
+#include "dns_metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DNS_HAVE_MMSG
+#include <sys/uio.h>
+#endif
+
+DNSServer* createServer(void) {
+    dnsLog(DNS_LOG_INFO, "开始创建服务器");
+    DNSServer* server = (DNSServer*)malloc(sizeof(DNSServer));
+    if (!server) {
+        dnsLog(DNS_LOG_ERROR, "内存分配失败");
+        return NULL;
+    }
+
+    server->sockfd = INVALID_SOCKET;
+    server->resolver = createResolver();
+    server->initialized = 0;
+    server->running = 0;
+    server->config.workerCount = 0;
+    server->config.batchSize = DEFAULT_BATCH_SIZE;
+    server->workers = NULL;
+    server->workerCount = 0;
+    server->cache = NULL;
+    atomic_init(&server->reloadRequested, 0);
+    initForwarderConfig(&server->config.forward);
+    server->config.cacheBytes = CACHE_DEFAULT_BYTES;
+    server->config.cacheShards = 0;
+    server->config.staleSeconds = CACHE_DEFAULT_STALE;
+    server->config.pinWorkers = 0;
+    server->config.statsPort = 0;
+    server->config.tcpConnections = TCP_DEFAULT_CONNECTIONS;
+    server->config.rateLimit.rate = 0;
+    server->config.rateLimit.burst = 0;
+    server->config.rateLimit.slip = RATE_DEFAULT_SLIP;
+    server->config.capturePath = NULL;
+    server->config.captureBytes = CAPTURE_DEFAULT_BYTES;
+    server->stats = NULL;
+    server->capture = NULL;
+
+    if (!server->resolver) {
+        dnsLog(DNS_LOG_ERROR, "创建解析器失败");
+        free(server);
+        return NULL;
+    }
+
+    dnsLog(DNS_LOG_INFO, "服务器创建成功");
+    return server;
+}
+
+static void freeWorker(DNSWorker* worker) {
+    if (worker->tcp) {
+        destroyTcpServer(worker->tcp);
+    }
+    destroyForwarder(worker->forwarder);
+    destroyRateLimiter(worker->limiter);
+    if (worker->loop) {
+        eventLoopDestroy(worker->loop);
+    }
+    arenaDestroy(&worker->arena);
+}
+
+void destroyServer(DNSServer* server) {
+    if (!server) return;
+
+    if (server->stats) {
+        destroyStatsEndpoint(server->stats);
+    }
+    if (server->cache) {
+        destroyCache(server->cache);
+    }
+
+    if (server->workers) {
+        SOCKET sharedTcp = server->workers[0].tcpSock;
+        for (int i = 0; i < server->workerCount; i++) {
+            DNSWorker* worker = &server->workers[i];
+            // 先注销TCP连接，再关闭监听套接字
+            freeWorker(worker);
+            if (worker->sock != INVALID_SOCKET && worker->sock != server->sockfd) {
+                closesocket(worker->sock);
+            }
+            if (worker->tcpSock != INVALID_SOCKET && worker->tcpSock != sharedTcp) {
+                closesocket(worker->tcpSock);
+            }
+        }
+        if (sharedTcp != INVALID_SOCKET) {
+            closesocket(sharedTcp);
+        }
+        free(server->workers);
+    }
+    // 工作线程都已停止，不会再写入
+    destroyCapture(server->capture);
+    if (server->sockfd != INVALID_SOCKET) {
+        closesocket(server->sockfd);
+    }
+    if (server->initialized) {
+        dnsNetCleanup();
+    }
+    if (server->resolver) {
+        destroyResolver(server->resolver);
+    }
+    free(server);
+}
+
+// 创建并绑定一个非阻塞的UDP或TCP监听套接字
+static SOCKET createListenSocket(int port, int type, int reusePort) {
+    SOCKET sock = socket(AF_INET, type, type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        fprintf(stderr, "Socket creation failed: %d\n", dnsSocketError());
+        return INVALID_SOCKET;
+    }
+    if (type == SOCK_STREAM) {
+        // 重启时不必等待旧连接的TIME_WAIT结束
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+    }
+
+#ifdef DNS_HAVE_REUSEPORT
+    if (reusePort) {
+        int one = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+            fprintf(stderr, "SO_REUSEPORT failed: %d\n", dnsSocketError());
+            closesocket(sock);
+            return INVALID_SOCKET;
+        }
+    }
+#else
+    (void)reusePort;
+#endif
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr*)&serverAddr, 
+             sizeof(serverAddr)) == SOCKET_ERROR) {
+        fprintf(stderr, "Bind failed: %d\n", dnsSocketError());
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    if (type == SOCK_STREAM && listen(sock, SOMAXCONN) == SOCKET_ERROR) {
+        fprintf(stderr, "Listen failed: %d\n", dnsSocketError());
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+
+    if (!dnsSetNonBlocking(sock)) {
+        fprintf(stderr, "Set non-blocking failed: %d\n", dnsSocketError());
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+// 为工作线程预分配报文环，报文环和消息数组放在本线程的一块连续内存中
+static int initWorker(DNSWorker* worker, DNSServer* server, int id) {
+    size_t batch = (size_t)server->config.batchSize;
+
+    worker->server = server;
+    worker->id = id;
+    worker->loop = eventLoopCreate();
+    arenaInit(&worker->arena, 2 * batch * DNS_PACKET_SIZE + ARENA_DEFAULT_CHUNK);
+    worker->rxBuffers = (char*)arenaAlloc(&worker->arena, batch * DNS_PACKET_SIZE);
+    worker->txBuffers = (char*)arenaAlloc(&worker->arena, batch * DNS_PACKET_SIZE);
+    worker->rxAddrs = (struct sockaddr_in*)arenaCalloc(&worker->arena, batch, sizeof(struct sockaddr_in));
+    if (!worker->loop || !worker->rxBuffers || !worker->txBuffers || !worker->rxAddrs) {
+        return 0;
+    }
+    if (server->config.rateLimit.rate > 0) {
+        worker->limiter = createRateLimiter(&server->config.rateLimit, RATE_DEFAULT_BUCKETS);
+        if (!worker->limiter) return 0;
+    }
+
+#ifdef DNS_HAVE_MMSG
+    struct mmsghdr* rxMsgs = (struct mmsghdr*)arenaCalloc(&worker->arena, batch, sizeof(struct mmsghdr));
+    struct mmsghdr* txMsgs = (struct mmsghdr*)arenaCalloc(&worker->arena, batch, sizeof(struct mmsghdr));
+    struct iovec* iovs = (struct iovec*)arenaCalloc(&worker->arena, batch * 2, sizeof(struct iovec));
+    worker->rxMsgs = rxMsgs;
+    worker->txMsgs = txMsgs;
+    worker->iovecs = iovs;
+    if (!rxMsgs || !txMsgs || !iovs) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < batch; i++) {
+        iovs[i].iov_base = worker->rxBuffers + i * DNS_PACKET_SIZE;
+        iovs[i].iov_len = DNS_PACKET_SIZE;
+        rxMsgs[i].msg_hdr.msg_iov = &iovs[i];
+        rxMsgs[i].msg_hdr.msg_iovlen = 1;
+
+        iovs[batch + i].iov_base = worker->txBuffers + i * DNS_PACKET_SIZE;
+        txMsgs[i].msg_hdr.msg_iov = &iovs[batch + i];
+        txMsgs[i].msg_hdr.msg_iovlen = 1;
+        txMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+#else
+    worker->rxMsgs = NULL;
+    worker->txMsgs = NULL;
+    worker->iovecs = NULL;
+#endif
+    return 1;
+}
+
+// 开启抓包时把一次应答写入调用线程的抓包段
+static void captureExchange(DNSServer* server, int segment, const ForwardClient* client, MetricPath path,
+                            uint64_t startNs, uint64_t latencyNs, const char* query, size_t queryLength,
+                            const char* response, size_t responseLength) {
+    CaptureFrame info;
+    memset(&info, 0, sizeof(info));
+    info.timestampNs = startNs;
+    info.latencyNs = latencyNs > UINT32_MAX ? UINT32_MAX : (uint32_t)latencyNs;
+    info.client = client->addr.sin_addr.s_addr;
+    info.clientPort = client->addr.sin_port;
+    info.path = (uint8_t)path;
+    info.transport = client->stream != 0 ? CAPTURE_TCP : CAPTURE_UDP;
+    captureRecord(server->capture, segment, &info, query, queryLength, response, responseLength);
+}
+
+#ifdef DNS_HAVE_MMSG
+
+// 用sendmmsg发出发送环中前count个应答
+static void sendBatch(DNSWorker* worker, SOCKET sock, int count) {
+    struct mmsghdr* txMsgs = (struct mmsghdr*)worker->txMsgs;
+    int sent = 0;
+    while (sent < count) {
+        int n = sendmmsg(sock, txMsgs + sent, (unsigned int)(count - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            metricsAdd(METRIC_SEND_ERRORS, (uint64_t)(count - sent));
+            dnsLog(DNS_LOG_WARN, "发送响应失败: %d", dnsSocketError());
+            break;
+        }
+        sent += n;
+    }
+}
+
+// 转发器一轮事件处理完时发出攒下的UDP应答
+static void flushResumed(void* ctx) {
+    DNSWorker* worker = (DNSWorker*)ctx;
+    if (worker->resumed > 0) {
+        sendBatch(worker, worker->sock, worker->resumed);
+        worker->resumed = 0;
+    }
+}
+
+// UDP应答已写入发送环的下一个槽位：记下客户端地址，发送环满时先发出一批。
+// 转发器回调时接收环空闲，客户端地址暂存在对应的接收地址槽位中
+static void sendResumed(DNSWorker* worker, const struct sockaddr_in* addr, size_t length) {
+    struct mmsghdr* txMsgs = (struct mmsghdr*)worker->txMsgs;
+    worker->rxAddrs[worker->resumed] = *addr;
+    txMsgs[worker->resumed].msg_hdr.msg_name = &worker->rxAddrs[worker->resumed];
+    txMsgs[worker->resumed].msg_hdr.msg_iov->iov_len = length;
+    if (++worker->resumed == worker->server->config.batchSize) {
+        flushResumed(worker);
+    }
+}
+
+#else
+
+static void flushResumed(void* ctx) {
+    (void)ctx;
+}
+
+static void sendResumed(DNSWorker* worker, const struct sockaddr_in* addr, size_t length) {
+    int sent = sendto(worker->sock, worker->txBuffers, (int)length, 0,
+                      (const struct sockaddr*)addr, sizeof(*addr));
+    if (sent == SOCKET_ERROR) {
+        metricsIncrement(METRIC_SEND_ERRORS);
+        dnsLog(DNS_LOG_WARN, "发送响应失败: %d", dnsSocketError());
+    }
+}
+
+#endif
+
+// 转发结果回调：上游应答到达或放弃后，在收到查询的工作线程中继续处理挂起的查询。
+// 写缓存，构造应答（失败时SERVFAIL）并发回客户端；后台刷新只更新缓存。
+// 应答在发送环的下一个槽位中构造，TCP应答随即复制进连接，槽位只被UDP应答占用
+static void onForwardResult(void* userData, const ForwardClient* client,
+                            const char* query, size_t queryLength,
+                            const char* response, size_t responseLength) {
+    DNSWorker* worker = (DNSWorker*)userData;
+    DNSServer* server = worker->server;
+    char* slot = worker->txBuffers + (size_t)worker->resumed * DNS_PACKET_SIZE;
+    MetricPath path = PATH_RELAYED;
+
+    // 后台刷新没有等待应答的客户端；失败时保留原条目，过期数据在serve-stale窗口内继续可用
+    if (client->refresh) {
+        if (response && server->cache && !client->coalesced) {
+            cacheStore(server->cache, query, queryLength, response, responseLength);
+        }
+        return;
+    }
+
+    if (response) {
+        dnsLog(DNS_LOG_DEBUG, "已中继外部DNS响应，长度: %d", (int)responseLength);
+        if (server->cache && !client->coalesced) {
+            cacheStore(server->cache, query, queryLength, response, responseLength);
+        }
+    } else {
+        dnsLog(DNS_LOG_WARN, "中继外部DNS失败");
+        if (server->cache && !client->coalesced) {
+            cacheStoreFailure(server->cache, query, queryLength);
+        }
+        responseLength = buildErrorResponse(query, queryLength, DNS_RCODE_SERVFAIL, slot, DNS_PACKET_SIZE);
+        response = slot;
+        path = PATH_FAILED;
+        if (responseLength == 0) return;
+    }
+
+    if (client->stream != 0) {
+        // 连接在应答送达前已关闭时应答被丢弃
+        if (!worker->tcp || !tcpServerReply(worker->tcp, client->stream, response, responseLength)) return;
+    } else {
+        // 经TCP从上游取回的完整应答可能超出UDP客户端的上限
+        if (responseLength > client->maxLength) {
+            responseLength = truncateResponse(response, responseLength, client->maxLength, slot, DNS_PACKET_SIZE);
+            if (responseLength == 0) return;
+            metricsIncrement(METRIC_TRUNCATED);
+        } else if (response != slot) {
+            memcpy(slot, response, responseLength);
+        }
+        response = slot;
+        sendResumed(worker, &client->addr, responseLength);
+    }
+
+    uint64_t latencyNs = dnsNowNs() - client->startNs;
+    metricsRecordLatency(path, latencyNs);
+    if (server->capture) {
+        captureExchange(server, worker->id, client, path, client->startNs, latencyNs,
+                        query, queryLength, response, responseLength);
+    }
+}
+
+// 缓存数据已应答客户端，再把查询转发到上游在后台刷新该条目
+static void refreshCache(DNSServer* server, const char* query, size_t length,
+                         const ForwardClient* origin, uint16_t id) {
+    ForwardClient client = *origin;
+    client.id = id;
+    client.startNs = dnsNowNs();
+    client.coalesced = 0;
+    client.stream = 0;
+    client.maxLength = DNS_TCP_MAX_MESSAGE;
+    client.refresh = 1;
+    if (forwardQuery(server->workers[origin->worker].forwarder, query, length, &client)) {
+        metricsIncrement(METRIC_CACHE_REFRESHES);
+    }
+}
+
+// TCP查询回调：与UDP走同一处理流程，转发的查询在本线程的转发器回调中应答
+static size_t onTcpQuery(void* ctx, const char* query, size_t length, uint32_t stream,
+                         const struct sockaddr_in* peer, char* response, size_t responseSize) {
+    DNSWorker* worker = (DNSWorker*)ctx;
+    ForwardClient origin;
+    memset(&origin, 0, sizeof(origin));
+    origin.sock = INVALID_SOCKET;
+    origin.addr = *peer;
+    origin.stream = stream;
+    origin.worker = worker->id;
+    size_t replyLength = handleQuery(worker->server, query, length, &origin, response, responseSize);
+    return replyLength == QUERY_FORWARDED ? TCP_REPLY_DEFERRED : replyLength;
+}
+
+// 汇总各工作线程转发器中的上游状态：计数相加，平滑RTT取有样本的线程的平均值，
+// 连续超时次数取最大值，任一线程剔除即视为剔除
+static int collectUpstreamStatus(DNSServer* server, UpstreamStatus* total) {
+    UpstreamStatus status[FORWARD_MAX_UPSTREAMS];
+    uint64_t srttSum[FORWARD_MAX_UPSTREAMS];
+    int srttSamples[FORWARD_MAX_UPSTREAMS];
+    int count = 0;
+
+    for (int w = 0; w < server->workerCount; w++) {
+        int n = getUpstreamStatus(server->workers[w].forwarder, status, FORWARD_MAX_UPSTREAMS);
+        for (int i = 0; i < n; i++) {
+            if (i >= count) {
+                total[i] = status[i];
+                total[i].queries = 0;
+                total[i].answers = 0;
+                total[i].timeouts = 0;
+                srttSum[i] = 0;
+                srttSamples[i] = 0;
+                count = i + 1;
+            }
+            total[i].queries += status[i].queries;
+            total[i].answers += status[i].answers;
+            total[i].timeouts += status[i].timeouts;
+            if (status[i].failures > total[i].failures) total[i].failures = status[i].failures;
+            total[i].evicted |= status[i].evicted;
+            if (status[i].srttUs > 0) {
+                srttSum[i] += status[i].srttUs;
+                srttSamples[i]++;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        total[i].srttUs = srttSamples[i] > 0 ? (uint32_t)(srttSum[i] / (uint64_t)srttSamples[i]) : 0;
+    }
+    return count;
+}
+
+// 统计端口回调：汇总各线程指标，并附加缓存和日志的统计
+static size_t renderStats(void* userData, char* buffer, size_t size) {
+    static MetricsSnapshot snapshot;  // 只在统计线程中使用
+    DNSServer* server = (DNSServer*)userData;
+
+    metricsCollect(&snapshot);
+    size_t pos = metricsFormatPrometheus(&snapshot, buffer, size);
+
+    if (server->cache) {
+        CacheStats stats;
+        cacheGetStats(server->cache, &stats);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_entries", "gauge", "缓存条目数", stats.entries);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_bytes", "gauge", "缓存占用字节数", stats.bytes);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_evictions_total", "counter",
+                           "容量不足而淘汰的缓存条目", stats.evictions);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_expired_total", "counter",
+                           "过期而删除的缓存条目", stats.expired);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_stale_total", "counter",
+                           "用过期数据应答的缓存命中", stats.stale);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_prefetches_total", "counter",
+                           "临近过期而预取的缓存条目", stats.prefetches);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_negative_inserts_total", "counter",
+                           "写入缓存的NXDOMAIN和NODATA应答", stats.negative);
+        metricsAppendValue(buffer, size, &pos, "dns_cache_failure_inserts_total", "counter",
+                           "上游失败后写入缓存的SERVFAIL", stats.failures);
+    }
+    metricsAppendValue(buffer, size, &pos, "dns_log_dropped_total", "counter",
+                       "日志缓冲区已满而丢弃的日志", dnsLogDropped());
+
+    if (server->workers && server->workers[0].forwarder) {
+        UpstreamStatus upstreams[FORWARD_MAX_UPSTREAMS];
+        int count = collectUpstreamStatus(server, upstreams);
+        char labels[FORWARD_MAX_UPSTREAMS][64];
+        for (int i = 0; i < count; i++) {
+            snprintf(labels[i], sizeof(labels[i]), "upstream=\"%s:%u\"",
+                     inet_ntoa(upstreams[i].addr.sin_addr), (unsigned)ntohs(upstreams[i].addr.sin_port));
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_srtt_seconds", "gauge", "上游平滑RTT");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_srtt_seconds", labels[i],
+                                (double)upstreams[i].srttUs / 1e6);
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_failures", "gauge", "上游连续超时次数");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_failures", labels[i],
+                                upstreams[i].failures);
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_evicted", "gauge", "上游是否处于剔除期");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_evicted", labels[i],
+                                upstreams[i].evicted);
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_queries_total", "counter",
+                            "发往上游的查询（含重试和对冲）");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_queries_total", labels[i],
+                                (double)upstreams[i].queries);
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_answers_total", "counter", "采用的上游应答");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_answers_total", labels[i],
+                                (double)upstreams[i].answers);
+        }
+        metricsAppendFamily(buffer, size, &pos, "dns_upstream_attempt_timeouts_total", "counter",
+                            "上游未能及时应答的次数");
+        for (int i = 0; i < count; i++) {
+            metricsAppendSample(buffer, size, &pos, "dns_upstream_attempt_timeouts_total", labels[i],
+                                (double)upstreams[i].timeouts);
+        }
+    }
+    return pos;
+}
+
+int initServer(DNSServer* server, int port) {
+    if (!dnsNetInit()) {
+        fprintf(stderr, "Network init failed: %d\n", dnsSocketError());
+        return 0;
+    }
+    server->initialized = 1;
+
+    if (server->config.batchSize <= 0) {
+        server->config.batchSize = DEFAULT_BATCH_SIZE;
+    }
+    int workerCount = server->config.workerCount;
+    if (workerCount <= 0) {
+        workerCount = dnsCpuCount();
+    }
+
+    server->workers = (DNSWorker*)calloc((size_t)workerCount, sizeof(DNSWorker));
+    if (!server->workers) {
+        fprintf(stderr, "Worker allocation failed\n");
+        return 0;
+    }
+    server->workerCount = workerCount;
+    for (int i = 0; i < workerCount; i++) {
+        server->workers[i].sock = INVALID_SOCKET;
+        server->workers[i].tcpSock = INVALID_SOCKET;
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        DNSWorker* worker = &server->workers[i];
+        if (!initWorker(worker, server, i)) {
+            fprintf(stderr, "Worker %d init failed\n", i);
+            return 0;
+        }
+
+#ifdef DNS_HAVE_REUSEPORT
+        // 每个工作线程独占一个SO_REUSEPORT套接字，由内核在线程间分流
+        worker->sock = createListenSocket(port, SOCK_DGRAM, 1);
+#else
+        // 不支持SO_REUSEPORT分流时所有工作线程共享同一个套接字
+        worker->sock = (i == 0) ? createListenSocket(port, SOCK_DGRAM, 0) : server->workers[0].sock;
+#endif
+        if (worker->sock == INVALID_SOCKET) {
+            return 0;
+        }
+        if (i == 0) {
+            server->sockfd = worker->sock;
+        }
+
+        if (server->config.tcpConnections > 0) {
+#ifdef DNS_HAVE_REUSEPORT
+            worker->tcpSock = createListenSocket(port, SOCK_STREAM, 1);
+#else
+            worker->tcpSock = (i == 0) ? createListenSocket(port, SOCK_STREAM, 0) : server->workers[0].tcpSock;
+#endif
+            if (worker->tcpSock == INVALID_SOCKET) {
+                return 0;
+            }
+        }
+    }
+
+    if (server->config.cacheBytes > 0) {
+        int shards = server->config.cacheShards > 0 ? server->config.cacheShards : workerCount;
+        server->cache = createCache(server->config.cacheBytes, shards, server->config.staleSeconds);
+        if (!server->cache) {
+            fprintf(stderr, "Cache init failed\n");
+            return 0;
+        }
+    }
+
+    // 每个工作线程一个转发器，在途上限按线程平分，总的在途数和内存与单个转发器相同
+    ForwarderConfig forward = server->config.forward;
+    if (forward.maxInflight <= 0) forward.maxInflight = FORWARD_DEFAULT_INFLIGHT;
+    forward.maxInflight = (forward.maxInflight + workerCount - 1) / workerCount;
+    if (forward.maxInflight < FORWARD_MIN_INFLIGHT) forward.maxInflight = FORWARD_MIN_INFLIGHT;
+    for (int i = 0; i < workerCount; i++) {
+        DNSWorker* worker = &server->workers[i];
+        worker->forwarder = createForwarder(worker->loop, &forward, onForwardResult, flushResumed, worker);
+        if (!worker->forwarder) {
+            fprintf(stderr, "Forwarder init failed\n");
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < workerCount && server->config.tcpConnections > 0; i++) {
+        DNSWorker* worker = &server->workers[i];
+        worker->tcp = createTcpServer(worker->loop, worker->tcpSock, server->config.tcpConnections,
+                                      onTcpQuery, worker);
+        if (!worker->tcp) {
+            fprintf(stderr, "TCP listener init failed\n");
+            return 0;
+        }
+    }
+
+    if (server->config.statsPort > 0) {
+        server->stats = createStatsEndpoint(server->config.statsPort, renderStats, server);
+        if (!server->stats) {
+            fprintf(stderr, "Stats endpoint init failed on port %d\n", server->config.statsPort);
+            return 0;
+        }
+    }
+
+    printf("DNS server running on port %d (%d workers%s, batch %d, %d cache shards, %s)\n",
+           port, workerCount, server->config.pinWorkers ? " pinned" : "", server->config.batchSize,
+           server->cache ? cacheShardCount(server->cache) : 0,
+           server->config.tcpConnections > 0 ? "UDP+TCP" : "UDP only");
+    if (server->config.capturePath) {
+        // 每个工作线程一段，转发完成的查询也在收到它的工作线程中记录
+        server->capture = createCapture(server->config.capturePath, server->config.captureBytes, workerCount);
+        if (!server->capture) {
+            fprintf(stderr, "Capture file init failed: %s\n", server->config.capturePath);
+            return 0;
+        }
+        printf("Capturing queries to %s (%lu bytes)\n", server->config.capturePath,
+               (unsigned long)server->capture->size);
+    }
+    if (server->config.rateLimit.rate > 0) {
+        const RateLimitConfig* limit = &server->config.rateLimit;
+        printf("UDP rate limit: %u queries/s per client, burst %u, slip %u\n", limit->rate,
+               limit->burst ? limit->burst : limit->rate, limit->slip);
+    }
+    return 1;
+}
+
+int loadDomainFile(DNSServer* server, const char* filename) {
+    if (!loadDomainMap(server->resolver, filename)) {
+        fprintf(stderr, "Failed to load domain-IP mapping file: %s\n", filename);
+        return 0;
+    }
+    printf("Successfully loaded domain-IP mapping file\n");
+    return 1;
+}
+
+// 查询处理完毕：记录延迟，开启抓包时写入本工作线程的抓包段，返回应答长度
+static size_t finishQuery(DNSServer* server, const ForwardClient* origin, MetricPath path, uint64_t startNs,
+                          const char* query, size_t length, const char* response, size_t replyLength) {
+    uint64_t latencyNs = dnsNowNs() - startNs;
+    metricsRecordLatency(path, latencyNs);
+    if (server->capture && replyLength > 0) {
+        captureExchange(server, origin->worker, origin, path, startNs, latencyNs,
+                        query, length, response, replyLength);
+    }
+    return replyLength;
+}
+
+size_t handleQuery(DNSServer* server, const char* buffer, size_t length,
+                   const ForwardClient* origin, char* response, size_t responseSize) {
+    if (!server || !buffer || !origin || !response) {
+        dnsLog(DNS_LOG_ERROR, "无效的参数");
+        return 0;
+    }
+
+    uint64_t startNs = dnsNowNs();
+    metricsIncrement(METRIC_QUERIES);
+
+    if (length < sizeof(struct DNSHeader)) {
+        metricsIncrement(METRIC_MALFORMED);
+        dnsLog(DNS_LOG_DEBUG, "DNS查询包太短");
+        return 0;
+    }
+
+    dnsLogHex(DNS_LOG_TRACE, "收到DNS请求", buffer, length);
+
+    DNSQuestion question;
+    char domain[DNS_MAX_NAME_LEN + 1];
+    size_t replyLength;
+    if (!parseDNSQuery(buffer, length, &question)) {
+        metricsIncrement(METRIC_MALFORMED);
+        dnsLog(DNS_LOG_DEBUG, "无法提取域名");
+        replyLength = buildErrorResponse(buffer, length, DNS_RCODE_FORMERR, response, responseSize);
+        return finishQuery(server, origin, PATH_FAILED, startNs, buffer, length, response, replyLength);
+    }
+    // 收到的是应答而不是查询：丢弃，避免与其他服务器互相反射
+    if (question.flags & 0x8000) {
+        metricsIncrement(METRIC_MALFORMED);
+        return 0;
+    }
+    // 只支持标准查询；区域传送不经UDP提供
+    int opcode = (question.flags >> 11) & 0xF;
+    if (opcode != 0 || question.qtype == DNS_TYPE_AXFR || question.qtype == DNS_TYPE_IXFR) {
+        replyLength = buildErrorResponse(buffer, length,
+                                         opcode != 0 ? DNS_RCODE_NOTIMP : DNS_RCODE_REFUSED,
+                                         response, responseSize);
+        return finishQuery(server, origin, PATH_FAILED, startNs, buffer, length, response, replyLength);
+    }
+    EdnsInfo edns;
+    if (!parseEdns(buffer, length, &question, &edns)) {
+        metricsIncrement(METRIC_MALFORMED);
+        replyLength = buildErrorResponse(buffer, length, DNS_RCODE_FORMERR, response, responseSize);
+        return finishQuery(server, origin, PATH_FAILED, startNs, buffer, length, response, replyLength);
+    }
+    // UDP应答不能超过客户端可接收的长度，TCP只受缓冲区限制
+    size_t limit = responseSize;
+    if (origin->stream == 0 && udpResponseLimit(&edns) < limit) {
+        limit = udpResponseLimit(&edns);
+    }
+    // 域名一次转换成索引使用的规范形式并算出哈希，本地查找不再重复规范化
+    uint32_t domainHash = 0;
+    size_t domainLength = qnameNormalize(buffer, length, question.nameOffset, domain, &domainHash);
+
+    dnsLog(DNS_LOG_DEBUG, "查询域名: %s 类型%u", domain, (unsigned)question.qtype);
+
+    // 根域名不在本地规则中，直接走缓存和转发；本地命中时直接复制预先编码的记录
+    LocalAnswer local;
+    if (domainLength > 0 &&
+        resolveLocalAnswer(server->resolver, domain, domainLength, domainHash, buffer, &question, &edns,
+                           response, limit, &local)) {
+        if (local.blocked) {
+            dnsLog(DNS_LOG_DEBUG, "域名被屏蔽: %s", domain);
+        } else if (dnsLogEnabled(DNS_LOG_DEBUG)) {
+            dnsLog(DNS_LOG_DEBUG, "本地解析: %s -> %d个IPv4地址，%d个IPv6地址",
+                   domain, local.v4Count, local.v6Count);
+        }
+        return finishQuery(server, origin, local.blocked ? PATH_BLOCKED : PATH_LOCAL, startNs,
+                           buffer, length, response, local.length);
+    }
+
+    if (server->cache) {
+        int refresh = 0;
+        size_t cached = cacheLookup(server->cache, buffer, length, response, responseSize, limit, &refresh);
+        if (refresh) {
+            refreshCache(server, buffer, length, origin, question.id);
+        }
+        if (cached > 0) {
+            // 缓存的应答不带TC，置了TC说明按客户端上限截断过
+            if (response[2] & 0x02) metricsIncrement(METRIC_TRUNCATED);
+            metricsIncrement(METRIC_CACHE_HITS);
+            dnsLog(DNS_LOG_DEBUG, "缓存命中: %s", domain);
+            return finishQuery(server, origin, PATH_CACHED, startNs, buffer, length, response, cached);
+        }
+        metricsIncrement(METRIC_CACHE_MISSES);
+    }
+
+    dnsLog(DNS_LOG_DEBUG, "转发查询: %s", domain);
+    // 挂起在本工作线程的转发器中，上游应答或放弃后在onForwardResult中继续处理
+    ForwardClient client = *origin;
+    client.id = question.id;
+    client.startNs = startNs;
+    client.coalesced = 0;
+    client.refresh = 0;
+    client.maxLength = (uint16_t)(limit > DNS_TCP_MAX_MESSAGE ? DNS_TCP_MAX_MESSAGE : limit);
+    if (forwardQuery(server->workers[origin->worker].forwarder, buffer, length, &client)) {
+        metricsIncrement(METRIC_FORWARDED);
+        return QUERY_FORWARDED;
+    }
+    metricsIncrement(METRIC_FORWARD_REJECTED);
+    dnsLog(DNS_LOG_WARN, "中继外部DNS失败: %s", domain);
+    replyLength = buildErrorResponse(buffer, length, DNS_RCODE_SERVFAIL, response, responseSize);
+    return finishQuery(server, origin, PATH_FAILED, startNs, buffer, length, response, replyLength);
+}
+
+// 处理一个UDP查询：先按客户端地址限速，超限的查询不解析直接丢弃，
+// 其中每slip个回一个TC应答。返回值含义同handleQuery
+static size_t handleDatagram(DNSWorker* worker, const char* query, size_t length,
+                             const ForwardClient* origin, char* reply, uint64_t nowNs) {
+    if (worker->limiter) {
+        RateVerdict verdict = rateLimiterCheck(worker->limiter, origin->addr.sin_addr.s_addr, nowNs);
+        if (verdict == RATE_DROP) {
+            metricsIncrement(METRIC_RATE_LIMITED);
+            return 0;
+        }
+        if (verdict == RATE_SLIP) {
+            metricsIncrement(METRIC_RATE_SLIPPED);
+            return buildSlipResponse(query, length, reply, DNS_PACKET_SIZE);
+        }
+    }
+    return handleQuery(worker->server, query, length, origin, reply, DNS_PACKET_SIZE);
+}
+
+#ifdef DNS_HAVE_MMSG
+
+// 一次recvmmsg收取一批查询，处理后用一次sendmmsg批量应答
+static void onUdpReadable(void* ctx, SOCKET sock, int events) {
+    DNSWorker* worker = (DNSWorker*)ctx;
+    DNSServer* server = worker->server;
+    struct mmsghdr* rxMsgs = (struct mmsghdr*)worker->rxMsgs;
+    struct mmsghdr* txMsgs = (struct mmsghdr*)worker->txMsgs;
+    int batch = server->config.batchSize;
+    ForwardClient origin;
+    (void)events;
+
+    memset(&origin, 0, sizeof(origin));
+    origin.sock = sock;
+    origin.worker = worker->id;
+    for (;;) {
+        for (int i = 0; i < batch; i++) {
+            rxMsgs[i].msg_hdr.msg_name = &worker->rxAddrs[i];
+            rxMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        int received = recvmmsg(sock, rxMsgs, (unsigned int)batch, MSG_DONTWAIT, NULL);
+        if (received <= 0) {
+            if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                dnsLog(DNS_LOG_WARN, "接收数据失败: %d", dnsSocketError());
+            }
+            return;
+        }
+
+        // 同一批报文共用一次取得的时间
+        uint64_t nowNs = worker->limiter ? dnsNowNs() : 0;
+        int replies = 0;
+        for (int i = 0; i < received; i++) {
+            char* reply = worker->txBuffers + (size_t)replies * DNS_PACKET_SIZE;
+            origin.addr = worker->rxAddrs[i];
+            size_t replyLength = handleDatagram(worker, worker->rxBuffers + (size_t)i * DNS_PACKET_SIZE,
+                                                rxMsgs[i].msg_len, &origin, reply, nowNs);
+            if (replyLength == 0 || replyLength == QUERY_FORWARDED) continue;
+
+            txMsgs[replies].msg_hdr.msg_name = &worker->rxAddrs[i];
+            txMsgs[replies].msg_hdr.msg_iov->iov_len = replyLength;
+            replies++;
+        }
+
+        sendBatch(worker, sock, replies);
+        if (received < batch) return;
+    }
+}
+
+#else
+
+// 没有批量收发接口时逐个收取，直到套接字暂无数据
+static void onUdpReadable(void* ctx, SOCKET sock, int events) {
+    DNSWorker* worker = (DNSWorker*)ctx;
+    DNSServer* server = worker->server;
+    int batch = server->config.batchSize;
+    ForwardClient origin;
+    (void)events;
+
+    memset(&origin, 0, sizeof(origin));
+    origin.sock = sock;
+    origin.worker = worker->id;
+    for (int i = 0; i < batch; i++) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+        int recvLen = recvfrom(sock, worker->rxBuffers, DNS_PACKET_SIZE, 0,
+                               (struct sockaddr*)&clientAddr, &clientLen);
+        if (recvLen == SOCKET_ERROR) {
+            int err = dnsSocketError();
+#ifdef _WIN32
+            // 对端端口不可达时Windows会在UDP套接字上报告WSAECONNRESET，忽略即可
+            if (err == WSAECONNRESET) continue;
+#endif
+            if (err != DNS_EWOULDBLOCK) {
+                dnsLog(DNS_LOG_WARN, "接收数据失败: %d", err);
+            }
+            return;
+        }
+        if (recvLen == 0) continue;
+
+        origin.addr = clientAddr;
+        size_t replyLength = handleDatagram(worker, worker->rxBuffers, (size_t)recvLen, &origin,
+                                            worker->txBuffers, worker->limiter ? dnsNowNs() : 0);
+        if (replyLength > 0 && replyLength != QUERY_FORWARDED) {
+            int sent = sendto(sock, worker->txBuffers, (int)replyLength, 0,
+                              (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+            if (sent == SOCKET_ERROR) {
+                metricsIncrement(METRIC_SEND_ERRORS);
+                dnsLog(DNS_LOG_WARN, "发送响应失败: %d", dnsSocketError());
+            }
+        }
+    }
+}
+
+#endif
+
+// 工作线程主循环
+static void workerMain(void* arg) {
+    DNSWorker* worker = (DNSWorker*)arg;
+    DNSServer* server = worker->server;
+
+    // 绑定CPU后线程的事件循环、报文环和本线程的统计分片都留在同一个核的缓存里
+    if (server->config.pinWorkers && !dnsPinThread(worker->id)) {
+        dnsLog(DNS_LOG_WARN, "工作线程%d绑定CPU失败", worker->id);
+    }
+    dnsLog(DNS_LOG_INFO, "工作线程%d开始监听", worker->id);
+    while (server->running) {
+        // 对冲和超时到期前醒来处理，转发器的等待上限也保证能及时看到停止标志
+        int waitMs = forwarderPoll(worker->forwarder, dnsNowNs());
+        if (eventLoopRunOnce(worker->loop, waitMs) < 0) {
+            dnsLog(DNS_LOG_ERROR, "工作线程%d事件循环出错: %d", worker->id, dnsSocketError());
+            break;
+        }
+        if (worker->tcp) {
+            tcpServerSweep(worker->tcp, dnsNowNs());
+        }
+    }
+    dnsLog(DNS_LOG_INFO, "工作线程%d退出", worker->id);
+}
+
+void requestReload(DNSServer* server) {
+    atomic_store(&server->reloadRequested, 1);
+}
+
+// 重新加载线程：在后台构建新规则快照，工作线程查询不受影响
+static void reloadMain(void* arg) {
+    DNSServer* server = (DNSServer*)arg;
+    while (server->running) {
+        if (atomic_exchange(&server->reloadRequested, 0)) {
+            dnsLog(DNS_LOG_INFO, "开始重新加载域名文件");
+            metricsIncrement(reloadDomainMap(server->resolver) ? METRIC_RELOADS
+                                                                : METRIC_RELOAD_FAILURES);
+        }
+        dnsSleepMs(RELOAD_POLL_MS);
+    }
+}
+
+int startServer(DNSServer* server) {
+    if (!server || !server->workers) {
+        dnsLog(DNS_LOG_ERROR, "服务器未初始化");
+        return 0;
+    }
+
+    dnsLog(DNS_LOG_INFO, "服务器开始监听");
+    server->running = 1;
+
+    for (int i = 0; i < server->workerCount; i++) {
+        DNSWorker* worker = &server->workers[i];
+        if (!eventLoopAdd(worker->loop, worker->sock, EVENT_READ, onUdpReadable, worker)) {
+            dnsLog(DNS_LOG_ERROR, "注册监听套接字失败");
+            server->running = 0;
+            return 0;
+        }
+    }
+
+    if (server->stats && !startStatsEndpoint(server->stats)) {
+        dnsLog(DNS_LOG_WARN, "启动统计线程失败");
+    }
+    int reloading = dnsThreadCreate(&server->reloadThread, reloadMain, server);
+    if (!reloading) {
+        dnsLog(DNS_LOG_WARN, "创建重新加载线程失败，规则不支持热更新");
+    }
+
+    // 工作线程0在当前线程运行，其余各自启动线程
+    int started = 1;
+    for (int i = 1; i < server->workerCount; i++) {
+        if (!dnsThreadCreate(&server->workers[i].thread, workerMain, &server->workers[i])) {
+            dnsLog(DNS_LOG_ERROR, "创建工作线程失败");
+            break;
+        }
+        started++;
+    }
+
+    workerMain(&server->workers[0]);
+
+    for (int i = 1; i < started; i++) {
+        dnsThreadJoin(server->workers[i].thread);
+    }
+    if (reloading) {
+        dnsThreadJoin(server->reloadThread);
+    }
+    return 1;
+}
@@ -1,33 +1,107 @@
-/**
- * @file dns_server.h
- * @brief DNS服务器类的头文件定义
- * @details 定义了DNS服务器的主要功能，包括初始化、启动、处理查询等功能
- */
-
-#ifndef DNS_SERVER_H
-#define DNS_SERVER_H
-
-#include <winsock2.h>
-#include "dns_resolver.h"
-#include <windows.h>
-
-// DNS服务器结构体
-typedef struct {
-    SOCKET sockfd;           // 服务器套接字
-    DNSResolver* resolver;   // DNS解析器实例
-    int initialized;         // 服务器初始化状态标志
-} DNSServer;
-
-// 调试日志函数
-void debug_log(const char* format, ...);
-
-// 函数声明
-DNSServer* createServer(void);
-void destroyServer(DNSServer* server);
-int initServer(DNSServer* server, int port);
-int loadDomainFile(DNSServer* server, const char* filename);
-int startServer(DNSServer* server);
-void handleQuery(DNSServer* server, const char* buffer, size_t length, 
-                const struct sockaddr_in* clientAddr);
-
-#endif // DNS_SERVER_H 
\ No newline at end of file
+/**
+ * @file dns_server.h
+ * @brief DNS服务器类的头文件定义
+ * @details 定义了DNS服务器的主要功能，包括初始化、启动、处理查询等功能
+ */
+
+#ifndef DNS_SERVER_H
+#define DNS_SERVER_H
+
+#include "dns_platform.h"
+#include "dns_resolver.h"
+#include "dns_event.h"
+#include "dns_forwarder.h"
+#include "dns_cache.h"
+#include "dns_stats.h"
+#include "dns_tcp.h"
+#include "dns_ratelimit.h"
+#include "dns_arena.h"
+#include "dns_capture.h"
+#include <stdatomic.h>
+
+#define DNS_PACKET_SIZE 4096       // 单个UDP报文缓冲区大小（EDNS0可协商更大的载荷）
+#define DEFAULT_BATCH_SIZE 32      // 默认每次批量收发的报文数
+#define RELOAD_POLL_MS 100         // 重新加载线程检查请求的间隔
+#define QUERY_FORWARDED ((size_t)-1) // handleQuery的返回值：查询已挂起在本工作线程的转发器中，上游应答后再应答客户端
+
+// 服务器配置
+typedef struct {
+    int workerCount;         // 工作线程数，0表示按CPU核数
+    int batchSize;           // 每次批量收发的报文数
+    ForwarderConfig forward; // 上游转发配置
+    size_t cacheBytes;       // 响应缓存容量（字节），0表示关闭缓存
+    int cacheShards;         // 响应缓存分片数，0表示与工作线程数相同
+    uint32_t staleSeconds;   // 缓存条目过期后继续应答的最长时间（秒），0表示不使用过期数据
+    int pinWorkers;          // 非0时把工作线程i绑定到CPU i（取模）
+    int statsPort;           // 统计端口（127.0.0.1上的HTTP），0表示关闭
+    int tcpConnections;      // 每个工作线程最多保持的TCP连接数，0表示不监听TCP
+    RateLimitConfig rateLimit; // 按客户端地址的UDP查询限速，rate为0表示不限速
+    const char* capturePath; // 抓包文件路径，NULL表示不抓包
+    size_t captureBytes;     // 抓包文件大小
+} DNSServerConfig;
+
+struct DNSServer;
+
+// 工作线程：拥有自己的事件循环和预分配的收发报文环
+typedef struct {
+    struct DNSServer* server;  // 所属服务器
+    int id;                    // 工作线程编号
+    SOCKET sock;               // 监听套接字（支持SO_REUSEPORT时每个线程独占一个）
+    SOCKET tcpSock;            // TCP监听套接字，共享方式与UDP相同
+    TcpServer* tcp;            // 本线程的TCP连接，未监听TCP时为NULL
+    RateLimiter* limiter;      // 本线程的UDP限速表，未限速时为NULL
+    Forwarder* forwarder;      // 本线程的上游转发器，由本线程的事件循环驱动
+    int resumed;               // 本轮转发结果中已写入发送环、尚未发出的UDP应答数
+    EventLoop* loop;           // 事件循环
+    DNSThread thread;          // 线程句柄
+    Arena arena;               // 本线程的报文环和消息数组
+    char* rxBuffers;           // 接收报文环，batchSize * DNS_PACKET_SIZE
+    char* txBuffers;           // 发送报文环，batchSize * DNS_PACKET_SIZE
+    struct sockaddr_in* rxAddrs; // 每个接收槽位对应的客户端地址
+    void* rxMsgs;              // recvmmsg使用的消息数组（仅Linux）
+    void* txMsgs;              // sendmmsg使用的消息数组（仅Linux）
+    void* iovecs;              // 收发消息共用的iovec数组（仅Linux）
+} DNSWorker;
+
+// DNS服务器结构体
+typedef struct DNSServer {
+    SOCKET sockfd;           // 服务器套接字（第一个工作线程的套接字）
+    DNSResolver* resolver;   // DNS解析器实例
+    int initialized;         // 服务器初始化状态标志
+    volatile int running;    // 运行标志，清零后工作线程退出
+    DNSServerConfig config;  // 服务器配置
+    DNSWorker* workers;      // 工作线程数组
+    int workerCount;         // 实际工作线程数
+    ResponseCache* cache;    // 中继响应缓存，未启用时为NULL
+    atomic_int reloadRequested; // 待处理的重新加载请求
+    DNSThread reloadThread;  // 后台重新加载线程
+    StatsEndpoint* stats;    // Prometheus统计端口，未启用时为NULL
+    CaptureFile* capture;    // 查询抓包文件，未启用时为NULL
+} DNSServer;
+
+// 函数声明
+DNSServer* createServer(void);
+void destroyServer(DNSServer* server);
+int initServer(DNSServer* server, int port);
+int loadDomainFile(DNSServer* server, const char* filename);
+int startServer(DNSServer* server);
+/**
+ * @brief 请求在后台重新加载域名文件
+ * @details 只设置原子标志，可以在信号处理函数中调用
+ */
+void requestReload(DNSServer* server);
+/**
+ * @brief 处理一个查询
+ * @param server 服务器
+ * @param buffer 查询报文
+ * @param length 查询长度
+ * @param origin 客户端（套接字、地址、TCP连接句柄和工作线程），转发时据此异步应答
+ * @param response 应答缓冲区
+ * @param responseSize 应答缓冲区大小
+ * @return 应答长度；0表示不应答；QUERY_FORWARDED表示已交给转发器。
+ *         UDP查询的应答不超过客户端可接收的长度，超出时截断并置TC位
+ */
+size_t handleQuery(DNSServer* server, const char* buffer, size_t length,
+                   const ForwardClient* origin, char* response, size_t responseSize);
+
+#endif // DNS_SERVER_H
@@ -0,0 +1,133 @@
+#include "dns_stats.h"
+#include "dns_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define ACCEPT_POLL_MS 500      // 检查停止标志的间隔
+#define REQUEST_TIMEOUT_MS 1000 // 等待请求头的时间
+#define MAX_REQUEST 2048
+
+struct StatsEndpoint {
+    SOCKET listenSock;
+    StatsRenderer render;
+    void* userData;
+    DNSThread thread;
+    atomic_int running;
+    char* body;                 // 指标文本缓冲区，只在统计线程中使用
+};
+
+StatsEndpoint* createStatsEndpoint(int port, StatsRenderer render, void* userData) {
+    StatsEndpoint* endpoint = (StatsEndpoint*)calloc(1, sizeof(StatsEndpoint));
+    if (!endpoint) return NULL;
+    endpoint->render = render;
+    endpoint->userData = userData;
+    atomic_init(&endpoint->running, 0);
+    endpoint->body = (char*)malloc(STATS_MAX_BODY);
+    endpoint->listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!endpoint->body || endpoint->listenSock == INVALID_SOCKET) {
+        destroyStatsEndpoint(endpoint);
+        return NULL;
+    }
+
+    int one = 1;
+    setsockopt(endpoint->listenSock, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(endpoint->listenSock, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(endpoint->listenSock, 16) == SOCKET_ERROR) {
+        dnsLog(DNS_LOG_ERROR, "统计端口%d监听失败: %d", port, dnsSocketError());
+        destroyStatsEndpoint(endpoint);
+        return NULL;
+    }
+    return endpoint;
+}
+
+// 等待套接字可读，超时返回0
+static int waitReadable(SOCKET sock, int timeoutMs) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(sock, &readSet);
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    return select((int)sock + 1, &readSet, NULL, NULL, &tv) > 0;
+}
+
+static int sendAll(SOCKET sock, const char* data, size_t length) {
+    while (length > 0) {
+        int n = send(sock, data, (int)length, DNS_MSG_NOSIGNAL);
+        if (n == SOCKET_ERROR) return 0;
+        data += n;
+        length -= (size_t)n;
+    }
+    return 1;
+}
+
+// 读取请求头并应答，只支持GET /metrics（以及GET /）
+static void serveClient(StatsEndpoint* endpoint, SOCKET client) {
+    char request[MAX_REQUEST];
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        if (!waitReadable(client, REQUEST_TIMEOUT_MS)) return;
+        int n = recv(client, request + received, (int)(sizeof(request) - 1 - received), 0);
+        if (n <= 0) return;
+        received += (size_t)n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[received] = '\0';
+
+    char header[256];
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        size_t length = endpoint->render(endpoint->userData, endpoint->body, STATS_MAX_BODY);
+        int n = snprintf(header, sizeof(header),
+                         "HTTP/1.0 200 OK\r\n"
+                         "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                         "Content-Length: %lu\r\n"
+                         "Connection: close\r\n\r\n", (unsigned long)length);
+        if (sendAll(client, header, (size_t)n)) {
+            sendAll(client, endpoint->body, length);
+        }
+    } else {
+        static const char notFound[] =
+            "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        sendAll(client, notFound, sizeof(notFound) - 1);
+    }
+}
+
+static void statsMain(void* arg) {
+    StatsEndpoint* endpoint = (StatsEndpoint*)arg;
+    while (atomic_load(&endpoint->running)) {
+        if (!waitReadable(endpoint->listenSock, ACCEPT_POLL_MS)) continue;
+        SOCKET client = accept(endpoint->listenSock, NULL, NULL);
+        if (client == INVALID_SOCKET) continue;
+        serveClient(endpoint, client);
+        closesocket(client);
+    }
+}
+
+int startStatsEndpoint(StatsEndpoint* endpoint) {
+    atomic_store(&endpoint->running, 1);
+    if (!dnsThreadCreate(&endpoint->thread, statsMain, endpoint)) {
+        atomic_store(&endpoint->running, 0);
+        return 0;
+    }
+    return 1;
+}
+
+void destroyStatsEndpoint(StatsEndpoint* endpoint) {
+    if (!endpoint) return;
+    if (atomic_load(&endpoint->running)) {
+        atomic_store(&endpoint->running, 0);
+        dnsThreadJoin(endpoint->thread);
+    }
+    if (endpoint->listenSock != INVALID_SOCKET) closesocket(endpoint->listenSock);
+    free(endpoint->body);
+    free(endpoint);
+}
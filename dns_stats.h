@@ -0,0 +1,46 @@
+/**
+ * @file dns_stats.h
+ * @brief 本地统计端口的头文件定义
+ * @details 在127.0.0.1上监听一个TCP端口，以HTTP/1.0返回Prometheus文本格式的指标（GET /metrics）。
+ *          请求由独立的后台线程逐个处理，不影响工作线程
+ */
+
+#ifndef DNS_STATS_H
+#define DNS_STATS_H
+
+#include "dns_platform.h"
+
+#define STATS_MAX_BODY (256 * 1024)  ///< 指标文本的最大长度
+
+/**
+ * @brief 生成指标文本的回调，在统计线程中调用
+ * @param userData 创建时传入的用户数据
+ * @param buffer 输出缓冲区
+ * @param size 缓冲区大小
+ * @return 写入的长度
+ */
+typedef size_t (*StatsRenderer)(void* userData, char* buffer, size_t size);
+
+typedef struct StatsEndpoint StatsEndpoint;
+
+/**
+ * @brief 创建统计端口并开始监听
+ * @param port TCP端口（仅绑定127.0.0.1）
+ * @param render 生成指标文本的回调
+ * @param userData 传给回调的用户数据
+ * @return 统计端口，失败返回NULL
+ */
+StatsEndpoint* createStatsEndpoint(int port, StatsRenderer render, void* userData);
+
+/**
+ * @brief 启动统计线程
+ * @return 成功返回1，失败返回0
+ */
+int startStatsEndpoint(StatsEndpoint* endpoint);
+
+/**
+ * @brief 停止统计线程并释放资源
+ */
+void destroyStatsEndpoint(StatsEndpoint* endpoint);
+
+#endif // DNS_STATS_H
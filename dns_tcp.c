@@ -0,0 +1,342 @@
+#include "dns_tcp.h"
+#include "dns_arena.h"
+#include "dns_log.h"
+#include "dns_metrics.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_SLOT 0xFFFFFFFFu
+#define MAX_MESSAGE 65535           // 2字节长度前缀能表示的最大报文
+#define ACCEPTS_PER_EVENT 32        // 每次可读事件最多接受的连接数，避免连接风暴占住工作线程
+#define READS_PER_EVENT 4           // 每次可读事件最多从一个连接读取的次数
+#define SWEEP_INTERVAL_NS 1000000000ULL
+#define POOLED_TX 2048              // 发送缓冲不超过该长度时从对象池取，积压更多时换成malloc的缓冲
+
+// 一个客户端连接
+typedef struct {
+    TcpServer* owner;
+    SOCKET sock;                    // INVALID_SOCKET表示空闲槽位
+    uint16_t generation;            // 槽位每次复用加一，使旧句柄上的迟到应答失效
+    uint32_t nextFree;
+    struct sockaddr_in peer;
+    uint64_t lastActiveNs;          // 最近一次收到数据或发出应答的时刻
+    int pending;                    // 等待异步应答的查询数
+    int peerClosed;                 // 对端已关闭写方向，应答发完后关闭
+    int events;                     // 当前在事件循环中关注的事件
+    size_t rxLength;
+    char rx[2 + TCP_MAX_QUERY_SIZE];
+    char* tx;                       // 待发送的应答（已带长度前缀）
+    size_t txOffset;
+    size_t txLength;
+    size_t txCapacity;
+    int txPooled;                   // tx是否来自对象池
+} TcpConnection;
+
+struct TcpServer {
+    EventLoop* loop;
+    SOCKET listenSock;
+    TcpQueryHandler handler;
+    void* ctx;
+    TcpConnection* connections;
+    uint32_t capacity;
+    uint32_t freeHead;              // 空闲槽位链表
+    char* scratch;                  // 构建应答用的缓冲区：2字节长度前缀 + 报文
+    uint64_t lastSweepNs;
+    Arena arena;                    // 连接表、构建应答缓冲区和发送缓冲对象池的内存
+    SlabPool txPool;                // 连接的发送缓冲，连接关闭时归还
+};
+
+static uint32_t streamOf(const TcpServer* server, const TcpConnection* conn) {
+    uint32_t slot = (uint32_t)(conn - server->connections);
+    return ((uint32_t)conn->generation << 16) | (slot + 1);
+}
+
+static void closeConnection(TcpConnection* conn) {
+    TcpServer* server = conn->owner;
+    eventLoopRemove(server->loop, conn->sock);
+    closesocket(conn->sock);
+    if (conn->txPooled) {
+        slabFree(&server->txPool, conn->tx);
+    } else {
+        free(conn->tx);
+    }
+    conn->sock = INVALID_SOCKET;
+    conn->generation++;
+    conn->tx = NULL;
+    conn->txOffset = conn->txLength = conn->txCapacity = 0;
+    conn->txPooled = 0;
+    conn->rxLength = 0;
+    conn->pending = 0;
+    conn->nextFree = server->freeHead;
+    server->freeHead = (uint32_t)(conn - server->connections);
+}
+
+static int backlogged(const TcpConnection* conn) {
+    return conn->txLength - conn->txOffset > TCP_MAX_BACKLOG;
+}
+
+// 按当前状态调整关注的事件：积压过多或对端已关闭时不再读，有待发数据时等待可写
+static void updateEvents(TcpConnection* conn) {
+    int events = 0;
+    if (!conn->peerClosed && !backlogged(conn)) events |= EVENT_READ;
+    if (conn->txOffset < conn->txLength) events |= EVENT_WRITE;
+    if (events != conn->events && eventLoopModify(conn->owner->loop, conn->sock, events)) {
+        conn->events = events;
+    }
+}
+
+// 尽量发出待发数据，连接出错被关闭时返回0
+static int flushConnection(TcpConnection* conn) {
+    while (conn->txOffset < conn->txLength) {
+        int n = send(conn->sock, conn->tx + conn->txOffset,
+                     (int)(conn->txLength - conn->txOffset), DNS_MSG_NOSIGNAL);
+        if (n == SOCKET_ERROR) {
+            if (dnsSocketError() == DNS_EWOULDBLOCK) return 1;
+            metricsIncrement(METRIC_SEND_ERRORS);
+            closeConnection(conn);
+            return 0;
+        }
+        conn->txOffset += (size_t)n;
+        conn->lastActiveNs = dnsNowNs();
+    }
+    conn->txOffset = 0;
+    conn->txLength = 0;
+    return 1;
+}
+
+// 追加一条已带长度前缀的应答并尝试发送，连接被关闭时返回0
+static int queueReply(TcpConnection* conn, const char* frame, size_t length) {
+    if (conn->txOffset > 0 && conn->txOffset == conn->txLength) {
+        conn->txOffset = 0;
+        conn->txLength = 0;
+    }
+    if (conn->txLength + length > conn->txCapacity) {
+        // 多数连接的积压放得进一个池对象；更多时换成malloc的缓冲并把池对象还回去
+        TcpServer* server = conn->owner;
+        int pooled = !conn->tx && length <= POOLED_TX;
+        char* grown = NULL;
+        size_t capacity = POOLED_TX;
+        if (pooled) {
+            grown = (char*)slabAlloc(&server->txPool);
+        } else {
+            while (capacity < conn->txLength + length) capacity *= 2;
+            grown = (char*)(conn->txPooled ? malloc(capacity) : realloc(conn->tx, capacity));
+            if (grown && conn->txPooled) {
+                memcpy(grown, conn->tx, conn->txLength);
+                slabFree(&server->txPool, conn->tx);
+            }
+        }
+        if (!grown) {
+            metricsIncrement(METRIC_SEND_ERRORS);
+            return 1;
+        }
+        conn->txPooled = pooled;
+        conn->tx = grown;
+        conn->txCapacity = capacity;
+    }
+    memcpy(conn->tx + conn->txLength, frame, length);
+    conn->txLength += length;
+    return flushConnection(conn);
+}
+
+// 处理接收缓冲中所有完整的查询，连接被关闭时返回0
+static int processFrames(TcpConnection* conn) {
+    TcpServer* server = conn->owner;
+    size_t consumed = 0;
+
+    while (conn->rxLength - consumed >= 2 && !backlogged(conn)) {
+        const char* frame = conn->rx + consumed;
+        size_t length = ((size_t)(uint8_t)frame[0] << 8) | (uint8_t)frame[1];
+        if (length < 12 || length > TCP_MAX_QUERY_SIZE) {
+            dnsLog(DNS_LOG_DEBUG, "TCP查询长度无效: %d，关闭连接", (int)length);
+            metricsIncrement(METRIC_MALFORMED);
+            closeConnection(conn);
+            return 0;
+        }
+        if (conn->rxLength - consumed < 2 + length) break;
+        consumed += 2 + length;
+
+        size_t reply = server->handler(server->ctx, frame + 2, length, streamOf(server, conn),
+                                       &conn->peer, server->scratch + 2, MAX_MESSAGE);
+        if (reply == TCP_REPLY_DEFERRED) {
+            conn->pending++;
+        } else if (reply > 0) {
+            server->scratch[0] = (char)(reply >> 8);
+            server->scratch[1] = (char)reply;
+            if (!queueReply(conn, server->scratch, reply + 2)) return 0;
+        }
+    }
+
+    if (consumed > 0) {
+        memmove(conn->rx, conn->rx + consumed, conn->rxLength - consumed);
+        conn->rxLength -= consumed;
+    }
+    return 1;
+}
+
+static void onConnectionEvent(void* ctx, SOCKET sock, int events) {
+    TcpConnection* conn = (TcpConnection*)ctx;
+
+    if (events & EVENT_WRITE) {
+        int wasBacklogged = backlogged(conn);
+        if (!flushConnection(conn)) return;
+        // 积压消化后继续处理暂停时已收到的查询
+        if (wasBacklogged && !backlogged(conn) && !processFrames(conn)) return;
+    }
+
+    if (events & EVENT_READ) {
+        for (int i = 0; i < READS_PER_EVENT && !conn->peerClosed && !backlogged(conn); i++) {
+            int n = recv(sock, conn->rx + conn->rxLength, (int)(sizeof(conn->rx) - conn->rxLength), 0);
+            if (n == 0) {
+                conn->peerClosed = 1;
+                break;
+            }
+            if (n == SOCKET_ERROR) {
+                if (dnsSocketError() == DNS_EWOULDBLOCK) break;
+                closeConnection(conn);
+                return;
+            }
+            conn->rxLength += (size_t)n;
+            conn->lastActiveNs = dnsNowNs();
+            if (!processFrames(conn)) return;
+            if (conn->rxLength == sizeof(conn->rx)) break;
+        }
+    }
+
+    if (conn->peerClosed && conn->pending == 0 && conn->txOffset == conn->txLength) {
+        closeConnection(conn);
+        return;
+    }
+    updateEvents(conn);
+}
+
+static void onAccept(void* ctx, SOCKET sock, int events) {
+    TcpServer* server = (TcpServer*)ctx;
+    (void)events;
+
+    for (int i = 0; i < ACCEPTS_PER_EVENT; i++) {
+        struct sockaddr_in peer;
+        socklen_t peerLen = sizeof(peer);
+        SOCKET client = accept(sock, (struct sockaddr*)&peer, &peerLen);
+        if (client == INVALID_SOCKET) {
+            // 监听套接字可能被多个工作线程共享，连接已被其他线程取走
+            return;
+        }
+        if (server->freeHead == NO_SLOT || !dnsSetNonBlocking(client)) {
+            metricsIncrement(METRIC_TCP_REJECTED);
+            closesocket(client);
+            continue;
+        }
+        // 流水线上连续的小应答不等待前一个的确认
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+        uint32_t slot = server->freeHead;
+        TcpConnection* conn = &server->connections[slot];
+        if (!eventLoopAdd(server->loop, client, EVENT_READ, onConnectionEvent, conn)) {
+            metricsIncrement(METRIC_TCP_REJECTED);
+            closesocket(client);
+            continue;
+        }
+        server->freeHead = conn->nextFree;
+        conn->sock = client;
+        conn->peer = peer;
+        conn->lastActiveNs = dnsNowNs();
+        conn->peerClosed = 0;
+        conn->events = EVENT_READ;
+        metricsIncrement(METRIC_TCP_ACCEPTED);
+    }
+}
+
+TcpServer* createTcpServer(EventLoop* loop, SOCKET listenSock, int maxConnections,
+                           TcpQueryHandler handler, void* ctx) {
+    TcpServer* server = (TcpServer*)calloc(1, sizeof(TcpServer));
+    if (!server) return NULL;
+    if (maxConnections <= 0) maxConnections = TCP_DEFAULT_CONNECTIONS;
+    if (maxConnections > 0xFFFE) maxConnections = 0xFFFE;  // 句柄低16位是槽位号加一
+
+    server->loop = loop;
+    server->listenSock = listenSock;
+    server->handler = handler;
+    server->ctx = ctx;
+    server->capacity = (uint32_t)maxConnections;
+    arenaInit(&server->arena, 0);
+    slabInit(&server->txPool, &server->arena, POOLED_TX, 0);
+    server->connections = (TcpConnection*)arenaCalloc(&server->arena, server->capacity, sizeof(TcpConnection));
+    server->scratch = (char*)arenaAlloc(&server->arena, 2 + MAX_MESSAGE);
+    if (!server->connections || !server->scratch) {
+        destroyTcpServer(server);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < server->capacity; i++) {
+        server->connections[i].owner = server;
+        server->connections[i].sock = INVALID_SOCKET;
+        server->connections[i].nextFree = i + 1 < server->capacity ? i + 1 : NO_SLOT;
+    }
+    server->freeHead = 0;
+
+    if (!eventLoopAdd(loop, listenSock, EVENT_READ, onAccept, server)) {
+        destroyTcpServer(server);
+        return NULL;
+    }
+    return server;
+}
+
+void destroyTcpServer(TcpServer* server) {
+    if (!server) return;
+    if (server->connections) {
+        for (uint32_t i = 0; i < server->capacity; i++) {
+            if (server->connections[i].sock != INVALID_SOCKET) {
+                closeConnection(&server->connections[i]);
+            }
+        }
+        eventLoopRemove(server->loop, server->listenSock);
+    }
+    slabCheckLeaks(&server->txPool, "TCP发送缓冲");
+    arenaDestroy(&server->arena);
+    free(server);
+}
+
+int tcpServerReply(TcpServer* server, uint32_t stream, const char* response, size_t length) {
+    if (length > MAX_MESSAGE) return 0;
+    uint32_t slot = (stream & 0xFFFF) - 1;
+    TcpConnection* conn = slot < server->capacity ? &server->connections[slot] : NULL;
+    if (!conn || conn->sock == INVALID_SOCKET || conn->generation != (uint16_t)(stream >> 16)) {
+        return 0;
+    }
+    if (conn->pending > 0) conn->pending--;
+    conn->lastActiveNs = dnsNowNs();
+    server->scratch[0] = (char)(length >> 8);
+    server->scratch[1] = (char)length;
+    memcpy(server->scratch + 2, response, length);
+    if (!queueReply(conn, server->scratch, 2 + length)) return 1;
+    if (conn->peerClosed && conn->pending == 0 && conn->txOffset == conn->txLength) {
+        closeConnection(conn);
+    } else {
+        updateEvents(conn);
+    }
+    return 1;
+}
+
+void tcpServerSweep(TcpServer* server, uint64_t now) {
+    if (now - server->lastSweepNs < SWEEP_INTERVAL_NS) return;
+    server->lastSweepNs = now;
+
+    uint64_t idleNs = (uint64_t)TCP_IDLE_TIMEOUT_MS * 1000000ULL;
+    uint64_t stallNs = (uint64_t)TCP_STALL_TIMEOUT_MS * 1000000ULL;
+    for (uint32_t i = 0; i < server->capacity; i++) {
+        TcpConnection* conn = &server->connections[i];
+        // 还有查询在等上游的连接不算空闲：转发器超时后一定会送回应答（至少是SERVFAIL）
+        if (conn->sock == INVALID_SOCKET || conn->pending > 0) continue;
+        if (conn->txOffset < conn->txLength) {
+            // 有待发应答时每次写出都会刷新lastActiveNs，长时间没有进展说明对端不再读取
+            if (conn->lastActiveNs + stallNs < now) {
+                dnsLog(DNS_LOG_DEBUG, "TCP连接的应答长时间发不出去，关闭");
+                closeConnection(conn);
+            }
+        } else if (conn->lastActiveNs + idleNs < now) {
+            dnsLog(DNS_LOG_DEBUG, "TCP连接空闲超时，关闭");
+            closeConnection(conn);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file dns_tcp.h
+ * @brief DNS over TCP客户端连接的头文件定义
+ * @details 每个工作线程一个TcpServer：监听套接字和已接受的连接都注册在工作线程的事件循环中，
+ *          全部使用非阻塞读写。报文按2字节长度前缀分帧，客户端可以在一个连接上连续发送多个查询
+ *          （流水线），应答按完成的先后写回。某个连接的发送积压过多时只暂停读取该连接，
+ *          慢客户端不会占住工作线程。
+ *          转发到上游的查询在同一工作线程的转发器回调中完成，经tcpServerReply写回连接
+ */
+
+#ifndef DNS_TCP_H
+#define DNS_TCP_H
+
+#include "dns_platform.h"
+#include "dns_event.h"
+
+#define TCP_DEFAULT_CONNECTIONS 256     ///< 默认每个工作线程最多保持的连接数
+#define TCP_IDLE_TIMEOUT_MS 10000       ///< 连接空闲（无查询、无待发应答）多久后关闭
+#define TCP_STALL_TIMEOUT_MS 30000      ///< 有待发应答但对端一直不读取，多久后关闭
+#define TCP_MAX_QUERY_SIZE 4096         ///< 可接受的最大查询长度，超过时关闭连接
+#define TCP_MAX_BACKLOG (256 * 1024)    ///< 发送积压超过该字节数时暂停读取该连接
+#define TCP_REPLY_DEFERRED ((size_t)-1) ///< 查询处理回调的返回值：应答稍后经tcpServerReply送达
+
+/**
+ * @brief 查询处理回调，在工作线程中调用
+ * @param ctx 创建时传入的上下文
+ * @param query 查询报文（不含长度前缀）
+ * @param length 查询长度
+ * @param stream 连接句柄，异步应答时传给tcpServerReply
+ * @param peer 客户端地址
+ * @param response 应答缓冲区
+ * @param responseSize 应答缓冲区大小
+ * @return 应答长度；0表示不应答；TCP_REPLY_DEFERRED表示应答稍后异步送达
+ */
+typedef size_t (*TcpQueryHandler)(void* ctx, const char* query, size_t length, uint32_t stream,
+                                  const struct sockaddr_in* peer, char* response, size_t responseSize);
+
+typedef struct TcpServer TcpServer;
+
+/**
+ * @brief 创建TCP服务并把监听套接字注册到事件循环
+ * @param loop 工作线程的事件循环
+ * @param listenSock 已开始监听的非阻塞套接字（由调用方关闭，可以被多个工作线程共享）
+ * @param maxConnections 最多保持的连接数，已满时新连接被立即关闭
+ * @param handler 查询处理回调
+ * @param ctx 回调上下文
+ * @return TCP服务，失败返回NULL
+ */
+TcpServer* createTcpServer(EventLoop* loop, SOCKET listenSock, int maxConnections,
+                           TcpQueryHandler handler, void* ctx);
+
+/**
+ * @brief 关闭所有连接并释放TCP服务（不关闭监听套接字）
+ * @details 必须在工作线程退出之后调用
+ */
+void destroyTcpServer(TcpServer* server);
+
+/**
+ * @brief 写回一个异步完成的应答，只能在工作线程中调用
+ * @param server TCP服务
+ * @param stream 查询处理回调收到的连接句柄
+ * @param response 应答报文
+ * @param length 应答长度
+ * @return 应答已交给连接返回1（发送出错时连接随即关闭）；连接已关闭或应答过长返回0
+ */
+int tcpServerReply(TcpServer* server, uint32_t stream, const char* response, size_t length);
+
+/**
+ * @brief 关闭空闲超时或应答长时间发不出去的连接，由工作线程在每轮事件循环后调用
+ * @details 仍有查询在等待上游应答的连接不会被关闭
+ */
+void tcpServerSweep(TcpServer* server, uint64_t now);
+
+#endif // DNS_TCP_H
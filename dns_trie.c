@@ -0,0 +1,185 @@
+#include "dns_trie.h"
+#include "dns_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODES 64
+#define INITIAL_EDGES 128
+#define INITIAL_LABELS 1024
+
+int trieInit(SuffixTrie* trie) {
+    memset(trie, 0, sizeof(*trie));
+    trie->nodes = (TrieNode*)calloc(INITIAL_NODES, sizeof(TrieNode));
+    trie->edges = (TrieEdge*)calloc(INITIAL_EDGES, sizeof(TrieEdge));
+    trie->labels = (char*)malloc(INITIAL_LABELS);
+    if (!trie->nodes || !trie->edges || !trie->labels) {
+        trieFree(trie);
+        return 0;
+    }
+    trie->nodeCount = 1;  // 根节点
+    trie->nodeCapacity = INITIAL_NODES;
+    trie->edgeMask = INITIAL_EDGES - 1;
+    trie->labelCapacity = INITIAL_LABELS;
+    return 1;
+}
+
+void trieFree(SuffixTrie* trie) {
+    free(trie->nodes);
+    free(trie->edges);
+    free(trie->labels);
+    memset(trie, 0, sizeof(*trie));
+}
+
+static uint32_t edgeHash(uint32_t parent, const char* label, size_t length) {
+    uint32_t h = hashDomain(label, length) ^ (parent * 0x9E3779B1u);
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+static const TrieEdge* findEdge(const SuffixTrie* trie, uint32_t parent,
+                                const char* label, size_t length, uint32_t hash) {
+    size_t pos = hash & trie->edgeMask;
+    while (trie->edges[pos].hash) {
+        const TrieEdge* edge = &trie->edges[pos];
+        if (edge->hash == hash && edge->parent == parent && edge->labelLength == length &&
+            memcmp(trie->labels + edge->labelOffset, label, length) == 0) {
+            return edge;
+        }
+        pos = (pos + 1) & trie->edgeMask;
+    }
+    return NULL;
+}
+
+static int growEdges(SuffixTrie* trie) {
+    size_t oldCapacity = trie->edgeMask + 1;
+    size_t newCapacity = oldCapacity * 2;
+    TrieEdge* newEdges = (TrieEdge*)calloc(newCapacity, sizeof(TrieEdge));
+    if (!newEdges) return 0;
+
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (!trie->edges[i].hash) continue;
+        size_t pos = trie->edges[i].hash & (newCapacity - 1);
+        while (newEdges[pos].hash) pos = (pos + 1) & (newCapacity - 1);
+        newEdges[pos] = trie->edges[i];
+    }
+    free(trie->edges);
+    trie->edges = newEdges;
+    trie->edgeMask = newCapacity - 1;
+    return 1;
+}
+
+// 取得(parent, label)对应的子节点，不存在时创建
+static int childNode(SuffixTrie* trie, uint32_t parent, const char* label,
+                     size_t length, uint32_t* child) {
+    uint32_t hash = edgeHash(parent, label, length);
+    const TrieEdge* edge = findEdge(trie, parent, label, length, hash);
+    if (edge) {
+        *child = edge->child;
+        return 1;
+    }
+
+    // 边表装载因子保持在1/2以下（边数 = 节点数 - 1）
+    if (trie->nodeCount * 2 > trie->edgeMask + 1 && !growEdges(trie)) return 0;
+    if (trie->nodeCount >= trie->nodeCapacity) {
+        size_t newCapacity = trie->nodeCapacity * 2;
+        TrieNode* nodes = (TrieNode*)realloc(trie->nodes, newCapacity * sizeof(TrieNode));
+        if (!nodes) return 0;
+        trie->nodes = nodes;
+        trie->nodeCapacity = newCapacity;
+    }
+    if (trie->labelSize + length > trie->labelCapacity) {
+        size_t newCapacity = trie->labelCapacity * 2;
+        while (newCapacity < trie->labelSize + length) newCapacity *= 2;
+        char* labels = (char*)realloc(trie->labels, newCapacity);
+        if (!labels) return 0;
+        trie->labels = labels;
+        trie->labelCapacity = newCapacity;
+    }
+
+    uint32_t index = (uint32_t)trie->nodeCount++;
+    memset(&trie->nodes[index], 0, sizeof(TrieNode));
+
+    size_t pos = hash & trie->edgeMask;
+    while (trie->edges[pos].hash) pos = (pos + 1) & trie->edgeMask;
+    TrieEdge* slot = &trie->edges[pos];
+    slot->hash = hash;
+    slot->parent = parent;
+    slot->child = index;
+    slot->labelOffset = (uint32_t)trie->labelSize;
+    slot->labelLength = (uint8_t)length;
+    memcpy(trie->labels + trie->labelSize, label, length);
+    trie->labelSize += length;
+
+    *child = index;
+    return 1;
+}
+
+int trieInsert(SuffixTrie* trie, const char* name, size_t length, int matchType,
+               uint32_t value, uint32_t* stored) {
+    uint32_t node = 0;
+    size_t end = length;
+
+    // 从最右边的标签开始逐级向下
+    while (end > 0) {
+        size_t start = end;
+        while (start > 0 && name[start - 1] != '.') start--;
+        size_t labelLength = end - start;
+        if (labelLength == 0 || labelLength > 63) return 0;
+        if (!childNode(trie, node, name + start, labelLength, &node)) return 0;
+        end = start > 0 ? start - 1 : 0;
+    }
+    if (node == 0) return 0;  // 不允许对根节点设置规则
+
+    TrieNode* target = &trie->nodes[node];
+    if (target->flags & matchType) {
+        // 先出现的规则优先
+        if (stored) *stored = matchType == TRIE_MATCH_SUFFIX ? target->suffixValue : target->wildcardValue;
+        return 1;
+    }
+    if (matchType == TRIE_MATCH_SUFFIX) target->suffixValue = value;
+    else target->wildcardValue = value;
+    target->flags |= (uint8_t)matchType;
+    trie->ruleCount++;
+    if (stored) *stored = value;
+    return 1;
+}
+
+void trieRemap(SuffixTrie* trie, const uint32_t* remap) {
+    for (size_t i = 0; i < trie->nodeCount; i++) {
+        TrieNode* node = &trie->nodes[i];
+        if (node->flags & TRIE_MATCH_SUFFIX) node->suffixValue = remap[node->suffixValue];
+        if (node->flags & TRIE_MATCH_WILDCARD) node->wildcardValue = remap[node->wildcardValue];
+    }
+}
+
+int trieLookup(const SuffixTrie* trie, const char* name, size_t length, uint32_t* value) {
+    if (trie->nodeCount <= 1) return 0;
+
+    uint32_t node = 0;
+    size_t end = length;
+    int found = 0;
+
+    while (end > 0) {
+        size_t start = end;
+        while (start > 0 && name[start - 1] != '.') start--;
+        size_t labelLength = end - start;
+
+        const TrieEdge* edge = findEdge(trie, node, name + start, labelLength,
+                                        edgeHash(node, name + start, labelLength));
+        if (!edge) break;
+        node = edge->child;
+        const TrieNode* current = &trie->nodes[node];
+
+        // 越深的匹配越具体，后面的匹配覆盖前面的
+        if (start > 0 && (current->flags & TRIE_MATCH_WILDCARD)) {
+            *value = current->wildcardValue;
+            found = 1;
+        } else if (current->flags & TRIE_MATCH_SUFFIX) {
+            *value = current->suffixValue;
+            found = 1;
+        }
+        if (start == 0) break;
+        end = start - 1;
+    }
+    return found;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file dns_trie.h
+ * @brief 反向标签后缀树的头文件定义
+ * @details 把通配符和后缀规则按标签从右到左编译成一棵树，例如*.doubleclick.net
+ *          对应路径 net -> doubleclick。查找时沿查询域名的标签从右到左走一遍，
+ *          取最深（最具体）的匹配，耗时只与标签数有关，与规则数无关。
+ *          树的边存放在以(父节点, 标签)为键的开放寻址哈希表中，标签文本存放在连续的字符池里
+ */
+
+#ifndef DNS_TRIE_H
+#define DNS_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRIE_MATCH_SUFFIX   0x1  ///< ".example.com"：匹配该域名本身及所有子域名
+#define TRIE_MATCH_WILDCARD 0x2  ///< "*.example.com"：只匹配子域名
+
+/**
+ * @struct TrieNode
+ * @brief 树节点，每个节点对应一个域名后缀
+ */
+typedef struct {
+    uint32_t suffixValue;   ///< 后缀规则的值（地址集合编号）
+    uint32_t wildcardValue; ///< 通配符规则的值
+    uint8_t flags;        ///< TRIE_MATCH_SUFFIX / TRIE_MATCH_WILDCARD的组合
+} TrieNode;
+
+/**
+ * @struct TrieEdge
+ * @brief 父节点经一个标签到子节点的边
+ */
+typedef struct {
+    uint32_t hash;        ///< (父节点, 标签)的哈希，0表示空槽
+    uint32_t parent;      ///< 父节点下标
+    uint32_t child;       ///< 子节点下标
+    uint32_t labelOffset; ///< 标签在字符池中的偏移
+    uint8_t labelLength;  ///< 标签长度
+} TrieEdge;
+
+/**
+ * @struct SuffixTrie
+ * @brief 反向标签后缀树
+ */
+typedef struct {
+    TrieNode* nodes;      ///< 节点数组，0号为根节点
+    size_t nodeCount;
+    size_t nodeCapacity;
+    TrieEdge* edges;      ///< 边哈希表
+    size_t edgeMask;      ///< 边表容量 - 1
+    char* labels;         ///< 标签字符池
+    size_t labelSize;
+    size_t labelCapacity;
+    size_t ruleCount;     ///< 规则数
+} SuffixTrie;
+
+/**
+ * @brief 初始化后缀树
+ * @return 成功返回1，失败返回0
+ */
+int trieInit(SuffixTrie* trie);
+
+/**
+ * @brief 释放后缀树
+ */
+void trieFree(SuffixTrie* trie);
+
+/**
+ * @brief 插入一条规则
+ * @param trie 后缀树
+ * @param name 规范化后的域名（不含"*."或前导点号）
+ * @param length 域名长度
+ * @param matchType TRIE_MATCH_SUFFIX或TRIE_MATCH_WILDCARD
+ * @param value 规则的值
+ * @param stored 输出实际保存的值（同一规则已存在时为原值），可为NULL
+ * @return 成功返回1（同一规则已存在时保留原值），失败返回0
+ */
+int trieInsert(SuffixTrie* trie, const char* name, size_t length, int matchType,
+               uint32_t value, uint32_t* stored);
+
+/**
+ * @brief 按映射表改写所有规则值，用于地址集合合并之后
+ * @param trie 后缀树
+ * @param remap remap[旧值]为新值
+ */
+void trieRemap(SuffixTrie* trie, const uint32_t* remap);
+
+/**
+ * @brief 查找最具体的匹配规则
+ * @param trie 后缀树
+ * @param name 规范化后的查询域名
+ * @param length 域名长度
+ * @param value 输出规则的值
+ * @return 找到返回1，否则返回0
+ * @details 不分配内存
+ */
+int trieLookup(const SuffixTrie* trie, const char* name, size_t length, uint32_t* value);
+
+#endif // DNS_TRIE_H
@@ -1,70 +1,211 @@
-#include "dns_server.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <windows.h>
-
-int main(int argc, char* argv[]) {
-    // 设置控制台编码为UTF-8
-    SetConsoleOutputCP(65001);
-    
-    // 检查命令行参数
-    if (argc != 3) {
-        fprintf(stderr, "用法: %s <端口号> <域名映射文件>\n", argv[0]);
-        fprintf(stderr, "示例: %s 5353 dnsrelay.txt\n", argv[0]);
-        return 1;
-    }
-
-    // 解析命令行参数
-    int port = atoi(argv[1]);
-    const char* domainFile = argv[2];
-
-    // 检查端口号是否有效
-    if (port <= 0 || port > 65535) {
-        fprintf(stderr, "错误: 无效的端口号 %d\n", port);
-        return 1;
-    }
-
-    // 检查文件是否存在
-    FILE* testFile = fopen(domainFile, "r");
-    if (!testFile) {
-        fprintf(stderr, "错误: 无法打开文件 %s\n", domainFile);
-        return 1;
-    }
-    fclose(testFile);
-
-    printf("正在启动DNS服务器...\n");
-    printf("端口: %d\n", port);
-    printf("域名文件: %s\n", domainFile);
-
-    // 创建并初始化DNS服务器
-    DNSServer* server = createServer();
-    if (!server) {
-        fprintf(stderr, "错误: 创建DNS服务器失败\n");
-        return 1;
-    }
-
-    printf("正在初始化服务器...\n");
-    if (!initServer(server, port)) {
-        fprintf(stderr, "错误: 初始化DNS服务器失败\n");
-        destroyServer(server);
-        return 1;
-    }
-
-    // 加载域名-IP映射文件
-    printf("正在加载域名映射文件...\n");
-    if (!loadDomainFile(server, domainFile)) {
-        fprintf(stderr, "错误: 加载域名文件失败\n");
-        destroyServer(server);
-        return 1;
-    }
-
-    printf("DNS服务器启动成功！\n");
-    printf("按Ctrl+C停止服务器\n");
-
-    // 启动DNS服务器
-    startServer(server);
-
-    // 清理资源
-    destroyServer(server);
-    return 0;
+#include "dns_server.h"
+#include "dns_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+static DNSServer* activeServer;  // 供信号处理函数和控制台命令线程使用
+
+#ifndef _WIN32
+// SIGHUP：重新加载域名文件
+static void onSignalReload(int sig) {
+    (void)sig;
+    if (activeServer) requestReload(activeServer);
+}
+#endif
+
+// 控制台命令线程：输入reload重新加载域名文件；标准输入关闭时退出
+static void controlMain(void* arg) {
+    (void)arg;
+    char line[64];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "reload") == 0) {
+            printf("正在重新加载域名文件...\n");
+            requestReload(activeServer);
+        } else if (line[0] != '\0') {
+            printf("未知命令: %s（可用命令: reload）\n", line);
+        }
+    }
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "用法: %s <端口号> <域名映射文件> [选项]\n", program);
+    fprintf(stderr, "域名映射文件可以是文本，也可以是rulec编译出的规则库镜像\n");
+    fprintf(stderr, "选项:\n");
+    fprintf(stderr, "  -w <数量>   工作线程数（默认按CPU核数）\n");
+    fprintf(stderr, "  -b <数量>   每次批量收发的报文数（默认%d）\n", DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  -u <地址[:端口]>  上游DNS服务器，可重复指定多个（默认8.8.8.8:53）\n");
+    fprintf(stderr, "  -t <毫秒>   上游单次查询超时（默认%d）\n", FORWARD_DEFAULT_TIMEOUT);
+    fprintf(stderr, "  -r <次数>   上游超时重试次数（默认%d）\n", FORWARD_DEFAULT_RETRIES);
+    fprintf(stderr, "  -H <毫秒>   首选上游多久未应答后同时发往次优上游，0表示不对冲（默认%d）\n",
+            FORWARD_DEFAULT_HEDGE);
+    fprintf(stderr, "  -c <字节数> 响应缓存容量，0表示关闭（默认%d）\n", CACHE_DEFAULT_BYTES);
+    fprintf(stderr, "  -S <数量>   响应缓存分片数（默认等于工作线程数）\n");
+    fprintf(stderr, "  -s <秒>     缓存过期后继续应答并在后台刷新的最长时间，0表示关闭（默认%d）\n",
+            CACHE_DEFAULT_STALE);
+    fprintf(stderr, "  -A          把第i个工作线程绑定到第i个CPU核\n");
+    fprintf(stderr, "  -l <级别>   日志级别error/warn/info/debug/trace（默认info）\n");
+    fprintf(stderr, "  -m <端口>   在127.0.0.1上开启Prometheus统计端口（GET /metrics）\n");
+    fprintf(stderr, "  -T <数量>   每个工作线程最多保持的TCP连接数，0表示不监听TCP（默认%d）\n",
+            TCP_DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -R <速率[:突发[:slip]]>  按客户端地址限制UDP查询（每秒查询数），超限的查询丢弃，\n"
+                    "              每slip个回一个TC应答促使改用TCP，0表示全部丢弃（默认不限速，slip默认%d）\n",
+            RATE_DEFAULT_SLIP);
+    fprintf(stderr, "  -C <文件>   把查询和应答以二进制帧写入内存映射的环形抓包文件，可用dnsreplay回放\n");
+    fprintf(stderr, "  -Z <兆字节> 抓包文件大小，写满后覆盖最早的帧（默认%u）\n", CAPTURE_DEFAULT_BYTES >> 20);
+    fprintf(stderr, "示例: %s 5353 dnsrelay.txt -w 4 -b 64 -u 127.0.0.1:5300 -u 127.0.0.1:5301\n", program);
+    fprintf(stderr, "运行中输入reload（或发送SIGHUP）可重新加载域名文件\n");
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    // 设置控制台编码为UTF-8
+    SetConsoleOutputCP(65001);
+#endif
+    
+    // 检查命令行参数
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // 解析命令行参数
+    int port = atoi(argv[1]);
+    const char* domainFile = argv[2];
+
+    // 检查端口号是否有效
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "错误: 无效的端口号 %d\n", port);
+        return 1;
+    }
+
+    // 检查文件是否存在
+    FILE* testFile = fopen(domainFile, "r");
+    if (!testFile) {
+        fprintf(stderr, "错误: 无法打开文件 %s\n", domainFile);
+        return 1;
+    }
+    fclose(testFile);
+
+    printf("正在启动DNS服务器...\n");
+    printf("端口: %d\n", port);
+    printf("域名文件: %s\n", domainFile);
+
+    // 启动异步日志，级别可由-l参数修改
+    if (!dnsLogInit("dns_debug.log", DNS_LOG_INFO)) {
+        fprintf(stderr, "警告: 无法打开日志文件dns_debug.log\n");
+    }
+
+    // 创建并初始化DNS服务器
+    DNSServer* server = createServer();
+    if (!server) {
+        fprintf(stderr, "错误: 创建DNS服务器失败\n");
+        return 1;
+    }
+
+    // 解析可选参数
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            server->config.workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            server->config.batchSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            struct sockaddr_in upstream;
+            if (!dnsParseAddress(argv[++i], 53, &upstream)) {
+                fprintf(stderr, "错误: 无效的上游地址 %s\n", argv[i]);
+                destroyServer(server);
+                return 1;
+            }
+            if (!addForwarderUpstream(&server->config.forward, &upstream)) {
+                fprintf(stderr, "错误: 上游最多%d个\n", FORWARD_MAX_UPSTREAMS);
+                destroyServer(server);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            server->config.forward.timeoutMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            server->config.forward.maxRetries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            server->config.forward.hedgeMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            server->config.cacheBytes = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            server->config.cacheShards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            server->config.staleSeconds = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-A") == 0) {
+            server->config.pinWorkers = 1;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            server->config.statsPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            server->config.tcpConnections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            if (!parseRateLimit(argv[++i], &server->config.rateLimit)) {
+                fprintf(stderr, "错误: 无效的限速参数 %s\n", argv[i]);
+                destroyServer(server);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            server->config.capturePath = argv[++i];
+        } else if (strcmp(argv[i], "-Z") == 0 && i + 1 < argc) {
+            server->config.captureBytes = (size_t)strtoul(argv[++i], NULL, 10) << 20;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            int level = dnsLogParseLevel(argv[++i]);
+            if (level < 0) {
+                fprintf(stderr, "错误: 无效的日志级别 %s\n", argv[i]);
+                destroyServer(server);
+                return 1;
+            }
+            dnsLogSetLevel((DNSLogLevel)level);
+        } else {
+            fprintf(stderr, "错误: 无效的参数 %s\n", argv[i]);
+            printUsage(argv[0]);
+            destroyServer(server);
+            return 1;
+        }
+    }
+
+    printf("正在初始化服务器...\n");
+    if (!initServer(server, port)) {
+        fprintf(stderr, "错误: 初始化DNS服务器失败\n");
+        destroyServer(server);
+        return 1;
+    }
+
+    // 加载域名-IP映射文件
+    printf("正在加载域名映射文件...\n");
+    if (!loadDomainFile(server, domainFile)) {
+        fprintf(stderr, "错误: 加载域名文件失败\n");
+        destroyServer(server);
+        return 1;
+    }
+
+    printf("DNS服务器启动成功！\n");
+    printf("按Ctrl+C停止服务器，输入reload重新加载域名文件\n");
+
+    activeServer = server;
+#ifndef _WIN32
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignalReload;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGHUP, &action, NULL);
+#endif
+    // 命令线程阻塞在标准输入上，进程退出时随之结束，不需要等待
+    DNSThread controlThread;
+    dnsThreadCreate(&controlThread, controlMain, NULL);
+
+    // 启动DNS服务器
+    startServer(server);
+
+    // 清理资源
+    destroyServer(server);
+    dnsLogShutdown();
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+/**
+ * @file dnsreplay.c
+ * @brief 抓包回放工具
+ * @details 读取服务器用-C写出的抓包文件，把各段的帧按收到查询的时刻合并排序，
+ *          再按原始的时间间隔（可用-x加速或减速，0表示不等待）把查询经UDP发往目标服务器，
+ *          由此在压测时重现生产环境的查询组合和到达节奏。经TCP收到的查询同样经UDP回放。
+ *          文件回绕后各段保留的时段不同，只回放所有段都完整保留的时段。
+ *          帧在读入时复制一份，可以直接回放正在抓包的服务器的文件，但读入瞬间正在写的帧可能不完整。
+ *          每个查询换用新的事务ID，收到应答后统计延迟，并与抓包时的RCODE比较。
+ *          -p只打印帧而不发送。
+ *          用法：dnsreplay <抓包文件> <服务器地址[:端口]> [-x 倍速] [-n 次数] [-t 超时毫秒] [-p]
+ */
+
+#include "dns_capture.h"
+#include "dns_metrics.h"
+#include "dns_platform.h"
+#include "dns_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ID_SPACE 65536
+
+static const char* const pathNames[METRIC_PATH_COUNT] = { "blocked", "local", "cached", "relayed", "failed" };
+
+typedef struct {
+    uint64_t sentNs;       // 0表示空闲
+    uint8_t rcode;         // 抓包时的RCODE
+} Outstanding;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t received;
+    uint64_t lost;
+    uint64_t mismatched;   // RCODE与抓包时不同
+    uint64_t* latencies;
+    size_t latencyCount;
+} ReplayStats;
+
+static int compareFrames(const void* a, const void* b) {
+    const CaptureFrame* x = *(const CaptureFrame* const*)a;
+    const CaptureFrame* y = *(const CaptureFrame* const*)b;
+    if (x->timestampNs != y->timestampNs) return x->timestampNs < y->timestampNs ? -1 : 1;
+    return x < y ? -1 : (x > y);
+}
+
+static int compareU64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y);
+}
+
+static uint64_t percentile(const uint64_t* sorted, size_t count, double p) {
+    if (count == 0) return 0;
+    size_t index = (size_t)(p / 100.0 * (double)(count - 1) + 0.5);
+    return sorted[index];
+}
+
+// 问题部分的域名，解析失败时为"?"
+static void questionName(const CaptureFrame* frame, char* name, size_t size) {
+    const uint8_t* packet = (const uint8_t*)captureQuery(frame);
+    size_t pos = sizeof(struct DNSHeader);
+    size_t out = 0;
+    while (pos < frame->queryLength && packet[pos] != 0 && packet[pos] < 64) {
+        size_t length = packet[pos++];
+        if (pos + length > frame->queryLength || out + length + 2 > size) break;
+        if (out > 0) name[out++] = '.';
+        memcpy(name + out, packet + pos, length);
+        out += length;
+        pos += length;
+    }
+    if (out == 0) {
+        snprintf(name, size, pos < frame->queryLength && packet[pos] == 0 ? "." : "?");
+        return;
+    }
+    name[out] = '\0';
+}
+
+static void printFrame(const CaptureView* view, const CaptureFrame* frame) {
+    char name[256];
+    struct in_addr client;
+    questionName(frame, name, sizeof(name));
+    client.s_addr = frame->client;
+    uint64_t wallMs = view->header->createdMs + (frame->timestampNs - view->header->createdNs) / 1000000;
+    uint8_t rcode = frame->responseLength >= 4 ? (uint8_t)captureResponse(frame)[3] & 0x0F : 0;
+    printf("%llu.%03llu %s:%u %s %s %s rcode=%u %.1fus %u/%u bytes\n",
+           (unsigned long long)(wallMs / 1000), (unsigned long long)(wallMs % 1000),
+           inet_ntoa(client), (unsigned)ntohs(frame->clientPort),
+           frame->transport == CAPTURE_TCP ? "tcp" : "udp",
+           frame->path < METRIC_PATH_COUNT ? pathNames[frame->path] : "?",
+           name, (unsigned)rcode, (double)frame->latencyNs / 1000.0,
+           (unsigned)frame->queryLength, (unsigned)frame->responseLength);
+}
+
+// 收取所有已到达的应答
+static void drainReplies(SOCKET sock, Outstanding* outstanding, ReplayStats* stats) {
+    char buffer[4096];
+    for (;;) {
+        int n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n < (int)sizeof(struct DNSHeader)) return;
+        uint16_t id = (uint16_t)(((uint8_t)buffer[0] << 8) | (uint8_t)buffer[1]);
+        Outstanding* slot = &outstanding[id];
+        if (slot->sentNs == 0) continue;
+        stats->latencies[stats->latencyCount++] = dnsNowNs() - slot->sentNs;
+        if (((uint8_t)buffer[3] & 0x0F) != slot->rcode) stats->mismatched++;
+        slot->sentNs = 0;
+        stats->received++;
+    }
+}
+
+// 等待直到deadline，期间收取应答
+static void waitUntil(SOCKET sock, uint64_t deadline, Outstanding* outstanding, ReplayStats* stats) {
+    for (;;) {
+        drainReplies(sock, outstanding, stats);
+        uint64_t now = dnsNowNs();
+        if (now >= deadline) return;
+        uint64_t waitUs = (deadline - now) / 1000;
+        struct timeval tv;
+        tv.tv_sec = (long)(waitUs / 1000000);
+        tv.tv_usec = (long)(waitUs % 1000000);
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        select((int)sock + 1, &readable, NULL, NULL, &tv);
+    }
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "用法: %s <抓包文件> <服务器地址[:端口]> [选项]\n", program);
+    fprintf(stderr, "  -x <倍速>   回放速度，1为原速，2为两倍速，0为不等待（默认1）\n");
+    fprintf(stderr, "  -n <次数>   整段回放的次数（默认1）\n");
+    fprintf(stderr, "  -t <毫秒>   应答超时（默认1000）\n");
+    fprintf(stderr, "  -p          只打印帧，不发送\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    double speed = 1.0;
+    int loops = 1;
+    int timeoutMs = 1000;
+    int printOnly = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) loops = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) timeoutMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0) printOnly = 1;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (speed < 0 || loops <= 0 || timeoutMs <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CaptureView view;
+    if (!captureOpenView(&view, argv[1])) {
+        fprintf(stderr, "无法读取抓包文件: %s\n", argv[1]);
+        return 1;
+    }
+
+    // 各段内部按时间有序，合并后整体排序
+    size_t count = 0;
+    for (uint32_t s = 0; s < view.header->segmentCount; s++) {
+        count += (size_t)(view.segments[s].frames - view.segments[s].overwritten);
+    }
+    const CaptureFrame** frames = (const CaptureFrame**)malloc((count ? count : 1) * sizeof(*frames));
+    if (!frames) return 1;
+    size_t total = 0;
+    uint64_t windowStart = 0;
+    for (uint32_t s = 0; s < view.header->segmentCount; s++) {
+        CaptureCursor cursor;
+        captureCursorInit(&view, s, &cursor);
+        const CaptureFrame* frame;
+        uint64_t oldest = UINT64_MAX;
+        while (total < count && (frame = captureNext(&cursor)) != NULL) {
+            if (frame->queryLength < sizeof(struct DNSHeader)) continue;
+            frames[total++] = frame;
+            if (frame->timestampNs < oldest) oldest = frame->timestampNs;
+        }
+        // 回绕过的段只保留了最近一段时间，更早的时段里其他段的帧没有它的帧与之对应
+        if (view.segments[s].wrapped && oldest != UINT64_MAX && oldest > windowStart) windowStart = oldest;
+    }
+    size_t kept = 0;
+    uint64_t paths[METRIC_PATH_COUNT] = { 0 };
+    for (size_t i = 0; i < total; i++) {
+        if (frames[i]->timestampNs < windowStart) continue;
+        frames[kept++] = frames[i];
+        if (frames[i]->path < METRIC_PATH_COUNT) paths[frames[i]->path]++;
+    }
+    if (kept < total) fprintf(stderr, "各段保留的时段不同，跳过最早的%zu帧\n", total - kept);
+    total = kept;
+    // 复制到私有内存，服务器仍在写同一个文件时已读出的帧不会被覆盖
+    size_t capacity = (size_t)(view.header->segmentSize * view.header->segmentCount);
+    char* copy = (char*)malloc(capacity);
+    if (!copy) return 1;
+    size_t bytes = 0;
+    kept = 0;
+    for (size_t i = 0; i < total; i++) {
+        uint32_t length = frames[i]->length;
+        if (length < sizeof(CaptureFrame) || length > capacity - bytes) continue;
+        CaptureFrame* frame = (CaptureFrame*)(copy + bytes);
+        memcpy(frame, frames[i], length);
+        if (sizeof(CaptureFrame) + (size_t)frame->queryLength + frame->responseLength > length ||
+            frame->queryLength < sizeof(struct DNSHeader)) {
+            continue;
+        }
+        frames[kept++] = frame;
+        bytes += length;
+    }
+    total = kept;
+    qsort(frames, total, sizeof(*frames), compareFrames);
+    if (total == 0) {
+        fprintf(stderr, "抓包文件中没有帧\n");
+        return 1;
+    }
+    uint64_t spanNs = frames[total - 1]->timestampNs - frames[0]->timestampNs;
+
+    if (printOnly) {
+        for (size_t i = 0; i < total; i++) printFrame(&view, frames[i]);
+        captureCloseView(&view);
+        return 0;
+    }
+
+    printf("%zu帧，跨度%.3f秒（", total, (double)spanNs / 1e9);
+    for (int p = 0; p < METRIC_PATH_COUNT; p++) {
+        printf("%s%s %llu", p ? "，" : "", pathNames[p], (unsigned long long)paths[p]);
+    }
+    printf("）\n");
+
+    if (!dnsNetInit()) return 1;
+    struct sockaddr_in server;
+    if (!dnsParseAddress(argv[2], 53, &server)) {
+        fprintf(stderr, "无效的服务器地址: %s\n", argv[2]);
+        return 1;
+    }
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET || connect(sock, (struct sockaddr*)&server, sizeof(server)) == SOCKET_ERROR ||
+        !dnsSetNonBlocking(sock)) {
+        fprintf(stderr, "创建套接字失败: %d\n", dnsSocketError());
+        return 1;
+    }
+    int bufferSize = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+
+    Outstanding* outstanding = (Outstanding*)calloc(ID_SPACE, sizeof(Outstanding));
+    ReplayStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.latencies = (uint64_t*)malloc(total * (size_t)loops * sizeof(uint64_t));
+    if (!outstanding || !stats.latencies) return 1;
+
+    // 每轮之间留出一个超时时间，使上一轮的应答都已到达或判为丢失
+    uint64_t timeoutNs = (uint64_t)timeoutMs * 1000000ULL;
+    uint64_t scaledSpan = speed > 0 ? (uint64_t)((double)spanNs / speed) : 0;
+    uint64_t start = dnsNowNs();
+    unsigned sinceDrain = 0;
+    char packet[65536];
+    uint16_t nextId = 0;
+    for (int loop = 0; loop < loops; loop++) {
+        uint64_t loopStart = start + (uint64_t)loop * (scaledSpan + timeoutNs);
+        if (loop > 0) waitUntil(sock, loopStart, outstanding, &stats);
+        for (size_t i = 0; i < total; i++) {
+            const CaptureFrame* frame = frames[i];
+            if (speed > 0) {
+                uint64_t due = loopStart + (uint64_t)((double)(frame->timestampNs - frames[0]->timestampNs) / speed);
+                if (due > dnsNowNs()) waitUntil(sock, due, outstanding, &stats);
+            } else if ((++sinceDrain & 63) == 0) {
+                drainReplies(sock, outstanding, &stats);
+            }
+
+            // 事务ID空间用完一圈时仍未应答的查询判为丢失
+            Outstanding* slot = &outstanding[nextId];
+            if (slot->sentNs != 0) stats.lost++;
+            memcpy(packet, captureQuery(frame), frame->queryLength);
+            packet[0] = (char)(nextId >> 8);
+            packet[1] = (char)nextId;
+            slot->sentNs = dnsNowNs();
+            slot->rcode = frame->responseLength >= 4 ? (uint8_t)captureResponse(frame)[3] & 0x0F : 0;
+            if (send(sock, packet, (int)frame->queryLength, 0) == SOCKET_ERROR) {
+                slot->sentNs = 0;
+                stats.lost++;
+            }
+            stats.sent++;
+            nextId++;
+        }
+    }
+    uint64_t sendEnd = dnsNowNs();
+    waitUntil(sock, sendEnd + timeoutNs, outstanding, &stats);
+    for (size_t i = 0; i < ID_SPACE; i++) {
+        if (outstanding[i].sentNs != 0) stats.lost++;
+    }
+
+    double seconds = (double)(sendEnd - start) / 1e9;
+    qsort(stats.latencies, stats.latencyCount, sizeof(uint64_t), compareU64);
+    double p50 = (double)percentile(stats.latencies, stats.latencyCount, 50) / 1000.0;
+    double p99 = (double)percentile(stats.latencies, stats.latencyCount, 99) / 1000.0;
+    double p999 = (double)percentile(stats.latencies, stats.latencyCount, 99.9) / 1000.0;
+    printf("发送 %llu，应答 %llu，丢失 %llu，RCODE不同 %llu\n", (unsigned long long)stats.sent,
+           (unsigned long long)stats.received, (unsigned long long)stats.lost,
+           (unsigned long long)stats.mismatched);
+    printf("发送速率 %.0f qps（原始 %.0f qps），延迟 p50 %.1fus p99 %.1fus p99.9 %.1fus\n",
+           seconds > 0 ? (double)stats.sent / seconds : 0.0,
+           spanNs > 0 ? (double)total * 1e9 / (double)spanNs : 0.0, p50, p99, p999);
+    printf("RESULT frames=%zu sent=%llu received=%llu lost=%llu mismatched=%llu qps=%.0f "
+           "p50_us=%.1f p99_us=%.1f p999_us=%.1f\n",
+           total, (unsigned long long)stats.sent, (unsigned long long)stats.received,
+           (unsigned long long)stats.lost, (unsigned long long)stats.mismatched,
+           seconds > 0 ? (double)stats.sent / seconds : 0.0, p50, p99, p999);
+
+    closesocket(sock);
+    free(outstanding);
+    free(stats.latencies);
+    free(frames);
+    captureCloseView(&view);
+    dnsNetCleanup();
+    return 0;
+}
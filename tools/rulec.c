@@ -0,0 +1,37 @@
+/**
+ * @file rulec.c
+ * @brief 规则库编译工具
+ * @details 把域名映射文件编译为可被服务器直接mmap的二进制镜像。
+ *          用法：rulec <域名映射文件> <输出镜像>
+ *          服务器的域名文件参数指向镜像即可，加载时按文件头自动识别
+ */
+
+#include "dns_ruledb.h"
+#include "dns_platform.h"
+#include <stdio.h>
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "用法: %s <域名映射文件> <输出镜像>\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t start = dnsNowNs();
+    long count = ruleDbCompile(argv[1], argv[2]);
+    if (count < 0) {
+        fprintf(stderr, "编译失败: %s -> %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    // 编译结果立即重新映射校验一遍
+    RuleDb* db = ruleDbOpen(argv[2]);
+    if (!db) {
+        fprintf(stderr, "生成的镜像无法通过校验: %s\n", argv[2]);
+        return 1;
+    }
+    printf("已编译%ld条规则（其中通配/后缀规则%u条），镜像%lu字节，用时%.1f ms\n",
+           count, db->suffixCount, (unsigned long)db->size,
+           (double)(dnsNowNs() - start) / 1e6);
+    ruleDbClose(db);
+    return 0;
+}